@@ -0,0 +1,937 @@
+/*
+ * alloc.c -
+ * Implementation of escape analysis and allocation of objects.
+ * See alloc.h for more information.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "alloc.h"
+#include "env.h"
+#include "stack.h"
+#include "util.h"
+
+const PM_Pass AL_pass = { "alloc", 2, NULL, AL_program, NULL };
+
+/* The largest object placed in a frame, in bytes. */
+#define AL_MAX_SLOT 1024
+
+/* The loop of a variable never assigned. */
+#define AL_UNASSIGNED -2
+/* The loop of code outside every loop. */
+#define AL_NO_LOOP -1
+
+typedef struct AL_Function_ * AL_Function;
+
+/* What the analysis knows of one function of the program. */
+struct AL_Function_ {
+    TR_Function func;
+    AL_Function parent;
+    /* The functions declared directly in func, by name; &AL_ambiguous
+     * for a name declared more than once. */
+    S_Table children;
+    /* The parameters in order, and whether each escapes. */
+    int param_count;
+    F_Var * params;
+    bool * param_escapes;
+    /* The functions found calling func, which must be analyzed again
+     * when one of its parameters turns out to escape. */
+    AL_Function * callers;
+    int caller_count;
+    int caller_capacity;
+    /* The caller recorded last, as each is recorded once in a row. */
+    AL_Function last_caller;
+    bool analyzed;
+    bool queued;
+};
+
+static struct AL_Function_ AL_ambiguous;
+
+typedef struct AL_Program_ {
+    AL_Function * functions;
+    int count;
+    int capacity;
+    /* The library functions, whose names a call may mean instead. */
+    S_Table library;
+} AL_Program;
+
+/* A record or array made in the function analyzed. */
+typedef struct AL_Object_ {
+    TR_Exp exp;
+    /* The innermost loop around it, or AL_NO_LOOP. */
+    int loop;
+    /* The variable it is directly assigned to, or -1. */
+    TR_Temp var;
+} AL_Object;
+
+/* The variables a record is replaced with, one per field in order. */
+typedef struct AL_Scalars_ {
+    int count;
+    int * offsets;
+    F_Var * vars;
+} AL_Scalars;
+
+/* The analysis of one function. Nodes are its temps: those of its
+ * variables, and those the objects it makes are numbered by. Nodes
+ * that one value may reach are merged into a class, which escapes as
+ * a whole. */
+typedef struct AL_Analysis_ {
+    AL_Program * program;
+    AL_Function function;
+    bool record_callers;
+    int node_count;
+    /* Union-find over the nodes; escapes holds for a class's root. */
+    int * parent;
+    bool * escapes;
+    /* For each variable: how often it is assigned (a parameter once
+     * on entry), the last value assigned, the innermost loop around
+     * all its assignments, how often it is read, and how often of those
+     * as the record whose field is accessed. */
+    int * assigns;
+    TR_Exp * values;
+    int * assign_loop;
+    int * uses;
+    int * field_uses;
+    /* The loops met so far, each with the loop around it and its depth. */
+    int * loop_parents;
+    int * loop_depths;
+    int loop_count;
+    int loop_capacity;
+    int loop;
+    AL_Object * objects;
+    int object_count;
+    int object_capacity;
+} AL_Analysis;
+
+static int AL_value(AL_Analysis * analysis, TR_Exp exp);
+static void AL_stm(AL_Analysis * analysis, TR_Stm stm);
+
+/* Collecting */
+
+static AL_Function AL_collect(AL_Program * program, TR_Function func, AL_Function parent) {
+    AL_Function function = malloc_checked(sizeof(*function));
+    memset(function, 0, sizeof(*function));
+    function->func = func;
+    function->parent = parent;
+    for (TR_VarList params = func->frame->parameters; params; params = params->tail) {
+        ++function->param_count;
+    }
+    int count = function->param_count;
+    if (count) {
+        function->params = malloc_checked(count * sizeof(*function->params));
+        function->param_escapes = malloc_checked(count * sizeof(*function->param_escapes));
+    }
+    // The frame lists its parameters last first.
+    int i = count;
+    for (TR_VarList params = func->frame->parameters; params; params = params->tail) {
+        --i;
+        function->params[i] = params->head;
+        // The frame of one that escapes is reached by nested functions.
+        function->param_escapes[i] = params->head->escape;
+    }
+    if (program->count == program->capacity) {
+        program->capacity = program->capacity ? 2 * program->capacity : 64;
+        program->functions = realloc_checked(program->functions,
+                program->capacity * sizeof(*program->functions));
+    }
+    program->functions[program->count++] = function;
+    for (TR_FunctionList children = func->children; children; children = children->tail) {
+        AL_Function child = AL_collect(program, children->head, function);
+        if (!function->children) {
+            function->children = S_empty();
+        }
+        S_Symbol name = children->head->name;
+        S_enter(function->children, name, S_look(function->children, name) ? &AL_ambiguous : child);
+    }
+    return function;
+}
+
+/* The function a call from analysis's function to name runs, or NULL
+ * if that cannot be told apart from another by name alone: a call
+ * names the nearest function in scope, which may be declared after it
+ * in a let, so a name declared at two levels, or twice at one, or
+ * also in the library, is not resolved. */
+static AL_Function AL_callee(AL_Analysis * analysis, S_Symbol name) {
+    AL_Function found = NULL;
+    for (AL_Function function = analysis->function; function; function = function->parent) {
+        AL_Function child = function->children ? S_look(function->children, name) : NULL;
+        if (child) {
+            if (found || child == &AL_ambiguous) {
+                return NULL;
+            }
+            found = child;
+        }
+    }
+    return found && !S_look(analysis->program->library, name) ? found : NULL;
+}
+
+/* Analysis */
+
+static int AL_find(AL_Analysis * analysis, int node) {
+    int * parent = analysis->parent;
+    while (parent[node] != node) {
+        parent[node] = parent[parent[node]];
+        node = parent[node];
+    }
+    return node;
+}
+
+/* Merge the classes of two nodes, either of which may be -1 for
+ * none; returns the merged class's node. */
+static int AL_union(AL_Analysis * analysis, int x, int y) {
+    if (x < 0) {
+        return y;
+    }
+    if (y < 0) {
+        return x;
+    }
+    x = AL_find(analysis, x);
+    y = AL_find(analysis, y);
+    if (x != y) {
+        analysis->parent[y] = x;
+        analysis->escapes[x] = analysis->escapes[x] || analysis->escapes[y];
+    }
+    return x;
+}
+
+static void AL_escape(AL_Analysis * analysis, int node) {
+    if (node >= 0) {
+        analysis->escapes[AL_find(analysis, node)] = true;
+    }
+}
+
+static int AL_loop_depth(AL_Analysis * analysis, int loop) {
+    return loop < 0 ? 0 : analysis->loop_depths[loop];
+}
+
+/* The innermost loop around both loops, either of which may be
+ * AL_UNASSIGNED for none. */
+static int AL_meet(AL_Analysis * analysis, int x, int y) {
+    if (x == AL_UNASSIGNED) {
+        return y;
+    }
+    if (y == AL_UNASSIGNED) {
+        return x;
+    }
+    while (x != y) {
+        if (AL_loop_depth(analysis, x) >= AL_loop_depth(analysis, y)) {
+            x = analysis->loop_parents[x];
+        } else {
+            y = analysis->loop_parents[y];
+        }
+    }
+    return x;
+}
+
+static void AL_enter_loop(AL_Analysis * analysis) {
+    if (analysis->loop_count == analysis->loop_capacity) {
+        analysis->loop_capacity = analysis->loop_capacity ? 2 * analysis->loop_capacity : 16;
+        int size = analysis->loop_capacity * sizeof(int);
+        analysis->loop_parents = realloc_checked(analysis->loop_parents, size);
+        analysis->loop_depths = realloc_checked(analysis->loop_depths, size);
+    }
+    int loop = analysis->loop_count++;
+    analysis->loop_parents[loop] = analysis->loop;
+    analysis->loop_depths[loop] = AL_loop_depth(analysis, analysis->loop) + 1;
+    analysis->loop = loop;
+}
+
+static void AL_leave_loop(AL_Analysis * analysis) {
+    analysis->loop = analysis->loop_parents[analysis->loop];
+}
+
+/* The node of a variable in a temp, or -1 for any other location. */
+static int AL_temp(AL_Analysis * analysis, TR_Exp exp) {
+    return exp && exp->kind == TR_MEM_EXP && exp->reg >= 0 && exp->reg < analysis->node_count
+        ? exp->reg : -1;
+}
+
+/* Assign the value of node (-1 for none) to the variable in temp. */
+static void AL_assign(AL_Analysis * analysis, int temp, int node, TR_Exp value) {
+    ++analysis->assigns[temp];
+    analysis->values[temp] = value;
+    analysis->assign_loop[temp] = AL_meet(analysis, analysis->assign_loop[temp], analysis->loop);
+    AL_union(analysis, temp, node);
+    // An object is recorded once its fields have been.
+    AL_Object * last = analysis->object_count ? &analysis->objects[analysis->object_count - 1] : NULL;
+    if (last && last->exp == value) {
+        last->var = temp;
+    }
+}
+
+/* Visit a location that is read or written. Reaching a field or an
+ * element reads the variable holding the object, but takes nothing
+ * from it anywhere. */
+static void AL_location(AL_Analysis * analysis, TR_Exp exp) {
+    if (!exp) {
+        return;
+    }
+    TR_Exp holder = NULL;
+    if (exp->kind == TR_FIELD_EXP) {
+        holder = exp->u.field.var;
+    } else if (exp->kind == TR_SUBSCRIPT_EXP) {
+        holder = exp->u.subscript.var;
+        AL_value(analysis, exp->u.subscript.index);
+    } else {
+        AL_value(analysis, exp);
+        return;
+    }
+    int temp = AL_temp(analysis, holder);
+    if (temp < 0) {
+        AL_location(analysis, holder);
+        return;
+    }
+    ++analysis->uses[temp];
+    if (exp->kind == TR_FIELD_EXP) {
+        ++analysis->field_uses[temp];
+    }
+}
+
+static void AL_call(AL_Analysis * analysis, S_Symbol name, TR_ExpList args) {
+    AL_Function callee = AL_callee(analysis, name);
+    if (callee && analysis->record_callers && callee->last_caller != analysis->function) {
+        if (callee->caller_count == callee->caller_capacity) {
+            callee->caller_capacity = callee->caller_capacity ? 2 * callee->caller_capacity : 4;
+            callee->callers = realloc_checked(callee->callers,
+                    callee->caller_capacity * sizeof(*callee->callers));
+        }
+        callee->callers[callee->caller_count++] = analysis->function;
+        callee->last_caller = analysis->function;
+    }
+    for (int i = 0, n = TR_exp_count(args); i < n; ++i) {
+        int node = AL_value(analysis, args->items[i]);
+        if (!callee || i >= callee->param_count || callee->param_escapes[i]) {
+            AL_escape(analysis, node);
+        }
+    }
+}
+
+/* Visit stms; returns the node of the value of the last, if it is an
+ * expression. */
+static int AL_stms(AL_Analysis * analysis, TR_StmList stms) {
+    int n = TR_stm_count(stms);
+    for (int i = 0; i < n - 1; ++i) {
+        AL_stm(analysis, stms->items[i]);
+    }
+    TR_Stm last = n ? stms->items[n - 1] : NULL;
+    if (last && last->kind == TR_EXP_STM) {
+        return AL_value(analysis, last->u.exp);
+    }
+    AL_stm(analysis, last);
+    return -1;
+}
+
+static int AL_object(AL_Analysis * analysis, TR_Exp exp) {
+    if (exp->reg < 0 || exp->reg >= analysis->node_count) {
+        return -1;
+    }
+    if (analysis->object_count == analysis->object_capacity) {
+        analysis->object_capacity = analysis->object_capacity ? 2 * analysis->object_capacity : 16;
+        analysis->objects = realloc_checked(analysis->objects,
+                analysis->object_capacity * sizeof(*analysis->objects));
+    }
+    analysis->objects[analysis->object_count++] = (AL_Object) { exp, analysis->loop, -1 };
+    return exp->reg;
+}
+
+/* A call of AL_value or AL_stm continued on a new stack segment. */
+typedef struct AL_DeepCall_ {
+    AL_Analysis * analysis;
+    TR_Exp exp;
+    TR_Stm stm;
+    int result;
+} AL_DeepCall;
+
+static void AL_run_deep_call(void * arg) {
+    AL_DeepCall * call = arg;
+    if (call->stm) {
+        AL_stm(call->analysis, call->stm);
+    } else {
+        call->result = AL_value(call->analysis, call->exp);
+    }
+}
+
+/* Visit exp; returns the node of the class of objects its value may
+ * be the address of, or -1 if it cannot be one made here. */
+static int AL_value(AL_Analysis * analysis, TR_Exp exp) {
+    if (!exp) {
+        return -1;
+    }
+    if (ST_low()) {
+        AL_DeepCall call = { analysis, exp, NULL, -1 };
+        ST_call(AL_run_deep_call, &call);
+        return call.result;
+    }
+    switch (exp->kind) {
+        case TR_NUM_EXP:
+        case TR_STRING_EXP:
+            return -1;
+        case TR_MEM_EXP:
+            {
+                int temp = AL_temp(analysis, exp);
+                if (temp >= 0) {
+                    ++analysis->uses[temp];
+                }
+                return temp;
+            }
+        case TR_VAR_EXP:
+            if (exp->u.var && exp->u.var->kind == TR_MEM_EXP) {
+                return AL_value(analysis, exp->u.var);
+            }
+            AL_location(analysis, exp->u.var);
+            return -1;
+        case TR_FIELD_EXP:
+        case TR_SUBSCRIPT_EXP:
+            {
+                // The address of a field or an element points into its object.
+                AL_location(analysis, exp);
+                TR_Exp holder = exp->kind == TR_FIELD_EXP ? exp->u.field.var : exp->u.subscript.var;
+                int temp = AL_temp(analysis, holder);
+                if (temp >= 0) {
+                    ++analysis->uses[temp];
+                }
+                return temp;
+            }
+        case TR_RECORD_EXP:
+            for (int i = 0, n = TR_exp_count(exp->u.record.fields); i < n; ++i) {
+                AL_escape(analysis, AL_value(analysis, exp->u.record.fields->items[i]));
+            }
+            return AL_object(analysis, exp);
+        case TR_ARRAY_EXP:
+            AL_escape(analysis, AL_value(analysis, exp->u.array.init));
+            return AL_object(analysis, exp);
+        case TR_ARITH_OP_EXP:
+            AL_value(analysis, exp->u.arith.left);
+            AL_value(analysis, exp->u.arith.right);
+            return -1;
+        case TR_DIV_OP_EXP:
+            AL_value(analysis, exp->u.div.left);
+            AL_value(analysis, exp->u.div.right);
+            return -1;
+        case TR_REL_OP_EXP:
+            AL_value(analysis, exp->u.rel.left);
+            AL_value(analysis, exp->u.rel.right);
+            return -1;
+        case TR_IF_EXP:
+            AL_value(analysis, exp->u.if_.test);
+            AL_value(analysis, exp->u.if_.true_branch);
+            return -1;
+        case TR_IF_ELSE_EXP:
+            {
+                AL_value(analysis, exp->u.if_else.test);
+                int true_node = AL_value(analysis, exp->u.if_else.true_branch);
+                int false_node = AL_value(analysis, exp->u.if_else.false_branch);
+                return AL_union(analysis, true_node, false_node);
+            }
+        case TR_FCALL_EXP:
+            AL_call(analysis, exp->u.fcall.name, exp->u.fcall.args);
+            return -1;
+        case TR_SEQ_EXP:
+            return AL_stms(analysis, exp->u.seq);
+    }
+    return -1;
+}
+
+static void AL_stm(AL_Analysis * analysis, TR_Stm stm) {
+    if (!stm) {
+        return;
+    }
+    if (ST_low()) {
+        AL_DeepCall call = { analysis, NULL, stm, -1 };
+        ST_call(AL_run_deep_call, &call);
+        return;
+    }
+    switch (stm->kind) {
+        case TR_ASSIGN_STM:
+            {
+                int node = AL_value(analysis, stm->u.assign.value);
+                int temp = AL_temp(analysis, stm->u.assign.var);
+                if (temp >= 0) {
+                    AL_assign(analysis, temp, node, stm->u.assign.value);
+                } else {
+                    // Anything stored in memory may be read from anywhere.
+                    AL_location(analysis, stm->u.assign.var);
+                    AL_escape(analysis, node);
+                }
+                break;
+            }
+        case TR_PCALL_STM:
+            AL_call(analysis, stm->u.pcall.name, stm->u.pcall.args);
+            break;
+        case TR_SEQ_STM:
+            AL_stms(analysis, stm->u.seq);
+            break;
+        case TR_IF_STM:
+            AL_value(analysis, stm->u.if_.test);
+            AL_stm(analysis, stm->u.if_.true_branch);
+            break;
+        case TR_IF_ELSE_STM:
+            AL_value(analysis, stm->u.if_else.test);
+            AL_stm(analysis, stm->u.if_else.true_branch);
+            AL_stm(analysis, stm->u.if_else.false_branch);
+            break;
+        case TR_WHILE_STM:
+            AL_enter_loop(analysis);
+            AL_value(analysis, stm->u.while_.test);
+            AL_stm(analysis, stm->u.while_.body);
+            AL_leave_loop(analysis);
+            break;
+        case TR_FOR_STM:
+            {
+                TR_Exp var = stm->u.for_.var;
+                if (var && var->kind == TR_VAR_EXP) {
+                    var = var->u.var;
+                }
+                AL_value(analysis, stm->u.for_.lo);
+                AL_value(analysis, stm->u.for_.hi);
+                int temp = AL_temp(analysis, var);
+                if (temp >= 0) {
+                    AL_assign(analysis, temp, -1, NULL);
+                } else {
+                    AL_location(analysis, var);
+                }
+                AL_enter_loop(analysis);
+                AL_stm(analysis, stm->u.for_.body);
+                AL_leave_loop(analysis);
+                break;
+            }
+        case TR_BREAK_STM:
+            break;
+        case TR_EXP_STM:
+            AL_value(analysis, stm->u.exp);
+            break;
+    }
+}
+
+/* Analyze function against the current summaries of its callees. */
+static void AL_analyze(AL_Analysis * analysis, AL_Program * program, AL_Function function,
+        bool record_callers) {
+    memset(analysis, 0, sizeof(*analysis));
+    analysis->program = program;
+    analysis->function = function;
+    analysis->record_callers = record_callers;
+    int count = analysis->node_count = function->func->temp_count;
+    if (count) {
+        analysis->parent = malloc_checked(count * sizeof(int));
+        analysis->escapes = malloc_checked(count * sizeof(bool));
+        analysis->assigns = malloc_checked(count * sizeof(int));
+        analysis->values = malloc_checked(count * sizeof(TR_Exp));
+        analysis->assign_loop = malloc_checked(count * sizeof(int));
+        analysis->uses = malloc_checked(count * sizeof(int));
+        analysis->field_uses = malloc_checked(count * sizeof(int));
+    }
+    for (int i = 0; i < count; ++i) {
+        analysis->parent[i] = i;
+        analysis->escapes[i] = false;
+        analysis->assigns[i] = 0;
+        analysis->values[i] = NULL;
+        analysis->assign_loop[i] = AL_UNASSIGNED;
+        analysis->uses[i] = 0;
+        analysis->field_uses[i] = 0;
+    }
+    analysis->loop = AL_NO_LOOP;
+    // A parameter in a temp is assigned its argument on entry.
+    for (int i = 0; i < function->param_count; ++i) {
+        int temp = function->params[i]->temp;
+        if (temp >= 0 && temp < count) {
+            AL_assign(analysis, temp, -1, NULL);
+        }
+    }
+    // The function's value is returned.
+    AL_escape(analysis, AL_stms(analysis, function->func->body));
+}
+
+/* Record which of function's parameters escape, by analysis; true if
+ * one was not known to before. */
+static bool AL_summarize(AL_Analysis * analysis, AL_Function function) {
+    bool changed = false;
+    for (int i = 0; i < function->param_count; ++i) {
+        int temp = function->params[i]->temp;
+        if (!function->param_escapes[i] && (temp < 0 || temp >= analysis->node_count
+                    || analysis->escapes[AL_find(analysis, temp)])) {
+            function->param_escapes[i] = true;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+static void AL_free(AL_Analysis * analysis) {
+    free(analysis->parent);
+    free(analysis->escapes);
+    free(analysis->assigns);
+    free(analysis->values);
+    free(analysis->assign_loop);
+    free(analysis->uses);
+    free(analysis->field_uses);
+    free(analysis->loop_parents);
+    free(analysis->loop_depths);
+    free(analysis->objects);
+}
+
+/* Scalar replacement */
+
+typedef struct AL_Rewriter_ {
+    AL_Scalars ** scalars;
+    int count;
+    int nesting_level;
+} AL_Rewriter;
+
+static TR_Exp AL_rewrite_exp(AL_Rewriter * rewriter, TR_Exp exp);
+static TR_Stm AL_rewrite_stm(AL_Rewriter * rewriter, TR_Stm stm);
+
+static T_Type AL_actual_type(T_Type type) {
+    while (type && type->kind == T_NAME) {
+        type = type->u.name.type;
+    }
+    return type;
+}
+
+/* The variables record, assigned to var, is replaced with, or NULL if
+ * var's type does not lay out a field for each of record's. */
+static AL_Scalars * AL_make_scalars(TR_Function func, F_Var var, TR_Exp record) {
+    T_Type type = var ? AL_actual_type(var->type) : NULL;
+    if (!type || type->kind != T_RECORD) {
+        return NULL;
+    }
+    int count = 0;
+    for (T_FieldList fields = type->u.record; fields; fields = fields->tail) {
+        ++count;
+    }
+    if (count != TR_exp_count(record->u.record.fields)) {
+        return NULL;
+    }
+    AL_Scalars * scalars = malloc_checked(sizeof(*scalars));
+    scalars->count = count;
+    scalars->offsets = count ? malloc_checked(count * sizeof(int)) : NULL;
+    scalars->vars = count ? malloc_checked(count * sizeof(F_Var)) : NULL;
+    // Fields are laid out as semantic analysis does.
+    int offset = 0;
+    int i = 0;
+    for (T_FieldList fields = type->u.record; fields; fields = fields->tail, ++i) {
+        string var_name = S_name(var->name);
+        string field_name = S_name(fields->head->name);
+        string name = malloc_checked(strlen(var_name) + strlen(field_name) + 2);
+        sprintf(name, "%s.%s", var_name, field_name);
+        F_Var scalar = make_F_Var(make_S_Symbol(name), AL_actual_type(fields->head->type),
+                func->temp_count++);
+        F_add_var(func->frame, scalar);
+        scalars->offsets[i] = offset;
+        scalars->vars[i] = scalar;
+        offset += T_size(fields->head->type);
+    }
+    return scalars;
+}
+
+static AL_Scalars * AL_scalars_of(AL_Rewriter * rewriter, TR_Exp location) {
+    if (!location || location->kind != TR_MEM_EXP || location->reg < 0
+            || location->reg >= rewriter->count) {
+        return NULL;
+    }
+    return rewriter->scalars[location->reg];
+}
+
+static void AL_rewrite_exps(AL_Rewriter * rewriter, TR_ExpList exps) {
+    for (int i = 0, n = TR_exp_count(exps); i < n; ++i) {
+        exps->items[i] = AL_rewrite_exp(rewriter, exps->items[i]);
+    }
+}
+
+static void AL_rewrite_stms(AL_Rewriter * rewriter, TR_StmList stms) {
+    for (int i = 0, n = TR_stm_count(stms); i < n; ++i) {
+        stms->items[i] = AL_rewrite_stm(rewriter, stms->items[i]);
+    }
+}
+
+/* A call of AL_rewrite_exp or AL_rewrite_stm continued on a new stack segment. */
+typedef struct AL_DeepRewrite_ {
+    AL_Rewriter * rewriter;
+    TR_Exp exp;
+    TR_Stm stm;
+    TR_Exp exp_result;
+    TR_Stm stm_result;
+} AL_DeepRewrite;
+
+static void AL_run_deep_rewrite(void * arg) {
+    AL_DeepRewrite * call = arg;
+    if (call->stm) {
+        call->stm_result = AL_rewrite_stm(call->rewriter, call->stm);
+    } else {
+        call->exp_result = AL_rewrite_exp(call->rewriter, call->exp);
+    }
+}
+
+static TR_Exp AL_rewrite_exp(AL_Rewriter * rewriter, TR_Exp exp) {
+    if (!exp) {
+        return NULL;
+    }
+    if (ST_low()) {
+        AL_DeepRewrite call = { rewriter, exp, NULL, NULL, NULL };
+        ST_call(AL_run_deep_rewrite, &call);
+        return call.exp_result;
+    }
+    switch (exp->kind) {
+        case TR_NUM_EXP:
+        case TR_STRING_EXP:
+        case TR_MEM_EXP:
+            break;
+        case TR_VAR_EXP:
+            exp->u.var = AL_rewrite_exp(rewriter, exp->u.var);
+            break;
+        case TR_FIELD_EXP:
+            {
+                AL_Scalars * scalars = AL_scalars_of(rewriter, exp->u.field.var);
+                for (int i = 0; scalars && i < scalars->count; ++i) {
+                    if (scalars->offsets[i] == exp->u.field.field_offset) {
+                        return make_TR_VarMemExp(scalars->vars[i], rewriter->nesting_level);
+                    }
+                }
+                exp->u.field.var = AL_rewrite_exp(rewriter, exp->u.field.var);
+                break;
+            }
+        case TR_SUBSCRIPT_EXP:
+            exp->u.subscript.var = AL_rewrite_exp(rewriter, exp->u.subscript.var);
+            exp->u.subscript.index = AL_rewrite_exp(rewriter, exp->u.subscript.index);
+            break;
+        case TR_RECORD_EXP:
+            AL_rewrite_exps(rewriter, exp->u.record.fields);
+            break;
+        case TR_ARRAY_EXP:
+            exp->u.array.init = AL_rewrite_exp(rewriter, exp->u.array.init);
+            break;
+        case TR_ARITH_OP_EXP:
+            exp->u.arith.left = AL_rewrite_exp(rewriter, exp->u.arith.left);
+            exp->u.arith.right = AL_rewrite_exp(rewriter, exp->u.arith.right);
+            break;
+        case TR_DIV_OP_EXP:
+            exp->u.div.left = AL_rewrite_exp(rewriter, exp->u.div.left);
+            exp->u.div.right = AL_rewrite_exp(rewriter, exp->u.div.right);
+            break;
+        case TR_REL_OP_EXP:
+            exp->u.rel.left = AL_rewrite_exp(rewriter, exp->u.rel.left);
+            exp->u.rel.right = AL_rewrite_exp(rewriter, exp->u.rel.right);
+            break;
+        case TR_IF_EXP:
+            exp->u.if_.test = AL_rewrite_exp(rewriter, exp->u.if_.test);
+            exp->u.if_.true_branch = AL_rewrite_exp(rewriter, exp->u.if_.true_branch);
+            break;
+        case TR_IF_ELSE_EXP:
+            exp->u.if_else.test = AL_rewrite_exp(rewriter, exp->u.if_else.test);
+            exp->u.if_else.true_branch = AL_rewrite_exp(rewriter, exp->u.if_else.true_branch);
+            exp->u.if_else.false_branch = AL_rewrite_exp(rewriter, exp->u.if_else.false_branch);
+            break;
+        case TR_FCALL_EXP:
+            AL_rewrite_exps(rewriter, exp->u.fcall.args);
+            break;
+        case TR_SEQ_EXP:
+            AL_rewrite_stms(rewriter, exp->u.seq);
+            break;
+    }
+    return exp;
+}
+
+static TR_Stm AL_rewrite_stm(AL_Rewriter * rewriter, TR_Stm stm) {
+    if (!stm) {
+        return NULL;
+    }
+    if (ST_low()) {
+        AL_DeepRewrite call = { rewriter, NULL, stm, NULL, NULL };
+        ST_call(AL_run_deep_rewrite, &call);
+        return call.stm_result;
+    }
+    switch (stm->kind) {
+        case TR_ASSIGN_STM:
+            {
+                AL_Scalars * scalars = AL_scalars_of(rewriter, stm->u.assign.var);
+                TR_Exp value = stm->u.assign.value;
+                if (scalars && value && value->kind == TR_RECORD_EXP) {
+                    // The fields are evaluated in order, as before.
+                    TR_StmList stms = NULL;
+                    for (int i = 0; i < scalars->count; ++i) {
+                        TR_Exp init = AL_rewrite_exp(rewriter, value->u.record.fields->items[i]);
+                        stms = TR_add_stm(stms, make_TR_AssignStm(init,
+                                    make_TR_VarMemExp(scalars->vars[i], rewriter->nesting_level)));
+                    }
+                    return make_TR_SeqStm(stms);
+                }
+                stm->u.assign.value = AL_rewrite_exp(rewriter, value);
+                stm->u.assign.var = AL_rewrite_exp(rewriter, stm->u.assign.var);
+                break;
+            }
+        case TR_PCALL_STM:
+            AL_rewrite_exps(rewriter, stm->u.pcall.args);
+            break;
+        case TR_SEQ_STM:
+            AL_rewrite_stms(rewriter, stm->u.seq);
+            break;
+        case TR_IF_STM:
+            stm->u.if_.test = AL_rewrite_exp(rewriter, stm->u.if_.test);
+            stm->u.if_.true_branch = AL_rewrite_stm(rewriter, stm->u.if_.true_branch);
+            break;
+        case TR_IF_ELSE_STM:
+            stm->u.if_else.test = AL_rewrite_exp(rewriter, stm->u.if_else.test);
+            stm->u.if_else.true_branch = AL_rewrite_stm(rewriter, stm->u.if_else.true_branch);
+            stm->u.if_else.false_branch = AL_rewrite_stm(rewriter, stm->u.if_else.false_branch);
+            break;
+        case TR_WHILE_STM:
+            stm->u.while_.test = AL_rewrite_exp(rewriter, stm->u.while_.test);
+            stm->u.while_.body = AL_rewrite_stm(rewriter, stm->u.while_.body);
+            break;
+        case TR_FOR_STM:
+            stm->u.for_.var = AL_rewrite_exp(rewriter, stm->u.for_.var);
+            stm->u.for_.lo = AL_rewrite_exp(rewriter, stm->u.for_.lo);
+            stm->u.for_.hi = AL_rewrite_exp(rewriter, stm->u.for_.hi);
+            stm->u.for_.body = AL_rewrite_stm(rewriter, stm->u.for_.body);
+            break;
+        case TR_BREAK_STM:
+            break;
+        case TR_EXP_STM:
+            stm->u.exp = AL_rewrite_exp(rewriter, stm->u.exp);
+            break;
+    }
+    return stm;
+}
+
+/* Placement */
+
+/* The variables of func, by temp. */
+static F_Var * AL_vars_by_temp(TR_Function func, int count) {
+    F_Var * vars = malloc_checked(count * sizeof(*vars));
+    memset(vars, 0, count * sizeof(*vars));
+    TR_VarList lists[] = { func->frame->parameters, func->frame->variables };
+    for (int i = 0; i < 2; ++i) {
+        for (TR_VarList list = lists[i]; list; list = list->tail) {
+            if (list->head->temp >= 0 && list->head->temp < count) {
+                vars[list->head->temp] = list->head;
+            }
+        }
+    }
+    return vars;
+}
+
+/* Replace or place in the frame each object of analysis's function
+ * that does not escape. */
+static void AL_place(AL_Analysis * analysis) {
+    TR_Function func = analysis->function->func;
+    int count = analysis->node_count;
+    if (!analysis->object_count) {
+        return;
+    }
+    // The innermost loop around every assignment to a class's variables,
+    // and how many variables and objects the class has.
+    int * class_loop = malloc_checked(count * sizeof(int));
+    int * members = malloc_checked(count * sizeof(int));
+    for (int i = 0; i < count; ++i) {
+        class_loop[i] = AL_UNASSIGNED;
+        members[i] = 0;
+    }
+    for (int i = 0; i < count; ++i) {
+        if (analysis->assign_loop[i] != AL_UNASSIGNED) {
+            int root = AL_find(analysis, i);
+            class_loop[root] = AL_meet(analysis, class_loop[root], analysis->assign_loop[i]);
+            ++members[root];
+        }
+    }
+    for (int i = 0; i < analysis->object_count; ++i) {
+        ++members[AL_find(analysis, analysis->objects[i].exp->reg)];
+    }
+    F_Var * vars = AL_vars_by_temp(func, count);
+    AL_Rewriter rewriter = { NULL, count, func->frame->nesting_level };
+    for (int i = 0; i < analysis->object_count; ++i) {
+        AL_Object * object = &analysis->objects[i];
+        TR_Exp exp = object->exp;
+        int root = AL_find(analysis, exp->reg);
+        int * slot = exp->kind == TR_RECORD_EXP ? &exp->u.record.offset : &exp->u.array.offset;
+        if (analysis->escapes[root] || *slot >= 0) {
+            continue;
+        }
+        // A record reached only through the fields of the one variable
+        // it initializes, which is assigned nothing else.
+        TR_Temp var = object->var;
+        if (exp->kind == TR_RECORD_EXP && var >= 0 && members[root] == 2
+                && analysis->assigns[var] == 1
+                && analysis->uses[var] == analysis->field_uses[var]) {
+            AL_Scalars * scalars = AL_make_scalars(func, vars[var], exp);
+            if (scalars) {
+                if (!rewriter.scalars) {
+                    rewriter.scalars = malloc_checked(count * sizeof(*rewriter.scalars));
+                    memset(rewriter.scalars, 0, count * sizeof(*rewriter.scalars));
+                }
+                rewriter.scalars[var] = scalars;
+                continue;
+            }
+        }
+        if (exp->size <= 0 || exp->size > AL_MAX_SLOT
+                || AL_meet(analysis, object->loop, class_loop[root]) != object->loop) {
+            continue;
+        }
+        S_Symbol name = var >= 0 && vars[var] ? vars[var]->name
+            : make_S_Symbol(exp->kind == TR_RECORD_EXP ? "record" : "array");
+        F_Var slot_var = make_F_Object(name, exp->size);
+        F_add_object(func->frame, slot_var);
+        *slot = slot_var->offset;
+    }
+    if (rewriter.scalars) {
+        AL_rewrite_stms(&rewriter, func->body);
+        for (int i = 0; i < count; ++i) {
+            if (rewriter.scalars[i]) {
+                free(rewriter.scalars[i]->offsets);
+                free(rewriter.scalars[i]->vars);
+                free(rewriter.scalars[i]);
+            }
+        }
+        free(rewriter.scalars);
+    }
+    free(vars);
+    free(class_loop);
+    free(members);
+}
+
+void AL_program(TR_Function main_) {
+    AL_Program program = { NULL, 0, 0, E_base_venv() };
+    AL_collect(&program, main_, NULL);
+    // Summarize the parameters, analyzing each function once and then
+    // again whenever a parameter of a function it calls turns out to
+    // escape. Nested functions come after their parents, so taking the
+    // last first mostly meets callees before their callers.
+    AL_Function * work = malloc_checked(program.count * sizeof(*work));
+    int work_count = 0;
+    for (int i = 0; i < program.count; ++i) {
+        work[work_count++] = program.functions[i];
+        program.functions[i]->queued = true;
+    }
+    while (work_count) {
+        AL_Function function = work[--work_count];
+        function->queued = false;
+        AL_Analysis analysis;
+        AL_analyze(&analysis, &program, function, !function->analyzed);
+        function->analyzed = true;
+        if (AL_summarize(&analysis, function)) {
+            for (int i = 0; i < function->caller_count; ++i) {
+                AL_Function caller = function->callers[i];
+                if (!caller->queued) {
+                    caller->queued = true;
+                    work[work_count++] = caller;
+                }
+            }
+        }
+        AL_free(&analysis);
+    }
+    free(work);
+    for (int i = 0; i < program.count; ++i) {
+        AL_Function function = program.functions[i];
+        AL_Analysis analysis;
+        AL_analyze(&analysis, &program, function, false);
+        AL_place(&analysis);
+        AL_free(&analysis);
+    }
+    for (int i = 0; i < program.count; ++i) {
+        free(program.functions[i]->params);
+        free(program.functions[i]->param_escapes);
+        free(program.functions[i]->callers);
+        free(program.functions[i]);
+    }
+    free(program.functions);
+}
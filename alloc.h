@@ -0,0 +1,37 @@
+/*
+ * alloc.h -
+ * Escape analysis of records and arrays, and their allocation off the
+ * heap. An object escapes if its address may outlive the activation
+ * of the function that made it: if the address is stored in memory
+ * (a field, an element, or a variable in the frame, which nested
+ * functions reach), returned, or passed for a parameter that escapes
+ * in turn. Whether each parameter escapes is summarized per function
+ * and iterated to a fixed point over the whole program, so that
+ * passing an object down a chain of calls keeps it local. Addresses
+ * are followed through the variables kept in temps (see escape.h)
+ * flow-insensitively: the objects and variables one value may reach
+ * share one fate.
+ * A record that does not escape, initializes a variable assigned
+ * nothing else, and is only ever reached through that variable's
+ * fields becomes a variable per field (scalar replacement). Any other
+ * object that does not escape gets a slot in its function's frame,
+ * sized from T_size like the rest of the frame, unless it is made in
+ * a loop and a variable it reaches is assigned outside that loop: each
+ * run of the allocation reuses the slot, so an object must not be
+ * reachable after the iteration that made it. Arrays qualify only
+ * when their length is constant, and objects only up to a bounded
+ * size, so frames stay small.
+ * All types and functions declared in this module begin with "AL_".
+ */
+
+#pragma once
+
+#include "pass_manager.h"
+#include "translate.h"
+
+/* Replace or place in frames the objects of main_ and every function
+ * nested in it that do not escape. */
+void AL_program(TR_Function main_);
+
+/* AL_program, as the -O2 pass "alloc". */
+extern const PM_Pass AL_pass;
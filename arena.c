@@ -0,0 +1,58 @@
+/*
+ * arena.c -
+ * Implementation of bump allocation for IR nodes.
+ * See arena.h for more information.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "util.h"
+
+#define AR_CHUNK_SIZE (256 << 10)
+/* Allocations larger than this get a chunk of their own,
+ * so that a chunk is never mostly wasted. */
+#define AR_LARGE (AR_CHUNK_SIZE / 8)
+#define AR_ALIGNMENT 8
+
+/* The unused part of the calling thread's current chunk. */
+static __thread char * next = NULL;
+static __thread char * end = NULL;
+/* The calling thread's latest allocation from its chunk. */
+static __thread char * latest = NULL;
+
+static int AR_round(int size) {
+    return (size + AR_ALIGNMENT - 1) & ~(AR_ALIGNMENT - 1);
+}
+
+void * AR_alloc(int size) {
+    size = AR_round(size);
+    if (size > AR_LARGE) {
+        return malloc_checked(size);
+    }
+    if (end - next < size) {
+        next = malloc_checked(AR_CHUNK_SIZE);
+        end = next + AR_CHUNK_SIZE;
+    }
+    latest = next;
+    next += size;
+    return latest;
+}
+
+void * AR_resize(void * old, int old_size, int new_size) {
+    new_size = AR_round(new_size);
+    if (old && old == latest && new_size <= AR_LARGE && latest + new_size <= end) {
+        next = latest + new_size;
+        return old;
+    }
+    void * p = AR_alloc(new_size);
+    if (old) {
+        memcpy(p, old, old_size < new_size ? old_size : new_size);
+        // Only a large allocation has a block of its own to free.
+        if (AR_round(old_size) > AR_LARGE) {
+            free(old);
+        }
+    }
+    return p;
+}
@@ -0,0 +1,19 @@
+/*
+ * arena.h -
+ * Bump allocation for IR nodes.
+ * Translation allocates millions of small nodes and frees none,
+ * so nodes are carved out of large chunks owned by the allocating
+ * thread: no header per node, no locks, and each function's IR
+ * ends up contiguous in memory, in the order it was built.
+ * Nothing allocated here is ever freed.
+ * All types and functions declared in this module begin with "AR_".
+ */
+
+#pragma once
+
+/* size bytes, aligned for any IR node. */
+void * AR_alloc(int size);
+
+/* Move an allocation of old_size bytes to one of new_size bytes,
+ * in place when it is the calling thread's latest allocation. */
+void * AR_resize(void * old, int old_size, int new_size);
@@ -0,0 +1,431 @@
+/*
+ * cache.c -
+ * Implementation of the whole-program compile cache.
+ * See cache.h for more information.
+ * An entry is a magic number, the exit status, and then the output
+ * as records: the stream (1 for stdout, 2 for stderr), the length,
+ * and the bytes written, in the order the compile wrote them.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "cache.h"
+
+#define CA_MAGIC "TIGCA001"
+#define CA_MAGIC_SIZE 8
+#define CA_NAME_SIZE 32
+#define CA_CHUNK (64 << 10)
+
+struct CA_Key_ {
+    /* Two independently mixed 64-bit hashes of everything added. */
+    unsigned long lanes[2];
+};
+
+typedef struct CA_Entry_ {
+    char name[CA_NAME_SIZE + 1];
+    long size;
+    struct timespec used;
+} CA_Entry;
+
+static void CA_add_bytes(CA_Key key, const unsigned char * bytes, size_t size) {
+    unsigned long a = key->lanes[0];
+    unsigned long b = key->lanes[1];
+    for (size_t i = 0; i < size; ++i) {
+        a = (a ^ bytes[i]) * 0x100000001b3UL;
+        b = (b + bytes[i] + 1) * 0x9e3779b97f4a7c15UL;
+        b ^= b >> 29;
+    }
+    key->lanes[0] = a;
+    key->lanes[1] = b;
+}
+
+/* Adds the size first, so that consecutive items cannot run together. */
+static void CA_add_sized(CA_Key key, const void * bytes, size_t size) {
+    unsigned long length = size;
+    CA_add_bytes(key, (const unsigned char *) &length, sizeof(length));
+    CA_add_bytes(key, bytes, size);
+}
+
+void CA_add_string(CA_Key key, string s) {
+    CA_add_sized(key, s, strlen(s));
+}
+
+bool CA_add_file(CA_Key key, string file_name) {
+    FILE * in = fopen(file_name, "rb");
+    if (!in) {
+        return false;
+    }
+    // Hash the contents on their own, then add that hash with its size.
+    struct CA_Key_ contents = { { 0, 0 } };
+    unsigned char * chunk = malloc_checked(CA_CHUNK);
+    unsigned long size = 0;
+    size_t got;
+    while ((got = fread(chunk, 1, CA_CHUNK, in)) > 0) {
+        CA_add_bytes(&contents, chunk, got);
+        size += got;
+    }
+    bool ok = !ferror(in);
+    fclose(in);
+    free(chunk);
+    CA_add_bytes(key, (const unsigned char *) &size, sizeof(size));
+    CA_add_bytes(key, (const unsigned char *) contents.lanes, sizeof(contents.lanes));
+    return ok;
+}
+
+CA_Key make_CA_Key() {
+    // A daemon's forks share the hash of the binary, computed once.
+    static struct CA_Key_ compiler;
+    static bool hashed = false;
+    if (!hashed) {
+        compiler.lanes[0] = 0xcbf29ce484222325UL;
+        compiler.lanes[1] = 0x6a09e667f3bcc909UL;
+        if (!CA_add_file(&compiler, "/proc/self/exe")) {
+            CA_add_string(&compiler, __DATE__ " " __TIME__);
+        }
+        hashed = true;
+    }
+    CA_Key key = malloc_checked(sizeof(*key));
+    *key = compiler;
+    return key;
+}
+
+static bool CA_write_all(int fd, const void * data, size_t size) {
+    const char * p = data;
+    while (size) {
+        ssize_t written = write(fd, p, size);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        p += written;
+        size -= written;
+    }
+    return true;
+}
+
+static bool CA_read_all(int fd, void * data, size_t size) {
+    char * p = data;
+    while (size) {
+        ssize_t got = read(fd, p, size);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            return false;
+        }
+        p += got;
+        size -= got;
+    }
+    return true;
+}
+
+static string CA_path(string dir, string name) {
+    string path = malloc_checked(strlen(dir) + strlen(name) + 2);
+    sprintf(path, "%s/%s", dir, name);
+    return path;
+}
+
+/* Adds one to the hits or the misses recorded in dir,
+ * under a lock, since several compiles may share the cache. */
+static void CA_count(string dir, bool hit) {
+    int fd = open(CA_path(dir, "stats"), O_RDWR | O_CREAT, 0666);
+    if (fd < 0) {
+        return;
+    }
+    struct flock lock;
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = F_WRLCK;
+    lock.l_whence = SEEK_SET;
+    if (!fcntl(fd, F_SETLKW, &lock)) {
+        long counts[2] = { 0, 0 };
+        if (pread(fd, counts, sizeof(counts), 0) != sizeof(counts)) {
+            counts[0] = counts[1] = 0;
+        }
+        ++counts[hit ? 0 : 1];
+        if (pwrite(fd, counts, sizeof(counts), 0) != sizeof(counts)) {
+            fprintf(stderr, "cannot update cache statistics in %s\n", dir);
+        }
+    }
+    close(fd);
+}
+
+static bool CA_is_entry_name(string name) {
+    if (strlen(name) != CA_NAME_SIZE) {
+        return false;
+    }
+    for (; *name; ++name) {
+        if (!strchr("0123456789abcdef", *name)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* The entries in dir; their number is stored in count. */
+static CA_Entry * CA_list_entries(string dir, int * count) {
+    *count = 0;
+    DIR * d = opendir(dir);
+    if (!d) {
+        return NULL;
+    }
+    int capacity = 64;
+    CA_Entry * entries = malloc_checked(capacity * sizeof(*entries));
+    struct dirent * dirent;
+    while ((dirent = readdir(d))) {
+        struct stat st;
+        if (!CA_is_entry_name(dirent->d_name) || stat(CA_path(dir, dirent->d_name), &st)) {
+            continue;
+        }
+        if (*count == capacity) {
+            CA_Entry * more = malloc_checked(2 * capacity * sizeof(*entries));
+            memcpy(more, entries, capacity * sizeof(*entries));
+            free(entries);
+            entries = more;
+            capacity *= 2;
+        }
+        CA_Entry * entry = &entries[(*count)++];
+        strcpy(entry->name, dirent->d_name);
+        entry->size = st.st_size;
+        entry->used = st.st_mtim;
+    }
+    closedir(d);
+    return entries;
+}
+
+static int CA_compare_use(const void * a, const void * b) {
+    const CA_Entry * x = a;
+    const CA_Entry * y = b;
+    if (x->used.tv_sec != y->used.tv_sec) {
+        return x->used.tv_sec < y->used.tv_sec ? -1 : 1;
+    }
+    return (x->used.tv_nsec > y->used.tv_nsec) - (x->used.tv_nsec < y->used.tv_nsec);
+}
+
+/* Removes the least recently used entries until dir holds at most max_bytes. */
+static void CA_evict(string dir, long max_bytes) {
+    int count;
+    CA_Entry * entries = CA_list_entries(dir, &count);
+    long total = 0;
+    for (int i = 0; i < count; ++i) {
+        total += entries[i].size;
+    }
+    if (total > max_bytes) {
+        qsort(entries, count, sizeof(*entries), CA_compare_use);
+        for (int i = 0; i < count && total > max_bytes; ++i) {
+            if (!unlink(CA_path(dir, entries[i].name))) {
+                total -= entries[i].size;
+            }
+        }
+    }
+    free(entries);
+}
+
+/* Checks that the records after the header fill the entry exactly. */
+static bool CA_check_records(int fd) {
+    unsigned char stream;
+    unsigned int length;
+    for (;;) {
+        ssize_t got = read(fd, &stream, 1);
+        if (got == 0) {
+            return true;
+        }
+        if (got < 0 || (stream != 1 && stream != 2) || !CA_read_all(fd, &length, sizeof(length))) {
+            return false;
+        }
+        off_t at = lseek(fd, 0, SEEK_CUR);
+        off_t end = lseek(fd, 0, SEEK_END);
+        if (at < 0 || end - at < length || lseek(fd, at + length, SEEK_SET) < 0) {
+            return false;
+        }
+    }
+}
+
+/* Writes the output stored at path to stdout and stderr and stores
+ * the exit status; false, writing nothing, if there is no valid entry. */
+static bool CA_replay(string path, int * status) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    char magic[CA_MAGIC_SIZE];
+    if (!CA_read_all(fd, magic, CA_MAGIC_SIZE) || memcmp(magic, CA_MAGIC, CA_MAGIC_SIZE)
+            || !CA_read_all(fd, status, sizeof(*status)) || !CA_check_records(fd)) {
+        close(fd);
+        return false;
+    }
+    lseek(fd, CA_MAGIC_SIZE + sizeof(*status), SEEK_SET);
+    char * chunk = malloc_checked(CA_CHUNK);
+    unsigned char stream;
+    unsigned int length;
+    while (CA_read_all(fd, &stream, 1) && CA_read_all(fd, &length, sizeof(length))) {
+        while (length) {
+            size_t size = length < CA_CHUNK ? length : CA_CHUNK;
+            if (!CA_read_all(fd, chunk, size)) {
+                break;
+            }
+            CA_write_all(stream, chunk, size);
+            length -= size;
+        }
+    }
+    free(chunk);
+    // The entry's modification time records its last use.
+    futimens(fd, NULL);
+    close(fd);
+    return true;
+}
+
+/* Runs the compile in a child whose stdout and stderr are pipes,
+ * passing what it writes through while recording it into out. */
+static int CA_record(int out, bool * ok, CA_Compile compile, int argc, char ** argv) {
+    int pipes[2][2];
+    if (pipe(pipes[0])) {
+        *ok = false;
+        return compile(argc, argv);
+    }
+    if (pipe(pipes[1])) {
+        close(pipes[0][0]);
+        close(pipes[0][1]);
+        *ok = false;
+        return compile(argc, argv);
+    }
+    fflush(stdout);
+    fflush(stderr);
+    pid_t child = fork();
+    if (child == 0) {
+        close(out);
+        for (int i = 0; i < 2; ++i) {
+            dup2(pipes[i][1], i + 1);
+            close(pipes[i][0]);
+            close(pipes[i][1]);
+        }
+        exit(compile(argc, argv));
+    }
+    struct pollfd fds[2];
+    for (int i = 0; i < 2; ++i) {
+        close(pipes[i][1]);
+        fds[i].fd = pipes[i][0];
+        fds[i].events = POLLIN;
+    }
+    if (child < 0) {
+        perror("fork");
+        close(fds[0].fd);
+        close(fds[1].fd);
+        *ok = false;
+        return compile(argc, argv);
+    }
+    char * chunk = malloc_checked(CA_CHUNK);
+    for (int open_pipes = 2; open_pipes; ) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            *ok = false;
+            break;
+        }
+        for (int i = 0; i < 2; ++i) {
+            if (fds[i].fd < 0 || !fds[i].revents) {
+                continue;
+            }
+            ssize_t got = read(fds[i].fd, chunk, CA_CHUNK);
+            if (got < 0 && errno == EINTR) {
+                continue;
+            }
+            if (got <= 0) {
+                close(fds[i].fd);
+                fds[i].fd = -1;
+                --open_pipes;
+                continue;
+            }
+            unsigned char stream = i + 1;
+            unsigned int length = got;
+            CA_write_all(stream, chunk, got);
+            *ok = *ok && CA_write_all(out, &stream, 1) && CA_write_all(out, &length, sizeof(length))
+                && CA_write_all(out, chunk, got);
+        }
+    }
+    free(chunk);
+    for (int i = 0; i < 2; ++i) {
+        if (fds[i].fd >= 0) {
+            close(fds[i].fd);
+        }
+    }
+    int wait_status;
+    while (waitpid(child, &wait_status, 0) < 0) {
+        if (errno != EINTR) {
+            *ok = false;
+            return EXIT_FAILURE;
+        }
+    }
+    // A compile that crashed is not worth replaying.
+    if (!WIFEXITED(wait_status)) {
+        *ok = false;
+        return 128 + WTERMSIG(wait_status);
+    }
+    return WEXITSTATUS(wait_status);
+}
+
+int CA_run(string dir, long max_bytes, CA_Key key, CA_Compile compile, int argc, char ** argv) {
+    char name[CA_NAME_SIZE + 1];
+    sprintf(name, "%016lx%016lx", key->lanes[0], key->lanes[1]);
+    if (mkdir(dir, 0777) && errno != EEXIST) {
+        perror(dir);
+        return compile(argc, argv);
+    }
+    string path = CA_path(dir, name);
+    int status;
+    if (CA_replay(path, &status)) {
+        CA_count(dir, true);
+        return status;
+    }
+    CA_count(dir, false);
+    char tmp_name[64];
+    sprintf(tmp_name, "tmp.%ld", (long) getpid());
+    string tmp_path = CA_path(dir, tmp_name);
+    int out = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (out < 0) {
+        return compile(argc, argv);
+    }
+    status = 0;
+    bool ok = CA_write_all(out, CA_MAGIC, CA_MAGIC_SIZE) && CA_write_all(out, &status, sizeof(status));
+    status = CA_record(out, &ok, compile, argc, argv);
+    ok = ok && pwrite(out, &status, sizeof(status), CA_MAGIC_SIZE) == sizeof(status);
+    ok = !close(out) && ok;
+    // The rename publishes the entry whole.
+    if (ok && !rename(tmp_path, path)) {
+        CA_evict(dir, max_bytes);
+    } else {
+        unlink(tmp_path);
+    }
+    return status;
+}
+
+void CA_print_stats(FILE * out, string dir) {
+    long counts[2] = { 0, 0 };
+    int fd = open(CA_path(dir, "stats"), O_RDONLY);
+    if (fd >= 0) {
+        if (pread(fd, counts, sizeof(counts), 0) != sizeof(counts)) {
+            counts[0] = counts[1] = 0;
+        }
+        close(fd);
+    }
+    int count;
+    CA_Entry * entries = CA_list_entries(dir, &count);
+    long total = 0;
+    for (int i = 0; i < count; ++i) {
+        total += entries[i].size;
+    }
+    free(entries);
+    long requests = counts[0] + counts[1];
+    fprintf(out, "hits: %ld\nmisses: %ld\nhit rate: %.1f%%\nentries: %d\nbytes: %ld\n",
+            counts[0], counts[1], requests ? 100.0 * counts[0] / requests : 0.0, count, total);
+}
@@ -0,0 +1,40 @@
+/*
+ * cache.h -
+ * A content-addressed, on-disk cache of whole-program compiles.
+ * An entry is keyed on a hash of the compiler itself, the command's
+ * arguments and the contents of its input files, and holds what the
+ * compile wrote to stdout and stderr, in order, and its exit status.
+ * A hit replays the entry without running any compiler phase.
+ * Entries are written to a temporary file and renamed into place,
+ * so readers never see half an entry; once the cache outgrows its
+ * size bound, the least recently used entries are removed.
+ * All types and functions declared in this module begin with "CA_".
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "util.h"
+
+#define CA_DEFAULT_MAX_BYTES (256L << 20)
+
+typedef struct CA_Key_ * CA_Key;
+
+/* A compile run with the given arguments, returning an exit status. */
+typedef int (*CA_Compile)(int argc, char ** argv);
+
+/* A key that already covers the running compiler's own binary. */
+CA_Key make_CA_Key();
+void CA_add_string(CA_Key key, string s);
+/* Add a file's contents; false if it cannot be read. */
+bool CA_add_file(CA_Key key, string file_name);
+
+/* Replay the entry for key from the cache in dir, or run
+ * compile(argc, argv) and store what it writes under key.
+ * Returns the compile's exit status. */
+int CA_run(string dir, long max_bytes, CA_Key key, CA_Compile compile, int argc, char ** argv);
+
+/* Print the hits and misses recorded in dir and the entries it holds. */
+void CA_print_stats(FILE * out, string dir);
@@ -0,0 +1,1383 @@
+/*
+ * cfg.c -
+ * Implementation of the canonical control-flow-graph IR.
+ * See cfg.h for more information.
+ */
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "cfg.h"
+#include "stack.h"
+#include "util.h"
+
+/* Where a value is stored: a variable of some frame, a variable kept
+ * in temp, or memory. */
+typedef struct CFG_Location_ {
+    bool is_var;
+    S_Symbol name;
+    int level;
+    int offset;
+    CFG_Operand address;
+    int temp;
+} CFG_Location;
+
+/* The exit of an enclosing loop, the target of its breaks. */
+typedef struct CFG_Loop_ {
+    TR_Label skip_label;
+    int exit;
+} CFG_Loop;
+
+typedef struct CFG_Builder_ {
+    CFG_Graph graph;
+    /* The block being filled, which has no end yet. */
+    CFG_Block current;
+    int loop_count;
+    int loop_capacity;
+    CFG_Loop * loops;
+    /* The graph's temp for each TR temp holding a variable, or -1. */
+    int * var_temps;
+} CFG_Builder;
+
+static CFG_Operand CFG_lower_exp(CFG_Builder * builder, TR_Exp exp);
+static void CFG_lower_stm(CFG_Builder * builder, TR_Stm stm);
+static CFG_Location CFG_lower_location(CFG_Builder * builder, TR_Exp exp);
+
+CFG_Operand CFG_none() {
+    CFG_Operand operand = { CFG_NONE, 0 };
+    return operand;
+}
+
+CFG_Operand CFG_const(int value) {
+    CFG_Operand operand = { CFG_CONST, value };
+    return operand;
+}
+
+CFG_Operand CFG_temp(int temp) {
+    CFG_Operand operand = { CFG_TEMP, temp };
+    return operand;
+}
+
+int CFG_new_temp(CFG_Graph graph) {
+    return graph->temp_count++;
+}
+
+CFG_Block CFG_new_block(CFG_Graph graph) {
+    if (graph->block_count == graph->block_capacity) {
+        int capacity = graph->block_capacity ? 2 * graph->block_capacity : 8;
+        graph->blocks = AR_resize(graph->blocks, graph->block_capacity * sizeof(CFG_Block),
+                capacity * sizeof(CFG_Block));
+        graph->block_capacity = capacity;
+    }
+    CFG_Block block = AR_alloc(sizeof(*block));
+    block->id = graph->block_count;
+    block->instr_count = 0;
+    block->instr_capacity = 0;
+    block->instrs = NULL;
+    block->end = CFG_RETURN;
+    block->value = CFG_none();
+    block->succ_count = 0;
+    block->pred_count = 0;
+    block->preds = NULL;
+    graph->blocks[graph->block_count++] = block;
+    return block;
+}
+
+void CFG_add_instr(CFG_Block block, CFG_Instr instr) {
+    if (block->instr_count == block->instr_capacity) {
+        int capacity = block->instr_capacity ? 2 * block->instr_capacity : 4;
+        block->instrs = AR_resize(block->instrs, block->instr_capacity * sizeof(CFG_Instr),
+                capacity * sizeof(CFG_Instr));
+        block->instr_capacity = capacity;
+    }
+    block->instrs[block->instr_count++] = instr;
+}
+
+int CFG_use_count(CFG_Instr * instr) {
+    switch (instr->kind) {
+        case CFG_MOVE:
+        case CFG_STORE_VAR:
+        case CFG_LOAD:
+        case CFG_ARRAY:
+            return 1;
+        case CFG_BINOP:
+        case CFG_STORE:
+            return 2;
+        case CFG_CALL:
+            return instr->u.call.arg_count;
+        case CFG_PHI:
+            return instr->u.phi.arg_count;
+        default:
+            return 0;
+    }
+}
+
+CFG_Operand * CFG_use(CFG_Instr * instr, int i) {
+    switch (instr->kind) {
+        case CFG_MOVE:
+            return &instr->u.move;
+        case CFG_BINOP:
+            return i ? &instr->u.binop.right : &instr->u.binop.left;
+        case CFG_STORE_VAR:
+            return &instr->u.var.value;
+        case CFG_LOAD:
+            return &instr->u.mem.address;
+        case CFG_STORE:
+            return i ? &instr->u.mem.value : &instr->u.mem.address;
+        case CFG_CALL:
+            return &instr->u.call.args[i];
+        case CFG_ARRAY:
+            return &instr->u.alloc.init;
+        case CFG_PHI:
+            return &instr->u.phi.args[i];
+        default:
+            return NULL;
+    }
+}
+
+/* Building */
+
+static CFG_Instr CFG_make_instr(int kind, int dst) {
+    CFG_Instr instr;
+    memset(&instr, 0, sizeof(instr));
+    instr.kind = kind;
+    instr.dst = dst;
+    return instr;
+}
+
+static void CFG_emit(CFG_Builder * builder, CFG_Instr instr) {
+    CFG_add_instr(builder->current, instr);
+}
+
+static void CFG_end_jump(CFG_Builder * builder, CFG_Block target) {
+    builder->current->end = CFG_JUMP;
+    builder->current->succ_count = 1;
+    builder->current->succs[0] = target->id;
+}
+
+static void CFG_end_branch(CFG_Builder * builder, CFG_Operand test,
+        CFG_Block if_true, CFG_Block if_false) {
+    builder->current->end = CFG_BRANCH;
+    builder->current->value = test;
+    builder->current->succ_count = 2;
+    builder->current->succs[0] = if_true->id;
+    builder->current->succs[1] = if_false->id;
+}
+
+static CFG_Operand CFG_emit_binop(CFG_Builder * builder, A_Oper op,
+        CFG_Operand left, CFG_Operand right) {
+    CFG_Instr instr = CFG_make_instr(CFG_BINOP, CFG_new_temp(builder->graph));
+    instr.u.binop.op = op;
+    instr.u.binop.left = left;
+    instr.u.binop.right = right;
+    CFG_emit(builder, instr);
+    return CFG_temp(instr.dst);
+}
+
+static void CFG_emit_move(CFG_Builder * builder, int dst, CFG_Operand value) {
+    CFG_Instr instr = CFG_make_instr(CFG_MOVE, dst);
+    instr.u.move = value;
+    CFG_emit(builder, instr);
+}
+
+/* The graph's temp for the variable in TR temp reg. */
+static int CFG_var_temp(CFG_Builder * builder, TR_Temp reg) {
+    if (builder->var_temps[reg] < 0) {
+        builder->var_temps[reg] = CFG_new_temp(builder->graph);
+    }
+    return builder->var_temps[reg];
+}
+
+static CFG_Operand CFG_emit_load(CFG_Builder * builder, CFG_Location location, int size) {
+    if (location.temp >= 0) {
+        // A copy, as the variable may be assigned before the value is used.
+        int dst = CFG_new_temp(builder->graph);
+        CFG_emit_move(builder, dst, CFG_temp(location.temp));
+        return CFG_temp(dst);
+    }
+    CFG_Instr instr = CFG_make_instr(location.is_var ? CFG_LOAD_VAR : CFG_LOAD,
+            CFG_new_temp(builder->graph));
+    if (location.is_var) {
+        instr.u.var.name = location.name;
+        instr.u.var.level = location.level;
+        instr.u.var.offset = location.offset;
+        instr.u.var.size = size;
+        instr.u.var.value = CFG_none();
+    } else {
+        instr.u.mem.address = location.address;
+        instr.u.mem.offset = location.offset;
+        instr.u.mem.size = size;
+        instr.u.mem.value = CFG_none();
+    }
+    CFG_emit(builder, instr);
+    return CFG_temp(instr.dst);
+}
+
+static void CFG_emit_store(CFG_Builder * builder, CFG_Location location, int size,
+        CFG_Operand value) {
+    if (location.temp >= 0) {
+        CFG_emit_move(builder, location.temp, value);
+        return;
+    }
+    CFG_Instr instr = CFG_make_instr(location.is_var ? CFG_STORE_VAR : CFG_STORE, -1);
+    if (location.is_var) {
+        instr.u.var.name = location.name;
+        instr.u.var.level = location.level;
+        instr.u.var.offset = location.offset;
+        instr.u.var.size = size;
+        instr.u.var.value = value;
+    } else {
+        instr.u.mem.address = location.address;
+        instr.u.mem.offset = location.offset;
+        instr.u.mem.size = size;
+        instr.u.mem.value = value;
+    }
+    CFG_emit(builder, instr);
+}
+
+/* Emits a call, whose result is CFG_NONE unless has_value. */
+static CFG_Operand CFG_emit_call(CFG_Builder * builder, S_Symbol name, TR_ExpList args,
+        bool has_value) {
+    int arg_count = TR_exp_count(args);
+    CFG_Operand * operands = arg_count ? AR_alloc(arg_count * sizeof(*operands)) : NULL;
+    for (int i = 0; i < arg_count; ++i) {
+        operands[i] = CFG_lower_exp(builder, args->items[i]);
+    }
+    CFG_Instr instr = CFG_make_instr(CFG_CALL, has_value ? CFG_new_temp(builder->graph) : -1);
+    instr.u.call.name = name;
+    instr.u.call.arg_count = arg_count;
+    instr.u.call.args = operands;
+    CFG_emit(builder, instr);
+    return has_value ? CFG_temp(instr.dst) : CFG_none();
+}
+
+static void CFG_push_loop(CFG_Builder * builder, TR_Label skip_label, CFG_Block exit) {
+    if (builder->loop_count == builder->loop_capacity) {
+        int capacity = builder->loop_capacity ? 2 * builder->loop_capacity : 8;
+        builder->loops = AR_resize(builder->loops, builder->loop_capacity * sizeof(CFG_Loop),
+                capacity * sizeof(CFG_Loop));
+        builder->loop_capacity = capacity;
+    }
+    CFG_Loop loop = { skip_label, exit->id };
+    builder->loops[builder->loop_count++] = loop;
+}
+
+/* A call of CFG_lower_exp, CFG_lower_stm or CFG_lower_location
+ * continued on a new stack segment. */
+typedef struct CFG_DeepCall_ {
+    CFG_Builder * builder;
+    TR_Exp exp;
+    TR_Stm stm;
+    bool location;
+    CFG_Operand value;
+    CFG_Location place;
+} CFG_DeepCall;
+
+static void CFG_run_deep_call(void * arg) {
+    CFG_DeepCall * call = arg;
+    if (call->stm) {
+        CFG_lower_stm(call->builder, call->stm);
+    } else if (call->location) {
+        call->place = CFG_lower_location(call->builder, call->exp);
+    } else {
+        call->value = CFG_lower_exp(call->builder, call->exp);
+    }
+}
+
+static CFG_Location CFG_lower_location(CFG_Builder * builder, TR_Exp exp) {
+    if (ST_low()) {
+        CFG_DeepCall call = { builder, exp, NULL, true };
+        ST_call(CFG_run_deep_call, &call);
+        return call.place;
+    }
+    CFG_Location location = { false, NULL, 0, 0, CFG_const(0), -1 };
+    if (!exp) {
+        return location;
+    }
+    switch (exp->kind) {
+        case TR_MEM_EXP:
+            if (exp->reg >= 0) {
+                location.temp = CFG_var_temp(builder, exp->reg);
+                return location;
+            }
+            location.is_var = true;
+            location.name = exp->u.mem.name;
+            location.level = exp->u.mem.nesting_level;
+            location.offset = exp->u.mem.offset;
+            return location;
+        case TR_FIELD_EXP:
+            {
+                // The record's address is the value of the variable holding it.
+                TR_Exp record = exp->u.field.var;
+                CFG_Location holder = CFG_lower_location(builder, record);
+                location.address = CFG_emit_load(builder, holder, record ? record->size : 0);
+                location.offset = exp->u.field.field_offset;
+                return location;
+            }
+        case TR_SUBSCRIPT_EXP:
+            {
+                TR_Exp array = exp->u.subscript.var;
+                CFG_Location holder = CFG_lower_location(builder, array);
+                CFG_Operand base = CFG_emit_load(builder, holder, array ? array->size : 0);
+                CFG_Operand index = CFG_lower_exp(builder, exp->u.subscript.index);
+                CFG_Operand scaled = CFG_emit_binop(builder, A_TIMES_OP, index,
+                        CFG_const(exp->size));
+                location.address = CFG_emit_binop(builder, A_PLUS_OP, base, scaled);
+                return location;
+            }
+        default:
+            // A computed address.
+            location.address = CFG_lower_exp(builder, exp);
+            return location;
+    }
+}
+
+/* Whether exp has a value. A sequence is translated with size 0, so
+ * its value is that of its last statement; a conditional takes the
+ * size of its true branch, which may be such a sequence. */
+static bool CFG_has_value(TR_Exp exp) {
+    while (exp && exp->size == 0) {
+        if (exp->kind == TR_SEQ_EXP) {
+            int count = TR_stm_count(exp->u.seq);
+            TR_Stm last = count ? exp->u.seq->items[count - 1] : NULL;
+            exp = last && last->kind == TR_EXP_STM ? last->u.exp : NULL;
+        } else if (exp->kind == TR_IF_ELSE_EXP) {
+            exp = exp->u.if_else.true_branch;
+        } else {
+            return false;
+        }
+    }
+    return exp != NULL;
+}
+
+/* Lowers the value of a conditional's branch into dst, if it has one. */
+static void CFG_lower_branch_value(CFG_Builder * builder, TR_Exp exp, int dst) {
+    CFG_Operand value = CFG_lower_exp(builder, exp);
+    if (dst >= 0) {
+        CFG_emit_move(builder, dst, value.kind == CFG_NONE ? CFG_const(0) : value);
+    }
+}
+
+/* Lowers exp, returning the operand holding its value, if it has one. */
+static CFG_Operand CFG_lower_exp(CFG_Builder * builder, TR_Exp exp) {
+    // A missing translation, left by an error, has no effect.
+    if (!exp) {
+        return CFG_const(0);
+    }
+    if (ST_low()) {
+        CFG_DeepCall call = { builder, exp, NULL, false };
+        ST_call(CFG_run_deep_call, &call);
+        return call.value;
+    }
+    CFG_Graph graph = builder->graph;
+    switch (exp->kind) {
+        case TR_NUM_EXP:
+            return CFG_const(exp->u.num);
+        case TR_STRING_EXP:
+            {
+                CFG_Instr instr = CFG_make_instr(CFG_STRING, CFG_new_temp(graph));
+                instr.u.string.text = exp->u.str.str;
+                instr.u.string.label = exp->u.str.label;
+                CFG_emit(builder, instr);
+                return CFG_temp(instr.dst);
+            }
+        case TR_MEM_EXP:
+            return CFG_emit_load(builder, CFG_lower_location(builder, exp), exp->size);
+        case TR_VAR_EXP:
+            return CFG_emit_load(builder, CFG_lower_location(builder, exp->u.var), exp->size);
+        case TR_FIELD_EXP:
+        case TR_SUBSCRIPT_EXP:
+            {
+                CFG_Location location = CFG_lower_location(builder, exp);
+                return CFG_emit_binop(builder, A_PLUS_OP, location.address,
+                        CFG_const(location.offset));
+            }
+        case TR_RECORD_EXP:
+            {
+                // The fields are evaluated before the record is made.
+                int count = TR_exp_count(exp->u.record.fields);
+                CFG_Operand * values = count ? AR_alloc(count * sizeof(*values)) : NULL;
+                for (int i = 0; i < count; ++i) {
+                    values[i] = CFG_lower_exp(builder, exp->u.record.fields->items[i]);
+                }
+                CFG_Instr instr = CFG_make_instr(CFG_RECORD, CFG_new_temp(graph));
+                instr.u.alloc.size = exp->size;
+                instr.u.alloc.init = CFG_none();
+                instr.u.alloc.offset = exp->u.record.offset;
+                CFG_emit(builder, instr);
+                CFG_Location field = { false, NULL, 0, 0, CFG_temp(instr.dst), -1 };
+                for (int i = 0; i < count; ++i) {
+                    TR_Exp init = exp->u.record.fields->items[i];
+                    int size = init ? init->size : 0;
+                    CFG_emit_store(builder, field, size, values[i]);
+                    field.offset += size;
+                }
+                return CFG_temp(instr.dst);
+            }
+        case TR_ARRAY_EXP:
+            {
+                CFG_Operand init = CFG_lower_exp(builder, exp->u.array.init);
+                CFG_Instr instr = CFG_make_instr(CFG_ARRAY, CFG_new_temp(graph));
+                instr.u.alloc.size = exp->size;
+                instr.u.alloc.init = init;
+                instr.u.alloc.offset = exp->u.array.offset;
+                CFG_emit(builder, instr);
+                return CFG_temp(instr.dst);
+            }
+        case TR_ARITH_OP_EXP:
+            {
+                CFG_Operand left = CFG_lower_exp(builder, exp->u.arith.left);
+                CFG_Operand right = CFG_lower_exp(builder, exp->u.arith.right);
+                return CFG_emit_binop(builder, exp->u.arith.op, left, right);
+            }
+        case TR_REL_OP_EXP:
+            {
+                CFG_Operand left = CFG_lower_exp(builder, exp->u.rel.left);
+                CFG_Operand right = CFG_lower_exp(builder, exp->u.rel.right);
+                return CFG_emit_binop(builder, exp->u.rel.op, left, right);
+            }
+        case TR_DIV_OP_EXP:
+            {
+                CFG_Operand left = CFG_lower_exp(builder, exp->u.div.left);
+                CFG_Operand right = CFG_lower_exp(builder, exp->u.div.right);
+                return CFG_emit_binop(builder, A_DIVIDE_OP, left, right);
+            }
+        case TR_IF_EXP:
+            {
+                CFG_Operand test = CFG_lower_exp(builder, exp->u.if_.test);
+                CFG_Block then_block = CFG_new_block(graph);
+                CFG_Block join_block = CFG_new_block(graph);
+                CFG_end_branch(builder, test, then_block, join_block);
+                builder->current = then_block;
+                CFG_lower_exp(builder, exp->u.if_.true_branch);
+                CFG_end_jump(builder, join_block);
+                builder->current = join_block;
+                return CFG_none();
+            }
+        case TR_IF_ELSE_EXP:
+            {
+                CFG_Operand test = CFG_lower_exp(builder, exp->u.if_else.test);
+                int dst = CFG_has_value(exp) ? CFG_new_temp(graph) : -1;
+                CFG_Block then_block = CFG_new_block(graph);
+                CFG_Block else_block = CFG_new_block(graph);
+                CFG_Block join_block = CFG_new_block(graph);
+                CFG_end_branch(builder, test, then_block, else_block);
+                builder->current = then_block;
+                CFG_lower_branch_value(builder, exp->u.if_else.true_branch, dst);
+                CFG_end_jump(builder, join_block);
+                builder->current = else_block;
+                CFG_lower_branch_value(builder, exp->u.if_else.false_branch, dst);
+                CFG_end_jump(builder, join_block);
+                builder->current = join_block;
+                return dst >= 0 ? CFG_temp(dst) : CFG_none();
+            }
+        case TR_FCALL_EXP:
+            return CFG_emit_call(builder, exp->u.fcall.name, exp->u.fcall.args, exp->size > 0);
+        case TR_SEQ_EXP:
+            {
+                // The value of a sequence is that of its last expression, if any.
+                TR_StmList stms = exp->u.seq;
+                int count = TR_stm_count(stms);
+                for (int i = 0; i + 1 < count; ++i) {
+                    CFG_lower_stm(builder, stms->items[i]);
+                }
+                if (!count) {
+                    return CFG_none();
+                }
+                TR_Stm last = stms->items[count - 1];
+                if (last && last->kind == TR_EXP_STM) {
+                    return CFG_lower_exp(builder, last->u.exp);
+                }
+                CFG_lower_stm(builder, last);
+                return CFG_none();
+            }
+    }
+    return CFG_none();
+}
+
+static void CFG_lower_stm(CFG_Builder * builder, TR_Stm stm) {
+    if (!stm) {
+        return;
+    }
+    if (ST_low()) {
+        CFG_DeepCall call = { builder, NULL, stm, false };
+        ST_call(CFG_run_deep_call, &call);
+        return;
+    }
+    CFG_Graph graph = builder->graph;
+    switch (stm->kind) {
+        case TR_ASSIGN_STM:
+            {
+                // The variable comes first in the source, so its address does too.
+                TR_Exp var = stm->u.assign.var;
+                CFG_Location location = CFG_lower_location(builder, var);
+                CFG_Operand value = CFG_lower_exp(builder, stm->u.assign.value);
+                CFG_emit_store(builder, location, var ? var->size : 0, value);
+                break;
+            }
+        case TR_PCALL_STM:
+            CFG_emit_call(builder, stm->u.pcall.name, stm->u.pcall.args, false);
+            break;
+        case TR_SEQ_STM:
+            for (int i = 0, n = TR_stm_count(stm->u.seq); i < n; ++i) {
+                CFG_lower_stm(builder, stm->u.seq->items[i]);
+            }
+            break;
+        case TR_IF_STM:
+            {
+                CFG_Operand test = CFG_lower_exp(builder, stm->u.if_.test);
+                CFG_Block then_block = CFG_new_block(graph);
+                CFG_Block join_block = CFG_new_block(graph);
+                CFG_end_branch(builder, test, then_block, join_block);
+                builder->current = then_block;
+                CFG_lower_stm(builder, stm->u.if_.true_branch);
+                CFG_end_jump(builder, join_block);
+                builder->current = join_block;
+                break;
+            }
+        case TR_IF_ELSE_STM:
+            {
+                CFG_Operand test = CFG_lower_exp(builder, stm->u.if_else.test);
+                CFG_Block then_block = CFG_new_block(graph);
+                CFG_Block else_block = CFG_new_block(graph);
+                CFG_Block join_block = CFG_new_block(graph);
+                CFG_end_branch(builder, test, then_block, else_block);
+                builder->current = then_block;
+                CFG_lower_stm(builder, stm->u.if_else.true_branch);
+                CFG_end_jump(builder, join_block);
+                builder->current = else_block;
+                CFG_lower_stm(builder, stm->u.if_else.false_branch);
+                CFG_end_jump(builder, join_block);
+                builder->current = join_block;
+                break;
+            }
+        case TR_WHILE_STM:
+            {
+                CFG_Block test_block = CFG_new_block(graph);
+                CFG_end_jump(builder, test_block);
+                builder->current = test_block;
+                CFG_Operand test = CFG_lower_exp(builder, stm->u.while_.test);
+                CFG_Block body_block = CFG_new_block(graph);
+                CFG_Block exit_block = CFG_new_block(graph);
+                CFG_end_branch(builder, test, body_block, exit_block);
+                builder->current = body_block;
+                CFG_push_loop(builder, stm->u.while_.skip_label, exit_block);
+                CFG_lower_stm(builder, stm->u.while_.body);
+                --builder->loop_count;
+                CFG_end_jump(builder, test_block);
+                builder->current = exit_block;
+                break;
+            }
+        case TR_FOR_STM:
+            {
+                // The bounds are evaluated once, before the loop.
+                TR_Exp var = stm->u.for_.var;
+                if (var && var->kind == TR_VAR_EXP) {
+                    var = var->u.var;
+                }
+                CFG_Location location = CFG_lower_location(builder, var);
+                int size = var ? var->size : 0;
+                CFG_emit_store(builder, location, size, CFG_lower_exp(builder, stm->u.for_.lo));
+                CFG_Operand hi = CFG_lower_exp(builder, stm->u.for_.hi);
+                CFG_Block test_block = CFG_new_block(graph);
+                CFG_end_jump(builder, test_block);
+                builder->current = test_block;
+                CFG_Operand test = CFG_emit_binop(builder, A_LE_OP,
+                        CFG_emit_load(builder, location, size), hi);
+                CFG_Block body_block = CFG_new_block(graph);
+                CFG_Block exit_block = CFG_new_block(graph);
+                CFG_end_branch(builder, test, body_block, exit_block);
+                builder->current = body_block;
+                CFG_push_loop(builder, stm->u.for_.skip_label, exit_block);
+                CFG_lower_stm(builder, stm->u.for_.body);
+                --builder->loop_count;
+                CFG_Operand next = CFG_emit_binop(builder, A_PLUS_OP,
+                        CFG_emit_load(builder, location, size), CFG_const(1));
+                CFG_emit_store(builder, location, size, next);
+                CFG_end_jump(builder, test_block);
+                builder->current = exit_block;
+                break;
+            }
+        case TR_BREAK_STM:
+            {
+                for (int i = builder->loop_count - 1; i >= 0; --i) {
+                    if (builder->loops[i].skip_label == stm->u.break_) {
+                        CFG_end_jump(builder, graph->blocks[builder->loops[i].exit]);
+                        // Whatever follows the break is unreachable.
+                        builder->current = CFG_new_block(graph);
+                        break;
+                    }
+                }
+                break;
+            }
+        case TR_EXP_STM:
+            CFG_lower_exp(builder, stm->u.exp);
+            break;
+    }
+}
+
+CFG_Graph CFG_build(TR_Function func) {
+    CFG_Graph graph = AR_alloc(sizeof(*graph));
+    graph->func = func;
+    graph->ssa = false;
+    graph->temp_count = 0;
+    graph->block_count = 0;
+    graph->block_capacity = 0;
+    graph->blocks = NULL;
+    CFG_Builder builder = { graph, CFG_new_block(graph), 0, 0, NULL,
+        AR_alloc(func->temp_count * sizeof(int) + 1) };
+    for (int t = 0; t < func->temp_count; ++t) {
+        builder.var_temps[t] = -1;
+    }
+    // A parameter kept in a temp starts as the argument in its slot.
+    for (TR_VarList params = func->frame ? func->frame->parameters : NULL; params;
+            params = params->tail) {
+        F_Var param = params->head;
+        if (!param->escape) {
+            CFG_Location slot = { true, param->name, func->frame->nesting_level, param->offset,
+                CFG_const(0), -1 };
+            CFG_Location temp = { false, NULL, 0, 0, CFG_const(0), CFG_var_temp(&builder, param->temp) };
+            int size = T_size(param->type);
+            CFG_emit_store(&builder, temp, size, CFG_emit_load(&builder, slot, size));
+        }
+    }
+    // The function returns the value of its last expression, if any.
+    CFG_Operand result = CFG_none();
+    int count = TR_stm_count(func->body);
+    for (int i = 0; i < count; ++i) {
+        TR_Stm stm = func->body->items[i];
+        if (i == count - 1 && stm && stm->kind == TR_EXP_STM) {
+            result = CFG_lower_exp(&builder, stm->u.exp);
+        } else {
+            CFG_lower_stm(&builder, stm);
+        }
+    }
+    builder.current->end = CFG_RETURN;
+    builder.current->value = result;
+    builder.current->succ_count = 0;
+    CFG_remove_unreachable(graph);
+    return graph;
+}
+
+static CFG_GraphList * CFG_build_tree(TR_Function func, CFG_GraphList * end) {
+    *end = AR_alloc(sizeof(**end));
+    (*end)->head = CFG_build(func);
+    (*end)->tail = NULL;
+    end = &(*end)->tail;
+    for (TR_FunctionList children = func->children; children; children = children->tail) {
+        end = CFG_build_tree(children->head, end);
+    }
+    return end;
+}
+
+CFG_GraphList CFG_build_all(TR_Function main_) {
+    CFG_GraphList graphs = NULL;
+    CFG_build_tree(main_, &graphs);
+    return graphs;
+}
+
+/* Graph maintenance */
+
+/* Realign the arguments of block's phis, which follow old_preds,
+ * with its new preds. */
+static void CFG_realign_phis(CFG_Block block, int * old_preds, int old_count) {
+    bool * taken = malloc_checked(old_count * sizeof(bool) + 1);
+    for (int i = 0; i < block->instr_count && block->instrs[i].kind == CFG_PHI; ++i) {
+        CFG_Instr * phi = &block->instrs[i];
+        CFG_Operand * args = block->pred_count
+            ? AR_alloc(block->pred_count * sizeof(*args)) : NULL;
+        memset(taken, 0, old_count * sizeof(bool));
+        for (int k = 0; k < block->pred_count; ++k) {
+            args[k] = CFG_none();
+            for (int j = 0; j < old_count && j < phi->u.phi.arg_count; ++j) {
+                if (!taken[j] && old_preds[j] == block->preds[k]) {
+                    taken[j] = true;
+                    args[k] = phi->u.phi.args[j];
+                    break;
+                }
+            }
+        }
+        phi->u.phi.arg_count = block->pred_count;
+        phi->u.phi.args = args;
+    }
+    free(taken);
+}
+
+void CFG_compute_preds(CFG_Graph graph) {
+    int ** old_preds = malloc_checked(graph->block_count * sizeof(int *) + 1);
+    int * old_counts = malloc_checked(graph->block_count * sizeof(int) + 1);
+    for (int i = 0; i < graph->block_count; ++i) {
+        old_preds[i] = graph->blocks[i]->preds;
+        old_counts[i] = graph->blocks[i]->pred_count;
+        graph->blocks[i]->pred_count = 0;
+    }
+    for (int i = 0; i < graph->block_count; ++i) {
+        CFG_Block block = graph->blocks[i];
+        for (int j = 0; j < block->succ_count; ++j) {
+            ++graph->blocks[block->succs[j]]->pred_count;
+        }
+    }
+    for (int i = 0; i < graph->block_count; ++i) {
+        CFG_Block block = graph->blocks[i];
+        block->preds = block->pred_count ? AR_alloc(block->pred_count * sizeof(int)) : NULL;
+        block->pred_count = 0;
+    }
+    for (int i = 0; i < graph->block_count; ++i) {
+        CFG_Block block = graph->blocks[i];
+        for (int j = 0; j < block->succ_count; ++j) {
+            CFG_Block succ = graph->blocks[block->succs[j]];
+            succ->preds[succ->pred_count++] = i;
+        }
+    }
+    for (int i = 0; i < graph->block_count; ++i) {
+        CFG_Block block = graph->blocks[i];
+        if (block->instr_count && block->instrs[0].kind == CFG_PHI) {
+            CFG_realign_phis(block, old_preds[i], old_counts[i]);
+        }
+    }
+    free(old_preds);
+    free(old_counts);
+}
+
+/* Marks in reached the blocks reachable from the entry. */
+static void CFG_mark_reachable(CFG_Graph graph, bool * reached) {
+    int * stack = malloc_checked((graph->block_count + 1) * sizeof(int));
+    int depth = 0;
+    memset(reached, 0, graph->block_count * sizeof(bool));
+    if (graph->block_count) {
+        reached[0] = true;
+        stack[depth++] = 0;
+    }
+    while (depth) {
+        CFG_Block block = graph->blocks[stack[--depth]];
+        for (int j = 0; j < block->succ_count; ++j) {
+            int succ = block->succs[j];
+            if (succ >= 0 && succ < graph->block_count && !reached[succ]) {
+                reached[succ] = true;
+                stack[depth++] = succ;
+            }
+        }
+    }
+    free(stack);
+}
+
+void CFG_remove_unreachable(CFG_Graph graph) {
+    bool * reached = malloc_checked(graph->block_count * sizeof(bool) + 1);
+    int * renumbered = malloc_checked(graph->block_count * sizeof(int) + 1);
+    CFG_mark_reachable(graph, reached);
+    int count = 0;
+    for (int i = 0; i < graph->block_count; ++i) {
+        renumbered[i] = reached[i] ? count++ : -1;
+        if (reached[i]) {
+            graph->blocks[renumbered[i]] = graph->blocks[i];
+        }
+    }
+    graph->block_count = count;
+    for (int i = 0; i < count; ++i) {
+        CFG_Block block = graph->blocks[i];
+        block->id = i;
+        for (int j = 0; j < block->succ_count; ++j) {
+            block->succs[j] = renumbered[block->succs[j]];
+        }
+        // So that phis can tell which of their arguments still apply.
+        for (int j = 0; j < block->pred_count; ++j) {
+            block->preds[j] = renumbered[block->preds[j]];
+        }
+    }
+    free(reached);
+    free(renumbered);
+    CFG_compute_preds(graph);
+}
+
+/* The block a jump to block reaches once it has passed the empty
+ * blocks that only jump on, memoized in targets; -1 there stands for
+ * not yet known and -2 for on the chain being followed. A chain that
+ * runs into a cycle of such blocks ends at the block it reaches the
+ * cycle at, which then jumps to itself. */
+static int CFG_jump_target(CFG_Graph graph, int * targets, int block) {
+    int end = block;
+    while (targets[end] == -1) {
+        CFG_Block b = graph->blocks[end];
+        if (b->instr_count || b->end != CFG_JUMP) {
+            targets[end] = end;
+            break;
+        }
+        targets[end] = -2;
+        end = b->succs[0];
+    }
+    int target = targets[end] == -2 ? end : targets[end];
+    while (targets[block] == -2) {
+        int next = graph->blocks[block]->succs[0];
+        targets[block] = target;
+        block = next;
+    }
+    return target;
+}
+
+void CFG_merge_blocks(CFG_Graph graph) {
+    int * targets = malloc_checked(graph->block_count * sizeof(int) + 1);
+    for (int i = 0; i < graph->block_count; ++i) {
+        targets[i] = -1;
+    }
+    for (int i = 0; i < graph->block_count; ++i) {
+        CFG_Block block = graph->blocks[i];
+        for (int j = 0; j < block->succ_count; ++j) {
+            block->succs[j] = CFG_jump_target(graph, targets, block->succs[j]);
+        }
+        if (block->end == CFG_BRANCH && block->succs[0] == block->succs[1]) {
+            block->end = CFG_JUMP;
+            block->value = CFG_none();
+            block->succ_count = 1;
+        }
+    }
+    free(targets);
+    CFG_remove_unreachable(graph);
+    for (int i = 0; i < graph->block_count; ++i) {
+        CFG_Block block = graph->blocks[i];
+        while (block->end == CFG_JUMP && block->succs[0] != i && block->succs[0] != 0
+                && graph->blocks[block->succs[0]]->pred_count == 1) {
+            CFG_Block next = graph->blocks[block->succs[0]];
+            for (int j = 0; j < next->instr_count; ++j) {
+                CFG_add_instr(block, next->instrs[j]);
+            }
+            block->end = next->end;
+            block->value = next->value;
+            block->succ_count = next->succ_count;
+            for (int j = 0; j < next->succ_count; ++j) {
+                block->succs[j] = next->succs[j];
+                CFG_Block succ = graph->blocks[next->succs[j]];
+                for (int k = 0; k < succ->pred_count; ++k) {
+                    if (succ->preds[k] == next->id) {
+                        succ->preds[k] = i;
+                    }
+                }
+            }
+            // Left an empty return that nothing reaches, to be dropped below.
+            next->instr_count = 0;
+            next->end = CFG_RETURN;
+            next->value = CFG_none();
+            next->succ_count = 0;
+        }
+    }
+    CFG_remove_unreachable(graph);
+}
+
+/* Dominators */
+
+int * CFG_reverse_postorder(CFG_Graph graph, int * count) {
+    int n = graph->block_count;
+    int * order = malloc_checked(n * sizeof(int) + 1);
+    bool * visited = malloc_checked(n * sizeof(bool) + 1);
+    // Each entry of the stack is a block and the next successor to visit.
+    int * stack = malloc_checked(2 * (n + 1) * sizeof(int));
+    int depth = 0;
+    int done = 0;
+    memset(visited, 0, n * sizeof(bool));
+    if (n) {
+        visited[0] = true;
+        stack[0] = 0;
+        stack[1] = 0;
+        depth = 1;
+    }
+    while (depth) {
+        int * top = &stack[2 * (depth - 1)];
+        CFG_Block block = graph->blocks[top[0]];
+        if (top[1] < block->succ_count) {
+            int succ = block->succs[top[1]++];
+            if (!visited[succ]) {
+                visited[succ] = true;
+                stack[2 * depth] = succ;
+                stack[2 * depth + 1] = 0;
+                ++depth;
+            }
+        } else {
+            order[done++] = top[0];
+            --depth;
+        }
+    }
+    for (int i = 0; i < done / 2; ++i) {
+        int swap = order[i];
+        order[i] = order[done - 1 - i];
+        order[done - 1 - i] = swap;
+    }
+    free(visited);
+    free(stack);
+    *count = done;
+    return order;
+}
+
+/* The algorithm of Cooper, Harvey and Kennedy: iterate the
+ * intersection of the predecessors' dominators to a fixed point. */
+int * CFG_dominators(CFG_Graph graph) {
+    int n = graph->block_count;
+    int count;
+    int * order = CFG_reverse_postorder(graph, &count);
+    int * position = malloc_checked(n * sizeof(int) + 1);
+    int * idom = malloc_checked(n * sizeof(int) + 1);
+    for (int i = 0; i < n; ++i) {
+        position[i] = -1;
+        idom[i] = -1;
+    }
+    for (int i = 0; i < count; ++i) {
+        position[order[i]] = i;
+    }
+    if (n) {
+        idom[0] = 0;
+    }
+    for (bool changed = true; changed; ) {
+        changed = false;
+        for (int i = 1; i < count; ++i) {
+            CFG_Block block = graph->blocks[order[i]];
+            int new_idom = -1;
+            for (int j = 0; j < block->pred_count; ++j) {
+                int pred = block->preds[j];
+                if (idom[pred] < 0) {
+                    continue;
+                }
+                if (new_idom < 0) {
+                    new_idom = pred;
+                    continue;
+                }
+                int a = pred;
+                int b = new_idom;
+                while (a != b) {
+                    while (position[a] > position[b]) {
+                        a = idom[a];
+                    }
+                    while (position[b] > position[a]) {
+                        b = idom[b];
+                    }
+                }
+                new_idom = a;
+            }
+            if (idom[block->id] != new_idom) {
+                idom[block->id] = new_idom;
+                changed = true;
+            }
+        }
+    }
+    free(order);
+    free(position);
+    return idom;
+}
+
+int * CFG_dominator_children(CFG_Graph graph, int * idom, int ** first) {
+    int n = graph->block_count;
+    // A counting sort of the blocks by immediate dominator.
+    int * start = malloc_checked((n + 2) * sizeof(int));
+    int * children = malloc_checked(n * sizeof(int) + 1);
+    memset(start, 0, (n + 2) * sizeof(int));
+    for (int i = 1; i < n; ++i) {
+        if (idom[i] >= 0) {
+            ++start[idom[i] + 2];
+        }
+    }
+    for (int i = 0; i < n; ++i) {
+        start[i + 2] += start[i + 1];
+    }
+    for (int i = 1; i < n; ++i) {
+        if (idom[i] >= 0) {
+            children[start[idom[i] + 1]++] = i;
+        }
+    }
+    *first = start;
+    return children;
+}
+
+void CFG_dominator_intervals(CFG_Graph graph, int * idom, int ** enter, int ** leave) {
+    int n = graph->block_count;
+    int * first;
+    int * children = CFG_dominator_children(graph, idom, &first);
+    int * in = malloc_checked(n * sizeof(int) + 1);
+    int * out = malloc_checked(n * sizeof(int) + 1);
+    for (int i = 0; i < n; ++i) {
+        in[i] = -1;
+        out[i] = -1;
+    }
+    // Each entry of the stack is a block and the next child to visit.
+    int * stack = malloc_checked(2 * n * sizeof(int) + 1);
+    int depth = n ? 1 : 0;
+    int clock = 0;
+    if (n) {
+        stack[0] = 0;
+        stack[1] = first[0];
+        in[0] = clock++;
+    }
+    while (depth) {
+        int * top = &stack[2 * (depth - 1)];
+        if (top[1] < first[top[0] + 1]) {
+            int child = children[top[1]++];
+            in[child] = clock++;
+            stack[2 * depth] = child;
+            stack[2 * depth + 1] = first[child];
+            ++depth;
+        } else {
+            out[top[0]] = clock++;
+            --depth;
+        }
+    }
+    free(first);
+    free(children);
+    free(stack);
+    *enter = in;
+    *leave = out;
+}
+
+/* Printing */
+
+static const char * CFG_op_names[] = {
+    "+", "-", "*", "/", "==", "<>", "<", "<=", ">", ">=", "&", "|"
+};
+
+static void CFG_print_operand(FILE * out, CFG_Operand operand) {
+    switch (operand.kind) {
+        case CFG_NONE:
+            fputs("_", out);
+            break;
+        case CFG_CONST:
+            fprintf(out, "%d", operand.value);
+            break;
+        case CFG_TEMP:
+            fprintf(out, "t%d", operand.value);
+            break;
+    }
+}
+
+static void CFG_print_address(FILE * out, CFG_Instr * instr) {
+    fputc('[', out);
+    CFG_print_operand(out, instr->u.mem.address);
+    fprintf(out, " + %d]", instr->u.mem.offset);
+}
+
+/* Where an object is placed, if not on the heap. */
+static void CFG_print_slot(FILE * out, int offset) {
+    if (offset >= 0) {
+        fprintf(out, " (frame offset %d)", offset);
+    }
+}
+
+static void CFG_print_instr(FILE * out, CFG_Instr * instr) {
+    fputs("    ", out);
+    if (instr->dst >= 0) {
+        fprintf(out, "t%d = ", instr->dst);
+    }
+    switch (instr->kind) {
+        case CFG_MOVE:
+            CFG_print_operand(out, instr->u.move);
+            break;
+        case CFG_BINOP:
+            CFG_print_operand(out, instr->u.binop.left);
+            fprintf(out, " %s ", CFG_op_names[instr->u.binop.op]);
+            CFG_print_operand(out, instr->u.binop.right);
+            break;
+        case CFG_LOAD_VAR:
+            fprintf(out, "load %s (level %d, offset %d)", S_name(instr->u.var.name),
+                    instr->u.var.level, instr->u.var.offset);
+            break;
+        case CFG_STORE_VAR:
+            fprintf(out, "store %s (level %d, offset %d) = ", S_name(instr->u.var.name),
+                    instr->u.var.level, instr->u.var.offset);
+            CFG_print_operand(out, instr->u.var.value);
+            break;
+        case CFG_LOAD:
+            fputs("load ", out);
+            CFG_print_address(out, instr);
+            break;
+        case CFG_STORE:
+            fputs("store ", out);
+            CFG_print_address(out, instr);
+            fputs(" = ", out);
+            CFG_print_operand(out, instr->u.mem.value);
+            break;
+        case CFG_CALL:
+            fprintf(out, "call %s(", S_name(instr->u.call.name));
+            for (int i = 0; i < instr->u.call.arg_count; ++i) {
+                if (i) {
+                    fputs(", ", out);
+                }
+                CFG_print_operand(out, instr->u.call.args[i]);
+            }
+            fputc(')', out);
+            break;
+        case CFG_RECORD:
+            fprintf(out, "record %d", instr->u.alloc.size);
+            CFG_print_slot(out, instr->u.alloc.offset);
+            break;
+        case CFG_ARRAY:
+            fprintf(out, "array %d of ", instr->u.alloc.size);
+            CFG_print_operand(out, instr->u.alloc.init);
+            CFG_print_slot(out, instr->u.alloc.offset);
+            break;
+        case CFG_STRING:
+            fprintf(out, "string L%d \"%s\"", instr->u.string.label, instr->u.string.text);
+            break;
+        case CFG_PHI:
+            fputs("phi(", out);
+            for (int i = 0; i < instr->u.phi.arg_count; ++i) {
+                if (i) {
+                    fputs(", ", out);
+                }
+                CFG_print_operand(out, instr->u.phi.args[i]);
+            }
+            fputc(')', out);
+            break;
+    }
+    fputc('\n', out);
+}
+
+void CFG_print(FILE * out, CFG_Graph graph) {
+    fprintf(out, "Function: %s - %d blocks - %d temps\n", S_name(graph->func->name),
+            graph->block_count, graph->temp_count);
+    for (int i = 0; i < graph->block_count; ++i) {
+        CFG_Block block = graph->blocks[i];
+        fprintf(out, "  b%d:", block->id);
+        if (block->pred_count) {
+            fputs(" preds", out);
+            for (int j = 0; j < block->pred_count; ++j) {
+                fprintf(out, " b%d", block->preds[j]);
+            }
+        }
+        fputc('\n', out);
+        for (int j = 0; j < block->instr_count; ++j) {
+            CFG_print_instr(out, &block->instrs[j]);
+        }
+        switch (block->end) {
+            case CFG_JUMP:
+                fprintf(out, "    jump b%d\n", block->succs[0]);
+                break;
+            case CFG_BRANCH:
+                fputs("    branch ", out);
+                CFG_print_operand(out, block->value);
+                fprintf(out, " ? b%d : b%d\n", block->succs[0], block->succs[1]);
+                break;
+            case CFG_RETURN:
+                fputs("    return", out);
+                if (block->value.kind != CFG_NONE) {
+                    fputc(' ', out);
+                    CFG_print_operand(out, block->value);
+                }
+                fputc('\n', out);
+                break;
+        }
+    }
+    fputc('\n', out);
+}
+
+/* Verification */
+
+typedef struct CFG_Verifier_ {
+    CFG_Graph graph;
+    FILE * errors;
+    int problems;
+} CFG_Verifier;
+
+static void CFG_report(CFG_Verifier * verifier, int block, string message, ...) {
+    va_list ap;
+    fprintf(verifier->errors, "%s: b%d: ", S_name(verifier->graph->func->name), block);
+    va_start(ap, message);
+    vfprintf(verifier->errors, message, ap);
+    va_end(ap);
+    fputc('\n', verifier->errors);
+    ++verifier->problems;
+}
+
+static void CFG_verify_operand(CFG_Verifier * verifier, int block, CFG_Operand operand,
+        bool optional) {
+    if (operand.kind == CFG_NONE && !optional) {
+        CFG_report(verifier, block, "missing operand");
+    } else if (operand.kind == CFG_TEMP
+            && (operand.value < 0 || operand.value >= verifier->graph->temp_count)) {
+        CFG_report(verifier, block, "temp t%d out of range", operand.value);
+    }
+}
+
+static void CFG_verify_instr(CFG_Verifier * verifier, int block, CFG_Instr * instr) {
+    CFG_Graph graph = verifier->graph;
+    if (instr->kind == CFG_PHI) {
+        CFG_Block phi_block = graph->blocks[block];
+        if (!graph->ssa) {
+            CFG_report(verifier, block, "phi outside SSA form");
+        } else if (instr != phi_block->instrs && instr[-1].kind != CFG_PHI) {
+            CFG_report(verifier, block, "phi after other instructions");
+        } else if (instr->u.phi.arg_count != phi_block->pred_count) {
+            CFG_report(verifier, block, "phi of %d arguments for %d predecessors",
+                    instr->u.phi.arg_count, phi_block->pred_count);
+            return;
+        }
+    }
+    bool defines = instr->kind != CFG_STORE_VAR && instr->kind != CFG_STORE
+        && instr->kind != CFG_CALL;
+    if (defines && (instr->dst < 0 || instr->dst >= graph->temp_count)) {
+        CFG_report(verifier, block, "instruction defines no valid temp (t%d)", instr->dst);
+    } else if (!defines && instr->kind != CFG_CALL && instr->dst != -1) {
+        CFG_report(verifier, block, "store defines t%d", instr->dst);
+    } else if (instr->kind == CFG_CALL && instr->dst >= graph->temp_count) {
+        CFG_report(verifier, block, "call defines temp t%d out of range", instr->dst);
+    }
+    if (instr->kind == CFG_BINOP
+            && (instr->u.binop.op < A_PLUS_OP || instr->u.binop.op > A_OR_OP)) {
+        CFG_report(verifier, block, "unknown operator %d", instr->u.binop.op);
+    }
+    if ((instr->kind == CFG_RECORD || instr->kind == CFG_ARRAY) && instr->u.alloc.offset >= 0
+            && (instr->u.alloc.offset < instr->u.alloc.size
+                || instr->u.alloc.offset > graph->func->frame->end)) {
+        CFG_report(verifier, block, "object of %d bytes at offset %d outside the frame",
+                instr->u.alloc.size, instr->u.alloc.offset);
+    }
+    if (instr->kind == CFG_CALL && instr->u.call.arg_count && !instr->u.call.args) {
+        CFG_report(verifier, block, "call has no argument array");
+        return;
+    }
+    for (int i = 0, n = CFG_use_count(instr); i < n; ++i) {
+        CFG_verify_operand(verifier, block, *CFG_use(instr, i), false);
+    }
+}
+
+/* Where each temp is defined, and the dominator tree numbered so
+ * that a block dominates another when its interval contains the other's. */
+typedef struct CFG_SSAInfo_ {
+    int * def_block;
+    int * def_index;
+    int * enter;
+    int * leave;
+} CFG_SSAInfo;
+
+static bool CFG_dominates(CFG_SSAInfo * info, int a, int b) {
+    return info->enter[a] <= info->enter[b] && info->leave[b] <= info->leave[a];
+}
+
+/* Check that the temp used by operand, if any, is defined where it
+ * dominates position index of block (the block's end if index is
+ * instr_count). */
+static void CFG_verify_ssa_use(CFG_Verifier * verifier, CFG_SSAInfo * info, int block,
+        int index, CFG_Operand operand) {
+    if (operand.kind != CFG_TEMP) {
+        return;
+    }
+    int temp = operand.value;
+    int def = info->def_block[temp];
+    if (def < 0) {
+        CFG_report(verifier, block, "t%d used but never defined", temp);
+    } else if (def == block ? info->def_index[temp] >= index : !CFG_dominates(info, def, block)) {
+        CFG_report(verifier, block, "use of t%d not dominated by its definition", temp);
+    }
+}
+
+static void CFG_verify_ssa(CFG_Verifier * verifier) {
+    CFG_Graph graph = verifier->graph;
+    int n = graph->block_count;
+    CFG_SSAInfo info;
+    info.def_block = malloc_checked(graph->temp_count * sizeof(int) + 1);
+    info.def_index = malloc_checked(graph->temp_count * sizeof(int) + 1);
+    for (int t = 0; t < graph->temp_count; ++t) {
+        info.def_block[t] = -1;
+    }
+    for (int i = 0; i < n; ++i) {
+        CFG_Block block = graph->blocks[i];
+        for (int j = 0; j < block->instr_count; ++j) {
+            int dst = block->instrs[j].dst;
+            if (dst < 0) {
+                continue;
+            }
+            if (info.def_block[dst] >= 0) {
+                CFG_report(verifier, i, "t%d defined more than once", dst);
+            }
+            info.def_block[dst] = i;
+            info.def_index[dst] = j;
+        }
+    }
+    int * idom = CFG_dominators(graph);
+    CFG_dominator_intervals(graph, idom, &info.enter, &info.leave);
+    for (int i = 0; i < n; ++i) {
+        CFG_Block block = graph->blocks[i];
+        for (int j = 0; j < block->instr_count; ++j) {
+            CFG_Instr * instr = &block->instrs[j];
+            for (int k = 0, m = CFG_use_count(instr); k < m; ++k) {
+                if (instr->kind == CFG_PHI) {
+                    // A phi's argument is used at the end of its predecessor.
+                    int pred = block->preds[k];
+                    CFG_verify_ssa_use(verifier, &info, pred, graph->blocks[pred]->instr_count,
+                            *CFG_use(instr, k));
+                } else {
+                    CFG_verify_ssa_use(verifier, &info, i, j, *CFG_use(instr, k));
+                }
+            }
+        }
+        CFG_verify_ssa_use(verifier, &info, i, block->instr_count, block->value);
+    }
+    free(info.def_block);
+    free(info.def_index);
+    free(info.enter);
+    free(info.leave);
+    free(idom);
+}
+
+bool CFG_verify(CFG_Graph graph, FILE * errors) {
+    CFG_Verifier verifier = { graph, errors, 0 };
+    if (!graph->block_count) {
+        CFG_report(&verifier, 0, "no entry block");
+        return false;
+    }
+    int edges = 0;
+    for (int i = 0; i < graph->block_count; ++i) {
+        CFG_Block block = graph->blocks[i];
+        if (block->id != i) {
+            CFG_report(&verifier, i, "block numbered %d", block->id);
+        }
+        for (int j = 0; j < block->instr_count; ++j) {
+            CFG_verify_instr(&verifier, i, &block->instrs[j]);
+        }
+        int expected = block->end == CFG_JUMP ? 1 : block->end == CFG_BRANCH ? 2 : 0;
+        if (block->succ_count != expected) {
+            CFG_report(&verifier, i, "%d successors for its end", block->succ_count);
+            continue;
+        }
+        if (block->end == CFG_BRANCH) {
+            CFG_verify_operand(&verifier, i, block->value, false);
+        } else if (block->end == CFG_RETURN) {
+            CFG_verify_operand(&verifier, i, block->value, true);
+        }
+        for (int j = 0; j < block->succ_count; ++j) {
+            int succ = block->succs[j];
+            if (succ < 0 || succ >= graph->block_count) {
+                CFG_report(&verifier, i, "successor b%d out of range", succ);
+                continue;
+            }
+            ++edges;
+            // Each edge is listed among its target's predecessors.
+            int listed = 0;
+            int needed = 0;
+            CFG_Block target = graph->blocks[succ];
+            for (int k = 0; k < target->pred_count; ++k) {
+                listed += target->preds[k] == i;
+            }
+            for (int k = 0; k < block->succ_count; ++k) {
+                needed += block->succs[k] == succ;
+            }
+            if (listed != needed) {
+                CFG_report(&verifier, i, "edge to b%d missing from its predecessors", succ);
+            }
+        }
+    }
+    int preds = 0;
+    for (int i = 0; i < graph->block_count; ++i) {
+        preds += graph->blocks[i]->pred_count;
+    }
+    if (preds != edges) {
+        CFG_report(&verifier, 0, "%d predecessors listed for %d edges", preds, edges);
+    }
+    bool * reached = malloc_checked(graph->block_count * sizeof(bool));
+    CFG_mark_reachable(graph, reached);
+    for (int i = 0; i < graph->block_count; ++i) {
+        if (!reached[i]) {
+            CFG_report(&verifier, i, "unreachable from the entry");
+        }
+    }
+    free(reached);
+    if (graph->ssa && !verifier.problems) {
+        CFG_verify_ssa(&verifier);
+    }
+    return !verifier.problems;
+}
@@ -0,0 +1,162 @@
+/*
+ * cfg.h -
+ * Canonical form of the IR: each function as a control-flow graph
+ * of basic blocks of three-address instructions.
+ * CFG_build linearizes a TR_Function's body. Every intermediate value
+ * gets a temp, evaluated left to right, so the instructions are in the
+ * order their side effects happen; statements hidden in expressions
+ * (sequences, conditionals) are hoisted into the blocks around them;
+ * structured ifs and loops become branches, and break a jump to the
+ * block after its loop. A block ends in exactly one jump, branch or
+ * return, and only blocks reachable from the entry, block 0, are kept.
+ * Temps are numbered per graph, densely from 0; a variable kept in a
+ * temp (see escape.h) gets one of them, which a parameter's argument
+ * is loaded into on entry. Optimization passes
+ * may put a graph into SSA form, with phis merging the values that
+ * reach a block, and take it back out.
+ * All types and functions declared in this module begin with "CFG_".
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "absyn.h"
+#include "symbol.h"
+#include "translate.h"
+
+typedef struct CFG_Graph_ * CFG_Graph;
+typedef struct CFG_GraphList_ * CFG_GraphList;
+typedef struct CFG_Block_ * CFG_Block;
+typedef struct CFG_Instr_ CFG_Instr;
+typedef struct CFG_Operand_ CFG_Operand;
+
+/* A constant or a temp; CFG_NONE stands for no value. */
+struct CFG_Operand_ {
+    enum { CFG_NONE, CFG_CONST, CFG_TEMP } kind;
+    int value;
+};
+
+struct CFG_Instr_ {
+    enum {
+        CFG_MOVE,
+        CFG_BINOP,
+        CFG_LOAD_VAR,
+        CFG_STORE_VAR,
+        CFG_LOAD,
+        CFG_STORE,
+        CFG_CALL,
+        CFG_RECORD,
+        CFG_ARRAY,
+        CFG_STRING,
+        CFG_PHI
+    } kind;
+    /* The temp defined, or -1 for none. */
+    int dst;
+    union {
+        CFG_Operand move;
+        /* Relational operators yield 1 or 0. */
+        struct { A_Oper op; CFG_Operand left; CFG_Operand right; } binop;
+        /* A variable of the frame at the given nesting level. */
+        struct { S_Symbol name; int level; int offset; int size; CFG_Operand value; } var;
+        /* The memory at address + offset. */
+        struct { CFG_Operand address; int offset; int size; CFG_Operand value; } mem;
+        struct { S_Symbol name; int arg_count; CFG_Operand * args; } call;
+        /* A record leaves init CFG_NONE; an array fills every element with it.
+         * The object is on the heap if offset is -1, and otherwise in the
+         * frame's object slot at offset, which it reuses on each run. */
+        struct { int size; CFG_Operand init; int offset; } alloc;
+        struct { string text; TR_Label label; } string;
+        /* In SSA form only: the value from each predecessor, in the
+         * order of the block's preds. */
+        struct { int arg_count; CFG_Operand * args; } phi;
+    } u;
+};
+
+struct CFG_Block_ {
+    int id;
+    int instr_count;
+    int instr_capacity;
+    CFG_Instr * instrs;
+    enum { CFG_JUMP, CFG_BRANCH, CFG_RETURN } end;
+    /* The condition of a branch, or the value returned, if any. */
+    CFG_Operand value;
+    /* A jump's target, or a branch's targets when true and when false. */
+    int succ_count;
+    int succs[2];
+    int pred_count;
+    int * preds;
+};
+
+struct CFG_Graph_ {
+    TR_Function func;
+    /* Whether the graph is in SSA form: each temp is defined once,
+     * and the phis come first in their blocks. */
+    bool ssa;
+    int temp_count;
+    int block_count;
+    int block_capacity;
+    CFG_Block * blocks;
+};
+
+struct CFG_GraphList_ {
+    CFG_Graph head;
+    CFG_GraphList tail;
+};
+
+CFG_Graph CFG_build(TR_Function func);
+
+/* The graphs of main_ and every function nested in it, in the order
+ * P_print_ir prints them. */
+CFG_GraphList CFG_build_all(TR_Function main_);
+
+/* Operands an instruction reads, by index from 0 up to
+ * CFG_use_count; passes may rewrite them in place. */
+int CFG_use_count(CFG_Instr * instr);
+CFG_Operand * CFG_use(CFG_Instr * instr, int i);
+
+CFG_Operand CFG_none();
+CFG_Operand CFG_const(int value);
+CFG_Operand CFG_temp(int temp);
+int CFG_new_temp(CFG_Graph graph);
+CFG_Block CFG_new_block(CFG_Graph graph);
+void CFG_add_instr(CFG_Block block, CFG_Instr instr);
+
+/* Recompute every block's predecessors from the successors, keeping
+ * each phi's argument from a predecessor that is still one. */
+void CFG_compute_preds(CFG_Graph graph);
+
+/* Drop the blocks not reachable from the entry and renumber the rest,
+ * keeping their order; recomputes the predecessors. */
+void CFG_remove_unreachable(CFG_Graph graph);
+
+/* Send each jump and branch past the empty blocks that only jump on,
+ * turn a branch both of whose targets agree into a jump, and merge
+ * each block into the block whose jump is its only predecessor; then
+ * drop the blocks left unreachable. The graph must not be in SSA form. */
+void CFG_merge_blocks(CFG_Graph graph);
+
+/* The blocks in reverse postorder from the entry; sets *count. */
+int * CFG_reverse_postorder(CFG_Graph graph, int * count);
+
+/* Each block's immediate dominator, the entry being its own;
+ * -1 for blocks not reachable from the entry. */
+int * CFG_dominators(CFG_Graph graph);
+
+/* The children of each block in the dominator tree idom: those of
+ * block b are children[(*first)[b]] up to children[(*first)[b + 1]].
+ * Both arrays are the caller's to free. */
+int * CFG_dominator_children(CFG_Graph graph, int * idom, int ** first);
+
+/* Number the dominator tree idom depth first, so that block a
+ * dominates block b exactly when a's interval from (*enter)[a] to
+ * (*leave)[a] contains b's; -1 for blocks not in the tree. Both arrays
+ * are the caller's to free. */
+void CFG_dominator_intervals(CFG_Graph graph, int * idom, int ** enter, int ** leave);
+
+void CFG_print(FILE * out, CFG_Graph graph);
+
+/* Check the graph's invariants, reporting each violation to errors;
+ * true if there are none. */
+bool CFG_verify(CFG_Graph graph, FILE * errors);
@@ -19,6 +19,13 @@ E_EnvEntry make_E_VarEntry(T_Type type, int nesting_level, int offset) {
     env_entry->u.var.type = type;
     env_entry->u.var.nesting_level = nesting_level;
     env_entry->u.var.offset = offset;
+    env_entry->u.var.temp = -1;
+    return env_entry;
+}
+
+E_EnvEntry make_E_TempEntry(T_Type type, int nesting_level, int temp) {
+    E_EnvEntry env_entry = make_E_VarEntry(type, nesting_level, -1);
+    env_entry->u.var.temp = temp;
     return env_entry;
 }
 
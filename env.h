@@ -13,6 +13,8 @@
  *  by Amittai Aviram - aviram@bc.edu.
  */
 
+#pragma once
+
 #include "types.h"
 
 typedef struct E_EnvEntry_ * E_EnvEntry;
@@ -20,12 +22,15 @@ typedef struct E_EnvEntry_ * E_EnvEntry;
 struct E_EnvEntry_ {
     enum { E_VAR_ENTRY, E_FUN_ENTRY } kind;
     union {
-        struct { T_Type type; int nesting_level; int offset; } var;
+        /* A variable in a temp of its function has no offset; one in
+         * the frame has temp -1. */
+        struct { T_Type type; int nesting_level; int offset; int temp; } var;
         struct { T_TypeList formals; T_Type result; } fun;
     } u;
 };
 
 E_EnvEntry make_E_VarEntry(T_Type type, int nesting_level, int offset);
+E_EnvEntry make_E_TempEntry(T_Type type, int nesting_level, int temp);
 E_EnvEntry make_E_FunEntry(T_TypeList formals, T_Type result);
 S_Table E_base_tenv();
 S_Table E_base_venv();
@@ -9,38 +9,148 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
 
 #include "errormsg.h"
 #include "util.h"
 
-bool any_errors = false;
+bool EM_any_errors = false;
 static string file_name = "";
 extern FILE * yyin;
+extern void yyrestart(FILE * input_file);
 extern int yylineno;
 extern int colnum;
 
+struct EM_Buffer_ {
+    string text;
+    int length;
+    int capacity;
+    bool any_errors;
+};
+
+static __thread EM_Buffer current_buffer = NULL;
+
+EM_Buffer make_EM_Buffer() {
+    EM_Buffer buffer = malloc_checked(sizeof(*buffer));
+    buffer->text = NULL;
+    buffer->length = 0;
+    buffer->capacity = 0;
+    buffer->any_errors = false;
+    return buffer;
+}
+
+EM_Buffer EM_redirect(EM_Buffer buffer) {
+    EM_Buffer previous = current_buffer;
+    current_buffer = buffer;
+    return previous;
+}
+
+bool EM_buffer_has_errors(EM_Buffer buffer) {
+    return buffer->any_errors;
+}
+
+string EM_buffer_text(EM_Buffer buffer) {
+    return buffer->length ? buffer->text : "";
+}
+
+static void EM_append(EM_Buffer buffer, string text, int length) {
+    if (buffer->length + length + 1 > buffer->capacity) {
+        int capacity = 2 * buffer->capacity + length + 1;
+        string grown = malloc_checked(capacity);
+        if (buffer->text) {
+            memcpy(grown, buffer->text, buffer->length);
+            free(buffer->text);
+        }
+        buffer->text = grown;
+        buffer->capacity = capacity;
+    }
+    memcpy(buffer->text + buffer->length, text, length);
+    buffer->length += length;
+    buffer->text[buffer->length] = '\0';
+}
+
+static void EM_vprintf(string format, va_list ap) {
+    if (!current_buffer) {
+        vfprintf(stderr, format, ap);
+        return;
+    }
+    char line[256];
+    va_list copy;
+    va_copy(copy, ap);
+    int length = vsnprintf(line, sizeof(line), format, copy);
+    va_end(copy);
+    if (length < (int) sizeof(line)) {
+        EM_append(current_buffer, line, length);
+    } else {
+        string text = malloc_checked(length + 1);
+        vsnprintf(text, length + 1, format, ap);
+        EM_append(current_buffer, text, length);
+        free(text);
+    }
+}
+
+static void EM_printf(string format, ...) {
+    va_list ap;
+    va_start(ap, format);
+    EM_vprintf(format, ap);
+    va_end(ap);
+}
+
+void EM_flush(EM_Buffer buffer) {
+    if (buffer->length) {
+        if (current_buffer) {
+            EM_append(current_buffer, buffer->text, buffer->length);
+        } else {
+            fputs(buffer->text, stderr);
+        }
+    }
+    if (buffer->any_errors) {
+        if (current_buffer) {
+            current_buffer->any_errors = true;
+        } else {
+            EM_any_errors = true;
+        }
+    }
+    buffer->length = 0;
+    buffer->any_errors = false;
+}
+
 void EM_error(E_Pos pos, string message, ...) {
     va_list ap;
-    any_errors = true;
+    if (current_buffer) {
+        current_buffer->any_errors = true;
+    } else {
+        EM_any_errors = true;
+    }
     if (file_name) {
-        fprintf(stderr,"%s:", file_name);
+        EM_printf("%s:", file_name);
     }
-    fprintf(stderr, "%d.%d: ", pos.first_line, pos.first_column);
+    EM_printf("%d.%d: ", pos.first_line, pos.first_column);
     va_start(ap, message);
-    vfprintf(stderr, message, ap);
+    EM_vprintf(message, ap);
     va_end(ap);
-    fprintf(stderr, "\n");
+    EM_printf("\n");
 }
 
-void EM_reset(string fname) {
-    any_errors = false;
+bool EM_reset(string fname) {
+    EM_any_errors = false;
     yylineno = 1;
     colnum = 1;
     file_name = fname;
-    yyin = fopen(fname, "r");
+    // "-" names the standard input.
+    yyin = strcmp(fname, "-") ? fopen(fname, "r") : stdin;
     if (!yyin) {
-        perror("Cannot open input file");
-        exit(EXIT_FAILURE);
+        return false;
+    }
+    // A directory opens, but cannot be read.
+    struct stat st;
+    if (fstat(fileno(yyin), &st) || S_ISDIR(st.st_mode)) {
+        fclose(yyin);
+        yyin = NULL;
+        return false;
     }
+    yyrestart(yyin);
+    return true;
 }
 
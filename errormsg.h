@@ -19,7 +19,22 @@ typedef struct E_Pos_ {
   int last_column;
 } E_Pos;
 
+typedef struct EM_Buffer_ * EM_Buffer;
+
 extern bool EM_any_errors;
 
 void EM_error(E_Pos, string, ...);
-void EM_reset(string file_name);
+/* Start reading file_name; false if it cannot be opened. */
+bool EM_reset(string file_name);
+
+/* Error buffers hold the diagnostics of work done on another thread
+ * until they can be emitted in source order.
+ * EM_redirect installs a buffer for the calling thread
+ * (NULL restores stderr) and returns the previous one;
+ * EM_flush moves a buffer's contents to the current destination. */
+EM_Buffer make_EM_Buffer();
+EM_Buffer EM_redirect(EM_Buffer buffer);
+void EM_flush(EM_Buffer buffer);
+bool EM_buffer_has_errors(EM_Buffer buffer);
+/* The diagnostics held by a buffer, one per line. */
+string EM_buffer_text(EM_Buffer buffer);
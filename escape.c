@@ -0,0 +1,166 @@
+/*
+ * escape.c -
+ * Implementation of escape analysis.
+ * See escape.h for more information.
+ */
+
+#include <stdlib.h>
+
+#include "escape.h"
+#include "stack.h"
+#include "symbol.h"
+#include "util.h"
+
+/* A name in scope: the function depth it is declared at and its
+ * declaration's escape flag. A function has none, but still hides
+ * any variable of the same name. */
+typedef struct ESC_Entry_ * ESC_Entry;
+
+struct ESC_Entry_ {
+    int depth;
+    bool * escape;
+};
+
+static void ESC_exp(S_Table env, int depth, A_Exp exp);
+
+static void ESC_declare(S_Table env, S_Symbol name, int depth, bool * escape) {
+    ESC_Entry entry = malloc_checked(sizeof(*entry));
+    entry->depth = depth;
+    entry->escape = escape;
+    if (escape) {
+        *escape = false;
+    }
+    S_enter(env, name, entry);
+}
+
+static void ESC_var(S_Table env, int depth, A_Var var) {
+    // Only the innermost variable of a chain of fields and subscripts is named.
+    while (var->kind != A_SIMPLE_VAR) {
+        if (var->kind == A_FIELD_VAR) {
+            var = var->u.field.var;
+        } else {
+            ESC_exp(env, depth, var->u.subscript.exp);
+            var = var->u.subscript.var;
+        }
+    }
+    ESC_Entry entry = S_look(env, var->u.simple);
+    if (entry && entry->escape && entry->depth < depth) {
+        *entry->escape = true;
+    }
+}
+
+static void ESC_decs(S_Table env, int depth, A_DecList decs) {
+    for (; decs; decs = decs->tail) {
+        A_Dec dec = decs->head;
+        switch (dec->kind) {
+            case A_TYPE_DEC_GROUP:
+                break;
+            case A_VAR_DEC:
+                ESC_exp(env, depth, dec->u.var.init);
+                ESC_declare(env, dec->u.var.var, depth, &dec->u.var.escape);
+                break;
+            case A_FUNCTION_DEC_GROUP:
+                // The functions of a group are in scope in all their bodies.
+                for (A_FunDecList fdl = dec->u.function; fdl; fdl = fdl->tail) {
+                    ESC_declare(env, fdl->head->name, depth, NULL);
+                }
+                for (A_FunDecList fdl = dec->u.function; fdl; fdl = fdl->tail) {
+                    A_FunDec fd = fdl->head;
+                    S_begin_scope(env);
+                    for (A_FieldList params = fd->params; params; params = params->tail) {
+                        ESC_declare(env, params->head->name, depth + 1, &params->head->escape);
+                    }
+                    ESC_exp(env, depth + 1, fd->body);
+                    S_end_scope(env);
+                }
+                break;
+        }
+    }
+}
+
+/* A call of ESC_exp continued on a new stack segment. */
+typedef struct ESC_DeepCall_ {
+    S_Table env;
+    int depth;
+    A_Exp exp;
+} ESC_DeepCall;
+
+static void ESC_run_deep_call(void * arg) {
+    ESC_DeepCall * call = arg;
+    ESC_exp(call->env, call->depth, call->exp);
+}
+
+static void ESC_exp(S_Table env, int depth, A_Exp exp) {
+    if (!exp) {
+        return;
+    }
+    if (ST_low()) {
+        ESC_DeepCall call = { env, depth, exp };
+        ST_call(ESC_run_deep_call, &call);
+        return;
+    }
+    switch (exp->kind) {
+        case A_VAR_EXP:
+            ESC_var(env, depth, exp->u.var);
+            break;
+        case A_NIL_EXP:
+        case A_INT_EXP:
+        case A_STRING_EXP:
+        case A_BREAK_EXP:
+            break;
+        case A_CALL_EXP:
+            for (A_ExpList args = exp->u.call.args; args; args = args->tail) {
+                ESC_exp(env, depth, args->head);
+            }
+            break;
+        case A_OP_EXP:
+            ESC_exp(env, depth, exp->u.op.left);
+            ESC_exp(env, depth, exp->u.op.right);
+            break;
+        case A_RECORD_EXP:
+            for (A_EFieldList fields = exp->u.record.fields; fields; fields = fields->tail) {
+                ESC_exp(env, depth, fields->head->exp);
+            }
+            break;
+        case A_SEQ_EXP:
+            for (A_ExpList exps = exp->u.seq; exps; exps = exps->tail) {
+                ESC_exp(env, depth, exps->head);
+            }
+            break;
+        case A_ASSIGN_EXP:
+            ESC_var(env, depth, exp->u.assign.var);
+            ESC_exp(env, depth, exp->u.assign.exp);
+            break;
+        case A_IF_EXP:
+            ESC_exp(env, depth, exp->u.iff.test);
+            ESC_exp(env, depth, exp->u.iff.then);
+            ESC_exp(env, depth, exp->u.iff.elsee);
+            break;
+        case A_WHILE_EXP:
+            ESC_exp(env, depth, exp->u.whilee.test);
+            ESC_exp(env, depth, exp->u.whilee.body);
+            break;
+        case A_FOR_EXP:
+            ESC_exp(env, depth, exp->u.forr.lo);
+            ESC_exp(env, depth, exp->u.forr.hi);
+            S_begin_scope(env);
+            ESC_declare(env, exp->u.forr.var, depth, &exp->u.forr.escape);
+            ESC_exp(env, depth, exp->u.forr.body);
+            S_end_scope(env);
+            break;
+        case A_LET_EXP:
+            S_begin_scope(env);
+            ESC_decs(env, depth, exp->u.let.decs);
+            ESC_exp(env, depth, exp->u.let.body);
+            S_end_scope(env);
+            break;
+        case A_ARRAY_EXP:
+            ESC_exp(env, depth, exp->u.array.size);
+            ESC_exp(env, depth, exp->u.array.init);
+            break;
+    }
+}
+
+void ESC_find_escapes(A_Exp prog) {
+    ESC_exp(S_empty(), 0, prog);
+}
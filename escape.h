@@ -0,0 +1,17 @@
+/*
+ * escape.h -
+ * Escape analysis of the abstract syntax.
+ * A variable, parameter or for-loop counter escapes when a function
+ * nested inside the one declaring it uses it: that function reaches
+ * it through the frame, so it must live there. ESC_find_escapes sets
+ * the escape flag of every declaration in a program accordingly;
+ * translation keeps the ones that do not escape in temps.
+ * All types and functions declared in this module begin with "ESC_".
+ */
+
+#pragma once
+
+#include "absyn.h"
+
+/* Set the escape flag of every variable declared in prog. */
+void ESC_find_escapes(A_Exp prog);
@@ -0,0 +1,271 @@
+/*
+ * fingerprint.c -
+ * Implementation of structural hashes of abstract syntax.
+ * See fingerprint.h for more information.
+ */
+
+#include <stdlib.h>
+
+#include "fingerprint.h"
+#include "stack.h"
+#include "table.h"
+#include "util.h"
+
+#define FP_PRIME 1099511628211UL
+#define FP_VALUE_REF ((void *) 1)
+#define FP_TYPE_REF ((void *) 2)
+#define FP_BOTH_REFS ((void *) 3)
+
+typedef struct FP_State_ * FP_State;
+
+struct FP_State_ {
+    FP_Hash hash;
+    TAB_Table seen;
+    FP_SymbolList refs;
+};
+
+static void FP_exp(FP_State state, A_Exp exp);
+static void FP_decs(FP_State state, A_DecList decs);
+
+FP_Hash FP_combine(FP_Hash hash, FP_Hash value) {
+    for (int i = 0; i < (int) sizeof(value); ++i) {
+        hash ^= (value >> (8 * i)) & 0xff;
+        hash *= FP_PRIME;
+    }
+    return hash;
+}
+
+FP_Hash FP_hash_string(FP_Hash hash, string s) {
+    for (; *s; ++s) {
+        hash ^= (unsigned char) *s;
+        hash *= FP_PRIME;
+    }
+    return FP_combine(hash, 0);
+}
+
+static void FP_int(FP_State state, FP_Hash value) {
+    state->hash = FP_combine(state->hash, value);
+}
+
+static void FP_sym(FP_State state, S_Symbol sym) {
+    state->hash = sym ? FP_hash_string(state->hash, S_name(sym)) : FP_combine(state->hash, 1);
+}
+
+static void FP_ref(FP_State state, S_Symbol sym, bool is_type) {
+    FP_sym(state, sym);
+    if (!sym) {
+        return;
+    }
+    void * seen = TAB_look(state->seen, sym);
+    void * bit = is_type ? FP_TYPE_REF : FP_VALUE_REF;
+    if (seen == bit || seen == FP_BOTH_REFS) {
+        return;
+    }
+    TAB_enter(state->seen, sym, seen ? FP_BOTH_REFS : bit);
+    FP_SymbolList ref = malloc_checked(sizeof(*ref));
+    ref->sym = sym;
+    ref->is_type = is_type;
+    ref->tail = state->refs;
+    state->refs = ref;
+}
+
+static void FP_var(FP_State state, A_Var var) {
+    FP_int(state, var->kind);
+    switch (var->kind) {
+        case A_SIMPLE_VAR:
+            FP_ref(state, var->u.simple, false);
+            break;
+        case A_FIELD_VAR:
+            FP_var(state, var->u.field.var);
+            FP_sym(state, var->u.field.sym);
+            break;
+        case A_SUBSCRIPT_VAR:
+            FP_var(state, var->u.subscript.var);
+            FP_exp(state, var->u.subscript.exp);
+            break;
+    }
+}
+
+/* A call of FP_exp continued on a new stack segment. */
+typedef struct FP_DeepCall_ {
+    FP_State state;
+    A_Exp exp;
+} FP_DeepCall;
+
+static void FP_run_deep_call(void * arg) {
+    FP_DeepCall * call = arg;
+    FP_exp(call->state, call->exp);
+}
+
+static void FP_exp(FP_State state, A_Exp exp) {
+    if (!exp) {
+        FP_int(state, -1);
+        return;
+    }
+    if (ST_low()) {
+        FP_DeepCall call = { state, exp };
+        ST_call(FP_run_deep_call, &call);
+        return;
+    }
+    FP_int(state, exp->kind);
+    switch (exp->kind) {
+        case A_VAR_EXP:
+            FP_var(state, exp->u.var);
+            break;
+        case A_NIL_EXP:
+        case A_BREAK_EXP:
+            break;
+        case A_INT_EXP:
+            FP_int(state, exp->u.intt);
+            break;
+        case A_STRING_EXP:
+            state->hash = FP_hash_string(state->hash, exp->u.stringg);
+            break;
+        case A_CALL_EXP:
+            FP_ref(state, exp->u.call.func, false);
+            for (A_ExpList args = exp->u.call.args; args; args = args->tail) {
+                FP_exp(state, args->head);
+            }
+            FP_int(state, -1);
+            break;
+        case A_OP_EXP:
+            FP_int(state, exp->u.op.oper);
+            FP_exp(state, exp->u.op.left);
+            FP_exp(state, exp->u.op.right);
+            break;
+        case A_RECORD_EXP:
+            FP_ref(state, exp->u.record.type, true);
+            for (A_EFieldList fields = exp->u.record.fields; fields; fields = fields->tail) {
+                FP_sym(state, fields->head->name);
+                FP_exp(state, fields->head->exp);
+            }
+            FP_int(state, -1);
+            break;
+        case A_SEQ_EXP:
+            for (A_ExpList exps = exp->u.seq; exps; exps = exps->tail) {
+                FP_exp(state, exps->head);
+            }
+            FP_int(state, -1);
+            break;
+        case A_ASSIGN_EXP:
+            FP_var(state, exp->u.assign.var);
+            FP_exp(state, exp->u.assign.exp);
+            break;
+        case A_IF_EXP:
+            FP_exp(state, exp->u.iff.test);
+            FP_exp(state, exp->u.iff.then);
+            FP_exp(state, exp->u.iff.elsee);
+            break;
+        case A_WHILE_EXP:
+            FP_exp(state, exp->u.whilee.test);
+            FP_exp(state, exp->u.whilee.body);
+            break;
+        case A_FOR_EXP:
+            FP_sym(state, exp->u.forr.var);
+            FP_exp(state, exp->u.forr.lo);
+            FP_exp(state, exp->u.forr.hi);
+            FP_exp(state, exp->u.forr.body);
+            break;
+        case A_LET_EXP:
+            FP_decs(state, exp->u.let.decs);
+            FP_exp(state, exp->u.let.body);
+            break;
+        case A_ARRAY_EXP:
+            FP_ref(state, exp->u.array.type, true);
+            FP_exp(state, exp->u.array.size);
+            FP_exp(state, exp->u.array.init);
+            break;
+    }
+}
+
+static void FP_type(FP_State state, A_Type type) {
+    FP_int(state, type->kind);
+    switch (type->kind) {
+        case A_NAME_TYPE:
+            FP_ref(state, type->u.name, true);
+            break;
+        case A_RECORD_TYPE:
+            for (A_FieldList fields = type->u.record; fields; fields = fields->tail) {
+                FP_sym(state, fields->head->name);
+                FP_ref(state, fields->head->type, true);
+            }
+            FP_int(state, -1);
+            break;
+        case A_ARRAY_TYPE:
+            FP_ref(state, type->u.array, true);
+            break;
+    }
+}
+
+static void FP_type_decs(FP_State state, A_TypeDecList decs) {
+    for (; decs; decs = decs->tail) {
+        FP_sym(state, decs->head->name);
+        FP_type(state, decs->head->type);
+    }
+    FP_int(state, -1);
+}
+
+static void FP_fundec(FP_State state, A_FunDec fd) {
+    FP_sym(state, fd->name);
+    for (A_FieldList params = fd->params; params; params = params->tail) {
+        FP_sym(state, params->head->name);
+        FP_ref(state, params->head->type, true);
+    }
+    FP_int(state, -1);
+    if (fd->result) {
+        FP_ref(state, fd->result, true);
+    } else {
+        FP_int(state, -1);
+    }
+    FP_exp(state, fd->body);
+}
+
+static void FP_decs(FP_State state, A_DecList decs) {
+    for (; decs; decs = decs->tail) {
+        A_Dec dec = decs->head;
+        FP_int(state, dec->kind);
+        switch (dec->kind) {
+            case A_TYPE_DEC_GROUP:
+                FP_type_decs(state, dec->u.type);
+                break;
+            case A_VAR_DEC:
+                FP_sym(state, dec->u.var.var);
+                if (dec->u.var.type) {
+                    FP_ref(state, dec->u.var.type, true);
+                } else {
+                    FP_int(state, -1);
+                }
+                FP_exp(state, dec->u.var.init);
+                break;
+            case A_FUNCTION_DEC_GROUP:
+                for (A_FunDecList fdl = dec->u.function; fdl; fdl = fdl->tail) {
+                    FP_fundec(state, fdl->head);
+                }
+                FP_int(state, -1);
+                break;
+        }
+    }
+    FP_int(state, -1);
+}
+
+static void FP_init(FP_State state) {
+    state->hash = 14695981039346656037UL;
+    state->seen = TAB_empty();
+    state->refs = NULL;
+}
+
+FP_Hash FP_hash_fundec(A_FunDec fd, FP_SymbolList * refs) {
+    struct FP_State_ state;
+    FP_init(&state);
+    FP_fundec(&state, fd);
+    *refs = state.refs;
+    return state.hash;
+}
+
+FP_Hash FP_hash_type_decs(A_TypeDecList decs, FP_SymbolList * refs) {
+    struct FP_State_ state;
+    FP_init(&state);
+    FP_type_decs(&state, decs);
+    *refs = state.refs;
+    return state.hash;
+}
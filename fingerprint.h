@@ -0,0 +1,35 @@
+/*
+ * fingerprint.h -
+ * Structural hashes of abstract syntax, used to recognise
+ * declarations that are unchanged between two compilations.
+ * Hashes ignore source positions, so moving a declaration
+ * without editing it leaves its fingerprint unchanged.
+ * While hashing, the symbols a declaration refers to are collected,
+ * separately for the value and type namespaces and without duplicates.
+ * All types and functions declared in this module begin with "FP_".
+ */
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "absyn.h"
+#include "symbol.h"
+
+typedef unsigned long FP_Hash;
+typedef struct FP_SymbolList_ * FP_SymbolList;
+
+struct FP_SymbolList_ {
+    S_Symbol sym;
+    bool is_type;
+    FP_SymbolList tail;
+};
+
+FP_Hash FP_combine(FP_Hash hash, FP_Hash value);
+FP_Hash FP_hash_string(FP_Hash hash, string s);
+
+/* Hash a function declaration: name, parameters, result type and body. */
+FP_Hash FP_hash_fundec(A_FunDec fd, FP_SymbolList * refs);
+
+/* Hash a group of type declarations. */
+FP_Hash FP_hash_type_decs(A_TypeDecList decs, FP_SymbolList * refs);
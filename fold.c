@@ -0,0 +1,382 @@
+/*
+ * fold.c -
+ * Implementation of constant folding.
+ * See fold.h for more information.
+ */
+
+#include <assert.h>
+#include <limits.h>
+
+#include "fold.h"
+#include "stack.h"
+
+const PM_Pass FOLD_pass = { "fold", 1, FOLD_function, NULL, NULL };
+
+static void FOLD_stm(TR_Stm stm);
+
+static bool FOLD_is_num(TR_Exp exp, int num) {
+    return exp->kind == TR_NUM_EXP && exp->u.num == num;
+}
+
+bool FOLD_pure(TR_Exp exp) {
+    switch (exp->kind) {
+        case TR_NUM_EXP:
+        case TR_STRING_EXP:
+        case TR_MEM_EXP:
+            return true;
+        case TR_VAR_EXP:
+            return exp->u.var->kind == TR_MEM_EXP;
+        case TR_ARITH_OP_EXP:
+            return FOLD_pure(exp->u.arith.left) && FOLD_pure(exp->u.arith.right);
+        case TR_REL_OP_EXP:
+            return FOLD_pure(exp->u.rel.left) && FOLD_pure(exp->u.rel.right);
+        default:
+            return false;
+    }
+}
+
+/* left op right with 32-bit wraparound, as the target computes it. */
+static int FOLD_apply(A_Oper op, int left, int right) {
+    unsigned l = left;
+    unsigned r = right;
+    switch (op) {
+        case A_PLUS_OP:
+            return (int) (l + r);
+        case A_MINUS_OP:
+            return (int) (l - r);
+        case A_TIMES_OP:
+            return (int) (l * r);
+        case A_EQ_OP:
+            return left == right;
+        case A_NEQ_OP:
+            return left != right;
+        case A_LT_OP:
+            return left < right;
+        case A_LE_OP:
+            return left <= right;
+        case A_GT_OP:
+            return left > right;
+        case A_GE_OP:
+            return left >= right;
+        case A_AND_OP:
+            return left != 0 && right != 0;
+        case A_OR_OP:
+            return left != 0 || right != 0;
+        default:
+            assert(0);
+            return 0;
+    }
+}
+
+bool FOLD_constant(A_Oper op, int left, int right, int * result) {
+    switch (op) {
+        case A_DIVIDE_OP:
+            if (right == 0 || (left == INT_MIN && right == -1)) {
+                return false;
+            }
+            *result = left / right;
+            return true;
+        case A_PLUS_OP:
+        case A_MINUS_OP:
+        case A_TIMES_OP:
+        case A_EQ_OP:
+        case A_NEQ_OP:
+        case A_LT_OP:
+        case A_LE_OP:
+        case A_GT_OP:
+        case A_GE_OP:
+        case A_AND_OP:
+        case A_OR_OP:
+            *result = FOLD_apply(op, left, right);
+            return true;
+        default:
+            // An operator not modeled here is left to run time.
+            return false;
+    }
+}
+
+/* Split exp into a base plus a constant, setting *k to the constant;
+ * the base is NULL when exp is itself a constant. */
+static TR_Exp FOLD_split_sum(TR_Exp exp, int * k) {
+    *k = 0;
+    if (exp->kind == TR_NUM_EXP) {
+        *k = exp->u.num;
+        return NULL;
+    }
+    if (exp->kind != TR_ARITH_OP_EXP) {
+        return exp;
+    }
+    TR_Exp left = exp->u.arith.left;
+    TR_Exp right = exp->u.arith.right;
+    if (exp->u.arith.op == A_PLUS_OP && right->kind == TR_NUM_EXP) {
+        *k = right->u.num;
+        return left;
+    }
+    if (exp->u.arith.op == A_PLUS_OP && left->kind == TR_NUM_EXP) {
+        *k = left->u.num;
+        return right;
+    }
+    if (exp->u.arith.op == A_MINUS_OP && right->kind == TR_NUM_EXP) {
+        *k = FOLD_apply(A_MINUS_OP, 0, right->u.num);
+        return left;
+    }
+    return exp;
+}
+
+/* base + k, written as base - -k when that reads better. */
+static TR_Exp FOLD_make_sum(TR_Exp base, int k) {
+    if (!base) {
+        return make_TR_NumExp(k);
+    }
+    if (k == 0) {
+        return base;
+    }
+    // (c - x) + k is (c + k) - x.
+    if (base->kind == TR_ARITH_OP_EXP && base->u.arith.op == A_MINUS_OP
+            && base->u.arith.left->kind == TR_NUM_EXP) {
+        return make_TR_ArithOpExp(make_TR_NumExp(FOLD_apply(A_PLUS_OP, base->u.arith.left->u.num, k)),
+                base->u.arith.right, A_MINUS_OP);
+    }
+    if (k < 0 && k != INT_MIN) {
+        return make_TR_ArithOpExp(base, make_TR_NumExp(-k), A_MINUS_OP);
+    }
+    return make_TR_ArithOpExp(base, make_TR_NumExp(k), A_PLUS_OP);
+}
+
+/* Fold left + right or left - right, whose operands are folded. */
+static TR_Exp FOLD_sum(TR_Exp exp) {
+    TR_Exp left = exp->u.arith.left;
+    TR_Exp right = exp->u.arith.right;
+    A_Oper op = exp->u.arith.op;
+    int left_k, right_k;
+    TR_Exp left_base = FOLD_split_sum(left, &left_k);
+    TR_Exp right_base = FOLD_split_sum(right, &right_k);
+    if (left_base == left && (right_base == right
+                || (right->kind == TR_NUM_EXP && right->u.num != 0))) {
+        return exp;
+    }
+    int k = FOLD_apply(op, left_k, right_k);
+    if (!right_base) {
+        return FOLD_make_sum(left_base, k);
+    }
+    if (op == A_PLUS_OP) {
+        return FOLD_make_sum(left_base ? make_TR_ArithOpExp(left_base, right_base, A_PLUS_OP)
+                : right_base, k);
+    }
+    if (left_base) {
+        return FOLD_make_sum(make_TR_ArithOpExp(left_base, right_base, A_MINUS_OP), k);
+    }
+    // k - (c - x) is x + (k - c), which undoes a double unary minus.
+    if (right_base->kind == TR_ARITH_OP_EXP && right_base->u.arith.op == A_MINUS_OP
+            && right_base->u.arith.left->kind == TR_NUM_EXP) {
+        return FOLD_make_sum(right_base->u.arith.right,
+                FOLD_apply(A_MINUS_OP, k, right_base->u.arith.left->u.num));
+    }
+    if (right_base == right && FOLD_is_num(left, k)) {
+        return exp;
+    }
+    return make_TR_ArithOpExp(make_TR_NumExp(k), right_base, A_MINUS_OP);
+}
+
+/* Fold left * right, whose operands are folded. */
+static TR_Exp FOLD_product(TR_Exp exp) {
+    TR_Exp left = exp->u.arith.left;
+    TR_Exp right = exp->u.arith.right;
+    if (left->kind == TR_NUM_EXP && right->kind == TR_NUM_EXP) {
+        return make_TR_NumExp(FOLD_apply(A_TIMES_OP, left->u.num, right->u.num));
+    }
+    // Put the constant, if any, on the right.
+    TR_Exp base = left;
+    TR_Exp factor = right;
+    if (left->kind == TR_NUM_EXP) {
+        base = right;
+        factor = left;
+    }
+    if (factor->kind != TR_NUM_EXP) {
+        return exp;
+    }
+    int k = factor->u.num;
+    // (x * c) * k is x * (c * k).
+    if (base->kind == TR_ARITH_OP_EXP && base->u.arith.op == A_TIMES_OP
+            && base->u.arith.right->kind == TR_NUM_EXP) {
+        k = FOLD_apply(A_TIMES_OP, base->u.arith.right->u.num, k);
+        base = base->u.arith.left;
+    }
+    if (k == 1) {
+        return base;
+    }
+    if (k == 0 && FOLD_pure(base)) {
+        return make_TR_NumExp(0);
+    }
+    if (base == left && FOLD_is_num(right, k)) {
+        return exp;
+    }
+    return make_TR_ArithOpExp(base, make_TR_NumExp(k), A_TIMES_OP);
+}
+
+static TR_Exp FOLD_division(TR_Exp exp) {
+    TR_Exp left = exp->u.div.left;
+    TR_Exp right = exp->u.div.right;
+    if (FOLD_is_num(right, 1)) {
+        return left;
+    }
+    int k;
+    if (left->kind == TR_NUM_EXP && right->kind == TR_NUM_EXP
+            && FOLD_constant(A_DIVIDE_OP, left->u.num, right->u.num, &k)) {
+        return make_TR_NumExp(k);
+    }
+    return exp;
+}
+
+static void FOLD_exps(TR_ExpList exps) {
+    for (int i = 0, n = TR_exp_count(exps); i < n; ++i) {
+        exps->items[i] = FOLD_exp(exps->items[i]);
+    }
+}
+
+static void FOLD_stms(TR_StmList stms) {
+    for (int i = 0, n = TR_stm_count(stms); i < n; ++i) {
+        FOLD_stm(stms->items[i]);
+    }
+}
+
+/* A call of FOLD_exp or FOLD_stm continued on a new stack segment. */
+typedef struct FOLD_DeepCall_ {
+    TR_Exp exp;
+    TR_Stm stm;
+    TR_Exp result;
+} FOLD_DeepCall;
+
+static void FOLD_run_deep_call(void * arg) {
+    FOLD_DeepCall * call = arg;
+    if (call->stm) {
+        FOLD_stm(call->stm);
+    } else {
+        call->result = FOLD_exp(call->exp);
+    }
+}
+
+TR_Exp FOLD_exp(TR_Exp exp) {
+    if (!exp) {
+        return NULL;
+    }
+    if (ST_low()) {
+        FOLD_DeepCall call = { exp, NULL, NULL };
+        ST_call(FOLD_run_deep_call, &call);
+        return call.result;
+    }
+    switch (exp->kind) {
+        case TR_NUM_EXP:
+        case TR_STRING_EXP:
+        case TR_MEM_EXP:
+            return exp;
+        case TR_VAR_EXP:
+            exp->u.var = FOLD_exp(exp->u.var);
+            return exp;
+        case TR_FIELD_EXP:
+            exp->u.field.var = FOLD_exp(exp->u.field.var);
+            return exp;
+        case TR_SUBSCRIPT_EXP:
+            exp->u.subscript.var = FOLD_exp(exp->u.subscript.var);
+            exp->u.subscript.index = FOLD_exp(exp->u.subscript.index);
+            return exp;
+        case TR_RECORD_EXP:
+            FOLD_exps(exp->u.record.fields);
+            return exp;
+        case TR_ARRAY_EXP:
+            exp->u.array.init = FOLD_exp(exp->u.array.init);
+            return exp;
+        case TR_ARITH_OP_EXP:
+            exp->u.arith.left = FOLD_exp(exp->u.arith.left);
+            exp->u.arith.right = FOLD_exp(exp->u.arith.right);
+            return exp->u.arith.op == A_TIMES_OP ? FOLD_product(exp) : FOLD_sum(exp);
+        case TR_DIV_OP_EXP:
+            exp->u.div.left = FOLD_exp(exp->u.div.left);
+            exp->u.div.right = FOLD_exp(exp->u.div.right);
+            return FOLD_division(exp);
+        case TR_REL_OP_EXP:
+            {
+                exp->u.rel.left = FOLD_exp(exp->u.rel.left);
+                exp->u.rel.right = FOLD_exp(exp->u.rel.right);
+                int k;
+                if (exp->u.rel.left->kind == TR_NUM_EXP && exp->u.rel.right->kind == TR_NUM_EXP
+                        && FOLD_constant(exp->u.rel.op, exp->u.rel.left->u.num,
+                            exp->u.rel.right->u.num, &k)) {
+                    return make_TR_NumExp(k);
+                }
+                return exp;
+            }
+        case TR_IF_EXP:
+            exp->u.if_.test = FOLD_exp(exp->u.if_.test);
+            exp->u.if_.true_branch = FOLD_exp(exp->u.if_.true_branch);
+            return exp;
+        case TR_IF_ELSE_EXP:
+            exp->u.if_else.test = FOLD_exp(exp->u.if_else.test);
+            exp->u.if_else.true_branch = FOLD_exp(exp->u.if_else.true_branch);
+            exp->u.if_else.false_branch = FOLD_exp(exp->u.if_else.false_branch);
+            return exp;
+        case TR_FCALL_EXP:
+            FOLD_exps(exp->u.fcall.args);
+            return exp;
+        case TR_SEQ_EXP:
+            FOLD_stms(exp->u.seq);
+            // A parenthesized expression is a sequence of just that expression.
+            if (TR_stm_count(exp->u.seq) == 1 && exp->u.seq->items[0]->kind == TR_EXP_STM
+                    && exp->u.seq->items[0]->u.exp) {
+                return exp->u.seq->items[0]->u.exp;
+            }
+            return exp;
+    }
+    return exp;
+}
+
+static void FOLD_stm(TR_Stm stm) {
+    if (!stm) {
+        return;
+    }
+    if (ST_low()) {
+        FOLD_DeepCall call = { NULL, stm, NULL };
+        ST_call(FOLD_run_deep_call, &call);
+        return;
+    }
+    switch (stm->kind) {
+        case TR_ASSIGN_STM:
+            stm->u.assign.value = FOLD_exp(stm->u.assign.value);
+            stm->u.assign.var = FOLD_exp(stm->u.assign.var);
+            break;
+        case TR_PCALL_STM:
+            FOLD_exps(stm->u.pcall.args);
+            break;
+        case TR_SEQ_STM:
+            FOLD_stms(stm->u.seq);
+            break;
+        case TR_IF_STM:
+            stm->u.if_.test = FOLD_exp(stm->u.if_.test);
+            FOLD_stm(stm->u.if_.true_branch);
+            break;
+        case TR_IF_ELSE_STM:
+            stm->u.if_else.test = FOLD_exp(stm->u.if_else.test);
+            FOLD_stm(stm->u.if_else.true_branch);
+            FOLD_stm(stm->u.if_else.false_branch);
+            break;
+        case TR_WHILE_STM:
+            stm->u.while_.test = FOLD_exp(stm->u.while_.test);
+            FOLD_stm(stm->u.while_.body);
+            break;
+        case TR_FOR_STM:
+            stm->u.for_.var = FOLD_exp(stm->u.for_.var);
+            stm->u.for_.lo = FOLD_exp(stm->u.for_.lo);
+            stm->u.for_.hi = FOLD_exp(stm->u.for_.hi);
+            FOLD_stm(stm->u.for_.body);
+            break;
+        case TR_BREAK_STM:
+            break;
+        case TR_EXP_STM:
+            stm->u.exp = FOLD_exp(stm->u.exp);
+            break;
+    }
+}
+
+void FOLD_function(TR_Function func) {
+    FOLD_stms(func->body);
+}
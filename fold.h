@@ -0,0 +1,35 @@
+/*
+ * fold.h -
+ * Constant folding and algebraic simplification of the TR IR.
+ * Arithmetic and comparisons of constants become constants; adding
+ * or subtracting 0 and multiplying by 1 disappear, as does a product
+ * with 0 whose other factor has no side effects; chains of constant
+ * additions or multiplications (such as the 0 - e of unary minus
+ * inside a sum) are reassociated into a single constant, looking
+ * through the sequence that parenthesizes an expression.
+ * Arithmetic wraps at 32 bits, as it does at run time. A division
+ * that would trap (by 0, or of the most negative int by -1) is kept
+ * so that it still traps.
+ * All types and functions declared in this module begin with "FOLD_".
+ */
+
+#pragma once
+
+#include "pass_manager.h"
+#include "translate.h"
+
+/* The simplified form of exp, which may be exp itself, rewritten in place. */
+TR_Exp FOLD_exp(TR_Exp exp);
+
+/* Set *result to left op right, as computed at run time; false if
+ * that would trap, or if op is not an operator this module models. */
+bool FOLD_constant(A_Oper op, int left, int right, int * result);
+
+/* Whether evaluating exp can neither have side effects nor trap. */
+bool FOLD_pure(TR_Exp exp);
+
+/* Simplify every expression in func's body. */
+void FOLD_function(TR_Function func);
+
+/* FOLD_function, as the -O1 pass "fold". */
+extern const PM_Pass FOLD_pass;
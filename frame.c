@@ -8,17 +8,33 @@ F_Frame make_F_Frame(int nesting_lvl) {
     frame->nesting_level = nesting_lvl;
     frame->parameters = NULL;
     frame->variables = NULL;
+    frame->objects = NULL;
     frame->end = 0;
     return frame;
 }
 
-F_Var make_F_Var(S_Symbol name, T_Type type) {
+F_Var make_F_Var(S_Symbol name, T_Type type, int temp) {
     F_Var var = malloc_checked(sizeof(*var));
     var->name = name;
     var->type = type;
+    var->size = T_size(type);
+    var->escape = temp < 0;
+    var->offset = -1;
+    var->temp = temp;
     return var;
 }
 
+F_Var make_F_Object(S_Symbol name, int size) {
+    F_Var object = malloc_checked(sizeof(*object));
+    object->name = name;
+    object->type = NULL;
+    object->size = size;
+    object->escape = true;
+    object->offset = -1;
+    object->temp = -1;
+    return object;
+}
+
 void F_add_param(F_Frame frame, F_Var param) {
     // Add new param to head of existing params list
     TR_VarList list = malloc_checked(sizeof(*list));
@@ -26,7 +42,8 @@ void F_add_param(F_Frame frame, F_Var param) {
     list->tail = frame->parameters;
     frame->parameters = list;
     // Use T_size function to update end variable
-    frame->end += T_size(param->type);
+    frame->end += param->size;
+    param->offset = frame->end;
 }
 
 void F_add_var(F_Frame frame, F_Var var) {
@@ -34,8 +51,26 @@ void F_add_var(F_Frame frame, F_Var var) {
     list->head = var;
     list->tail = frame->variables;
     frame->variables = list;
-    // Use T_size function to update end variable
-    frame->end += T_size(var->type);
+    // Only a variable that escapes takes up a slot
+    if (var->escape) {
+        frame->end += var->size;
+        var->offset = frame->end;
+    }
+}
+
+void F_add_object(F_Frame frame, F_Var object) {
+    TR_VarList list = malloc_checked(sizeof(*list));
+    list->head = object;
+    list->tail = frame->objects;
+    frame->objects = list;
+    frame->end += object->size;
+    object->offset = frame->end;
+}
+
+static void F_print_temp(F_Var var) {
+    if (!var->escape) {
+        printf(" - temp: t%d", var->temp);
+    }
 }
 
 void F_print_frame(F_Frame frame) {
@@ -48,6 +83,7 @@ void F_print_frame(F_Frame frame) {
                 F_Var v = params->head;
                 printf("\t\t\t%s : ", S_name(params->head->name)); 
                 T_print_type(v->type); // Print type of the variable
+                F_print_temp(v);
                 printf("\n");
             }
         }
@@ -60,10 +96,17 @@ void F_print_frame(F_Frame frame) {
                 F_Var v = vars->head;
                 printf("\t\t\t%s : ", S_name(vars->head->name)); 
                 T_print_type(v->type); // Print type of the variable
+                F_print_temp(v);
                 printf("\n");
             }
         }
     }
-    
+    if (frame->objects) {
+        printf("\t\tStack Objects:\n");
+        for (TR_VarList objects = frame->objects; objects; objects = objects->tail) {
+            F_Var v = objects->head;
+            printf("\t\t\t%s : %d bytes - offset: %d\n", S_name(v->name), v->size, v->offset);
+        }
+    }
 }
 
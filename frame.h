@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stdbool.h>
+
 #include "symbol.h"
 #include "types.h"
 
@@ -11,16 +13,31 @@ struct F_Frame_ {
     int nesting_level;
     TR_VarList parameters;
     TR_VarList variables;
+    /* Records and arrays placed in the frame instead of on the heap. */
+    TR_VarList objects;
     int end;
 };
 
+/* A variable that escapes (see escape.h) lives in the frame, at
+ * offset; one that does not lives in temp instead, and has an offset
+ * only if it is a parameter, whose argument arrives there. A slot
+ * takes size bytes, T_size(type) for all but objects, which have no
+ * type of their own. */
 struct F_Var_ {
     S_Symbol name;
     T_Type type;
+    int size;
+    bool escape;
+    int offset;
+    int temp;
 };
 
 F_Frame make_F_Frame(int nesting_level);
-F_Var make_F_Var(S_Symbol name, T_Type type);
+/* A variable in temp, or in the frame if temp is -1. */
+F_Var make_F_Var(S_Symbol name, T_Type type, int temp);
+/* A record or array of size bytes, to be placed in the frame. */
+F_Var make_F_Object(S_Symbol name, int size);
 void F_add_param(F_Frame frame, F_Var param);
 void F_add_var(F_Frame frame, F_Var var);
+void F_add_object(F_Frame frame, F_Var object);
 void F_print_frame(F_Frame frame);
\ No newline at end of file
@@ -0,0 +1,360 @@
+/*
+ * gvn.c -
+ * Implementation of global value numbering.
+ * See gvn.h for more information.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "fold.h"
+#include "gvn.h"
+#include "stack.h"
+#include "util.h"
+
+const PM_Pass GVN_pass = { "gvn", 2, NULL, NULL, GVN_graph };
+
+/* An operation available in the blocks dominated by the one computing it. */
+typedef struct GVN_Entry_ {
+    A_Oper op;
+    CFG_Operand left;
+    CFG_Operand right;
+    int temp;
+    int bucket;
+    /* The entry this one hides in its bucket, or -1. */
+    int next;
+} GVN_Entry;
+
+typedef struct GVN_Numberer_ {
+    CFG_Graph graph;
+    /* What each temp is replaced by, or CFG_NONE to keep it. */
+    CFG_Operand * values;
+    /* A hash table of the entries, which come and go in stack order. */
+    int bucket_mask;
+    int * buckets;
+    int entry_count;
+    int entry_capacity;
+    GVN_Entry * entries;
+    int * first_child;
+    int * children;
+} GVN_Numberer;
+
+static CFG_Operand GVN_resolve(GVN_Numberer * numberer, CFG_Operand operand) {
+    while (operand.kind == CFG_TEMP && numberer->values[operand.value].kind != CFG_NONE) {
+        operand = numberer->values[operand.value];
+    }
+    return operand;
+}
+
+static bool GVN_same(CFG_Operand a, CFG_Operand b) {
+    return a.kind == b.kind && a.value == b.value;
+}
+
+/* Whether operand a goes after b in a canonical operation: constants last,
+ * then temps in increasing order. */
+static bool GVN_after(CFG_Operand a, CFG_Operand b) {
+    if (a.kind != b.kind) {
+        return a.kind == CFG_CONST;
+    }
+    return a.kind == CFG_TEMP && a.value > b.value;
+}
+
+/* Put the operands of instr, a binary operation, in canonical order. */
+static void GVN_canonicalize(CFG_Instr * instr) {
+    A_Oper op = instr->u.binop.op;
+    A_Oper mirrored;
+    switch (op) {
+        case A_PLUS_OP:
+        case A_TIMES_OP:
+        case A_EQ_OP:
+        case A_NEQ_OP:
+            mirrored = op;
+            break;
+        case A_LT_OP:
+            mirrored = A_GT_OP;
+            break;
+        case A_GT_OP:
+            mirrored = A_LT_OP;
+            break;
+        case A_LE_OP:
+            mirrored = A_GE_OP;
+            break;
+        case A_GE_OP:
+            mirrored = A_LE_OP;
+            break;
+        default:
+            return;
+    }
+    if (GVN_after(instr->u.binop.left, instr->u.binop.right)) {
+        CFG_Operand swap = instr->u.binop.left;
+        instr->u.binop.left = instr->u.binop.right;
+        instr->u.binop.right = swap;
+        instr->u.binop.op = mirrored;
+    }
+}
+
+/* The value of instr, a canonical binary operation, when it is
+ * already known without computing it: its constant, or an operand
+ * that it leaves unchanged. */
+static CFG_Operand GVN_simplify(CFG_Instr * instr) {
+    CFG_Operand left = instr->u.binop.left;
+    CFG_Operand right = instr->u.binop.right;
+    int result;
+    if (left.kind == CFG_CONST && right.kind == CFG_CONST
+            && FOLD_constant(instr->u.binop.op, left.value, right.value, &result)) {
+        return CFG_const(result);
+    }
+    if (right.kind == CFG_CONST) {
+        switch (instr->u.binop.op) {
+            case A_PLUS_OP:
+            case A_MINUS_OP:
+                return right.value ? CFG_none() : left;
+            case A_TIMES_OP:
+            case A_DIVIDE_OP:
+                return right.value == 1 ? left : CFG_none();
+            default:
+                return CFG_none();
+        }
+    }
+    if (GVN_same(left, right)) {
+        switch (instr->u.binop.op) {
+            case A_MINUS_OP:
+            case A_NEQ_OP:
+            case A_LT_OP:
+            case A_GT_OP:
+                return CFG_const(0);
+            case A_EQ_OP:
+            case A_LE_OP:
+            case A_GE_OP:
+                return CFG_const(1);
+            default:
+                return CFG_none();
+        }
+    }
+    return CFG_none();
+}
+
+static int GVN_hash(GVN_Numberer * numberer, CFG_Instr * instr) {
+    unsigned hash = instr->u.binop.op;
+    hash = hash * 31 + instr->u.binop.left.kind;
+    hash = hash * 31 + (unsigned) instr->u.binop.left.value;
+    hash = hash * 31 + instr->u.binop.right.kind;
+    hash = hash * 31 + (unsigned) instr->u.binop.right.value;
+    hash ^= hash >> 15;
+    return hash & numberer->bucket_mask;
+}
+
+/* The temp of an available operation the same as instr, or -1 after
+ * making instr itself available. */
+static int GVN_find(GVN_Numberer * numberer, CFG_Instr * instr) {
+    int bucket = GVN_hash(numberer, instr);
+    for (int e = numberer->buckets[bucket]; e >= 0; e = numberer->entries[e].next) {
+        GVN_Entry * entry = &numberer->entries[e];
+        if (entry->op == instr->u.binop.op && GVN_same(entry->left, instr->u.binop.left)
+                && GVN_same(entry->right, instr->u.binop.right)) {
+            return entry->temp;
+        }
+    }
+    if (numberer->entry_count == numberer->entry_capacity) {
+        numberer->entry_capacity = numberer->entry_capacity ? 2 * numberer->entry_capacity : 64;
+        numberer->entries = realloc_checked(numberer->entries,
+                numberer->entry_capacity * sizeof(GVN_Entry));
+    }
+    GVN_Entry * entry = &numberer->entries[numberer->entry_count];
+    entry->op = instr->u.binop.op;
+    entry->left = instr->u.binop.left;
+    entry->right = instr->u.binop.right;
+    entry->temp = instr->dst;
+    entry->bucket = bucket;
+    entry->next = numberer->buckets[bucket];
+    numberer->buckets[bucket] = numberer->entry_count++;
+    return -1;
+}
+
+/* The single value of a phi's arguments, other than the phi itself, or CFG_NONE. */
+static CFG_Operand GVN_phi_value(CFG_Instr * phi) {
+    CFG_Operand value = CFG_none();
+    for (int k = 0; k < phi->u.phi.arg_count; ++k) {
+        CFG_Operand arg = phi->u.phi.args[k];
+        if (arg.kind == CFG_TEMP && arg.value == phi->dst) {
+            continue;
+        }
+        if (value.kind != CFG_NONE && !GVN_same(value, arg)) {
+            return CFG_none();
+        }
+        value = arg;
+    }
+    return value;
+}
+
+static void GVN_number(GVN_Numberer * numberer, int block_id);
+
+/* A call of GVN_number continued on a new stack segment. */
+typedef struct GVN_DeepCall_ {
+    GVN_Numberer * numberer;
+    int block_id;
+} GVN_DeepCall;
+
+static void GVN_run_deep_call(void * arg) {
+    GVN_DeepCall * call = arg;
+    GVN_number(call->numberer, call->block_id);
+}
+
+/* Number the values of block and, recursively, the blocks it
+ * immediately dominates. */
+static void GVN_number(GVN_Numberer * numberer, int block_id) {
+    if (ST_low()) {
+        GVN_DeepCall call = { numberer, block_id };
+        ST_call(GVN_run_deep_call, &call);
+        return;
+    }
+    CFG_Block block = numberer->graph->blocks[block_id];
+    int mark = numberer->entry_count;
+    for (int j = 0; j < block->instr_count; ++j) {
+        CFG_Instr * instr = &block->instrs[j];
+        for (int k = 0, n = CFG_use_count(instr); k < n; ++k) {
+            *CFG_use(instr, k) = GVN_resolve(numberer, *CFG_use(instr, k));
+        }
+        CFG_Operand value = CFG_none();
+        if (instr->kind == CFG_MOVE) {
+            value = instr->u.move;
+        } else if (instr->kind == CFG_PHI) {
+            value = GVN_phi_value(instr);
+        } else if (instr->kind == CFG_BINOP) {
+            GVN_canonicalize(instr);
+            value = GVN_simplify(instr);
+            if (value.kind == CFG_NONE) {
+                int temp = GVN_find(numberer, instr);
+                value = temp >= 0 ? CFG_temp(temp) : CFG_none();
+            }
+        }
+        if (value.kind != CFG_NONE && !(value.kind == CFG_TEMP && value.value == instr->dst)) {
+            numberer->values[instr->dst] = value;
+        }
+    }
+    block->value = GVN_resolve(numberer, block->value);
+    for (int i = numberer->first_child[block_id]; i < numberer->first_child[block_id + 1]; ++i) {
+        GVN_number(numberer, numberer->children[i]);
+    }
+    while (numberer->entry_count > mark) {
+        GVN_Entry * entry = &numberer->entries[--numberer->entry_count];
+        numberer->buckets[entry->bucket] = entry->next;
+    }
+}
+
+/* Whether deleting instr, when its result is unused, changes nothing. */
+static bool GVN_removable(CFG_Instr * instr) {
+    switch (instr->kind) {
+        case CFG_MOVE:
+        case CFG_PHI:
+        case CFG_LOAD_VAR:
+        case CFG_STRING:
+            return true;
+        case CFG_BINOP:
+            // Unless it is a division that may trap.
+            return instr->u.binop.op != A_DIVIDE_OP
+                || (instr->u.binop.right.kind == CFG_CONST && instr->u.binop.right.value != 0
+                    && instr->u.binop.right.value != -1);
+        default:
+            return false;
+    }
+}
+
+static void GVN_need(CFG_Operand operand, bool * needed, int * work, int * depth) {
+    if (operand.kind == CFG_TEMP && !needed[operand.value]) {
+        needed[operand.value] = true;
+        work[(*depth)++] = operand.value;
+    }
+}
+
+/* Replace every operand by its value, and delete the instructions
+ * replaced or not needed. */
+static void GVN_sweep(GVN_Numberer * numberer) {
+    CFG_Graph graph = numberer->graph;
+    int temps = graph->temp_count;
+    CFG_Instr ** defs = malloc_checked(temps * sizeof(CFG_Instr *) + 1);
+    bool * needed = malloc_checked(temps * sizeof(bool) + 1);
+    int * work = malloc_checked(temps * sizeof(int) + 1);
+    int depth = 0;
+    memset(defs, 0, temps * sizeof(CFG_Instr *));
+    memset(needed, 0, temps * sizeof(bool));
+    for (int i = 0; i < graph->block_count; ++i) {
+        CFG_Block block = graph->blocks[i];
+        for (int j = 0; j < block->instr_count; ++j) {
+            CFG_Instr * instr = &block->instrs[j];
+            for (int k = 0, n = CFG_use_count(instr); k < n; ++k) {
+                *CFG_use(instr, k) = GVN_resolve(numberer, *CFG_use(instr, k));
+            }
+            if (instr->dst >= 0) {
+                defs[instr->dst] = instr;
+            }
+        }
+        block->value = GVN_resolve(numberer, block->value);
+    }
+    // Mark what the instructions with effects need, transitively.
+    for (int i = 0; i < graph->block_count; ++i) {
+        CFG_Block block = graph->blocks[i];
+        for (int j = 0; j < block->instr_count; ++j) {
+            CFG_Instr * instr = &block->instrs[j];
+            if (instr->dst < 0 || !GVN_removable(instr)) {
+                for (int k = 0, n = CFG_use_count(instr); k < n; ++k) {
+                    GVN_need(*CFG_use(instr, k), needed, work, &depth);
+                }
+            }
+        }
+        GVN_need(block->value, needed, work, &depth);
+    }
+    while (depth) {
+        CFG_Instr * instr = defs[work[--depth]];
+        for (int k = 0, n = instr ? CFG_use_count(instr) : 0; k < n; ++k) {
+            GVN_need(*CFG_use(instr, k), needed, work, &depth);
+        }
+    }
+    for (int i = 0; i < graph->block_count; ++i) {
+        CFG_Block block = graph->blocks[i];
+        int kept = 0;
+        for (int j = 0; j < block->instr_count; ++j) {
+            CFG_Instr * instr = &block->instrs[j];
+            if (instr->dst >= 0 && GVN_removable(instr) && !needed[instr->dst]) {
+                continue;
+            }
+            block->instrs[kept++] = *instr;
+        }
+        block->instr_count = kept;
+    }
+    free(defs);
+    free(needed);
+    free(work);
+}
+
+void GVN_graph(CFG_Graph graph) {
+    if (!graph->ssa || !graph->block_count) {
+        return;
+    }
+    GVN_Numberer numberer;
+    memset(&numberer, 0, sizeof(numberer));
+    numberer.graph = graph;
+    numberer.values = malloc_checked(graph->temp_count * sizeof(CFG_Operand) + 1);
+    for (int t = 0; t < graph->temp_count; ++t) {
+        numberer.values[t] = CFG_none();
+    }
+    int buckets = 16;
+    while (buckets < graph->temp_count) {
+        buckets *= 2;
+    }
+    numberer.bucket_mask = buckets - 1;
+    numberer.buckets = malloc_checked(buckets * sizeof(int));
+    for (int i = 0; i < buckets; ++i) {
+        numberer.buckets[i] = -1;
+    }
+    int * idom = CFG_dominators(graph);
+    numberer.children = CFG_dominator_children(graph, idom, &numberer.first_child);
+    GVN_number(&numberer, 0);
+    GVN_sweep(&numberer);
+    free(idom);
+    free(numberer.values);
+    free(numberer.buckets);
+    free(numberer.entries);
+    free(numberer.first_child);
+    free(numberer.children);
+}
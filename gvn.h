@@ -0,0 +1,24 @@
+/*
+ * gvn.h -
+ * Global value numbering over a CFG in SSA form. Walking the
+ * dominator tree, an operation that computes what a dominating one
+ * already has (the same operator on the same operands, put in a
+ * canonical order) is deleted and its temp replaced by the earlier
+ * one's; so are copies, operations on constants or with an identity
+ * operand, and phis whose arguments are all the same value. Then the
+ * instructions whose results are never needed and that have no
+ * effects are deleted, cycles of them through phis included.
+ * Does nothing to a graph not in SSA form.
+ * All types and functions declared in this module begin with "GVN_".
+ */
+
+#pragma once
+
+#include "cfg.h"
+#include "pass_manager.h"
+
+/* Number the values of graph, which must be in SSA form. */
+void GVN_graph(CFG_Graph graph);
+
+/* GVN_graph, as the -O2 pass "gvn". */
+extern const PM_Pass GVN_pass;
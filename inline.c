@@ -0,0 +1,987 @@
+/*
+ * inline.c -
+ * Implementation of inlining.
+ * See inline.h for more information.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "env.h"
+#include "inline.h"
+#include "ir_metrics.h"
+#include "stack.h"
+#include "util.h"
+
+const PM_Pass INL_pass = { "inline", 2, NULL, INL_program, NULL };
+
+/* A callee of at most this many nodes costs about as much as calling
+ * it, and is inlined at every call. */
+#define INL_SMALL 16
+/* Each loop around a call doubles that, up to this many times. */
+#define INL_MAX_LOOP_BONUS 2
+/* The largest callee inlined at its only call, after which it is deleted. */
+#define INL_ONCE 400
+/* The size in nodes no caller grows beyond by inlining. */
+#define INL_MAX_CALLER 4000
+
+typedef struct INL_Function_ * INL_Function;
+
+/* What the inliner knows of one function of the program. */
+struct INL_Function_ {
+    TR_Function func;
+    /* Its place in the program's functions, which list the functions
+     * nested in it right after it, up to end. */
+    int index;
+    int end;
+    /* Whether every call of func's name means func: the name is
+     * declared once in the program, and not in the library. */
+    bool unique;
+    /* Whether every call in func's body resolves by name alone. */
+    bool resolved;
+    /* The calls of func in the program. */
+    int calls;
+    /* The functions func calls, each once. */
+    INL_Function * callees;
+    int callee_count;
+    int callee_capacity;
+    /* The function whose callees func was last added to. */
+    INL_Function caller_mark;
+    /* The number of nodes in func's body. */
+    long size;
+    enum { INL_NEW, INL_ACTIVE, INL_DONE } state;
+    /* Whether a call from main_ reaches func, through the calls of others. */
+    bool reached;
+    bool deleted;
+};
+
+static struct INL_Function_ INL_ambiguous;
+
+typedef struct INL_Program_ {
+    INL_Function * functions;
+    int count;
+    int capacity;
+    /* The functions by name; &INL_ambiguous for a name declared more than once. */
+    S_Table names;
+    /* The library functions, whose names a call may mean instead. */
+    S_Table library;
+    /* The functions reached whose calls are still to be followed. */
+    INL_Function * work;
+    int work_count;
+} INL_Program;
+
+/* Collecting */
+
+static void INL_collect(INL_Program * program, TR_Function func) {
+    INL_Function function = malloc_checked(sizeof(*function));
+    memset(function, 0, sizeof(*function));
+    function->func = func;
+    function->index = program->count;
+    function->resolved = true;
+    function->size = IM_function_size(func);
+    if (program->count == program->capacity) {
+        program->capacity = program->capacity ? 2 * program->capacity : 64;
+        program->functions = realloc_checked(program->functions,
+                program->capacity * sizeof(*program->functions));
+    }
+    program->functions[program->count++] = function;
+    INL_Function named = S_look(program->names, func->name);
+    S_enter(program->names, func->name, named ? &INL_ambiguous : function);
+    for (TR_FunctionList children = func->children; children; children = children->tail) {
+        INL_collect(program, children->head);
+    }
+    function->end = program->count;
+}
+
+/* The function every call of name means, or NULL if there is none. */
+static INL_Function INL_resolve(INL_Program * program, S_Symbol name) {
+    INL_Function function = S_look(program->names, name);
+    return function && function->unique ? function : NULL;
+}
+
+/* Counting calls */
+
+/* Adds delta to the calls of each function called in a body; when
+ * caller is set, also records its callees and whether they resolve,
+ * and when reaching, marks each callee reached. */
+typedef struct INL_Counter_ {
+    INL_Program * program;
+    INL_Function caller;
+    int delta;
+    bool reaching;
+} INL_Counter;
+
+static void INL_count_exp(INL_Counter * counter, TR_Exp exp);
+static void INL_count_stm(INL_Counter * counter, TR_Stm stm);
+
+static void INL_count_call(INL_Counter * counter, S_Symbol name, TR_ExpList args) {
+    for (int i = 0, n = TR_exp_count(args); i < n; ++i) {
+        INL_count_exp(counter, args->items[i]);
+    }
+    INL_Function callee = INL_resolve(counter->program, name);
+    INL_Function caller = counter->caller;
+    if (callee) {
+        callee->calls += counter->delta;
+        if (counter->reaching && !callee->reached) {
+            callee->reached = true;
+            counter->program->work[counter->program->work_count++] = callee;
+        }
+    }
+    if (!caller) {
+        return;
+    }
+    if (!callee) {
+        // A library function is the same from anywhere.
+        if (S_look(counter->program->names, name) || !S_look(counter->program->library, name)) {
+            caller->resolved = false;
+        }
+        return;
+    }
+    if (callee->caller_mark != caller) {
+        callee->caller_mark = caller;
+        if (caller->callee_count == caller->callee_capacity) {
+            caller->callee_capacity = caller->callee_capacity ? 2 * caller->callee_capacity : 8;
+            caller->callees = realloc_checked(caller->callees,
+                    caller->callee_capacity * sizeof(*caller->callees));
+        }
+        caller->callees[caller->callee_count++] = callee;
+    }
+}
+
+static void INL_count_stms(INL_Counter * counter, TR_StmList stms) {
+    for (int i = 0, n = TR_stm_count(stms); i < n; ++i) {
+        INL_count_stm(counter, stms->items[i]);
+    }
+}
+
+/* A call of INL_count_exp or INL_count_stm continued on a new stack segment. */
+typedef struct INL_DeepCount_ {
+    INL_Counter * counter;
+    TR_Exp exp;
+    TR_Stm stm;
+} INL_DeepCount;
+
+static void INL_run_deep_count(void * arg) {
+    INL_DeepCount * call = arg;
+    if (call->stm) {
+        INL_count_stm(call->counter, call->stm);
+    } else {
+        INL_count_exp(call->counter, call->exp);
+    }
+}
+
+static void INL_count_exp(INL_Counter * counter, TR_Exp exp) {
+    if (!exp) {
+        return;
+    }
+    if (ST_low()) {
+        INL_DeepCount call = { counter, exp, NULL };
+        ST_call(INL_run_deep_count, &call);
+        return;
+    }
+    switch (exp->kind) {
+        case TR_NUM_EXP:
+        case TR_STRING_EXP:
+        case TR_MEM_EXP:
+            break;
+        case TR_VAR_EXP:
+            INL_count_exp(counter, exp->u.var);
+            break;
+        case TR_FIELD_EXP:
+            INL_count_exp(counter, exp->u.field.var);
+            break;
+        case TR_SUBSCRIPT_EXP:
+            INL_count_exp(counter, exp->u.subscript.var);
+            INL_count_exp(counter, exp->u.subscript.index);
+            break;
+        case TR_RECORD_EXP:
+            for (int i = 0, n = TR_exp_count(exp->u.record.fields); i < n; ++i) {
+                INL_count_exp(counter, exp->u.record.fields->items[i]);
+            }
+            break;
+        case TR_ARRAY_EXP:
+            INL_count_exp(counter, exp->u.array.init);
+            break;
+        case TR_ARITH_OP_EXP:
+            INL_count_exp(counter, exp->u.arith.left);
+            INL_count_exp(counter, exp->u.arith.right);
+            break;
+        case TR_DIV_OP_EXP:
+            INL_count_exp(counter, exp->u.div.left);
+            INL_count_exp(counter, exp->u.div.right);
+            break;
+        case TR_REL_OP_EXP:
+            INL_count_exp(counter, exp->u.rel.left);
+            INL_count_exp(counter, exp->u.rel.right);
+            break;
+        case TR_IF_EXP:
+            INL_count_exp(counter, exp->u.if_.test);
+            INL_count_exp(counter, exp->u.if_.true_branch);
+            break;
+        case TR_IF_ELSE_EXP:
+            INL_count_exp(counter, exp->u.if_else.test);
+            INL_count_exp(counter, exp->u.if_else.true_branch);
+            INL_count_exp(counter, exp->u.if_else.false_branch);
+            break;
+        case TR_FCALL_EXP:
+            INL_count_call(counter, exp->u.fcall.name, exp->u.fcall.args);
+            break;
+        case TR_SEQ_EXP:
+            INL_count_stms(counter, exp->u.seq);
+            break;
+    }
+}
+
+static void INL_count_stm(INL_Counter * counter, TR_Stm stm) {
+    if (!stm) {
+        return;
+    }
+    if (ST_low()) {
+        INL_DeepCount call = { counter, NULL, stm };
+        ST_call(INL_run_deep_count, &call);
+        return;
+    }
+    switch (stm->kind) {
+        case TR_ASSIGN_STM:
+            INL_count_exp(counter, stm->u.assign.var);
+            INL_count_exp(counter, stm->u.assign.value);
+            break;
+        case TR_PCALL_STM:
+            INL_count_call(counter, stm->u.pcall.name, stm->u.pcall.args);
+            break;
+        case TR_SEQ_STM:
+            INL_count_stms(counter, stm->u.seq);
+            break;
+        case TR_IF_STM:
+            INL_count_exp(counter, stm->u.if_.test);
+            INL_count_stm(counter, stm->u.if_.true_branch);
+            break;
+        case TR_IF_ELSE_STM:
+            INL_count_exp(counter, stm->u.if_else.test);
+            INL_count_stm(counter, stm->u.if_else.true_branch);
+            INL_count_stm(counter, stm->u.if_else.false_branch);
+            break;
+        case TR_WHILE_STM:
+            INL_count_exp(counter, stm->u.while_.test);
+            INL_count_stm(counter, stm->u.while_.body);
+            break;
+        case TR_FOR_STM:
+            INL_count_exp(counter, stm->u.for_.var);
+            INL_count_exp(counter, stm->u.for_.lo);
+            INL_count_exp(counter, stm->u.for_.hi);
+            INL_count_stm(counter, stm->u.for_.body);
+            break;
+        case TR_BREAK_STM:
+            break;
+        case TR_EXP_STM:
+            INL_count_exp(counter, stm->u.exp);
+            break;
+    }
+}
+
+/* Deleting */
+
+/* Whether nothing calls function, so that it need not be inlined into. */
+static bool INL_uncalled(INL_Program * program, INL_Function function) {
+    return function->unique && !function->calls && function != program->functions[0];
+}
+
+static void INL_unlink(TR_Function func) {
+    TR_Function parent = func->parent;
+    TR_FunctionList previous = NULL;
+    for (TR_FunctionList list = parent->children; list; previous = list, list = list->tail) {
+        if (list->head == func) {
+            if (previous) {
+                previous->tail = list->tail;
+            } else {
+                parent->children = list->tail;
+            }
+            if (parent->last_child == list) {
+                parent->last_child = previous;
+            }
+            return;
+        }
+    }
+}
+
+/* Delete the functions that no call from main_ reaches, and those
+ * nested in them. A function whose name does not resolve may be
+ * called by any call of it, so it is kept as if main_ called it. */
+static void INL_delete_unreached(INL_Program * program) {
+    program->work_count = 0;
+    for (int i = 0; i < program->count; ++i) {
+        INL_Function function = program->functions[i];
+        function->reached = !function->deleted && (i == 0 || !function->unique);
+        if (function->reached) {
+            program->work[program->work_count++] = function;
+        }
+    }
+    while (program->work_count) {
+        INL_Function function = program->work[--program->work_count];
+        INL_Counter counter = { program, NULL, 0, true };
+        INL_count_stms(&counter, function->func->body);
+    }
+    for (int i = 0; i < program->count; ++i) {
+        INL_Function function = program->functions[i];
+        if (function->deleted || function->reached) {
+            continue;
+        }
+        // The calls it and the functions nested in it made are gone.
+        INL_Counter counter = { program, NULL, -1, false };
+        for (int k = function->index; k < function->end; ++k) {
+            INL_Function nested = program->functions[k];
+            if (!nested->deleted) {
+                nested->deleted = true;
+                INL_count_stms(&counter, nested->func->body);
+            }
+        }
+        INL_unlink(function->func);
+    }
+}
+
+/* Copying */
+
+/* How the callee's body is renumbered into the caller's. Each map
+ * entry is filled on first use; those of variables up front. */
+typedef struct INL_Copier_ {
+    TR_Function into;
+    int from_level;
+    int level;
+    TR_Temp * temps;
+    int temp_count;
+    TR_Label * labels;
+    int label_count;
+    /* The caller's variable for each of the callee's, by temp and by offset. */
+    F_Var * temp_vars;
+    F_Var * slot_vars;
+    int slot_count;
+} INL_Copier;
+
+static TR_Exp INL_copy_exp(INL_Copier * copier, TR_Exp exp);
+static TR_Stm INL_copy_stm(INL_Copier * copier, TR_Stm stm);
+
+static S_Symbol INL_name(TR_Function from, S_Symbol name) {
+    string from_name = S_name(from->name);
+    string var_name = S_name(name);
+    string joined = malloc_checked(strlen(from_name) + strlen(var_name) + 2);
+    sprintf(joined, "%s.%s", from_name, var_name);
+    return make_S_Symbol(joined);
+}
+
+/* Give each variable and object of from one of copier's function. */
+static void INL_begin_copy(INL_Copier * copier, TR_Function into, TR_Function from) {
+    // Read from's counts first, as into may be from.
+    copier->into = into;
+    copier->from_level = from->frame->nesting_level;
+    copier->level = into->frame->nesting_level;
+    copier->temp_count = from->temp_count;
+    copier->label_count = from->label_count;
+    copier->slot_count = from->frame->end + 1;
+    copier->temps = malloc_checked(copier->temp_count * sizeof(TR_Temp) + 1);
+    copier->temp_vars = malloc_checked(copier->temp_count * sizeof(F_Var) + 1);
+    for (int t = 0; t < copier->temp_count; ++t) {
+        copier->temps[t] = -1;
+        copier->temp_vars[t] = NULL;
+    }
+    copier->labels = malloc_checked(copier->label_count * sizeof(TR_Label) + 1);
+    for (int l = 0; l < copier->label_count; ++l) {
+        copier->labels[l] = -1;
+    }
+    copier->slot_vars = malloc_checked(copier->slot_count * sizeof(F_Var));
+    memset(copier->slot_vars, 0, copier->slot_count * sizeof(F_Var));
+    TR_VarList lists[] = { from->frame->parameters, from->frame->variables, from->frame->objects };
+    for (int i = 0; i < 3; ++i) {
+        for (TR_VarList list = lists[i]; list; list = list->tail) {
+            F_Var var = list->head;
+            S_Symbol name = INL_name(from, var->name);
+            F_Var copy;
+            if (i == 2) {
+                copy = make_F_Object(name, var->size);
+                F_add_object(into->frame, copy);
+            } else if (var->escape) {
+                copy = make_F_Var(name, var->type, -1);
+                F_add_var(into->frame, copy);
+            } else {
+                copy = make_F_Var(name, var->type, into->temp_count++);
+                F_add_var(into->frame, copy);
+                if (var->temp >= 0 && var->temp < copier->temp_count) {
+                    copier->temps[var->temp] = copy->temp;
+                    copier->temp_vars[var->temp] = copy;
+                }
+                continue;
+            }
+            if (var->offset >= 0 && var->offset < copier->slot_count) {
+                copier->slot_vars[var->offset] = copy;
+            }
+        }
+    }
+}
+
+static void INL_end_copy(INL_Copier * copier) {
+    free(copier->temps);
+    free(copier->temp_vars);
+    free(copier->labels);
+    free(copier->slot_vars);
+}
+
+static TR_Temp INL_temp(INL_Copier * copier, TR_Temp temp) {
+    if (temp < 0 || temp >= copier->temp_count) {
+        return -1;
+    }
+    if (copier->temps[temp] < 0) {
+        copier->temps[temp] = copier->into->temp_count++;
+    }
+    return copier->temps[temp];
+}
+
+static TR_Label INL_label(INL_Copier * copier, TR_Label label) {
+    if (label < 0 || label >= copier->label_count) {
+        return label;
+    }
+    if (copier->labels[label] < 0) {
+        copier->labels[label] = copier->into->label_count++;
+    }
+    return copier->labels[label];
+}
+
+/* The caller's slot for the callee's at offset, made for it if the
+ * callee's frame does not list one. */
+static F_Var INL_slot(INL_Copier * copier, int offset, S_Symbol name, int size) {
+    bool listed = offset >= 0 && offset < copier->slot_count;
+    if (listed && copier->slot_vars[offset]) {
+        return copier->slot_vars[offset];
+    }
+    F_Var slot = make_F_Object(name, size);
+    F_add_object(copier->into->frame, slot);
+    if (listed) {
+        copier->slot_vars[offset] = slot;
+    }
+    return slot;
+}
+
+static TR_ExpList INL_copy_exps(INL_Copier * copier, TR_ExpList exps) {
+    TR_ExpList copy = NULL;
+    for (int i = 0, n = TR_exp_count(exps); i < n; ++i) {
+        copy = TR_add_exp(copy, INL_copy_exp(copier, exps->items[i]));
+    }
+    return copy;
+}
+
+static TR_StmList INL_copy_stms(INL_Copier * copier, TR_StmList stms) {
+    TR_StmList copy = NULL;
+    for (int i = 0, n = TR_stm_count(stms); i < n; ++i) {
+        copy = TR_add_stm(copy, INL_copy_stm(copier, stms->items[i]));
+    }
+    return copy;
+}
+
+/* The frame slot of a copied object, unless it is on the heap. */
+static int INL_copy_slot(INL_Copier * copier, TR_Exp exp, int offset) {
+    if (offset == -1) {
+        return -1;
+    }
+    return INL_slot(copier, offset, make_S_Symbol(exp->kind == TR_RECORD_EXP ? "record" : "array"),
+            exp->size)->offset;
+}
+
+/* A call of INL_copy_exp or INL_copy_stm continued on a new stack segment. */
+typedef struct INL_DeepCopy_ {
+    INL_Copier * copier;
+    TR_Exp exp;
+    TR_Stm stm;
+    TR_Exp exp_result;
+    TR_Stm stm_result;
+} INL_DeepCopy;
+
+static void INL_run_deep_copy(void * arg) {
+    INL_DeepCopy * call = arg;
+    if (call->stm) {
+        call->stm_result = INL_copy_stm(call->copier, call->stm);
+    } else {
+        call->exp_result = INL_copy_exp(call->copier, call->exp);
+    }
+}
+
+static TR_Exp INL_copy_exp(INL_Copier * copier, TR_Exp exp) {
+    if (!exp) {
+        return NULL;
+    }
+    if (ST_low()) {
+        INL_DeepCopy call = { copier, exp, NULL, NULL, NULL };
+        ST_call(INL_run_deep_copy, &call);
+        return call.exp_result;
+    }
+    // Copy the node whole, then renumber it and copy its children.
+    TR_Exp copy = AR_alloc(TR_exp_size(exp));
+    memcpy(copy, exp, TR_exp_size(exp));
+    copy->reg = INL_temp(copier, exp->reg);
+    switch (exp->kind) {
+        case TR_NUM_EXP:
+            break;
+        case TR_STRING_EXP:
+            copy->u.str.label = INL_label(copier, exp->u.str.label);
+            break;
+        case TR_MEM_EXP:
+            if (exp->reg >= 0) {
+                F_Var var = exp->reg < copier->temp_count ? copier->temp_vars[exp->reg] : NULL;
+                if (var) {
+                    copy->u.mem.name = var->name;
+                }
+                copy->u.mem.nesting_level = copier->level;
+                copy->u.mem.offset = -1;
+            } else if (exp->u.mem.nesting_level == copier->from_level) {
+                F_Var var = INL_slot(copier, exp->u.mem.offset, exp->u.mem.name, exp->size);
+                copy->u.mem.name = var->name;
+                copy->u.mem.nesting_level = copier->level;
+                copy->u.mem.offset = var->offset;
+            }
+            break;
+        case TR_VAR_EXP:
+            copy->u.var = INL_copy_exp(copier, exp->u.var);
+            break;
+        case TR_FIELD_EXP:
+            copy->u.field.var = INL_copy_exp(copier, exp->u.field.var);
+            break;
+        case TR_SUBSCRIPT_EXP:
+            copy->u.subscript.var = INL_copy_exp(copier, exp->u.subscript.var);
+            copy->u.subscript.index = INL_copy_exp(copier, exp->u.subscript.index);
+            break;
+        case TR_RECORD_EXP:
+            copy->u.record.fields = INL_copy_exps(copier, exp->u.record.fields);
+            copy->u.record.offset = INL_copy_slot(copier, exp, exp->u.record.offset);
+            break;
+        case TR_ARRAY_EXP:
+            copy->u.array.init = INL_copy_exp(copier, exp->u.array.init);
+            copy->u.array.offset = INL_copy_slot(copier, exp, exp->u.array.offset);
+            break;
+        case TR_ARITH_OP_EXP:
+            copy->u.arith.left = INL_copy_exp(copier, exp->u.arith.left);
+            copy->u.arith.right = INL_copy_exp(copier, exp->u.arith.right);
+            break;
+        case TR_DIV_OP_EXP:
+            copy->u.div.left = INL_copy_exp(copier, exp->u.div.left);
+            copy->u.div.right = INL_copy_exp(copier, exp->u.div.right);
+            break;
+        case TR_REL_OP_EXP:
+            copy->u.rel.left = INL_copy_exp(copier, exp->u.rel.left);
+            copy->u.rel.right = INL_copy_exp(copier, exp->u.rel.right);
+            break;
+        case TR_IF_EXP:
+            copy->u.if_.test = INL_copy_exp(copier, exp->u.if_.test);
+            copy->u.if_.false_label = INL_label(copier, exp->u.if_.false_label);
+            copy->u.if_.true_branch = INL_copy_exp(copier, exp->u.if_.true_branch);
+            break;
+        case TR_IF_ELSE_EXP:
+            copy->u.if_else.test = INL_copy_exp(copier, exp->u.if_else.test);
+            copy->u.if_else.false_label = INL_label(copier, exp->u.if_else.false_label);
+            copy->u.if_else.true_branch = INL_copy_exp(copier, exp->u.if_else.true_branch);
+            copy->u.if_else.false_branch = INL_copy_exp(copier, exp->u.if_else.false_branch);
+            copy->u.if_else.join_label = INL_label(copier, exp->u.if_else.join_label);
+            break;
+        case TR_FCALL_EXP:
+            copy->u.fcall.args = INL_copy_exps(copier, exp->u.fcall.args);
+            break;
+        case TR_SEQ_EXP:
+            copy->u.seq = INL_copy_stms(copier, exp->u.seq);
+            break;
+    }
+    return copy;
+}
+
+static TR_Stm INL_copy_stm(INL_Copier * copier, TR_Stm stm) {
+    if (!stm) {
+        return NULL;
+    }
+    if (ST_low()) {
+        INL_DeepCopy call = { copier, NULL, stm, NULL, NULL };
+        ST_call(INL_run_deep_copy, &call);
+        return call.stm_result;
+    }
+    TR_Stm copy = AR_alloc(TR_stm_size(stm));
+    memcpy(copy, stm, TR_stm_size(stm));
+    switch (stm->kind) {
+        case TR_ASSIGN_STM:
+            copy->u.assign.var = INL_copy_exp(copier, stm->u.assign.var);
+            copy->u.assign.value = INL_copy_exp(copier, stm->u.assign.value);
+            break;
+        case TR_PCALL_STM:
+            copy->u.pcall.args = INL_copy_exps(copier, stm->u.pcall.args);
+            break;
+        case TR_SEQ_STM:
+            copy->u.seq = INL_copy_stms(copier, stm->u.seq);
+            break;
+        case TR_IF_STM:
+            copy->u.if_.test = INL_copy_exp(copier, stm->u.if_.test);
+            copy->u.if_.false_label = INL_label(copier, stm->u.if_.false_label);
+            copy->u.if_.true_branch = INL_copy_stm(copier, stm->u.if_.true_branch);
+            break;
+        case TR_IF_ELSE_STM:
+            copy->u.if_else.test = INL_copy_exp(copier, stm->u.if_else.test);
+            copy->u.if_else.false_label = INL_label(copier, stm->u.if_else.false_label);
+            copy->u.if_else.true_branch = INL_copy_stm(copier, stm->u.if_else.true_branch);
+            copy->u.if_else.false_branch = INL_copy_stm(copier, stm->u.if_else.false_branch);
+            copy->u.if_else.join_label = INL_label(copier, stm->u.if_else.join_label);
+            break;
+        case TR_WHILE_STM:
+            copy->u.while_.test_label = INL_label(copier, stm->u.while_.test_label);
+            copy->u.while_.test = INL_copy_exp(copier, stm->u.while_.test);
+            copy->u.while_.skip_label = INL_label(copier, stm->u.while_.skip_label);
+            copy->u.while_.body = INL_copy_stm(copier, stm->u.while_.body);
+            break;
+        case TR_FOR_STM:
+            copy->u.for_.var = INL_copy_exp(copier, stm->u.for_.var);
+            copy->u.for_.lo = INL_copy_exp(copier, stm->u.for_.lo);
+            copy->u.for_.hi = INL_copy_exp(copier, stm->u.for_.hi);
+            copy->u.for_.test_label = INL_label(copier, stm->u.for_.test_label);
+            copy->u.for_.skip_label = INL_label(copier, stm->u.for_.skip_label);
+            copy->u.for_.body = INL_copy_stm(copier, stm->u.for_.body);
+            break;
+        case TR_BREAK_STM:
+            copy->u.break_ = INL_label(copier, stm->u.break_);
+            break;
+        case TR_EXP_STM:
+            copy->u.exp = INL_copy_exp(copier, stm->u.exp);
+            break;
+    }
+    return copy;
+}
+
+/* Inlining */
+
+typedef struct INL_Inliner_ {
+    INL_Program * program;
+    INL_Function function;
+    /* The number of loops around the code being rewritten. */
+    int loop_depth;
+} INL_Inliner;
+
+static TR_Exp INL_inline_exp(INL_Inliner * inliner, TR_Exp exp);
+static TR_Stm INL_inline_stm(INL_Inliner * inliner, TR_Stm stm);
+
+static int INL_param_count(TR_Function func) {
+    int count = 0;
+    for (TR_VarList params = func->frame->parameters; params; params = params->tail) {
+        ++count;
+    }
+    return count;
+}
+
+/* Whether a function nested in function may still be called, and so
+ * reach its frame. */
+static bool INL_nests_called(INL_Program * program, INL_Function function) {
+    for (int k = function->index + 1; k < function->end; k = program->functions[k]->end) {
+        INL_Function nested = program->functions[k];
+        if (!nested->deleted && !INL_uncalled(program, nested)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* The function to inline a call of name with args at, or NULL. */
+static INL_Function INL_choose(INL_Inliner * inliner, S_Symbol name, TR_ExpList args,
+        bool has_value) {
+    INL_Function callee = INL_resolve(inliner->program, name);
+    if (!callee || callee->deleted || !callee->resolved || INL_nests_called(inliner->program, callee)
+            || INL_param_count(callee->func) != TR_exp_count(args)) {
+        return NULL;
+    }
+    // The value of the call is that of the callee's last expression.
+    TR_StmList body = callee->func->body;
+    int count = TR_stm_count(body);
+    if (has_value && (!count || !body->items[count - 1]
+                || body->items[count - 1]->kind != TR_EXP_STM)) {
+        return NULL;
+    }
+    long limit;
+    if (callee->state != INL_DONE) {
+        // A recursive call.
+        limit = INL_SMALL;
+    } else if (callee->calls == 1) {
+        limit = INL_ONCE;
+    } else {
+        int bonus = inliner->loop_depth < INL_MAX_LOOP_BONUS ? inliner->loop_depth
+            : INL_MAX_LOOP_BONUS;
+        limit = INL_SMALL << bonus;
+    }
+    if (callee->size > limit || inliner->function->size + callee->size > INL_MAX_CALLER) {
+        return NULL;
+    }
+    return callee;
+}
+
+/* The statements a call of callee with args is replaced with: each
+ * argument, in order, moved into its parameter's variable, then the
+ * callee's body. */
+static TR_StmList INL_expand(INL_Inliner * inliner, INL_Function callee, TR_ExpList args) {
+    TR_Function into = inliner->function->func;
+    TR_Function from = callee->func;
+    int param_count = INL_param_count(from);
+    F_Var * params = malloc_checked(param_count * sizeof(*params) + 1);
+    // The frame lists its parameters last first.
+    int i = param_count;
+    for (TR_VarList list = from->frame->parameters; list; list = list->tail) {
+        params[--i] = list->head;
+    }
+    INL_Copier copier;
+    INL_begin_copy(&copier, into, from);
+    TR_StmList body = from->body;
+    TR_StmList stms = NULL;
+    for (i = 0; i < param_count; ++i) {
+        F_Var param = params[i];
+        F_Var var = param->escape
+            ? INL_slot(&copier, param->offset, param->name, param->size)
+            : copier.temp_vars[param->temp];
+        stms = TR_add_stm(stms, make_TR_AssignStm(args->items[i],
+                    make_TR_VarMemExp(var, copier.level)));
+    }
+    TR_StmList copy = INL_copy_stms(&copier, body);
+    for (int k = 0, n = TR_stm_count(copy); k < n; ++k) {
+        stms = TR_add_stm(stms, copy->items[k]);
+    }
+    INL_end_copy(&copier);
+    free(params);
+    INL_Counter counter = { inliner->program, NULL, 1, false };
+    INL_count_stms(&counter, copy);
+    --callee->calls;
+    inliner->function->size += callee->size + 2 * param_count + 1;
+    return stms;
+}
+
+static void INL_inline_exps(INL_Inliner * inliner, TR_ExpList exps) {
+    for (int i = 0, n = TR_exp_count(exps); i < n; ++i) {
+        exps->items[i] = INL_inline_exp(inliner, exps->items[i]);
+    }
+}
+
+static void INL_inline_stms(INL_Inliner * inliner, TR_StmList stms) {
+    for (int i = 0, n = TR_stm_count(stms); i < n; ++i) {
+        stms->items[i] = INL_inline_stm(inliner, stms->items[i]);
+    }
+}
+
+/* A call of INL_inline_exp or INL_inline_stm continued on a new stack segment. */
+typedef struct INL_DeepInline_ {
+    INL_Inliner * inliner;
+    TR_Exp exp;
+    TR_Stm stm;
+    TR_Exp exp_result;
+    TR_Stm stm_result;
+} INL_DeepInline;
+
+static void INL_run_deep_inline(void * arg) {
+    INL_DeepInline * call = arg;
+    if (call->stm) {
+        call->stm_result = INL_inline_stm(call->inliner, call->stm);
+    } else {
+        call->exp_result = INL_inline_exp(call->inliner, call->exp);
+    }
+}
+
+/* Rewrite a loop's part, which runs once per iteration. */
+static TR_Exp INL_inline_loop_exp(INL_Inliner * inliner, TR_Exp exp) {
+    ++inliner->loop_depth;
+    exp = INL_inline_exp(inliner, exp);
+    --inliner->loop_depth;
+    return exp;
+}
+
+static TR_Stm INL_inline_loop_stm(INL_Inliner * inliner, TR_Stm stm) {
+    ++inliner->loop_depth;
+    stm = INL_inline_stm(inliner, stm);
+    --inliner->loop_depth;
+    return stm;
+}
+
+static TR_Exp INL_inline_exp(INL_Inliner * inliner, TR_Exp exp) {
+    if (!exp) {
+        return NULL;
+    }
+    if (ST_low()) {
+        INL_DeepInline call = { inliner, exp, NULL, NULL, NULL };
+        ST_call(INL_run_deep_inline, &call);
+        return call.exp_result;
+    }
+    switch (exp->kind) {
+        case TR_NUM_EXP:
+        case TR_STRING_EXP:
+        case TR_MEM_EXP:
+            break;
+        case TR_VAR_EXP:
+            exp->u.var = INL_inline_exp(inliner, exp->u.var);
+            break;
+        case TR_FIELD_EXP:
+            exp->u.field.var = INL_inline_exp(inliner, exp->u.field.var);
+            break;
+        case TR_SUBSCRIPT_EXP:
+            exp->u.subscript.var = INL_inline_exp(inliner, exp->u.subscript.var);
+            exp->u.subscript.index = INL_inline_exp(inliner, exp->u.subscript.index);
+            break;
+        case TR_RECORD_EXP:
+            INL_inline_exps(inliner, exp->u.record.fields);
+            break;
+        case TR_ARRAY_EXP:
+            exp->u.array.init = INL_inline_exp(inliner, exp->u.array.init);
+            break;
+        case TR_ARITH_OP_EXP:
+            exp->u.arith.left = INL_inline_exp(inliner, exp->u.arith.left);
+            exp->u.arith.right = INL_inline_exp(inliner, exp->u.arith.right);
+            break;
+        case TR_DIV_OP_EXP:
+            exp->u.div.left = INL_inline_exp(inliner, exp->u.div.left);
+            exp->u.div.right = INL_inline_exp(inliner, exp->u.div.right);
+            break;
+        case TR_REL_OP_EXP:
+            exp->u.rel.left = INL_inline_exp(inliner, exp->u.rel.left);
+            exp->u.rel.right = INL_inline_exp(inliner, exp->u.rel.right);
+            break;
+        case TR_IF_EXP:
+            exp->u.if_.test = INL_inline_exp(inliner, exp->u.if_.test);
+            exp->u.if_.true_branch = INL_inline_exp(inliner, exp->u.if_.true_branch);
+            break;
+        case TR_IF_ELSE_EXP:
+            exp->u.if_else.test = INL_inline_exp(inliner, exp->u.if_else.test);
+            exp->u.if_else.true_branch = INL_inline_exp(inliner, exp->u.if_else.true_branch);
+            exp->u.if_else.false_branch = INL_inline_exp(inliner, exp->u.if_else.false_branch);
+            break;
+        case TR_FCALL_EXP:
+            {
+                INL_inline_exps(inliner, exp->u.fcall.args);
+                INL_Function callee = INL_choose(inliner, exp->u.fcall.name, exp->u.fcall.args,
+                        exp->size > 0);
+                if (callee) {
+                    // The sequence keeps the call's size, which records lay out.
+                    TR_Exp seq = make_TR_SeqExp(INL_expand(inliner, callee, exp->u.fcall.args));
+                    seq->size = exp->size;
+                    return seq;
+                }
+                break;
+            }
+        case TR_SEQ_EXP:
+            INL_inline_stms(inliner, exp->u.seq);
+            break;
+    }
+    return exp;
+}
+
+static TR_Stm INL_inline_stm(INL_Inliner * inliner, TR_Stm stm) {
+    if (!stm) {
+        return NULL;
+    }
+    if (ST_low()) {
+        INL_DeepInline call = { inliner, NULL, stm, NULL, NULL };
+        ST_call(INL_run_deep_inline, &call);
+        return call.stm_result;
+    }
+    switch (stm->kind) {
+        case TR_ASSIGN_STM:
+            stm->u.assign.var = INL_inline_exp(inliner, stm->u.assign.var);
+            stm->u.assign.value = INL_inline_exp(inliner, stm->u.assign.value);
+            break;
+        case TR_PCALL_STM:
+            {
+                INL_inline_exps(inliner, stm->u.pcall.args);
+                INL_Function callee = INL_choose(inliner, stm->u.pcall.name, stm->u.pcall.args,
+                        false);
+                if (callee) {
+                    return make_TR_SeqStm(INL_expand(inliner, callee, stm->u.pcall.args));
+                }
+                break;
+            }
+        case TR_SEQ_STM:
+            INL_inline_stms(inliner, stm->u.seq);
+            break;
+        case TR_IF_STM:
+            stm->u.if_.test = INL_inline_exp(inliner, stm->u.if_.test);
+            stm->u.if_.true_branch = INL_inline_stm(inliner, stm->u.if_.true_branch);
+            break;
+        case TR_IF_ELSE_STM:
+            stm->u.if_else.test = INL_inline_exp(inliner, stm->u.if_else.test);
+            stm->u.if_else.true_branch = INL_inline_stm(inliner, stm->u.if_else.true_branch);
+            stm->u.if_else.false_branch = INL_inline_stm(inliner, stm->u.if_else.false_branch);
+            break;
+        case TR_WHILE_STM:
+            stm->u.while_.test = INL_inline_loop_exp(inliner, stm->u.while_.test);
+            stm->u.while_.body = INL_inline_loop_stm(inliner, stm->u.while_.body);
+            break;
+        case TR_FOR_STM:
+            stm->u.for_.var = INL_inline_exp(inliner, stm->u.for_.var);
+            stm->u.for_.lo = INL_inline_exp(inliner, stm->u.for_.lo);
+            stm->u.for_.hi = INL_inline_exp(inliner, stm->u.for_.hi);
+            stm->u.for_.body = INL_inline_loop_stm(inliner, stm->u.for_.body);
+            break;
+        case TR_BREAK_STM:
+            break;
+        case TR_EXP_STM:
+            stm->u.exp = INL_inline_exp(inliner, stm->u.exp);
+            break;
+    }
+    return stm;
+}
+
+/* Inline the calls in function's body, unless nothing calls it. */
+static void INL_function(INL_Program * program, INL_Function function) {
+    if (function->deleted || INL_uncalled(program, function)) {
+        return;
+    }
+    INL_Inliner inliner = { program, function, 0 };
+    INL_inline_stms(&inliner, function->func->body);
+    function->size = IM_function_size(function->func);
+}
+
+void INL_program(TR_Function main_) {
+    INL_Program program = { NULL, 0, 0, S_empty(), E_base_venv(), NULL, 0 };
+    INL_collect(&program, main_);
+    program.work = malloc_checked(program.count * sizeof(*program.work));
+    for (int i = 0; i < program.count; ++i) {
+        INL_Function function = program.functions[i];
+        INL_Function named = S_look(program.names, function->func->name);
+        function->unique = named == function && !S_look(program.library, function->func->name);
+    }
+    for (int i = 0; i < program.count; ++i) {
+        INL_Counter counter = { &program, program.functions[i], 1, false };
+        INL_count_stms(&counter, program.functions[i]->func->body);
+    }
+    // Functions never called need not be inlined into or from.
+    INL_delete_unreached(&program);
+    // Handle each function after the functions it calls, except those
+    // it is called from in turn, taking the functions depth first.
+    INL_Function * stack = malloc_checked(program.count * sizeof(*stack));
+    int * next = malloc_checked(program.count * sizeof(*next));
+    for (int i = 0; i < program.count; ++i) {
+        INL_Function root = program.functions[i];
+        if (root->state != INL_NEW) {
+            continue;
+        }
+        int depth = 0;
+        root->state = INL_ACTIVE;
+        stack[depth] = root;
+        next[depth++] = 0;
+        while (depth) {
+            INL_Function top = stack[depth - 1];
+            if (next[depth - 1] < top->callee_count) {
+                INL_Function callee = top->callees[next[depth - 1]++];
+                if (callee->state == INL_NEW) {
+                    callee->state = INL_ACTIVE;
+                    stack[depth] = callee;
+                    next[depth++] = 0;
+                }
+                continue;
+            }
+            INL_function(&program, top);
+            top->state = INL_DONE;
+            --depth;
+        }
+    }
+    free(stack);
+    free(next);
+    INL_delete_unreached(&program);
+    for (int i = 0; i < program.count; ++i) {
+        free(program.functions[i]->callees);
+        free(program.functions[i]);
+    }
+    free(program.functions);
+    free(program.work);
+}
@@ -0,0 +1,38 @@
+/*
+ * inline.h -
+ * Inlining of calls. A call is replaced with the arguments moved into
+ * new variables of the caller, one per parameter, followed by a copy
+ * of the callee's body, whose last expression is the call's value.
+ * The copy renumbers the callee's temps and labels into the caller's,
+ * gives the callee's variables and objects variables and slots of the
+ * caller's frame, and moves its accesses to its own frame to the
+ * caller's nesting level. Its accesses to the frames of enclosing
+ * functions stay as they are: the callee is nested in a function that
+ * encloses the caller, so they reach the same frames from either.
+ * Only a function with no functions nested in it is inlined, and only
+ * where calls resolve by name alone: its name, and every name it
+ * calls, is declared once in the program and not also in the library.
+ * Callees are handled before their callers, so a caller takes in a
+ * callee's body with the calls in it already inlined. A call is
+ * inlined if the callee is about as small as the call, with more
+ * allowed in loops, or if it is the callee's only call and the callee
+ * is not too large, as long as the caller stays within a size bound.
+ * A recursive call, of a function whose body is still being handled,
+ * is inlined only if the callee is small, and the calls in the copy
+ * are left alone, so recursion unrolls at most one level per call.
+ * Functions that no chain of calls from the main program reaches any
+ * more are deleted, with the functions nested in them.
+ * All types and functions declared in this module begin with "INL_".
+ */
+
+#pragma once
+
+#include "pass_manager.h"
+#include "translate.h"
+
+/* Inline calls throughout main_ and every function nested in it, and
+ * delete the functions no longer reached. */
+void INL_program(TR_Function main_);
+
+/* INL_program, as the -O2 pass "inline". */
+extern const PM_Pass INL_pass;
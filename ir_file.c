@@ -0,0 +1,727 @@
+/*
+ * ir_file.c -
+ * Implementation of the binary IR file.
+ * See ir_file.h for more information.
+ */
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "frame.h"
+#include "ir_file.h"
+#include "stack.h"
+#include "symbol.h"
+
+#define IRF_MAGIC "TIGERIR"
+#define IRF_BYTE_ORDER 0x0102
+/* Every object in the file starts at a multiple of this. */
+#define IRF_ALIGN 8
+#define IRF_ALIGNED(size) (((size) + IRF_ALIGN - 1) & ~(long) (IRF_ALIGN - 1))
+
+/* The file starts with the header; main_ and type are stored
+ * as offsets and relocated like every other pointer. */
+typedef struct IRF_Header_ {
+    char magic[8];
+    uint32_t version;
+    uint16_t pointer_size;
+    uint16_t byte_order;
+    uint64_t size;
+    /* IRF_checksum of the whole file, read with this field as zero. */
+    uint64_t checksum;
+    TR_Function main_;
+    T_Type type;
+    /* The positions of the pointers to relocate. */
+    uint64_t relocs;
+    uint64_t reloc_count;
+    /* The positions of the pointers to the running compiler's
+     * own symbols and primitive types. */
+    uint64_t fixups;
+    uint64_t fixup_count;
+} IRF_Header;
+
+typedef struct IRF_Fixup_ {
+    uint64_t position;
+    /* IRF_SYMBOL, whose pointer holds the offset of its IRF_Name,
+     * or IRF_TYPE, naming the primitive T_Type of type_kind. */
+    uint32_t kind;
+    uint32_t type_kind;
+} IRF_Fixup;
+
+enum { IRF_SYMBOL, IRF_TYPE };
+
+/* A distinct symbol's name, followed by its text; symbol caches
+ * the interned symbol once the first reference to it is loaded. */
+typedef struct IRF_Name_ {
+    S_Symbol symbol;
+    char text[];
+} IRF_Name;
+
+/* Where an object in memory was written to the file. Only what may
+ * be reached twice is looked up: functions (through parent), the cells
+ * of children (through last_child), frames, types and symbols.
+ * Statements, expressions and strings form a tree and are written
+ * as they are reached. */
+typedef struct IRF_Written_ {
+    const void * object;
+    long offset;
+} IRF_Written;
+
+typedef struct IRF_Writer_ {
+    char * data;
+    long size;
+    long capacity;
+    IRF_Written * written;
+    long written_count;
+    long written_capacity;
+    uint64_t * relocs;
+    long reloc_count;
+    long reloc_capacity;
+    IRF_Fixup * fixups;
+    long fixup_count;
+    long fixup_capacity;
+} IRF_Writer;
+
+/* A checksum of the size bytes at data, a multiple of IRF_ALIGN,
+ * in which the header's own checksum counts as zero. Each step is
+ * invertible, so a change to any one word always changes the sum. */
+static uint64_t IRF_checksum(const char * data, uint64_t size) {
+    uint64_t sum = 0xcbf29ce484222325u;
+    for (uint64_t i = 0; i < size; i += sizeof(uint64_t)) {
+        uint64_t word = 0;
+        if (i != offsetof(IRF_Header, checksum)) {
+            memcpy(&word, data + i, sizeof(word));
+        }
+        sum = (sum ^ word) * 0x100000001b3u;
+        sum ^= sum >> 29;
+    }
+    return sum;
+}
+
+static long IRF_stm(IRF_Writer * writer, TR_Stm stm);
+static long IRF_exp(IRF_Writer * writer, TR_Exp exp);
+static long IRF_function(IRF_Writer * writer, TR_Function func);
+static long IRF_type(IRF_Writer * writer, T_Type type);
+
+/* Writing */
+
+/* items, of *capacity items of item_size bytes each, grown to twice
+ * the capacity; realloc can move a large block without copying it. */
+static void * IRF_grow(void * items, long * capacity, int item_size) {
+    *capacity *= 2;
+    items = realloc(items, *capacity * item_size);
+    if (!items) {
+        perror("Memory allocation failure");
+        exit(1);
+    }
+    return items;
+}
+
+/* size zeroed bytes at the end of the file; returns their offset. */
+static long IRF_reserve(IRF_Writer * writer, long size) {
+    size = IRF_ALIGNED(size);
+    while (writer->size + size > writer->capacity) {
+        writer->data = IRF_grow(writer->data, &writer->capacity, 1);
+    }
+    long offset = writer->size;
+    memset(writer->data + offset, 0, size);
+    writer->size += size;
+    return offset;
+}
+
+/* Copy size bytes to the file at offset. */
+static void IRF_put(IRF_Writer * writer, long offset, const void * bytes, long size) {
+    memcpy(writer->data + offset, bytes, size);
+}
+
+static unsigned long IRF_hash(const void * object, long capacity) {
+    return (((uintptr_t) object >> 3) * 2654435761u) & (capacity - 1);
+}
+
+/* The slot for object, or the empty slot where it belongs. */
+static IRF_Written * IRF_slot(IRF_Written * written, long capacity, const void * object) {
+    unsigned long i = IRF_hash(object, capacity);
+    while (written[i].object && written[i].object != object) {
+        i = (i + 1) & (capacity - 1);
+    }
+    return &written[i];
+}
+
+/* The offset object was written at, or 0 if it has not been. */
+static long IRF_find(IRF_Writer * writer, const void * object) {
+    return IRF_slot(writer->written, writer->written_capacity, object)->offset;
+}
+
+static void IRF_remember(IRF_Writer * writer, const void * object, long offset) {
+    *IRF_slot(writer->written, writer->written_capacity, object) = (IRF_Written) { object, offset };
+    // Keep the map at most half full.
+    if (2 * ++writer->written_count > writer->written_capacity) {
+        long capacity = 2 * writer->written_capacity;
+        IRF_Written * written = malloc_checked(capacity * sizeof(*written));
+        memset(written, 0, capacity * sizeof(*written));
+        for (long i = 0; i < writer->written_capacity; ++i) {
+            if (writer->written[i].object) {
+                *IRF_slot(written, capacity, writer->written[i].object) = writer->written[i];
+            }
+        }
+        free(writer->written);
+        writer->written = written;
+        writer->written_capacity = capacity;
+    }
+}
+
+/* Store the offset target in the pointer at position, to be
+ * relocated on load; 0 stands for NULL and needs no relocation. */
+static void IRF_link(IRF_Writer * writer, long position, long target) {
+    uintptr_t value = target;
+    IRF_put(writer, position, &value, sizeof(value));
+    if (!target) {
+        return;
+    }
+    if (writer->reloc_count == writer->reloc_capacity) {
+        writer->relocs = IRF_grow(writer->relocs, &writer->reloc_capacity,
+                sizeof(*writer->relocs));
+    }
+    writer->relocs[writer->reloc_count++] = position;
+}
+
+static void IRF_add_fixup(IRF_Writer * writer, IRF_Fixup fixup) {
+    if (writer->fixup_count == writer->fixup_capacity) {
+        writer->fixups = IRF_grow(writer->fixups, &writer->fixup_capacity,
+                sizeof(*writer->fixups));
+    }
+    writer->fixups[writer->fixup_count++] = fixup;
+}
+
+static void IRF_link_symbol(IRF_Writer * writer, long position, S_Symbol symbol) {
+    uintptr_t value = 0;
+    if (symbol) {
+        value = IRF_find(writer, symbol);
+        if (!value) {
+            string text = S_name(symbol);
+            value = IRF_reserve(writer, sizeof(IRF_Name) + strlen(text) + 1);
+            IRF_put(writer, value + offsetof(IRF_Name, text), text, strlen(text) + 1);
+            IRF_remember(writer, symbol, value);
+        }
+        IRF_add_fixup(writer, (IRF_Fixup) { position, IRF_SYMBOL, 0 });
+    }
+    IRF_put(writer, position, &value, sizeof(value));
+}
+
+static void IRF_link_type(IRF_Writer * writer, long position, T_Type type) {
+    if (type && (type->kind == T_NIL || type->kind == T_INT
+                || type->kind == T_STRING || type->kind == T_VOID)) {
+        IRF_add_fixup(writer, (IRF_Fixup) { position, IRF_TYPE, type->kind });
+        return;
+    }
+    IRF_link(writer, position, IRF_type(writer, type));
+}
+
+static long IRF_string(IRF_Writer * writer, string text) {
+    if (!text) {
+        return 0;
+    }
+    long offset = IRF_reserve(writer, strlen(text) + 1);
+    IRF_put(writer, offset, text, strlen(text) + 1);
+    return offset;
+}
+
+static long IRF_field(IRF_Writer * writer, T_Field field) {
+    if (!field) {
+        return 0;
+    }
+    long offset = IRF_find(writer, field);
+    if (offset) {
+        return offset;
+    }
+    offset = IRF_reserve(writer, sizeof(*field));
+    IRF_remember(writer, field, offset);
+    IRF_link_symbol(writer, offset + offsetof(struct T_Field_, name), field->name);
+    IRF_link_type(writer, offset + offsetof(struct T_Field_, type), field->type);
+    return offset;
+}
+
+static long IRF_fields(IRF_Writer * writer, T_FieldList fields) {
+    long first = IRF_find(writer, fields);
+    long tail = -1;
+    for (; fields && !IRF_find(writer, fields); fields = fields->tail) {
+        long cell = IRF_reserve(writer, sizeof(*fields));
+        IRF_remember(writer, fields, cell);
+        if (tail < 0) {
+            first = cell;
+        } else {
+            IRF_link(writer, tail, cell);
+        }
+        IRF_link(writer, cell + offsetof(struct T_FieldList_, head), IRF_field(writer, fields->head));
+        tail = cell + offsetof(struct T_FieldList_, tail);
+    }
+    if (tail >= 0 && fields) {
+        IRF_link(writer, tail, IRF_find(writer, fields));
+    }
+    return first;
+}
+
+static long IRF_type(IRF_Writer * writer, T_Type type) {
+    if (!type) {
+        return 0;
+    }
+    long offset = IRF_find(writer, type);
+    if (offset) {
+        return offset;
+    }
+    offset = IRF_reserve(writer, sizeof(*type));
+    IRF_put(writer, offset, &type->kind, sizeof(type->kind));
+    // Recursive types lead back here, so the type is remembered first.
+    IRF_remember(writer, type, offset);
+    switch (type->kind) {
+        case T_RECORD:
+            IRF_link(writer, offset + offsetof(struct T_Type_, u.record),
+                    IRF_fields(writer, type->u.record));
+            break;
+        case T_ARRAY:
+            IRF_link_type(writer, offset + offsetof(struct T_Type_, u.array), type->u.array);
+            break;
+        case T_NAME:
+            IRF_link_symbol(writer, offset + offsetof(struct T_Type_, u.name.sym),
+                    type->u.name.sym);
+            IRF_link_type(writer, offset + offsetof(struct T_Type_, u.name.type),
+                    type->u.name.type);
+            break;
+        default:
+            break;
+    }
+    return offset;
+}
+
+static long IRF_var(IRF_Writer * writer, F_Var var) {
+    if (!var) {
+        return 0;
+    }
+    long offset = IRF_find(writer, var);
+    if (offset) {
+        return offset;
+    }
+    offset = IRF_reserve(writer, sizeof(*var));
+    IRF_put(writer, offset, var, sizeof(*var));
+    IRF_remember(writer, var, offset);
+    IRF_link_symbol(writer, offset + offsetof(struct F_Var_, name), var->name);
+    IRF_link_type(writer, offset + offsetof(struct F_Var_, type), var->type);
+    return offset;
+}
+
+static long IRF_vars(IRF_Writer * writer, TR_VarList vars) {
+    long first = 0;
+    long tail = -1;
+    for (; vars; vars = vars->tail) {
+        long cell = IRF_reserve(writer, sizeof(*vars));
+        if (tail < 0) {
+            first = cell;
+        } else {
+            IRF_link(writer, tail, cell);
+        }
+        IRF_link(writer, cell + offsetof(struct TR_VarList_, head), IRF_var(writer, vars->head));
+        tail = cell + offsetof(struct TR_VarList_, tail);
+    }
+    return first;
+}
+
+static long IRF_frame(IRF_Writer * writer, F_Frame frame) {
+    if (!frame) {
+        return 0;
+    }
+    long offset = IRF_find(writer, frame);
+    if (offset) {
+        return offset;
+    }
+    offset = IRF_reserve(writer, sizeof(*frame));
+    IRF_put(writer, offset, frame, sizeof(*frame));
+    IRF_remember(writer, frame, offset);
+    IRF_link(writer, offset + offsetof(struct F_Frame_, parameters),
+            IRF_vars(writer, frame->parameters));
+    IRF_link(writer, offset + offsetof(struct F_Frame_, variables),
+            IRF_vars(writer, frame->variables));
+    IRF_link(writer, offset + offsetof(struct F_Frame_, objects),
+            IRF_vars(writer, frame->objects));
+    return offset;
+}
+
+/* A list of statements or expressions is written with its capacity
+ * trimmed to its length. */
+static long IRF_stm_list(IRF_Writer * writer, TR_StmList stms) {
+    if (!stms) {
+        return 0;
+    }
+    long offset = IRF_reserve(writer,
+            offsetof(struct TR_StmList_, items) + stms->length * sizeof(TR_Stm));
+    int header[] = { stms->length, stms->length };
+    IRF_put(writer, offset, header, sizeof(header));
+    for (int i = 0; i < stms->length; ++i) {
+        IRF_link(writer, offset + offsetof(struct TR_StmList_, items) + i * sizeof(TR_Stm),
+                IRF_stm(writer, stms->items[i]));
+    }
+    return offset;
+}
+
+static long IRF_exp_list(IRF_Writer * writer, TR_ExpList exps) {
+    if (!exps) {
+        return 0;
+    }
+    long offset = IRF_reserve(writer,
+            offsetof(struct TR_ExpList_, items) + exps->length * sizeof(TR_Exp));
+    int header[] = { exps->length, exps->length };
+    IRF_put(writer, offset, header, sizeof(header));
+    for (int i = 0; i < exps->length; ++i) {
+        IRF_link(writer, offset + offsetof(struct TR_ExpList_, items) + i * sizeof(TR_Exp),
+                IRF_exp(writer, exps->items[i]));
+    }
+    return offset;
+}
+
+/* A call of IRF_stm, IRF_exp or IRF_function continued on a new stack segment. */
+typedef struct IRF_DeepCall_ {
+    IRF_Writer * writer;
+    TR_Stm stm;
+    TR_Exp exp;
+    TR_Function func;
+    long result;
+} IRF_DeepCall;
+
+static void IRF_run_deep_call(void * arg) {
+    IRF_DeepCall * call = arg;
+    if (call->stm) {
+        call->result = IRF_stm(call->writer, call->stm);
+    } else if (call->exp) {
+        call->result = IRF_exp(call->writer, call->exp);
+    } else {
+        call->result = IRF_function(call->writer, call->func);
+    }
+}
+
+#define IRF_STM_FIELD(field) (offset + offsetof(struct TR_Stm_, u.field))
+#define IRF_EXP_FIELD(field) (offset + offsetof(struct TR_Exp_, u.field))
+
+static long IRF_stm(IRF_Writer * writer, TR_Stm stm) {
+    if (!stm) {
+        return 0;
+    }
+    if (ST_low()) {
+        IRF_DeepCall call = { writer, stm, NULL, NULL, 0 };
+        ST_call(IRF_run_deep_call, &call);
+        return call.result;
+    }
+    // Copy the node whole, then overwrite its pointers with offsets.
+    long offset = IRF_reserve(writer, TR_stm_size(stm));
+    IRF_put(writer, offset, stm, TR_stm_size(stm));
+    switch (stm->kind) {
+        case TR_ASSIGN_STM:
+            IRF_link(writer, IRF_STM_FIELD(assign.value), IRF_exp(writer, stm->u.assign.value));
+            IRF_link(writer, IRF_STM_FIELD(assign.var), IRF_exp(writer, stm->u.assign.var));
+            break;
+        case TR_PCALL_STM:
+            IRF_link_symbol(writer, IRF_STM_FIELD(pcall.name), stm->u.pcall.name);
+            IRF_link(writer, IRF_STM_FIELD(pcall.args), IRF_exp_list(writer, stm->u.pcall.args));
+            break;
+        case TR_SEQ_STM:
+            IRF_link(writer, IRF_STM_FIELD(seq), IRF_stm_list(writer, stm->u.seq));
+            break;
+        case TR_IF_STM:
+            IRF_link(writer, IRF_STM_FIELD(if_.test), IRF_exp(writer, stm->u.if_.test));
+            IRF_link(writer, IRF_STM_FIELD(if_.true_branch),
+                    IRF_stm(writer, stm->u.if_.true_branch));
+            break;
+        case TR_IF_ELSE_STM:
+            IRF_link(writer, IRF_STM_FIELD(if_else.test), IRF_exp(writer, stm->u.if_else.test));
+            IRF_link(writer, IRF_STM_FIELD(if_else.true_branch),
+                    IRF_stm(writer, stm->u.if_else.true_branch));
+            IRF_link(writer, IRF_STM_FIELD(if_else.false_branch),
+                    IRF_stm(writer, stm->u.if_else.false_branch));
+            break;
+        case TR_WHILE_STM:
+            IRF_link(writer, IRF_STM_FIELD(while_.test), IRF_exp(writer, stm->u.while_.test));
+            IRF_link(writer, IRF_STM_FIELD(while_.body), IRF_stm(writer, stm->u.while_.body));
+            break;
+        case TR_FOR_STM:
+            IRF_link(writer, IRF_STM_FIELD(for_.var), IRF_exp(writer, stm->u.for_.var));
+            IRF_link(writer, IRF_STM_FIELD(for_.lo), IRF_exp(writer, stm->u.for_.lo));
+            IRF_link(writer, IRF_STM_FIELD(for_.hi), IRF_exp(writer, stm->u.for_.hi));
+            IRF_link(writer, IRF_STM_FIELD(for_.body), IRF_stm(writer, stm->u.for_.body));
+            break;
+        case TR_BREAK_STM:
+            break;
+        case TR_EXP_STM:
+            IRF_link(writer, IRF_STM_FIELD(exp), IRF_exp(writer, stm->u.exp));
+            break;
+    }
+    return offset;
+}
+
+static long IRF_exp(IRF_Writer * writer, TR_Exp exp) {
+    if (!exp) {
+        return 0;
+    }
+    if (ST_low()) {
+        IRF_DeepCall call = { writer, NULL, exp, NULL, 0 };
+        ST_call(IRF_run_deep_call, &call);
+        return call.result;
+    }
+    long offset = IRF_reserve(writer, TR_exp_size(exp));
+    IRF_put(writer, offset, exp, TR_exp_size(exp));
+    switch (exp->kind) {
+        case TR_NUM_EXP:
+            break;
+        case TR_STRING_EXP:
+            IRF_link(writer, IRF_EXP_FIELD(str.str), IRF_string(writer, exp->u.str.str));
+            break;
+        case TR_MEM_EXP:
+            IRF_link_symbol(writer, IRF_EXP_FIELD(mem.name), exp->u.mem.name);
+            break;
+        case TR_VAR_EXP:
+            IRF_link(writer, IRF_EXP_FIELD(var), IRF_exp(writer, exp->u.var));
+            break;
+        case TR_FIELD_EXP:
+            IRF_link(writer, IRF_EXP_FIELD(field.var), IRF_exp(writer, exp->u.field.var));
+            IRF_link_symbol(writer, IRF_EXP_FIELD(field.field_name), exp->u.field.field_name);
+            break;
+        case TR_SUBSCRIPT_EXP:
+            IRF_link(writer, IRF_EXP_FIELD(subscript.var), IRF_exp(writer, exp->u.subscript.var));
+            IRF_link(writer, IRF_EXP_FIELD(subscript.index),
+                    IRF_exp(writer, exp->u.subscript.index));
+            break;
+        case TR_RECORD_EXP:
+            IRF_link(writer, IRF_EXP_FIELD(record.fields), IRF_exp_list(writer, exp->u.record.fields));
+            break;
+        case TR_ARRAY_EXP:
+            IRF_link(writer, IRF_EXP_FIELD(array.init), IRF_exp(writer, exp->u.array.init));
+            break;
+        case TR_ARITH_OP_EXP:
+            IRF_link(writer, IRF_EXP_FIELD(arith.left), IRF_exp(writer, exp->u.arith.left));
+            IRF_link(writer, IRF_EXP_FIELD(arith.right), IRF_exp(writer, exp->u.arith.right));
+            break;
+        case TR_DIV_OP_EXP:
+            IRF_link(writer, IRF_EXP_FIELD(div.left), IRF_exp(writer, exp->u.div.left));
+            IRF_link(writer, IRF_EXP_FIELD(div.right), IRF_exp(writer, exp->u.div.right));
+            break;
+        case TR_REL_OP_EXP:
+            IRF_link(writer, IRF_EXP_FIELD(rel.left), IRF_exp(writer, exp->u.rel.left));
+            IRF_link(writer, IRF_EXP_FIELD(rel.right), IRF_exp(writer, exp->u.rel.right));
+            break;
+        case TR_IF_EXP:
+            IRF_link(writer, IRF_EXP_FIELD(if_.test), IRF_exp(writer, exp->u.if_.test));
+            IRF_link(writer, IRF_EXP_FIELD(if_.true_branch),
+                    IRF_exp(writer, exp->u.if_.true_branch));
+            break;
+        case TR_IF_ELSE_EXP:
+            IRF_link(writer, IRF_EXP_FIELD(if_else.test), IRF_exp(writer, exp->u.if_else.test));
+            IRF_link(writer, IRF_EXP_FIELD(if_else.true_branch),
+                    IRF_exp(writer, exp->u.if_else.true_branch));
+            IRF_link(writer, IRF_EXP_FIELD(if_else.false_branch),
+                    IRF_exp(writer, exp->u.if_else.false_branch));
+            break;
+        case TR_FCALL_EXP:
+            IRF_link_symbol(writer, IRF_EXP_FIELD(fcall.name), exp->u.fcall.name);
+            IRF_link(writer, IRF_EXP_FIELD(fcall.args), IRF_exp_list(writer, exp->u.fcall.args));
+            break;
+        case TR_SEQ_EXP:
+            IRF_link(writer, IRF_EXP_FIELD(seq), IRF_stm_list(writer, exp->u.seq));
+            break;
+    }
+    return offset;
+}
+
+static long IRF_function(IRF_Writer * writer, TR_Function func) {
+    if (!func) {
+        return 0;
+    }
+    if (ST_low()) {
+        IRF_DeepCall call = { writer, NULL, NULL, func, 0 };
+        ST_call(IRF_run_deep_call, &call);
+        return call.result;
+    }
+    long offset = IRF_find(writer, func);
+    if (offset) {
+        return offset;
+    }
+    offset = IRF_reserve(writer, sizeof(*func));
+    IRF_put(writer, offset, func, sizeof(*func));
+    IRF_remember(writer, func, offset);
+    IRF_link_symbol(writer, offset + offsetof(struct TR_Function_, name), func->name);
+    IRF_link(writer, offset + offsetof(struct TR_Function_, frame), IRF_frame(writer, func->frame));
+    IRF_link(writer, offset + offsetof(struct TR_Function_, parent),
+            IRF_function(writer, func->parent));
+    IRF_link(writer, offset + offsetof(struct TR_Function_, body),
+            IRF_stm_list(writer, func->body));
+    long tail = offset + offsetof(struct TR_Function_, children);
+    for (TR_FunctionList children = func->children; children; children = children->tail) {
+        long cell = IRF_reserve(writer, sizeof(*children));
+        IRF_remember(writer, children, cell);
+        IRF_link(writer, tail, cell);
+        IRF_link(writer, cell + offsetof(struct TR_FunctionList_, head),
+                IRF_function(writer, children->head));
+        tail = cell + offsetof(struct TR_FunctionList_, tail);
+    }
+    IRF_link(writer, tail, 0);
+    IRF_link(writer, offset + offsetof(struct TR_Function_, last_child),
+            func->last_child ? IRF_find(writer, func->last_child) : 0);
+    return offset;
+}
+
+bool IRF_write(string path, TR_Function main_, T_Type type) {
+    IRF_Writer writer;
+    memset(&writer, 0, sizeof(writer));
+    writer.capacity = 1 << 16;
+    writer.data = malloc_checked(writer.capacity);
+    writer.written_capacity = 1 << 10;
+    writer.written = malloc_checked(writer.written_capacity * sizeof(*writer.written));
+    memset(writer.written, 0, writer.written_capacity * sizeof(*writer.written));
+    writer.reloc_capacity = 1 << 10;
+    writer.relocs = malloc_checked(writer.reloc_capacity * sizeof(*writer.relocs));
+    writer.fixup_capacity = 1 << 10;
+    writer.fixups = malloc_checked(writer.fixup_capacity * sizeof(*writer.fixups));
+
+    long header = IRF_reserve(&writer, sizeof(IRF_Header));
+    IRF_link(&writer, header + offsetof(IRF_Header, main_), IRF_function(&writer, main_));
+    IRF_link_type(&writer, header + offsetof(IRF_Header, type), type);
+    long relocs = IRF_reserve(&writer, writer.reloc_count * sizeof(*writer.relocs));
+    IRF_put(&writer, relocs, writer.relocs, writer.reloc_count * sizeof(*writer.relocs));
+    long fixups = IRF_reserve(&writer, writer.fixup_count * sizeof(*writer.fixups));
+    IRF_put(&writer, fixups, writer.fixups, writer.fixup_count * sizeof(*writer.fixups));
+
+    IRF_Header * h = (IRF_Header *) (writer.data + header);
+    memcpy(h->magic, IRF_MAGIC, sizeof(h->magic));
+    h->version = IRF_VERSION;
+    h->pointer_size = sizeof(void *);
+    h->byte_order = IRF_BYTE_ORDER;
+    h->size = writer.size;
+    h->relocs = relocs;
+    h->reloc_count = writer.reloc_count;
+    h->fixups = fixups;
+    h->fixup_count = writer.fixup_count;
+    h->checksum = IRF_checksum(writer.data, writer.size);
+
+    FILE * out = fopen(path, "wb");
+    bool ok = out && fwrite(writer.data, 1, writer.size, out) == (size_t) writer.size;
+    ok = out && !fclose(out) && ok;
+    free(writer.data);
+    free(writer.written);
+    free(writer.relocs);
+    free(writer.fixups);
+    return ok;
+}
+
+/* Loading */
+
+static T_Type IRF_primitive_type(uint32_t kind) {
+    switch (kind) {
+        case T_NIL: return make_T_Nil();
+        case T_INT: return make_T_Int();
+        case T_STRING: return make_T_String();
+        case T_VOID: return make_T_Void();
+        default: return NULL;
+    }
+}
+
+/* Whether a pointer-sized slot at position lies within size bytes. */
+static bool IRF_slot_fits(uint64_t position, uint64_t size) {
+    return position % IRF_ALIGN == 0 && position <= size - sizeof(void *);
+}
+
+/* Turn the offsets in the mapped file at base into pointers;
+ * returns what is wrong with the file, or NULL. */
+static string IRF_relocate(char * base, uint64_t size) {
+    IRF_Header * header = (IRF_Header *) base;
+    if (memcmp(header->magic, IRF_MAGIC, sizeof(header->magic))) {
+        return "not an IR file";
+    }
+    if (header->version != IRF_VERSION) {
+        return "unsupported IR file version";
+    }
+    if (header->pointer_size != sizeof(void *) || header->byte_order != IRF_BYTE_ORDER) {
+        return "IR file written for another architecture";
+    }
+    if (header->size != size || size % IRF_ALIGN
+            || header->relocs > size || header->reloc_count > (size - header->relocs) / sizeof(uint64_t)
+            || header->fixups > size || header->fixup_count > (size - header->fixups) / sizeof(IRF_Fixup)) {
+        return "truncated or corrupt IR file";
+    }
+    // Past this check, the nodes' kinds and lengths are trusted.
+    if (header->checksum != IRF_checksum(base, size)) {
+        return "corrupt IR file";
+    }
+    uint64_t * relocs = (uint64_t *) (base + header->relocs);
+    for (uint64_t i = 0; i < header->reloc_count; ++i) {
+        if (!IRF_slot_fits(relocs[i], size)) {
+            return "corrupt IR file";
+        }
+        uintptr_t * slot = (uintptr_t *) (base + relocs[i]);
+        if (*slot >= size) {
+            return "corrupt IR file";
+        }
+        *(void **) slot = base + *slot;
+    }
+    IRF_Fixup * fixups = (IRF_Fixup *) (base + header->fixups);
+    for (uint64_t i = 0; i < header->fixup_count; ++i) {
+        if (!IRF_slot_fits(fixups[i].position, size)) {
+            return "corrupt IR file";
+        }
+        void ** slot = (void **) (base + fixups[i].position);
+        if (fixups[i].kind == IRF_TYPE) {
+            if (!(*slot = IRF_primitive_type(fixups[i].type_kind))) {
+                return "corrupt IR file";
+            }
+            continue;
+        }
+        uintptr_t offset = (uintptr_t) *slot;
+        if (!IRF_slot_fits(offset, size - sizeof(IRF_Name))) {
+            return "corrupt IR file";
+        }
+        IRF_Name * name = (IRF_Name *) (base + offset);
+        if (!name->symbol) {
+            if (!memchr(name->text, 0, size - offset - sizeof(IRF_Name))) {
+                return "corrupt IR file";
+            }
+            name->symbol = make_S_Symbol(name->text);
+        }
+        *slot = name->symbol;
+    }
+    return NULL;
+}
+
+TR_Function IRF_load(string path, T_Type * type, FILE * errors) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st)) {
+        fprintf(errors, "%s: cannot open IR file\n", path);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return NULL;
+    }
+    if ((uint64_t) st.st_size < sizeof(IRF_Header)) {
+        close(fd);
+        fprintf(errors, "%s: not an IR file\n", path);
+        return NULL;
+    }
+    // Private, so relocating writes only this process's copy of a page.
+    char * base = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        fprintf(errors, "%s: cannot map IR file\n", path);
+        return NULL;
+    }
+    string problem = IRF_relocate(base, st.st_size);
+    if (problem) {
+        fprintf(errors, "%s: %s\n", path, problem);
+        munmap(base, st.st_size);
+        return NULL;
+    }
+    IRF_Header * header = (IRF_Header *) base;
+    if (type) {
+        *type = header->type;
+    }
+    return header->main_;
+}
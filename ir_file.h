@@ -0,0 +1,40 @@
+/*
+ * ir_file.h -
+ * Saving a translated program to a binary file that later runs,
+ * possibly of another process, map straight into memory.
+ * The file holds the TR_Function tree, with its frames, variables,
+ * types, statements, expressions and string literals, laid out as
+ * the very structs the rest of the compiler walks, every pointer
+ * replaced by its target's offset from the start of the file.
+ * Loading maps the file privately and rewrites each offset listed
+ * in its relocation table into an address; nothing is allocated,
+ * copied or parsed per node, so a large program loads in about the
+ * time it takes to touch its pages. Symbols are interned once per
+ * distinct name and the primitive types resolve to the running
+ * compiler's own, so loaded IR compares equal to freshly built IR.
+ * A file records its format version, pointer size and byte order,
+ * and loads only into a compiler that matches all three; it also
+ * records a checksum of its contents, and a file that fails it is
+ * rejected before anything in it is followed.
+ * All types and functions declared in this module begin with "IRF_".
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "translate.h"
+#include "types.h"
+#include "util.h"
+
+#define IRF_VERSION 4
+
+/* Write main_ and every function nested in it to path, with the
+ * program's type; false if the file cannot be written. */
+bool IRF_write(string path, TR_Function main_, T_Type type);
+
+/* Map the program saved at path, setting *type to its type;
+ * NULL, after reporting why to errors, if it cannot be loaded.
+ * The mapping lasts as long as the process. */
+TR_Function IRF_load(string path, T_Type * type, FILE * errors);
@@ -0,0 +1,255 @@
+/*
+ * ir_metrics.c -
+ * Implementation of IR size and shape metrics.
+ * See ir_metrics.h for more information.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "ir_metrics.h"
+#include "print_ir.h"
+#include "stack.h"
+
+#define IM_STM_KINDS (TR_EXP_STM + 1)
+#define IM_EXP_KINDS (TR_SEQ_EXP + 1)
+
+typedef struct IM_Metrics_ {
+    long stms[IM_STM_KINDS];
+    long exps[IM_EXP_KINDS];
+    long temps;
+    long labels;
+    long frame_size;
+    int max_exp_depth;
+    long nonlocal_accesses;
+} IM_Metrics;
+
+static void IM_count_exp(IM_Metrics * metrics, int level, TR_Exp exp, int depth);
+static void IM_count_stm(IM_Metrics * metrics, int level, TR_Stm stm, int depth);
+
+/* A call of IM_count_exp or IM_count_stm continued on a new stack segment. */
+typedef struct IM_DeepCall_ {
+    IM_Metrics * metrics;
+    int level;
+    TR_Exp exp;
+    TR_Stm stm;
+    int depth;
+} IM_DeepCall;
+
+static void IM_run_deep_call(void * arg) {
+    IM_DeepCall * call = arg;
+    if (call->stm) {
+        IM_count_stm(call->metrics, call->level, call->stm, call->depth);
+    } else {
+        IM_count_exp(call->metrics, call->level, call->exp, call->depth);
+    }
+}
+
+static void IM_count_exps(IM_Metrics * metrics, int level, TR_ExpList exps, int depth) {
+    for (int i = 0, n = TR_exp_count(exps); i < n; ++i) {
+        IM_count_exp(metrics, level, exps->items[i], depth);
+    }
+}
+
+static void IM_count_stms(IM_Metrics * metrics, int level, TR_StmList stms, int depth) {
+    for (int i = 0, n = TR_stm_count(stms); i < n; ++i) {
+        IM_count_stm(metrics, level, stms->items[i], depth);
+    }
+}
+
+/* Counts exp, found at the given depth of expression nesting
+ * in a function at the given nesting level. */
+static void IM_count_exp(IM_Metrics * metrics, int level, TR_Exp exp, int depth) {
+    if (!exp) {
+        return;
+    }
+    if (ST_low()) {
+        IM_DeepCall call = { metrics, level, exp, NULL, depth };
+        ST_call(IM_run_deep_call, &call);
+        return;
+    }
+    ++metrics->exps[exp->kind];
+    if (++depth > metrics->max_exp_depth) {
+        metrics->max_exp_depth = depth;
+    }
+    switch (exp->kind) {
+        case TR_MEM_EXP:
+            if (exp->u.mem.nesting_level < level) {
+                ++metrics->nonlocal_accesses;
+            }
+            break;
+        case TR_VAR_EXP:
+            IM_count_exp(metrics, level, exp->u.var, depth);
+            break;
+        case TR_FIELD_EXP:
+            IM_count_exp(metrics, level, exp->u.field.var, depth);
+            break;
+        case TR_SUBSCRIPT_EXP:
+            IM_count_exp(metrics, level, exp->u.subscript.var, depth);
+            IM_count_exp(metrics, level, exp->u.subscript.index, depth);
+            break;
+        case TR_RECORD_EXP:
+            IM_count_exps(metrics, level, exp->u.record.fields, depth);
+            break;
+        case TR_ARRAY_EXP:
+            IM_count_exp(metrics, level, exp->u.array.init, depth);
+            break;
+        case TR_ARITH_OP_EXP:
+            IM_count_exp(metrics, level, exp->u.arith.left, depth);
+            IM_count_exp(metrics, level, exp->u.arith.right, depth);
+            break;
+        case TR_DIV_OP_EXP:
+            IM_count_exp(metrics, level, exp->u.div.left, depth);
+            IM_count_exp(metrics, level, exp->u.div.right, depth);
+            break;
+        case TR_REL_OP_EXP:
+            IM_count_exp(metrics, level, exp->u.rel.left, depth);
+            IM_count_exp(metrics, level, exp->u.rel.right, depth);
+            break;
+        case TR_IF_EXP:
+            IM_count_exp(metrics, level, exp->u.if_.test, depth);
+            IM_count_exp(metrics, level, exp->u.if_.true_branch, depth);
+            break;
+        case TR_IF_ELSE_EXP:
+            IM_count_exp(metrics, level, exp->u.if_else.test, depth);
+            IM_count_exp(metrics, level, exp->u.if_else.true_branch, depth);
+            IM_count_exp(metrics, level, exp->u.if_else.false_branch, depth);
+            break;
+        case TR_FCALL_EXP:
+            IM_count_exps(metrics, level, exp->u.fcall.args, depth);
+            break;
+        case TR_SEQ_EXP:
+            IM_count_stms(metrics, level, exp->u.seq, depth);
+            break;
+        default:
+            break;
+    }
+}
+
+static void IM_count_stm(IM_Metrics * metrics, int level, TR_Stm stm, int depth) {
+    if (!stm) {
+        return;
+    }
+    if (ST_low()) {
+        IM_DeepCall call = { metrics, level, NULL, stm, depth };
+        ST_call(IM_run_deep_call, &call);
+        return;
+    }
+    ++metrics->stms[stm->kind];
+    switch (stm->kind) {
+        case TR_ASSIGN_STM:
+            IM_count_exp(metrics, level, stm->u.assign.value, depth);
+            IM_count_exp(metrics, level, stm->u.assign.var, depth);
+            break;
+        case TR_PCALL_STM:
+            IM_count_exps(metrics, level, stm->u.pcall.args, depth);
+            break;
+        case TR_SEQ_STM:
+            IM_count_stms(metrics, level, stm->u.seq, depth);
+            break;
+        case TR_IF_STM:
+            IM_count_exp(metrics, level, stm->u.if_.test, depth);
+            IM_count_stm(metrics, level, stm->u.if_.true_branch, depth);
+            break;
+        case TR_IF_ELSE_STM:
+            IM_count_exp(metrics, level, stm->u.if_else.test, depth);
+            IM_count_stm(metrics, level, stm->u.if_else.true_branch, depth);
+            IM_count_stm(metrics, level, stm->u.if_else.false_branch, depth);
+            break;
+        case TR_WHILE_STM:
+            IM_count_exp(metrics, level, stm->u.while_.test, depth);
+            IM_count_stm(metrics, level, stm->u.while_.body, depth);
+            break;
+        case TR_FOR_STM:
+            IM_count_exp(metrics, level, stm->u.for_.var, depth);
+            IM_count_exp(metrics, level, stm->u.for_.lo, depth);
+            IM_count_exp(metrics, level, stm->u.for_.hi, depth);
+            IM_count_stm(metrics, level, stm->u.for_.body, depth);
+            break;
+        case TR_EXP_STM:
+            IM_count_exp(metrics, level, stm->u.exp, depth);
+            break;
+        default:
+            break;
+    }
+}
+
+static void IM_print_fields(FILE * out, IM_Metrics * metrics) {
+    fprintf(out, "\"frame_size\": %ld, \"temps\": %ld, \"labels\": %ld, "
+            "\"max_exp_depth\": %d, \"nonlocal_accesses\": %ld, \"stms\": {",
+            metrics->frame_size, metrics->temps, metrics->labels,
+            metrics->max_exp_depth, metrics->nonlocal_accesses);
+    for (int i = 0; i < IM_STM_KINDS; ++i) {
+        fprintf(out, "%s\"%s\": %ld", i ? ", " : "", P_stm_names[i], metrics->stms[i]);
+    }
+    fprintf(out, "}, \"exps\": {");
+    for (int i = 0; i < IM_EXP_KINDS; ++i) {
+        fprintf(out, "%s\"%s\": %ld", i ? ", " : "", P_exp_names[i], metrics->exps[i]);
+    }
+    fprintf(out, "}");
+}
+
+/* Prints the metrics of func and its nested functions,
+ * adding them to the totals. */
+static void IM_print_function(FILE * out, TR_Function func, IM_Metrics * total, long * count) {
+    IM_Metrics metrics;
+    memset(&metrics, 0, sizeof(metrics));
+    int level = func->frame->nesting_level;
+    metrics.frame_size = func->frame->end;
+    // The counts kept while translating; a variable kept in a temp
+    // names its temp at every use, so the nodes cannot be counted.
+    metrics.temps = func->temp_count;
+    metrics.labels = func->label_count;
+    IM_count_stms(&metrics, level, func->body, 0);
+    fprintf(out, "%s\n  {\"name\": \"%s\", \"parent\": ", *count ? "," : "", S_name(func->name));
+    if (func->parent) {
+        fprintf(out, "\"%s\"", S_name(func->parent->name));
+    } else {
+        fprintf(out, "null");
+    }
+    fprintf(out, ", \"nesting_level\": %d, ", level);
+    IM_print_fields(out, &metrics);
+    fprintf(out, "}");
+    ++*count;
+    for (int i = 0; i < IM_STM_KINDS; ++i) {
+        total->stms[i] += metrics.stms[i];
+    }
+    for (int i = 0; i < IM_EXP_KINDS; ++i) {
+        total->exps[i] += metrics.exps[i];
+    }
+    total->temps += metrics.temps;
+    total->labels += metrics.labels;
+    total->frame_size += metrics.frame_size;
+    if (metrics.max_exp_depth > total->max_exp_depth) {
+        total->max_exp_depth = metrics.max_exp_depth;
+    }
+    total->nonlocal_accesses += metrics.nonlocal_accesses;
+    for (TR_FunctionList children = func->children; children; children = children->tail) {
+        IM_print_function(out, children->head, total, count);
+    }
+}
+
+long IM_function_size(TR_Function func) {
+    IM_Metrics metrics;
+    memset(&metrics, 0, sizeof(metrics));
+    IM_count_stms(&metrics, func->frame ? func->frame->nesting_level : 0, func->body, 0);
+    long size = 0;
+    for (int i = 0; i < IM_STM_KINDS; ++i) {
+        size += metrics.stms[i];
+    }
+    for (int i = 0; i < IM_EXP_KINDS; ++i) {
+        size += metrics.exps[i];
+    }
+    return size;
+}
+
+void IM_print_metrics(FILE * out, TR_Function main_) {
+    IM_Metrics total;
+    memset(&total, 0, sizeof(total));
+    long count = 0;
+    fprintf(out, "{\"functions\": [");
+    IM_print_function(out, main_, &total, &count);
+    fprintf(out, "\n], \"total\": {\"functions\": %ld, ", count);
+    IM_print_fields(out, &total);
+    fprintf(out, "}}\n");
+}
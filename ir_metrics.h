@@ -0,0 +1,24 @@
+/*
+ * ir_metrics.h -
+ * Size and shape metrics of the IR of a translated program,
+ * reported as JSON so that they can be compared across versions
+ * of the compiler and used to find the functions that blow up.
+ * For each function: the number of statements and expressions
+ * of each kind, the temps and labels it allocates, its frame size
+ * and nesting level, the depth of its deepest expression and the
+ * number of its accesses to variables of enclosing functions.
+ * All types and functions declared in this module begin with "IM_".
+ */
+
+#pragma once
+
+#include <stdio.h>
+
+#include "translate.h"
+
+/* Print the metrics of main_ and every function nested in it,
+ * in the order P_print_ir prints them, followed by their totals. */
+void IM_print_metrics(FILE * out, TR_Function main_);
+
+/* The number of statements and expressions in func's own body. */
+long IM_function_size(TR_Function func);
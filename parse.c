@@ -3,8 +3,39 @@
  * Run ./parse <Tiger-source-code-file>
  * to see visual representations of the Tiger code.
  * This version prints the output type and IR by default.
- * Use the -p flag at the end of the command
+ * Use the -p flag after the file name
  * to print the AST before the type and IR.
+ * Use -j <n> to check sibling function bodies on n threads.
+ * Use -r <edited-file> to check the program, then re-check the
+ * edited version incrementally and print the latter's results.
+ * Use --check-only to report type errors and the program's type
+ * without translating it to IR.
+ * Use --stats to print the time and allocations of each phase
+ * to stderr, or --stats=json to print them as JSON.
+ * Use --trace=<file> to write a Chrome trace of the compile to file.
+ * Use --ir-metrics to print the size and shape of each function's IR
+ * as JSON in place of the type and IR; nothing else goes to stdout.
+ * Use --cfg to print each function's control-flow graph of basic
+ * blocks in place of the IR, after verifying it.
+ * Use --emit-ir=<file> to also save the program's IR to a binary file;
+ * ./parse --load-ir=<file> [--cfg] maps one back in and prints it
+ * as the compile that saved it would have; the graphs are optimized
+ * after loading, so --cfg needs the compile's -O and -f options too.
+ * Use -O1 or -O2 to optimize the IR (-O0, the default, does not),
+ * -fno-<pass> to skip one pass, -fpasses=<pass,...> to run exactly
+ * those passes in that order, -fverify-ir to verify the IR after
+ * every pass, and --pass-stats[=json] to print each pass's time and
+ * effect on the size of the IR to stderr.
+ * Run ./parse --server=<socket> to start a compile daemon, and add
+ * --client=<socket> to any command to have the daemon run it,
+ * if one is listening; the file name "-" reads standard input.
+ * Use --cache=<dir> to replay the output of an identical earlier
+ * compile from an on-disk cache, bounded by --cache-size=<MB>;
+ * ./parse --cache-stats=<dir> reports its hits and misses.
+ * Run ./parse --watch=<dir> to check every Tiger source in dir, then
+ * re-check each one incrementally whenever it is saved.
+ * Run ./parse --query to answer editor queries (types, definitions,
+ * references, diagnostics) as JSON-RPC on standard input and output.
  * Orig. author: Andrew Appel.
  * Revised by Amittai Aviram - aviram@bc.edu.
  */
@@ -12,26 +43,51 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "absyn.h"
+#include "cache.h"
+#include "cfg.h"
 #include "errormsg.h"
+#include "ir_file.h"
+#include "ir_metrics.h"
 #include "parse.h"
+#include "pass_manager.h"
+#include "pool.h"
 #include "prabsyn.h"
 #include "print_ir.h"
+#include "query.h"
 #include "semant.h"
+#include "server.h"
+#include "stats.h"
 #include "symbol.h"
+#include "trace.h"
 #include "util.h"
+#include "watch.h"
 #include "y.tab.h"
 
 extern A_Exp absyn_root;
+extern FILE * yyin;
 
-/* Parse source file fname; 
- * return abstract syntax data structure.
+/* Whether stdout is reserved for machine-readable output. */
+static bool quiet = false;
+
+/* Parse source file fname; return its abstract syntax data
+ * structure, or NULL, with *readable false if the file cannot be read.
  */
-A_Exp parse(string fname) {
-    EM_reset(fname);
-    if (!yyparse()) {
-        puts("Parsing successful!");
+static A_Exp parse_file(string fname, bool * readable) {
+    *readable = EM_reset(fname);
+    if (!*readable) {
+        return NULL;
+    }
+    int result = yyparse();
+    if (yyin != stdin) {
+        fclose(yyin);
+    }
+    if (!result) {
+        if (!quiet) {
+            puts("Parsing successful!");
+        }
         return absyn_root;
     } else {
         fprintf(stderr, "Parsing failed\n");
@@ -39,29 +95,398 @@ A_Exp parse(string fname) {
     }
 }
 
-int main(int argc, char ** argv) {
+/* Parse source file fname; 
+ * return abstract syntax data structure.
+ */
+A_Exp parse(string fname) {
+    bool readable;
+    A_Exp program = parse_file(fname, &readable);
+    if (!readable) {
+        fprintf(stderr, "%s: cannot be read\n", fname);
+    }
+    return program;
+}
+
+/* End the phase in progress, if any, and start the named one,
+ * both in the statistics and in the trace; NULL starts none.
+ */
+static void begin_phase(string name) {
+    static bool in_phase = false;
+    if (name) {
+        STAT_begin(name);
+    } else {
+        STAT_end();
+    }
+    if (in_phase) {
+        TRACE_end();
+    }
+    in_phase = name != NULL;
+    if (in_phase) {
+        TRACE_begin(name, "phase");
+    }
+}
+
+/* Print the program's type and either its IR or, if cfg,
+ * its verified control-flow graphs; main_ may be NULL. */
+static void print_program(TR_Function main_, T_Type type, bool cfg) {
+    if (!type) {
+        puts("Type could not be established.");
+        return;
+    }
+    printf("Type: %s\n", T_type_name(type));
+    if (main_ && cfg) {
+        begin_phase("cfg");
+        CFG_GraphList graphs = CFG_build_all(main_);
+        // As with PM_run, a program with errors is not optimized.
+        if (!EM_any_errors) {
+            begin_phase("optimize CFG");
+            PM_run_graphs(graphs);
+        }
+        begin_phase("print");
+        for (CFG_GraphList g = graphs; g; g = g->tail) {
+            CFG_verify(g->head, stderr);
+            CFG_print(stdout, g->head);
+        }
+    } else if (main_) {
+        P_print_ir(main_);
+    }
+}
+
+/* Apply arg if it is one of the options that choose the optimization
+ * passes; false if it is not. A pass it cannot apply ends the program. */
+static bool pass_option(string arg) {
+    if (!strncmp(arg, "-O", 2) && arg[2] >= '0' && arg[2] <= '0' + PM_MAX_LEVEL && !arg[3]) {
+        PM_set_level(arg[2] - '0');
+    } else if (!strncmp(arg, "-fno-", 5)) {
+        if (!PM_disable(arg + 5)) {
+            fprintf(stderr, "unknown pass: %s\n", arg + 5);
+            exit(EXIT_FAILURE);
+        }
+    } else if (!strncmp(arg, "-fpasses=", 9)) {
+        if (!PM_set_order(arg + 9)) {
+            fprintf(stderr, "unknown pass in %s\n", arg + 9);
+            exit(EXIT_FAILURE);
+        }
+    } else if (!strcmp(arg, "-fverify-ir")) {
+        if (!PM_enable_verification()) {
+            fprintf(stderr, "-fverify-ir needs a build without NDEBUG\n");
+            exit(EXIT_FAILURE);
+        }
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/* Compile as the command line asks; returns the exit status. */
+static int compile(int argc, char ** argv) {
     if (argc < 2) {
-        fprintf(stderr,"usage: %s filename\n", argv[0]);
+        fprintf(stderr,"usage: %s filename [-p] [-j <threads>] [-r <edited-file>] [--check-only] [--ir-metrics] [--cfg] [--stats[=json]] [--trace=<file>] [--client=<socket>]\n"
+                "       [--cache=<dir>] [--cache-size=<MB>] [--emit-ir=<file>]\n"
+                "       [-O<level>] [-fno-<pass>] [-fpasses=<pass,...>] [-fverify-ir] [--pass-stats[=json]]\n"
+                "       %s --load-ir=<file> [-O<level>] [-fno-<pass>] [-fpasses=<pass,...>] [-fverify-ir] [--cfg]\n"
+                "       %s --server=<socket>\n"
+                "       %s --cache-stats=<dir>\n"
+                "       %s --watch=<dir>\n"
+                "       %s --query\n", argv[0], argv[0], argv[0], argv[0], argv[0], argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    bool print_ast = false;
+    int jobs = 1;
+    string edited_file = NULL;
+    bool check_only = false;
+    bool ir_metrics = false;
+    bool cfg = false;
+    bool stats = false;
+    bool stats_json = false;
+    string trace_file = NULL;
+    string ir_file = NULL;
+    bool pass_stats = false;
+    bool pass_stats_json = false;
+    PM_reset();
+    for (int i = 2; i < argc; ++i) {
+        if (!strcmp(argv[i], "-p")) {
+            print_ast = true;
+        } else if (!strcmp(argv[i], "-j") && i + 1 < argc) {
+            jobs = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-r") && i + 1 < argc) {
+            edited_file = argv[++i];
+        } else if (!strcmp(argv[i], "--check-only")) {
+            check_only = true;
+        } else if (!strcmp(argv[i], "--ir-metrics")) {
+            ir_metrics = true;
+            quiet = true;
+        } else if (!strcmp(argv[i], "--cfg")) {
+            cfg = true;
+        } else if (!strcmp(argv[i], "--stats")) {
+            stats = true;
+        } else if (!strcmp(argv[i], "--stats=json")) {
+            stats = true;
+            stats_json = true;
+        } else if (!strncmp(argv[i], "--trace=", 8)) {
+            trace_file = argv[i] + 8;
+        } else if (!strncmp(argv[i], "--emit-ir=", 10)) {
+            ir_file = argv[i] + 10;
+        } else if (!strncmp(argv[i], "-j", 2)) {
+            jobs = atoi(argv[i] + 2);
+        } else if (!strcmp(argv[i], "--pass-stats")) {
+            pass_stats = true;
+        } else if (!strcmp(argv[i], "--pass-stats=json")) {
+            pass_stats = true;
+            pass_stats_json = true;
+        } else if (!pass_option(argv[i])) {
+            fprintf(stderr, "unknown option: %s\n", argv[i]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (ir_metrics && (print_ast || check_only)) {
+        fprintf(stderr, "--ir-metrics cannot be combined with -p or --check-only\n");
         exit(EXIT_FAILURE);
     }
-    A_Exp program = parse(argv[1]);
+    if (cfg && (check_only || ir_metrics)) {
+        fprintf(stderr, "--cfg cannot be combined with --check-only or --ir-metrics\n");
+        exit(EXIT_FAILURE);
+    }
+    if (ir_file && check_only) {
+        fprintf(stderr, "--emit-ir cannot be combined with --check-only\n");
+        exit(EXIT_FAILURE);
+    }
+    // The trace's heap counter reads the allocation statistics.
+    if (stats || trace_file) {
+        STAT_enable();
+    }
+    if (trace_file) {
+        TRACE_start();
+    }
+    begin_phase("parse");
+    bool readable;
+    A_Exp program = parse_file(argv[1], &readable);
+    if (!readable) {
+        fprintf(stderr, "%s: cannot be read\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    SEM_ExpType prog_exp_type;
     if (program) {
-        if (argc == 3 && !strcmp(argv[2], "-p")) {
+        if (print_ast) {
+                begin_phase("print AST");
                 puts("\nAbstract syntax:\n");
                 pr_exp(stdout, program, 0);
                 puts("\n");
         }
-        SEM_ExpType prog_exp_type = SEM_trans_prog(program);
-        if (prog_exp_type) {
-            printf("Type: %s\n", T_type_name(prog_exp_type->type));
-            P_print_ir(prog_exp_type->exp->u.function);
+        if (jobs > 1) {
+            PL_start(jobs);
+        }
+        begin_phase(check_only ? "check" : "semant");
+        if (edited_file) {
+            SEM_Cache cache = make_SEM_Cache(check_only);
+            SEM_recheck_prog(cache, program);
+            begin_phase("reparse");
+            program = parse_file(edited_file, &readable);
+            if (!readable) {
+                fprintf(stderr, "%s: cannot be read\n", edited_file);
+            }
+            if (program) {
+                begin_phase("recheck");
+                prog_exp_type = SEM_recheck_prog(cache, program);
+                int reused, checked;
+                SEM_cache_stats(cache, &reused, &checked);
+                fprintf(stderr, "Re-check: reused %d, checked %d top-level function bodies\n",
+                        reused, checked);
+            }
+        } else if (check_only) {
+            prog_exp_type = SEM_check_prog(program);
+        } else {
+            prog_exp_type = SEM_trans_prog(program);
+        }
+        if (jobs > 1) {
+            PL_stop();
+        }
+    }
+    // A failed reparse of the edited file also ends here.
+    if (program) {
+        TR_Function main_ = prog_exp_type.exp.kind == TR_FUNCTION
+            ? prog_exp_type.exp.u.function : NULL;
+        if (main_ && !EM_any_errors) {
+            begin_phase("optimize");
+            PM_run(main_);
+        }
+        if (ir_file && main_) {
+            begin_phase("emit IR");
+            if (!IRF_write(ir_file, main_, prog_exp_type.type)) {
+                fprintf(stderr, "Error: cannot write IR to %s\n", ir_file);
+            }
+        }
+        begin_phase("print");
+        if (ir_metrics) {
+            if (main_) {
+                IM_print_metrics(stdout, main_);
+            }
         } else {
-            puts("Type could not be established.");
+            print_program(main_, prog_exp_type.type, cfg);
         }
     }
-    else {
+    else if (readable) {
         fprintf(stderr, "Error: Parsing failed.\n");
     }
+    begin_phase(NULL);
+    if (trace_file && !TRACE_write(trace_file)) {
+        fprintf(stderr, "Error: cannot write trace to %s\n", trace_file);
+    }
+    if (stats) {
+        fflush(stdout);
+        STAT_print(stderr, stats_json);
+    }
+    if (pass_stats) {
+        fflush(stdout);
+        PM_print_stats(stderr, pass_stats_json);
+    }
     // puts("\nDone.");
-    return EXIT_SUCCESS;
+    return readable ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* Compile through the cache named by --cache=<dir>, if any.
+ * The key covers the input files' contents and every argument but -j,
+ * which does not change the output. Compiles that read standard input,
+ * report on their own run (--stats, --trace, --pass-stats) or write files besides
+ * their output (--emit-ir) bypass the cache.
+ */
+static int compile_cached(int argc, char ** argv) {
+    string cache_dir = NULL;
+    long max_bytes = CA_DEFAULT_MAX_BYTES;
+    int kept = 1;
+    for (int i = 1; i < argc; ++i) {
+        if (i >= 2 && !strncmp(argv[i], "--cache=", 8)) {
+            cache_dir = argv[i] + 8;
+        } else if (i >= 2 && !strncmp(argv[i], "--cache-size=", 13)) {
+            max_bytes = atol(argv[i] + 13) << 20;
+        } else {
+            argv[kept++] = argv[i];
+        }
+    }
+    argv[kept] = NULL;
+    argc = kept;
+    if (!cache_dir || argc < 2) {
+        return compile(argc, argv);
+    }
+    CA_Key key = make_CA_Key();
+    CA_add_string(key, argv[1]);
+    bool cacheable = strcmp(argv[1], "-") && CA_add_file(key, argv[1]);
+    for (int i = 2; i < argc && cacheable; ++i) {
+        if (!strcmp(argv[i], "-j") && i + 1 < argc) {
+            ++i;
+            continue;
+        }
+        if (!strncmp(argv[i], "-j", 2)) {
+            continue;
+        }
+        if (!strcmp(argv[i], "-r") && i + 1 < argc) {
+            cacheable = strcmp(argv[i + 1], "-") && CA_add_file(key, argv[i + 1]);
+        } else if (!strncmp(argv[i], "--stats", 7) || !strncmp(argv[i], "--trace=", 8)
+                || !strncmp(argv[i], "--emit-ir=", 10) || !strncmp(argv[i], "--pass-stats", 12)) {
+            cacheable = false;
+        }
+        CA_add_string(key, argv[i]);
+    }
+    if (!cacheable) {
+        return compile(argc, argv);
+    }
+    return CA_run(cache_dir, max_bytes, key, compile, argc, argv);
+}
+
+/* The incremental-check state of each watched file, by path. */
+static S_Table watched_files = NULL;
+
+/* Re-checks a watched file that has changed, reusing what it can
+ * from the file's previous check, and reports the result. Only the
+ * type is reported, so the file is checked without translating it. */
+static void recheck_file(string path, bool removed) {
+    S_Symbol key = make_S_Symbol(path);
+    SEM_Cache cache = S_look(watched_files, key);
+    if (removed) {
+        if (cache) {
+            S_enter(watched_files, key, NULL);
+            printf("%s: removed\n", path);
+            fflush(stdout);
+        }
+        return;
+    }
+    if (!cache) {
+        cache = make_SEM_Cache(true);
+        S_enter(watched_files, key, cache);
+    }
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    bool readable;
+    A_Exp program = parse_file(path, &readable);
+    if (!readable) {
+        printf("%s: cannot be read\n", path);
+        fflush(stdout);
+        return;
+    }
+    if (!program) {
+        printf("%s: parsing failed\n", path);
+        fflush(stdout);
+        return;
+    }
+    SEM_ExpType prog_exp_type = SEM_recheck_prog(cache, program);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    int reused, checked;
+    SEM_cache_stats(cache, &reused, &checked);
+    printf("%s: %s (%.1f ms; reused %d, checked %d function bodies)\n", path,
+            prog_exp_type.type ? T_type_name(prog_exp_type.type) : "type could not be established",
+            (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) * 1e-6,
+            reused, checked);
+    fflush(stdout);
+}
+
+int main(int argc, char ** argv) {
+    if (argc == 2 && !strncmp(argv[1], "--server=", 9)) {
+        SEM_prebuild_base_envs();
+        return SV_serve(argv[1] + 9, compile_cached);
+    }
+    if (argc == 2 && !strncmp(argv[1], "--watch=", 8)) {
+        quiet = true;
+        watched_files = S_empty();
+        return WA_watch(argv[1] + 8, recheck_file);
+    }
+    if (argc == 2 && !strcmp(argv[1], "--query")) {
+        quiet = true;
+        return QY_serve(stdin, stdout);
+    }
+    if (argc >= 2 && !strncmp(argv[1], "--load-ir=", 10)) {
+        bool cfg = false;
+        for (int i = 2; i < argc; ++i) {
+            if (!strcmp(argv[i], "--cfg")) {
+                cfg = true;
+            } else if (!pass_option(argv[i])) {
+                fprintf(stderr, "unknown option: %s\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+        }
+        T_Type type;
+        TR_Function main_ = IRF_load(argv[1] + 10, &type, stderr);
+        if (!main_) {
+            return EXIT_FAILURE;
+        }
+        print_program(main_, type, cfg);
+        return EXIT_SUCCESS;
+    }
+    if (argc == 2 && !strncmp(argv[1], "--cache-stats=", 14)) {
+        CA_print_stats(stdout, argv[1] + 14);
+        return EXIT_SUCCESS;
+    }
+    for (int i = 2; i < argc; ++i) {
+        if (!strncmp(argv[i], "--client=", 9)) {
+            string socket_path = argv[i] + 9;
+            // Forward the command without this option.
+            memmove(&argv[i], &argv[i + 1], (argc - i) * sizeof(*argv));
+            --argc;
+            int status = SV_forward(socket_path, argc, argv);
+            if (status >= 0) {
+                return status;
+            }
+            break;
+        }
+    }
+    return compile_cached(argc, argv);
 }
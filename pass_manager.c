@@ -0,0 +1,571 @@
+/*
+ * pass_manager.c -
+ * Implementation of the optimization pipeline.
+ * See pass_manager.h for more information.
+ */
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "alloc.h"
+#include "fold.h"
+#include "gvn.h"
+#include "inline.h"
+#include "ir_metrics.h"
+#include "pass_manager.h"
+#include "print_ir.h"
+#include "sccp.h"
+#include "simplify.h"
+#include "ssa.h"
+#include "stack.h"
+#include "trace.h"
+
+/* Every pass, in the order the pipeline runs them. */
+static const PM_Pass * const PM_pipeline[] = {
+    &FOLD_pass,
+    &SIMP_pass,
+    &INL_pass,
+    &AL_pass,
+    &SSA_build_pass,
+    &SCCP_pass,
+    &GVN_pass,
+    &SSA_destroy_pass,
+    NULL
+};
+
+#define PM_PASS_COUNT (sizeof(PM_pipeline) / sizeof(*PM_pipeline) - 1)
+/* An explicit order may name a pass more than once. */
+#define PM_MAX_ORDER 64
+
+typedef struct PM_Record_ {
+    bool disabled;
+    long runs;
+    double seconds;
+    long size_before;
+    long size_after;
+} PM_Record;
+
+static PM_Record PM_records[PM_PASS_COUNT + 1];
+static int PM_level = 0;
+/* The passes to run, by index in PM_pipeline, when given explicitly. */
+static int PM_order[PM_MAX_ORDER];
+static int PM_order_count = -1;
+static bool PM_verifying = false;
+
+void PM_reset() {
+    memset(PM_records, 0, sizeof(PM_records));
+    PM_level = 0;
+    PM_order_count = -1;
+    PM_verifying = false;
+}
+
+void PM_set_level(int level) {
+    PM_level = level;
+}
+
+static int PM_find(string name, int length) {
+    for (int i = 0; i < (int) PM_PASS_COUNT; ++i) {
+        if ((int) strlen(PM_pipeline[i]->name) == length
+                && !strncmp(PM_pipeline[i]->name, name, length)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool PM_disable(string name) {
+    int i = PM_find(name, strlen(name));
+    if (i < 0) {
+        return false;
+    }
+    PM_records[i].disabled = true;
+    return true;
+}
+
+bool PM_set_order(string names) {
+    int order[PM_MAX_ORDER];
+    int count = 0;
+    for (string name = names; *name; ) {
+        int length = strcspn(name, ",");
+        int i = PM_find(name, length);
+        if (i < 0 || count == PM_MAX_ORDER) {
+            return false;
+        }
+        order[count++] = i;
+        name += length;
+        if (*name == ',') {
+            ++name;
+        }
+    }
+    memcpy(PM_order, order, count * sizeof(*order));
+    PM_order_count = count;
+    return true;
+}
+
+bool PM_enable_verification() {
+#ifdef NDEBUG
+    return false;
+#else
+    PM_verifying = true;
+    return true;
+#endif
+}
+
+/* The pipeline index of the nth pass to run, or -1 past the last. */
+static int PM_nth(int n) {
+    if (PM_order_count >= 0) {
+        return n < PM_order_count ? PM_order[n] : -1;
+    }
+    return n < (int) PM_PASS_COUNT ? n : -1;
+}
+
+static bool PM_active(int i) {
+    return !PM_records[i].disabled && (PM_order_count >= 0 || PM_pipeline[i]->level <= PM_level);
+}
+
+static double PM_now() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+/* Verification */
+
+typedef struct PM_Verifier_ {
+    TR_Function func;
+    FILE * errors;
+    int problems;
+    /* The skip labels of the enclosing loops. */
+    TR_Label * loops;
+    int loop_count;
+    int loop_capacity;
+} PM_Verifier;
+
+static void PM_verify_exp(PM_Verifier * verifier, TR_Exp exp);
+static void PM_verify_stm(PM_Verifier * verifier, TR_Stm stm);
+
+static void PM_report(PM_Verifier * verifier, string message, ...) {
+    va_list ap;
+    fprintf(verifier->errors, "%s: ", S_name(verifier->func->name));
+    va_start(ap, message);
+    vfprintf(verifier->errors, message, ap);
+    va_end(ap);
+    fputc('\n', verifier->errors);
+    ++verifier->problems;
+}
+
+static void PM_verify_label(PM_Verifier * verifier, TR_Label label) {
+    if (label < 0 || label >= verifier->func->label_count) {
+        PM_report(verifier, "label L%d out of range", label);
+    }
+}
+
+/* A location, as assigned to or loaded by a VAR. */
+static void PM_verify_location(PM_Verifier * verifier, TR_Exp exp) {
+    if (exp && exp->kind != TR_MEM_EXP && exp->kind != TR_FIELD_EXP
+            && exp->kind != TR_SUBSCRIPT_EXP) {
+        PM_report(verifier, "%s used as a location", P_exp_names[exp->kind]);
+    }
+    PM_verify_exp(verifier, exp);
+}
+
+/* The frame slot of a record or array, unless it is on the heap. */
+static void PM_verify_slot(PM_Verifier * verifier, TR_Exp exp, int offset) {
+    if (offset != -1 && (offset < exp->size || !verifier->func->frame
+                || offset > verifier->func->frame->end)) {
+        PM_report(verifier, "%s of %d bytes at frame offset %d", P_exp_names[exp->kind],
+                exp->size, offset);
+    }
+}
+
+static void PM_verify_exps(PM_Verifier * verifier, TR_ExpList exps) {
+    if (exps && (exps->length < 1 || exps->length > exps->capacity)) {
+        PM_report(verifier, "expression list of length %d and capacity %d",
+                exps->length, exps->capacity);
+        return;
+    }
+    for (int i = 0, n = TR_exp_count(exps); i < n; ++i) {
+        PM_verify_exp(verifier, exps->items[i]);
+    }
+}
+
+static void PM_verify_stms(PM_Verifier * verifier, TR_StmList stms) {
+    if (stms && (stms->length < 1 || stms->length > stms->capacity)) {
+        PM_report(verifier, "statement list of length %d and capacity %d",
+                stms->length, stms->capacity);
+        return;
+    }
+    for (int i = 0, n = TR_stm_count(stms); i < n; ++i) {
+        PM_verify_stm(verifier, stms->items[i]);
+    }
+}
+
+/* A call of PM_verify_exp or PM_verify_stm continued on a new stack segment. */
+typedef struct PM_DeepCall_ {
+    PM_Verifier * verifier;
+    TR_Exp exp;
+    TR_Stm stm;
+} PM_DeepCall;
+
+static void PM_run_deep_call(void * arg) {
+    PM_DeepCall * call = arg;
+    if (call->stm) {
+        PM_verify_stm(call->verifier, call->stm);
+    } else {
+        PM_verify_exp(call->verifier, call->exp);
+    }
+}
+
+static void PM_verify_exp(PM_Verifier * verifier, TR_Exp exp) {
+    if (!exp) {
+        PM_report(verifier, "missing expression");
+        return;
+    }
+    if (ST_low()) {
+        PM_DeepCall call = { verifier, exp, NULL };
+        ST_call(PM_run_deep_call, &call);
+        return;
+    }
+    if (exp->kind < TR_NUM_EXP || exp->kind > TR_SEQ_EXP) {
+        PM_report(verifier, "unknown expression kind %d", exp->kind);
+        return;
+    }
+    if (exp->reg < -1 || exp->reg >= verifier->func->temp_count) {
+        PM_report(verifier, "%s has temp t%d out of range", P_exp_names[exp->kind], exp->reg);
+    }
+    if (exp->size < 0) {
+        PM_report(verifier, "%s has size %d", P_exp_names[exp->kind], exp->size);
+    }
+    switch (exp->kind) {
+        case TR_NUM_EXP:
+            break;
+        case TR_STRING_EXP:
+            if (!exp->u.str.str) {
+                PM_report(verifier, "string_exp has no text");
+            }
+            PM_verify_label(verifier, exp->u.str.label);
+            break;
+        case TR_MEM_EXP:
+            if (!exp->u.mem.name || (exp->u.mem.offset < 0 && exp->reg < 0)) {
+                PM_report(verifier, "mem_exp has no name or a negative offset");
+            }
+            if (exp->reg >= 0 && verifier->func->frame
+                    && exp->u.mem.nesting_level != verifier->func->frame->nesting_level) {
+                PM_report(verifier, "mem_exp in temp t%d belongs to nesting level %d",
+                        exp->reg, exp->u.mem.nesting_level);
+            }
+            break;
+        case TR_VAR_EXP:
+            PM_verify_location(verifier, exp->u.var);
+            break;
+        case TR_FIELD_EXP:
+            PM_verify_exp(verifier, exp->u.field.var);
+            if (exp->u.field.field_offset < 0) {
+                PM_report(verifier, "field_exp has a negative offset");
+            }
+            break;
+        case TR_SUBSCRIPT_EXP:
+            PM_verify_exp(verifier, exp->u.subscript.var);
+            PM_verify_exp(verifier, exp->u.subscript.index);
+            break;
+        case TR_RECORD_EXP:
+            PM_verify_exps(verifier, exp->u.record.fields);
+            PM_verify_slot(verifier, exp, exp->u.record.offset);
+            break;
+        case TR_ARRAY_EXP:
+            PM_verify_exp(verifier, exp->u.array.init);
+            PM_verify_slot(verifier, exp, exp->u.array.offset);
+            break;
+        case TR_ARITH_OP_EXP:
+            if (exp->u.arith.op < A_PLUS_OP || exp->u.arith.op > A_TIMES_OP) {
+                PM_report(verifier, "arith_op_exp with operator %d", exp->u.arith.op);
+            }
+            PM_verify_exp(verifier, exp->u.arith.left);
+            PM_verify_exp(verifier, exp->u.arith.right);
+            break;
+        case TR_DIV_OP_EXP:
+            PM_verify_exp(verifier, exp->u.div.left);
+            PM_verify_exp(verifier, exp->u.div.right);
+            break;
+        case TR_REL_OP_EXP:
+            if (exp->u.rel.op < A_EQ_OP || exp->u.rel.op > A_OR_OP) {
+                PM_report(verifier, "rel_op_exp with operator %d", exp->u.rel.op);
+            }
+            PM_verify_exp(verifier, exp->u.rel.left);
+            PM_verify_exp(verifier, exp->u.rel.right);
+            break;
+        case TR_IF_EXP:
+            PM_verify_exp(verifier, exp->u.if_.test);
+            PM_verify_exp(verifier, exp->u.if_.true_branch);
+            PM_verify_label(verifier, exp->u.if_.false_label);
+            break;
+        case TR_IF_ELSE_EXP:
+            PM_verify_exp(verifier, exp->u.if_else.test);
+            PM_verify_exp(verifier, exp->u.if_else.true_branch);
+            PM_verify_exp(verifier, exp->u.if_else.false_branch);
+            PM_verify_label(verifier, exp->u.if_else.false_label);
+            PM_verify_label(verifier, exp->u.if_else.join_label);
+            break;
+        case TR_FCALL_EXP:
+            if (!exp->u.fcall.name) {
+                PM_report(verifier, "fcall_exp has no name");
+            }
+            PM_verify_exps(verifier, exp->u.fcall.args);
+            break;
+        case TR_SEQ_EXP:
+            PM_verify_stms(verifier, exp->u.seq);
+            break;
+    }
+}
+
+static void PM_verify_loop_body(PM_Verifier * verifier, TR_Label skip_label, TR_Stm body) {
+    if (verifier->loop_count == verifier->loop_capacity) {
+        int capacity = verifier->loop_capacity ? 2 * verifier->loop_capacity : 8;
+        TR_Label * loops = malloc_checked(capacity * sizeof(*loops));
+        memcpy(loops, verifier->loops, verifier->loop_count * sizeof(*loops));
+        free(verifier->loops);
+        verifier->loops = loops;
+        verifier->loop_capacity = capacity;
+    }
+    verifier->loops[verifier->loop_count++] = skip_label;
+    PM_verify_stm(verifier, body);
+    --verifier->loop_count;
+}
+
+static void PM_verify_stm(PM_Verifier * verifier, TR_Stm stm) {
+    if (!stm) {
+        PM_report(verifier, "missing statement");
+        return;
+    }
+    if (ST_low()) {
+        PM_DeepCall call = { verifier, NULL, stm };
+        ST_call(PM_run_deep_call, &call);
+        return;
+    }
+    switch (stm->kind) {
+        case TR_ASSIGN_STM:
+            PM_verify_location(verifier, stm->u.assign.var);
+            PM_verify_exp(verifier, stm->u.assign.value);
+            break;
+        case TR_PCALL_STM:
+            if (!stm->u.pcall.name) {
+                PM_report(verifier, "pcall_stm has no name");
+            }
+            PM_verify_exps(verifier, stm->u.pcall.args);
+            break;
+        case TR_SEQ_STM:
+            PM_verify_stms(verifier, stm->u.seq);
+            break;
+        case TR_IF_STM:
+            PM_verify_exp(verifier, stm->u.if_.test);
+            PM_verify_stm(verifier, stm->u.if_.true_branch);
+            PM_verify_label(verifier, stm->u.if_.false_label);
+            break;
+        case TR_IF_ELSE_STM:
+            PM_verify_exp(verifier, stm->u.if_else.test);
+            PM_verify_stm(verifier, stm->u.if_else.true_branch);
+            PM_verify_stm(verifier, stm->u.if_else.false_branch);
+            PM_verify_label(verifier, stm->u.if_else.false_label);
+            PM_verify_label(verifier, stm->u.if_else.join_label);
+            break;
+        case TR_WHILE_STM:
+            PM_verify_label(verifier, stm->u.while_.test_label);
+            PM_verify_label(verifier, stm->u.while_.skip_label);
+            PM_verify_exp(verifier, stm->u.while_.test);
+            PM_verify_loop_body(verifier, stm->u.while_.skip_label, stm->u.while_.body);
+            break;
+        case TR_FOR_STM:
+            PM_verify_label(verifier, stm->u.for_.test_label);
+            PM_verify_label(verifier, stm->u.for_.skip_label);
+            PM_verify_exp(verifier, stm->u.for_.var);
+            PM_verify_exp(verifier, stm->u.for_.lo);
+            PM_verify_exp(verifier, stm->u.for_.hi);
+            PM_verify_loop_body(verifier, stm->u.for_.skip_label, stm->u.for_.body);
+            break;
+        case TR_BREAK_STM:
+            {
+                int i = verifier->loop_count - 1;
+                while (i >= 0 && verifier->loops[i] != stm->u.break_) {
+                    --i;
+                }
+                if (i < 0) {
+                    PM_report(verifier, "break to L%d outside its loop", stm->u.break_);
+                }
+                break;
+            }
+        case TR_EXP_STM:
+            PM_verify_exp(verifier, stm->u.exp);
+            break;
+        default:
+            PM_report(verifier, "unknown statement kind %d", stm->kind);
+            break;
+    }
+}
+
+bool PM_verify_function(TR_Function func, FILE * errors) {
+    PM_Verifier verifier = { func, errors, 0, NULL, 0, 0 };
+    if (!func->frame) {
+        PM_report(&verifier, "no frame");
+    }
+    PM_verify_stms(&verifier, func->body);
+    free(verifier.loops);
+    return !verifier.problems;
+}
+
+/* Running */
+
+/* Append func and the functions nested in it to functions, in the
+ * order P_print_ir prints them; returns the new count. */
+static int PM_collect(TR_Function func, TR_Function ** functions, int count, int * capacity) {
+    if (count == *capacity) {
+        *capacity = *capacity ? 2 * *capacity : 64;
+        TR_Function * grown = malloc_checked(*capacity * sizeof(*grown));
+        memcpy(grown, *functions, count * sizeof(*grown));
+        free(*functions);
+        *functions = grown;
+    }
+    (*functions)[count++] = func;
+    for (TR_FunctionList children = func->children; children; children = children->tail) {
+        count = PM_collect(children->head, functions, count, capacity);
+    }
+    return count;
+}
+
+static void PM_check(string pass, TR_Function func) {
+    if (PM_verifying && !PM_verify_function(func, stderr)) {
+        fprintf(stderr, "IR verification failed in %s after %s\n", S_name(func->name), pass);
+        exit(EXIT_FAILURE);
+    }
+}
+
+static long PM_program_size(TR_Function * functions, int count) {
+    long size = 0;
+    for (int i = 0; i < count; ++i) {
+        size += IM_function_size(functions[i]);
+    }
+    return size;
+}
+
+void PM_run(TR_Function main_) {
+    TR_Function * functions = NULL;
+    int capacity = 0;
+    int count = PM_collect(main_, &functions, 0, &capacity);
+    for (int i = 0; i < count; ++i) {
+        PM_check("translation", functions[i]);
+    }
+    for (int n = 0; PM_nth(n) >= 0; ) {
+        int first = PM_nth(n);
+        const PM_Pass * pass = PM_pipeline[first];
+        if (!PM_active(first) || pass->run_graph) {
+            ++n;
+            continue;
+        }
+        if (pass->run_program) {
+            PM_Record * record = &PM_records[first];
+            record->size_before += PM_program_size(functions, count);
+            TRACE_begin(pass->name, "pass");
+            double start = PM_now();
+            pass->run_program(main_);
+            record->seconds += PM_now() - start;
+            TRACE_end();
+            ++record->runs;
+            // The pass may have added or deleted functions.
+            count = PM_collect(main_, &functions, 0, &capacity);
+            record->size_after += PM_program_size(functions, count);
+            for (int i = 0; i < count; ++i) {
+                PM_check(pass->name, functions[i]);
+            }
+            ++n;
+            continue;
+        }
+        // Run this and the function passes right after it on each function in turn.
+        int end = n;
+        while (PM_nth(end) >= 0 && (!PM_active(PM_nth(end)) || PM_pipeline[PM_nth(end)]->run_function)) {
+            ++end;
+        }
+        for (int i = 0; i < count; ++i) {
+            TR_Function func = functions[i];
+            TRACE_begin(S_name(func->name), "optimize");
+            for (int m = n; m < end; ++m) {
+                int index = PM_nth(m);
+                if (!PM_active(index)) {
+                    continue;
+                }
+                PM_Record * record = &PM_records[index];
+                record->size_before += IM_function_size(func);
+                double start = PM_now();
+                PM_pipeline[index]->run_function(func);
+                record->seconds += PM_now() - start;
+                ++record->runs;
+                record->size_after += IM_function_size(func);
+                PM_check(PM_pipeline[index]->name, func);
+            }
+            TRACE_end();
+        }
+        n = end;
+    }
+    free(functions);
+}
+
+static long PM_graph_size(CFG_Graph graph) {
+    long size = 0;
+    for (int i = 0; i < graph->block_count; ++i) {
+        size += graph->blocks[i]->instr_count + 1;
+    }
+    return size;
+}
+
+void PM_run_graphs(CFG_GraphList graphs) {
+    for (int n = 0; PM_nth(n) >= 0; ++n) {
+        int index = PM_nth(n);
+        const PM_Pass * pass = PM_pipeline[index];
+        if (!PM_active(index) || !pass->run_graph) {
+            continue;
+        }
+        PM_Record * record = &PM_records[index];
+        for (CFG_GraphList g = graphs; g; g = g->tail) {
+            record->size_before += PM_graph_size(g->head);
+            double start = PM_now();
+            pass->run_graph(g->head);
+            record->seconds += PM_now() - start;
+            ++record->runs;
+            record->size_after += PM_graph_size(g->head);
+            if (PM_verifying && !CFG_verify(g->head, stderr)) {
+                fprintf(stderr, "CFG verification failed in %s after %s\n",
+                        S_name(g->head->func->name), pass->name);
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+}
+
+void PM_print_stats(FILE * out, bool json) {
+    if (json) {
+        fprintf(out, "{\"level\": %d, \"passes\": [", PM_level);
+    } else {
+        fprintf(out, "%-16s %8s %12s %12s %12s\n", "pass", "runs", "time (ms)", "size before",
+                "size after");
+    }
+    bool first = true;
+    for (int i = 0; i < (int) PM_PASS_COUNT; ++i) {
+        PM_Record * record = &PM_records[i];
+        if (!record->runs) {
+            continue;
+        }
+        if (json) {
+            fprintf(out, "%s{\"name\": \"%s\", \"runs\": %ld, \"ms\": %.3f, "
+                    "\"size_before\": %ld, \"size_after\": %ld}",
+                    first ? "" : ", ", PM_pipeline[i]->name, record->runs,
+                    record->seconds * 1e3, record->size_before, record->size_after);
+        } else {
+            fprintf(out, "%-16s %8ld %12.3f %12ld %12ld\n", PM_pipeline[i]->name, record->runs,
+                    record->seconds * 1e3, record->size_before, record->size_after);
+        }
+        first = false;
+    }
+    if (json) {
+        fprintf(out, "]}\n");
+    }
+}
@@ -0,0 +1,68 @@
+/*
+ * pass_manager.h -
+ * The optimization pipeline between translation and printing.
+ * Each pass rewrites the IR in place: one function's TR IR at a time,
+ * the whole program's (for passes that add or delete functions),
+ * or one function's control-flow graph once the graphs are built.
+ * Passes run in pipeline order; consecutive function passes run
+ * back to back on each function before moving to the next, so each
+ * function's IR is walked while it is still in cache.
+ * The -O level selects the passes whose level it reaches; any pass
+ * can then be switched off by name, or an explicit order given.
+ * Every run of a pass records its time and the size of the IR
+ * before and after. In builds without NDEBUG, the IR can be verified
+ * after every pass, naming the pass that broke it.
+ * All types and functions declared in this module begin with "PM_".
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "cfg.h"
+#include "translate.h"
+#include "util.h"
+
+#define PM_MAX_LEVEL 2
+
+typedef struct PM_Pass_ {
+    /* Used in -fno-<name>, -fpasses=<names> and the statistics. */
+    string name;
+    /* The lowest -O level that runs the pass. */
+    int level;
+    /* Exactly one is set. */
+    void (*run_function)(TR_Function func);
+    void (*run_program)(TR_Function main_);
+    void (*run_graph)(CFG_Graph graph);
+} PM_Pass;
+
+/* Forget the options and statistics of an earlier compile. */
+void PM_reset();
+
+/* Run the passes whose level is at most level (0 runs none). */
+void PM_set_level(int level);
+
+/* Skip the named pass; false if there is no such pass. */
+bool PM_disable(string name);
+
+/* Run exactly the comma-separated passes, in that order, whatever
+ * the level; false, leaving the order alone, if one is unknown. */
+bool PM_set_order(string names);
+
+/* Verify the IR after each pass; false if this build cannot. */
+bool PM_enable_verification();
+
+/* Run the TR passes over main_ and every function nested in it. */
+void PM_run(TR_Function main_);
+
+/* Run the graph passes over each graph. */
+void PM_run_graphs(CFG_GraphList graphs);
+
+/* Check the structural invariants of func's TR IR, reporting each
+ * violation to errors; true if there are none. */
+bool PM_verify_function(TR_Function func, FILE * errors);
+
+/* Print each pass that ran, with its runs, time and IR size before
+ * and after, as a table or as JSON. */
+void PM_print_stats(FILE * out, bool json);
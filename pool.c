@@ -0,0 +1,168 @@
+/*
+ * pool.c -
+ * Implementation of the work-stealing thread pool.
+ * See pool.h for more information.
+ * The deques are guarded by one mutex each; tasks here are
+ * whole function bodies, so contention on them is negligible.
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pool.h"
+#include "util.h"
+
+#define PL_MAX_WORKERS 64
+#define PL_INITIAL_CAPACITY 16
+
+struct PL_Task_ {
+    void (*run)(void *);
+    void * arg;
+    int done;
+};
+
+typedef struct PL_Deque_ * PL_Deque;
+
+struct PL_Deque_ {
+    pthread_mutex_t lock;
+    PL_Task * tasks;
+    int capacity;
+    int top;
+    int bottom;
+};
+
+static struct PL_Deque_ deques[PL_MAX_WORKERS];
+static pthread_t threads[PL_MAX_WORKERS];
+static int worker_count = 0;
+static int stopping = 0;
+static __thread int worker_id = 0;
+
+static void PL_push(PL_Deque deque, PL_Task task) {
+    pthread_mutex_lock(&deque->lock);
+    if (deque->bottom - deque->top == deque->capacity) {
+        PL_Task * tasks = malloc_checked(2 * deque->capacity * sizeof(*tasks));
+        for (int i = deque->top; i < deque->bottom; ++i) {
+            tasks[i % (2 * deque->capacity)] = deque->tasks[i % deque->capacity];
+        }
+        free(deque->tasks);
+        deque->tasks = tasks;
+        deque->capacity *= 2;
+    }
+    deque->tasks[deque->bottom % deque->capacity] = task;
+    ++deque->bottom;
+    pthread_mutex_unlock(&deque->lock);
+}
+
+/* Take the newest task from the owner's end. */
+static PL_Task PL_pop(PL_Deque deque) {
+    PL_Task task = NULL;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->bottom > deque->top) {
+        --deque->bottom;
+        task = deque->tasks[deque->bottom % deque->capacity];
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return task;
+}
+
+/* Take the oldest task from the thief's end. */
+static PL_Task PL_steal(PL_Deque deque) {
+    PL_Task task = NULL;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->bottom > deque->top) {
+        task = deque->tasks[deque->top % deque->capacity];
+        ++deque->top;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return task;
+}
+
+static PL_Task PL_find_task() {
+    PL_Task task = PL_pop(&deques[worker_id]);
+    for (int i = 1; !task && i < worker_count; ++i) {
+        task = PL_steal(&deques[(worker_id + i) % worker_count]);
+    }
+    return task;
+}
+
+static void PL_run(PL_Task task) {
+    task->run(task->arg);
+    __atomic_store_n(&task->done, 1, __ATOMIC_RELEASE);
+}
+
+static void * PL_worker(void * arg) {
+    worker_id = (int) (long) arg;
+    while (!__atomic_load_n(&stopping, __ATOMIC_ACQUIRE)) {
+        PL_Task task = PL_find_task();
+        if (task) {
+            PL_run(task);
+        } else {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+void PL_start(int workers) {
+    if (workers > PL_MAX_WORKERS) {
+        workers = PL_MAX_WORKERS;
+    }
+    if (workers < 1) {
+        workers = 1;
+    }
+    worker_count = workers;
+    stopping = 0;
+    worker_id = 0;
+    for (int i = 0; i < worker_count; ++i) {
+        pthread_mutex_init(&deques[i].lock, NULL);
+        deques[i].capacity = PL_INITIAL_CAPACITY;
+        deques[i].tasks = malloc_checked(PL_INITIAL_CAPACITY * sizeof(PL_Task));
+        deques[i].top = 0;
+        deques[i].bottom = 0;
+    }
+    for (int i = 1; i < worker_count; ++i) {
+        if (pthread_create(&threads[i], NULL, PL_worker, (void *) (long) i)) {
+            perror("Cannot start worker thread");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+void PL_stop() {
+    __atomic_store_n(&stopping, 1, __ATOMIC_RELEASE);
+    for (int i = 1; i < worker_count; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    for (int i = 0; i < worker_count; ++i) {
+        free(deques[i].tasks);
+        pthread_mutex_destroy(&deques[i].lock);
+    }
+    worker_count = 0;
+}
+
+bool PL_active() {
+    return worker_count > 1;
+}
+
+PL_Task PL_spawn(void (*run)(void *), void * arg) {
+    PL_Task task = malloc_checked(sizeof(*task));
+    task->run = run;
+    task->arg = arg;
+    task->done = 0;
+    PL_push(&deques[worker_id], task);
+    return task;
+}
+
+void PL_join(PL_Task task) {
+    while (!__atomic_load_n(&task->done, __ATOMIC_ACQUIRE)) {
+        PL_Task other = PL_find_task();
+        if (other) {
+            PL_run(other);
+        } else {
+            sched_yield();
+        }
+    }
+    free(task);
+}
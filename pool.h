@@ -0,0 +1,33 @@
+/*
+ * pool.h -
+ * A small work-stealing thread pool.
+ * Each worker owns a deque of tasks: it pushes and pops
+ * at the bottom of its own deque and steals from the top
+ * of the others' when it runs dry.
+ * The thread that calls PL_start becomes worker 0;
+ * a thread waiting in PL_join runs other tasks meanwhile,
+ * so tasks may spawn and join tasks of their own.
+ * All types and functions declared in this module begin with "PL_".
+ */
+
+#pragma once
+
+#include <stdbool.h>
+
+typedef struct PL_Task_ * PL_Task;
+
+/* Start a pool of the given number of workers (including the caller). */
+void PL_start(int workers);
+
+/* Stop and join the helper threads. */
+void PL_stop();
+
+/* True between PL_start and PL_stop when there are helper threads. */
+bool PL_active();
+
+/* Queue run(arg) on the calling worker's deque. */
+PL_Task PL_spawn(void (*run)(void *), void * arg);
+
+/* Wait until the task has run, running other queued tasks meanwhile.
+ * Frees the task. */
+void PL_join(PL_Task task);
@@ -10,6 +10,7 @@
 #include <stdio.h>
 #include "absyn.h"  /* abstract syntax data structures */
 #include "prabsyn.h" /* function prototype */
+#include "stack.h" /* segmented-stack fallback */
 #include "symbol.h" /* symbol table data structures */
 #include "util.h"
 
@@ -32,8 +33,30 @@ static void indent(FILE * out, int d) {
     for (int i = 0; i <= d; i++) fprintf(out, " ");
 }
 
+/* A call of pr_exp or pr_var continued on a new stack segment. */
+struct deep_call {
+    FILE * out;
+    A_Exp exp;
+    A_Var var;
+    int d;
+};
+
+static void run_deep_call(void * arg) {
+    struct deep_call * call = arg;
+    if (call->var) {
+        pr_var(call->out, call->var, call->d);
+    } else {
+        pr_exp(call->out, call->exp, call->d);
+    }
+}
+
 /* Print A_Var types. Indent d spaces. */
 static void pr_var(FILE * out, A_Var v, int d) {
+    if (ST_low()) {
+        struct deep_call call = { out, NULL, v, d };
+        ST_call(run_deep_call, &call);
+        return;
+    }
     indent(out, d);
     switch (v->kind) {
         case A_SIMPLE_VAR:
@@ -70,6 +93,11 @@ void pr_oper(FILE * out, A_Oper d) {
 
 /* Print A_Var types. Indent d spaces. */
 void pr_exp(FILE * out, A_Exp v, int d) {
+    if (ST_low()) {
+        struct deep_call call = { out, v, NULL, d };
+        ST_call(run_deep_call, &call);
+        return;
+    }
     indent(out, d);
     switch (v->kind) {
         case A_VAR_EXP:
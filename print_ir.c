@@ -10,6 +10,8 @@
 #include <stdio.h>
 
 #include "print_ir.h"
+#include "stack.h"
+#include "trace.h"
 
 #define OFFSET 2
 
@@ -58,6 +60,11 @@ const char * P_op_names[] = {
     "or_op"
 };
 
+/* The function being printed, whose name qualifies its temps and labels,
+ * as in "f.t3" and "f.L2". */
+static string function_name;
+
+void P_print_exp(TR_Exp exp, int offset);
 void P_print_exp_list(TR_ExpList exp_list, int offset);
 void P_print_stm(TR_Stm stm, int offset);
 
@@ -72,10 +79,43 @@ void P_print_name(S_Symbol name, int offset) {
     printf("%s\n", S_name(name));
 }
 
+/* Where a record or array is placed, if not on the heap. */
+static void P_print_slot(int slot, int offset) {
+    if (slot >= 0) {
+        indent(offset);
+        printf("Frame offset: %d\n", slot);
+    }
+}
+
+/* A call of P_print_exp or P_print_stm continued on a new stack segment. */
+typedef struct P_DeepCall_ {
+    TR_Exp exp;
+    TR_Stm stm;
+    int offset;
+} P_DeepCall;
+
+static void P_run_deep_call(void * arg) {
+    P_DeepCall * call = arg;
+    if (call->stm) {
+        P_print_stm(call->stm, call->offset);
+    } else {
+        P_print_exp(call->exp, call->offset);
+    }
+}
+
 void P_print_exp(TR_Exp exp, int offset) {
+    if (ST_low()) {
+        P_DeepCall call = { exp, NULL, offset };
+        ST_call(P_run_deep_call, &call);
+        return;
+    }
     indent(offset); 
-    printf("%s - reg: %d - size: %d\n",
-            P_exp_names[exp->kind], exp->reg, exp->size);
+    if (exp->reg >= 0) {
+        printf("%s - reg: %s.t%d - size: %d\n",
+                P_exp_names[exp->kind], function_name, exp->reg, exp->size);
+    } else {
+        printf("%s - reg: none - size: %d\n", P_exp_names[exp->kind], exp->size);
+    }
     switch (exp->kind) {
         case TR_NUM_EXP:
             {
@@ -86,14 +126,19 @@ void P_print_exp(TR_Exp exp, int offset) {
         case TR_STRING_EXP:
             {
                 indent(offset + OFFSET);
-                printf("%d: %s\n",
-                        exp->u.str.label, exp->u.str.str);
+                printf("%s.L%d: %s\n",
+                        function_name, exp->u.str.label, exp->u.str.str);
                 break;
 
             }
         case TR_MEM_EXP:
             {
                 indent(offset + OFFSET);
+                if (exp->reg >= 0) {
+                    printf("%s - nesting: %d - in temp\n",
+                            S_name(exp->u.mem.name), exp->u.mem.nesting_level);
+                    break;
+                }
                 printf(
                         "%s - nesting: %d - offset: %d\n",
                         S_name(exp->u.mem.name),
@@ -123,14 +168,16 @@ void P_print_exp(TR_Exp exp, int offset) {
             }
         case TR_RECORD_EXP:
             {
-                P_print_exp_list(exp->u.record, offset + OFFSET);
+                P_print_exp_list(exp->u.record.fields, offset + OFFSET);
+                P_print_slot(exp->u.record.offset, offset + OFFSET);
                 break;
             }
         case TR_ARRAY_EXP:
             {
                 indent(offset + OFFSET);
                 printf("Initializer:\n");
-                P_print_exp(exp->u.array, offset + 2 * OFFSET);
+                P_print_exp(exp->u.array.init, offset + 2 * OFFSET);
+                P_print_slot(exp->u.array.offset, offset + OFFSET);
                 break;
             }
         case TR_ARITH_OP_EXP:
@@ -164,9 +211,12 @@ void P_print_exp(TR_Exp exp, int offset) {
         case TR_SEQ_EXP:
             {
                 TR_StmList stms = exp->u.seq;
-                P_print_stm(stms->head, offset + OFFSET);
-                for (TR_StmList stms = exp->u.seq; stms; stms = stms->tail) {
-                    P_print_stm(stms->head, offset + OFFSET);
+                // An empty sequence prints nothing.
+                if (!stms) {
+                    break;
+                }
+                for (int i = 0; i < stms->length; ++i) {
+                    P_print_stm(stms->items[i], offset + OFFSET);
                 }
                 break;
             }
@@ -176,17 +226,22 @@ void P_print_exp(TR_Exp exp, int offset) {
 }
 
 void P_print_exp_list(TR_ExpList exp_list, int offset) {
-    for (TR_ExpList exps = exp_list; exps; exps = exps->tail) {
-        P_print_exp(exps->head, offset);
+    for (int i = 0, n = TR_exp_count(exp_list); i < n; ++i) {
+        P_print_exp(exp_list->items[i], offset);
     }
 }
 
 void P_print_label(string name, TR_Label label, int offset) {
     indent(offset);
-    printf("%s - %d:\n", name, label);
+    printf("%s - %s.L%d:\n", name, function_name, label);
 }
 
 void P_print_stm(TR_Stm stm, int offset) {
+    if (ST_low()) {
+        P_DeepCall call = { NULL, stm, offset };
+        ST_call(P_run_deep_call, &call);
+        return;
+    }
     indent(offset); 
     printf("%s\n", P_stm_names[stm->kind]);
     switch (stm->kind) {
@@ -205,9 +260,12 @@ void P_print_stm(TR_Stm stm, int offset) {
         case TR_SEQ_STM:
             {
                 TR_StmList stms = stm->u.seq;
-                P_print_stm(stms->head, offset + OFFSET);
-                for (TR_StmList stms = stm->u.seq; stms; stms = stms->tail) {
-                    P_print_stm(stms->head, offset + OFFSET);
+                // An empty sequence prints nothing.
+                if (!stms) {
+                    break;
+                }
+                for (int i = 0; i < stms->length; ++i) {
+                    P_print_stm(stms->items[i], offset + OFFSET);
                 }
                 break;
             }
@@ -218,7 +276,7 @@ void P_print_stm(TR_Stm stm, int offset) {
                 puts("True:");
                 P_print_stm(stm->u.if_.true_branch, offset + 2 * OFFSET);
                 indent(offset + OFFSET);
-                printf("Skip: %d\n", stm->u.if_.false_label);
+                printf("Skip: %s.L%d\n", function_name, stm->u.if_.false_label);
                 break;
             }
         case TR_IF_ELSE_STM:
@@ -228,20 +286,20 @@ void P_print_stm(TR_Stm stm, int offset) {
                 puts("True:");
                 P_print_stm(stm->u.if_else.true_branch, offset + 2 * OFFSET);
                 indent(offset + OFFSET);
-                printf("False - %d:\n", stm->u.if_else.false_label);
+                printf("False - %s.L%d:\n", function_name, stm->u.if_else.false_label);
                 P_print_stm(stm->u.if_else.false_branch, offset + 2 * OFFSET);
                 indent(offset + OFFSET);
-                printf("Join: %d\n", stm->u.if_else.join_label);
+                printf("Join: %s.L%d\n", function_name, stm->u.if_else.join_label);
                 break;
             }
         case TR_WHILE_STM:
             {
                 indent(offset + OFFSET);
-                printf("Test - %d:\n", stm->u.while_.test_label);
+                printf("Test - %s.L%d:\n", function_name, stm->u.while_.test_label);
                 P_print_exp(stm->u.while_.test, offset + 2 * OFFSET);
                 P_print_stm(stm->u.while_.body, offset + OFFSET);
                 indent(offset + OFFSET);
-                printf("Skip: %d\n", stm->u.while_.skip_label);
+                printf("Skip: %s.L%d\n", function_name, stm->u.while_.skip_label);
                 break;
             }
         case TR_FOR_STM:
@@ -250,10 +308,10 @@ void P_print_stm(TR_Stm stm, int offset) {
                 P_print_exp(stm->u.for_.lo, offset + OFFSET);
                 P_print_exp(stm->u.for_.hi, offset + OFFSET);
                 indent(offset + OFFSET);
-                printf("Test: %d\n", stm->u.for_.test_label);
+                printf("Test: %s.L%d\n", function_name, stm->u.for_.test_label);
                 P_print_stm(stm->u.for_.body, offset + OFFSET);
                 indent(offset + OFFSET);
-                printf("Skip: %d\n", stm->u.for_.skip_label);
+                printf("Skip: %s.L%d\n", function_name, stm->u.for_.skip_label);
                 break;
             }
         case TR_BREAK_STM:
@@ -272,17 +330,20 @@ void P_print_function_body(TR_Function func) {
     if (!func->body) {
         return;
     }
-    for (TR_StmList stms = func->body; stms; stms = stms->tail) {
-        P_print_stm(stms->head, OFFSET);
+    for (int i = 0; i < func->body->length; ++i) {
+        P_print_stm(func->body->items[i], OFFSET);
     }
 }
 
 void P_print_ir(TR_Function func) {
+    TRACE_begin(S_name(func->name), "print");
+    function_name = S_name(func->name);
     TR_print_function(func);
     indent(OFFSET);
     puts("Code:");
     P_print_function_body(func);
     putchar('\n');
+    TRACE_end();
     for (TR_FunctionList flist = func->children; flist; flist = flist->tail) {
         P_print_ir(flist->head);
     }
@@ -12,5 +12,9 @@
 
 #include "translate.h"
 
+/* The names of the statement and expression kinds, indexed by kind. */
+extern const char * P_stm_names[];
+extern const char * P_exp_names[];
+
 void P_print_ir(TR_Function main_);
 void P_print_function_body(TR_Function func);
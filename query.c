@@ -0,0 +1,545 @@
+/*
+ * query.c -
+ * Implementation of the query service for editor tooling.
+ * See query.h for more information.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+
+#include "absyn.h"
+#include "errormsg.h"
+#include "parse.h"
+#include "query.h"
+#include "semant.h"
+#include "symbol.h"
+#include "xref.h"
+
+/* JSON-RPC error codes. */
+#define QY_PARSE_ERROR -32700
+#define QY_INVALID_REQUEST -32600
+#define QY_METHOD_NOT_FOUND -32601
+#define QY_INVALID_PARAMS -32602
+
+typedef struct QY_Json_ * QY_Json;
+typedef struct QY_Member_ * QY_Member;
+typedef struct QY_File_ * QY_File;
+typedef struct QY_Diagnostic_ * QY_Diagnostic;
+
+/* A parsed JSON value; arrays are objects whose members have no keys. */
+struct QY_Json_ {
+    enum { QY_NULL, QY_BOOL, QY_NUMBER, QY_STRING, QY_ARRAY, QY_OBJECT } kind;
+    union {
+        bool boolean;
+        double number;
+        string string;
+        QY_Member members;
+    } u;
+};
+
+struct QY_Member_ {
+    string key;
+    QY_Json value;
+    QY_Member tail;
+};
+
+struct QY_Diagnostic_ {
+    int line;
+    int column;
+    string message;
+    QY_Diagnostic tail;
+};
+
+/* What is known about a file as of its last check. */
+struct QY_File_ {
+    string path;
+    struct timespec modified;
+    long size;
+    bool checked;
+    T_Type type;
+    XR_Index index;
+    QY_Diagnostic diagnostics;
+};
+
+/* The files queried so far, by path. */
+static S_Table files = NULL;
+
+/* JSON parsing */
+
+static void QY_skip_space(const char ** p) {
+    while (**p == ' ' || **p == '\t' || **p == '\n' || **p == '\r') {
+        ++*p;
+    }
+}
+
+static QY_Json make_QY_Json(int kind) {
+    QY_Json json = malloc_checked(sizeof(*json));
+    json->kind = kind;
+    return json;
+}
+
+/* Appends the UTF-8 encoding of a code point from a \u escape. */
+static char * QY_put_utf8(char * out, unsigned code) {
+    if (code < 0x80) {
+        *out++ = code;
+    } else if (code < 0x800) {
+        *out++ = 0xc0 | (code >> 6);
+        *out++ = 0x80 | (code & 0x3f);
+    } else {
+        *out++ = 0xe0 | (code >> 12);
+        *out++ = 0x80 | ((code >> 6) & 0x3f);
+        *out++ = 0x80 | (code & 0x3f);
+    }
+    return out;
+}
+
+static string QY_parse_string(const char ** p) {
+    // Escapes only shrink, so the raw length bounds the result.
+    const char * start = ++*p;
+    const char * end = start;
+    while (*end && *end != '"') {
+        end += end[0] == '\\' && end[1] ? 2 : 1;
+    }
+    if (*end != '"') {
+        return NULL;
+    }
+    string text = malloc_checked(end - start + 1);
+    char * out = text;
+    for (const char * in = start; in < end; ++in) {
+        if (*in != '\\') {
+            *out++ = *in;
+            continue;
+        }
+        switch (*++in) {
+            case 'b': *out++ = '\b'; break;
+            case 'f': *out++ = '\f'; break;
+            case 'n': *out++ = '\n'; break;
+            case 'r': *out++ = '\r'; break;
+            case 't': *out++ = '\t'; break;
+            case 'u':
+                {
+                    unsigned code;
+                    if (end - in < 5 || sscanf(in + 1, "%4x", &code) != 1) {
+                        return NULL;
+                    }
+                    out = QY_put_utf8(out, code);
+                    in += 4;
+                    break;
+                }
+            default: *out++ = *in; break;
+        }
+    }
+    *out = '\0';
+    *p = end + 1;
+    return text;
+}
+
+static QY_Json QY_parse_value(const char ** p);
+
+/* Parses the members of an object or the elements of an array. */
+static QY_Json QY_parse_members(const char ** p, bool object) {
+    QY_Json json = make_QY_Json(object ? QY_OBJECT : QY_ARRAY);
+    json->u.members = NULL;
+    QY_Member * last = &json->u.members;
+    char close = object ? '}' : ']';
+    ++*p;
+    QY_skip_space(p);
+    if (**p == close) {
+        ++*p;
+        return json;
+    }
+    for (;;) {
+        QY_Member member = malloc_checked(sizeof(*member));
+        member->key = NULL;
+        member->tail = NULL;
+        QY_skip_space(p);
+        if (object) {
+            if (**p != '"' || !(member->key = QY_parse_string(p))) {
+                return NULL;
+            }
+            QY_skip_space(p);
+            if (*(*p)++ != ':') {
+                return NULL;
+            }
+        }
+        if (!(member->value = QY_parse_value(p))) {
+            return NULL;
+        }
+        *last = member;
+        last = &member->tail;
+        QY_skip_space(p);
+        if (**p == close) {
+            ++*p;
+            return json;
+        }
+        if (*(*p)++ != ',') {
+            return NULL;
+        }
+    }
+}
+
+static QY_Json QY_parse_value(const char ** p) {
+    QY_skip_space(p);
+    QY_Json json;
+    switch (**p) {
+        case '{':
+            return QY_parse_members(p, true);
+        case '[':
+            return QY_parse_members(p, false);
+        case '"':
+            json = make_QY_Json(QY_STRING);
+            json->u.string = QY_parse_string(p);
+            return json->u.string ? json : NULL;
+        case 't':
+        case 'f':
+        case 'n':
+            {
+                bool is_true = !strncmp(*p, "true", 4);
+                bool is_false = !strncmp(*p, "false", 5);
+                if (!is_true && !is_false && strncmp(*p, "null", 4)) {
+                    return NULL;
+                }
+                json = make_QY_Json(is_true || is_false ? QY_BOOL : QY_NULL);
+                json->u.boolean = is_true;
+                *p += is_false ? 5 : 4;
+                return json;
+            }
+        default:
+            {
+                char * end;
+                double number = strtod(*p, &end);
+                if (end == *p) {
+                    return NULL;
+                }
+                json = make_QY_Json(QY_NUMBER);
+                json->u.number = number;
+                *p = end;
+                return json;
+            }
+    }
+}
+
+static QY_Json QY_member(QY_Json object, string key) {
+    if (!object || object->kind != QY_OBJECT) {
+        return NULL;
+    }
+    for (QY_Member member = object->u.members; member; member = member->tail) {
+        if (!strcmp(member->key, key)) {
+            return member->value;
+        }
+    }
+    return NULL;
+}
+
+/* JSON writing */
+
+static void QY_write_string(FILE * out, const char * s) {
+    fputc('"', out);
+    for (; *s; ++s) {
+        unsigned char c = *s;
+        if (c == '"' || c == '\\') {
+            fprintf(out, "\\%c", c);
+        } else if (c == '\n') {
+            fputs("\\n", out);
+        } else if (c < 0x20) {
+            fprintf(out, "\\u%04x", c);
+        } else {
+            fputc(c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+static void QY_write_json(FILE * out, QY_Json json) {
+    if (!json) {
+        fputs("null", out);
+        return;
+    }
+    switch (json->kind) {
+        case QY_NULL:
+            fputs("null", out);
+            break;
+        case QY_BOOL:
+            fputs(json->u.boolean ? "true" : "false", out);
+            break;
+        case QY_NUMBER:
+            fprintf(out, "%.17g", json->u.number);
+            break;
+        case QY_STRING:
+            QY_write_string(out, json->u.string);
+            break;
+        case QY_ARRAY:
+        case QY_OBJECT:
+            fputc(json->kind == QY_OBJECT ? '{' : '[', out);
+            for (QY_Member member = json->u.members; member; member = member->tail) {
+                if (member->key) {
+                    QY_write_string(out, member->key);
+                    fputc(':', out);
+                }
+                QY_write_json(out, member->value);
+                if (member->tail) {
+                    fputc(',', out);
+                }
+            }
+            fputc(json->kind == QY_OBJECT ? '}' : ']', out);
+            break;
+    }
+}
+
+/* Files */
+
+/* Splits the buffered diagnostics, "file:line.column: message", into records. */
+static QY_Diagnostic QY_diagnostics(string text) {
+    QY_Diagnostic diagnostics = NULL;
+    QY_Diagnostic * last = &diagnostics;
+    while (*text) {
+        char * end = strchr(text, '\n');
+        int length = end ? end - text : (int) strlen(text);
+        string line = malloc_checked(length + 1);
+        memcpy(line, text, length);
+        line[length] = '\0';
+        text += end ? length + 1 : length;
+        // The file name may itself contain colons, so look for the position.
+        int at = -1;
+        int line_number;
+        int column;
+        int skip;
+        for (char * colon = strchr(line, ':'); colon; colon = strchr(colon + 1, ':')) {
+            if (sscanf(colon + 1, "%d.%d: %n", &line_number, &column, &skip) == 2) {
+                at = colon + 1 + skip - line;
+                break;
+            }
+        }
+        if (at < 0) {
+            continue;
+        }
+        QY_Diagnostic diagnostic = malloc_checked(sizeof(*diagnostic));
+        diagnostic->line = line_number;
+        diagnostic->column = column;
+        diagnostic->message = line + at;
+        diagnostic->tail = NULL;
+        *last = diagnostic;
+        last = &diagnostic->tail;
+    }
+    return diagnostics;
+}
+
+/* The file at path, checked again if it has changed since its last check;
+ * NULL if it cannot be read. */
+static QY_File QY_file(string path) {
+    S_Symbol key = make_S_Symbol(path);
+    QY_File file = S_look(files, key);
+    struct stat st;
+    if (stat(path, &st)) {
+        return NULL;
+    }
+    if (!file) {
+        file = malloc_checked(sizeof(*file));
+        file->path = make_String(path);
+        file->checked = false;
+        file->type = NULL;
+        file->index = make_XR_Index();
+        S_enter(files, key, file);
+    }
+    if (file->checked && file->size == st.st_size
+            && file->modified.tv_sec == st.st_mtim.tv_sec
+            && file->modified.tv_nsec == st.st_mtim.tv_nsec) {
+        return file;
+    }
+    file->checked = true;
+    file->modified = st.st_mtim;
+    file->size = st.st_size;
+    EM_Buffer errors = make_EM_Buffer();
+    EM_Buffer enclosing_errors = EM_redirect(errors);
+    A_Exp program = parse(file->path);
+    // After a syntax error, the index of the last good version is kept.
+    if (program) {
+        XR_Index index = make_XR_Index();
+        file->type = SEM_check_prog_indexed(program, index).type;
+        file->index = index;
+        // Sort the index now, as part of the load, rather than on the first query.
+        XR_find(index, 0, 0);
+    }
+    EM_redirect(enclosing_errors);
+    file->diagnostics = QY_diagnostics(EM_buffer_text(errors));
+    return file;
+}
+
+/* Responses */
+
+static void QY_write_position(FILE * out, A_Pos pos) {
+    fprintf(out, "{\"line\":%d,\"column\":%d}", pos.first_line, pos.first_column);
+}
+
+static void QY_diagnostics_result(FILE * out, QY_File file) {
+    fprintf(out, "{\"type\":");
+    QY_write_string(out, file->type ? T_type_name(file->type) : "unknown");
+    fprintf(out, ",\"diagnostics\":[");
+    for (QY_Diagnostic diagnostic = file->diagnostics; diagnostic; diagnostic = diagnostic->tail) {
+        fprintf(out, "{\"line\":%d,\"column\":%d,\"message\":", diagnostic->line, diagnostic->column);
+        QY_write_string(out, diagnostic->message);
+        fprintf(out, "}%s", diagnostic->tail ? "," : "");
+    }
+    fprintf(out, "]}");
+}
+
+static void QY_write_uses(FILE * out, XR_PosList uses, bool first) {
+    if (!uses) {
+        return;
+    }
+    // The list holds the latest use first.
+    QY_write_uses(out, uses->tail, first);
+    if (uses->tail || !first) {
+        fputc(',', out);
+    }
+    QY_write_position(out, uses->head);
+}
+
+/* Writes the result of a query on decl, the declaration at the position. */
+static void QY_decl_result(FILE * out, string method, XR_Decl decl) {
+    if (!strcmp(method, "hover")) {
+        if (!decl) {
+            fputs("null", out);
+            return;
+        }
+        fprintf(out, "{\"name\":");
+        QY_write_string(out, S_name(decl->name));
+        fprintf(out, ",\"kind\":\"%s\",\"description\":",
+                decl->entry->kind == E_FUN_ENTRY ? "function" : "variable");
+        QY_write_string(out, XR_describe(decl));
+        fputc('}', out);
+    } else if (!strcmp(method, "definition")) {
+        if (decl && decl->declared) {
+            QY_write_position(out, decl->pos);
+        } else {
+            fputs("null", out);
+        }
+    } else {
+        fputc('[', out);
+        if (decl && decl->declared) {
+            QY_write_position(out, decl->pos);
+        }
+        if (decl) {
+            QY_write_uses(out, decl->uses, !decl->declared);
+        }
+        fputc(']', out);
+    }
+}
+
+/* Writes the response to one request to out; returns false on shutdown. */
+static bool QY_answer(FILE * out, QY_Json request) {
+    QY_Json id = QY_member(request, "id");
+    QY_Json method = QY_member(request, "method");
+    QY_Json params = QY_member(request, "params");
+    int error = 0;
+    string error_message = NULL;
+    bool running = true;
+    char * result = NULL;
+    size_t result_size = 0;
+    FILE * result_out = open_memstream(&result, &result_size);
+    if (!method || method->kind != QY_STRING) {
+        error = QY_INVALID_REQUEST;
+        error_message = "missing method";
+    } else if (!strcmp(method->u.string, "shutdown") || !strcmp(method->u.string, "exit")) {
+        fputs("null", result_out);
+        running = false;
+    } else if (strcmp(method->u.string, "diagnostics") && strcmp(method->u.string, "hover")
+            && strcmp(method->u.string, "definition") && strcmp(method->u.string, "references")) {
+        error = QY_METHOD_NOT_FOUND;
+        error_message = "method not found";
+    } else {
+        QY_Json path = QY_member(params, "file");
+        QY_Json line = QY_member(params, "line");
+        QY_Json column = QY_member(params, "column");
+        bool positional = strcmp(method->u.string, "diagnostics");
+        QY_File file = path && path->kind == QY_STRING ? QY_file(path->u.string) : NULL;
+        if (!file) {
+            error = QY_INVALID_PARAMS;
+            error_message = "missing or unreadable file";
+        } else if (!positional) {
+            QY_diagnostics_result(result_out, file);
+        } else if (!line || line->kind != QY_NUMBER || !column || column->kind != QY_NUMBER) {
+            error = QY_INVALID_PARAMS;
+            error_message = "missing line or column";
+        } else {
+            XR_Decl decl = XR_find(file->index, line->u.number, column->u.number);
+            QY_decl_result(result_out, method->u.string, decl);
+        }
+    }
+    fclose(result_out);
+    // Notifications, which have no id, get no response.
+    if (id) {
+        char * body = NULL;
+        size_t body_size = 0;
+        FILE * body_out = open_memstream(&body, &body_size);
+        fprintf(body_out, "{\"jsonrpc\":\"2.0\",\"id\":");
+        QY_write_json(body_out, id);
+        if (error) {
+            fprintf(body_out, ",\"error\":{\"code\":%d,\"message\":", error);
+            QY_write_string(body_out, error_message);
+            fputc('}', body_out);
+        } else {
+            fprintf(body_out, ",\"result\":%s", result);
+        }
+        fputc('}', body_out);
+        fclose(body_out);
+        fprintf(out, "Content-Length: %zu\r\n\r\n%s", body_size, body);
+        fflush(out);
+        free(body);
+    }
+    free(result);
+    return running;
+}
+
+/* Reads the next message's headers and body; NULL at end of input. */
+static string QY_read_message(FILE * in) {
+    long length = -1;
+    char header[256];
+    for (;;) {
+        if (!fgets(header, sizeof(header), in)) {
+            return NULL;
+        }
+        if (!strcmp(header, "\r\n") || !strcmp(header, "\n")) {
+            if (length >= 0) {
+                break;
+            }
+            continue;
+        }
+        if (!strncasecmp(header, "Content-Length:", 15)) {
+            length = atol(header + 15);
+        }
+    }
+    string body = malloc_checked(length + 1);
+    if (fread(body, 1, length, in) != (size_t) length) {
+        free(body);
+        return NULL;
+    }
+    body[length] = '\0';
+    return body;
+}
+
+int QY_serve(FILE * in, FILE * out) {
+    files = S_empty();
+    for (;;) {
+        string message = QY_read_message(in);
+        if (!message) {
+            return EXIT_SUCCESS;
+        }
+        const char * p = message;
+        QY_Json request = QY_parse_value(&p);
+        if (!request || request->kind != QY_OBJECT) {
+            char body[128];
+            int length = sprintf(body, "{\"jsonrpc\":\"2.0\",\"id\":null,\"error\":{\"code\":%d,"
+                    "\"message\":\"parse error\"}}", QY_PARSE_ERROR);
+            fprintf(out, "Content-Length: %d\r\n\r\n%s", length, body);
+            fflush(out);
+        } else if (!QY_answer(out, request)) {
+            free(message);
+            return EXIT_SUCCESS;
+        }
+        free(message);
+    }
+}
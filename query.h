@@ -0,0 +1,24 @@
+/*
+ * query.h -
+ * A query service for editor tooling, speaking JSON-RPC 2.0 over
+ * a pair of streams, with messages framed by Content-Length headers
+ * as in the Language Server Protocol.
+ * Each file named in a query is parsed, type-checked and indexed
+ * (see xref.h) once; it is checked again only when its modification
+ * time or size changes, so most queries are answered from the index.
+ * Methods, each taking "file" and, where a position is needed,
+ * 1-based "line" and "column":
+ *  - diagnostics: the program's type and its error messages;
+ *  - hover: the name at the position and its type;
+ *  - definition: where the name at the position is declared;
+ *  - references: the declaration and every use of that name;
+ *  - shutdown: stop serving.
+ * All types and functions declared in this module begin with "QY_".
+ */
+
+#pragma once
+
+#include <stdio.h>
+
+/* Answer the queries read from in on out until shutdown or end of input. */
+int QY_serve(FILE * in, FILE * out);
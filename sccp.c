@@ -0,0 +1,311 @@
+/*
+ * sccp.c -
+ * Implementation of sparse conditional constant propagation.
+ * See sccp.h for more information.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "fold.h"
+#include "sccp.h"
+#include "util.h"
+
+const PM_Pass SCCP_pass = { "sccp", 2, NULL, NULL, SCCP_graph };
+
+/* What is known of a temp, from least to most: nothing yet, that it
+ * is always value, or that it varies. */
+typedef struct SCCP_Value_ {
+    enum { SCCP_UNKNOWN, SCCP_CONST, SCCP_VARYING } kind;
+    int value;
+} SCCP_Value;
+
+/* A use of a temp: the instruction at index of block, or its end if
+ * index is the block's instr_count. */
+typedef struct SCCP_Use_ {
+    int block;
+    int index;
+} SCCP_Use;
+
+typedef struct SCCP_Solver_ {
+    CFG_Graph graph;
+    SCCP_Value * values;
+    /* The uses of temp t are uses[first_use[t]] up to uses[first_use[t + 1]]. */
+    int * first_use;
+    SCCP_Use * uses;
+    /* Whether each block, and each successor edge (2 per block), is
+     * known to run. */
+    bool * reached;
+    bool * edges;
+    /* Edges newly known to run, and temps newly lowered. */
+    int edge_count;
+    int * edge_work;
+    int temp_count;
+    int * temp_work;
+} SCCP_Solver;
+
+static SCCP_Value SCCP_make(int kind, int value) {
+    SCCP_Value result = { kind, value };
+    return result;
+}
+
+static SCCP_Value SCCP_meet(SCCP_Value a, SCCP_Value b) {
+    if (a.kind == SCCP_UNKNOWN) {
+        return b;
+    }
+    if (b.kind == SCCP_UNKNOWN) {
+        return a;
+    }
+    if (a.kind == SCCP_CONST && b.kind == SCCP_CONST && a.value == b.value) {
+        return a;
+    }
+    return SCCP_make(SCCP_VARYING, 0);
+}
+
+static SCCP_Value SCCP_operand(SCCP_Solver * solver, CFG_Operand operand) {
+    switch (operand.kind) {
+        case CFG_CONST:
+            return SCCP_make(SCCP_CONST, operand.value);
+        case CFG_TEMP:
+            return solver->values[operand.value];
+        default:
+            return SCCP_make(SCCP_VARYING, 0);
+    }
+}
+
+/* Collect the uses of each temp, by counting sort. */
+static void SCCP_find_uses(SCCP_Solver * solver) {
+    CFG_Graph graph = solver->graph;
+    int temps = graph->temp_count;
+    solver->first_use = malloc_checked((temps + 2) * sizeof(int));
+    memset(solver->first_use, 0, (temps + 2) * sizeof(int));
+    for (int pass = 0; pass < 2; ++pass) {
+        for (int i = 0; i < graph->block_count; ++i) {
+            CFG_Block block = graph->blocks[i];
+            for (int j = 0; j <= block->instr_count; ++j) {
+                CFG_Instr * instr = j < block->instr_count ? &block->instrs[j] : NULL;
+                int n = instr ? CFG_use_count(instr) : 1;
+                for (int k = 0; k < n; ++k) {
+                    CFG_Operand operand = instr ? *CFG_use(instr, k) : block->value;
+                    if (operand.kind != CFG_TEMP) {
+                        continue;
+                    }
+                    if (pass) {
+                        SCCP_Use use = { i, j };
+                        solver->uses[solver->first_use[operand.value + 1]++] = use;
+                    } else {
+                        ++solver->first_use[operand.value + 2];
+                    }
+                }
+            }
+        }
+        if (!pass) {
+            for (int t = 0; t < temps; ++t) {
+                solver->first_use[t + 2] += solver->first_use[t + 1];
+            }
+            solver->uses = malloc_checked(solver->first_use[temps + 1] * sizeof(SCCP_Use) + 1);
+        }
+    }
+}
+
+static void SCCP_lower(SCCP_Solver * solver, int temp, SCCP_Value value) {
+    SCCP_Value old = solver->values[temp];
+    value = SCCP_meet(old, value);
+    if (value.kind != old.kind) {
+        solver->values[temp] = value;
+        solver->temp_work[solver->temp_count++] = temp;
+    }
+}
+
+static void SCCP_reach_edge(SCCP_Solver * solver, int block, int succ) {
+    int edge = 2 * block + succ;
+    if (!solver->edges[edge]) {
+        solver->edges[edge] = true;
+        solver->edge_work[solver->edge_count++] = edge;
+    }
+}
+
+/* Whether control is known to flow from block pred to block. */
+static bool SCCP_flows(SCCP_Solver * solver, int pred, int block) {
+    CFG_Block from = solver->graph->blocks[pred];
+    for (int j = 0; j < from->succ_count; ++j) {
+        if (from->succs[j] == block && solver->edges[2 * pred + j]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void SCCP_visit_instr(SCCP_Solver * solver, int block_id, CFG_Instr * instr) {
+    if (instr->dst < 0) {
+        return;
+    }
+    SCCP_Value value = SCCP_make(SCCP_VARYING, 0);
+    switch (instr->kind) {
+        case CFG_PHI:
+            {
+                CFG_Block block = solver->graph->blocks[block_id];
+                value = SCCP_make(SCCP_UNKNOWN, 0);
+                for (int k = 0; k < instr->u.phi.arg_count; ++k) {
+                    if (SCCP_flows(solver, block->preds[k], block_id)) {
+                        value = SCCP_meet(value, SCCP_operand(solver, instr->u.phi.args[k]));
+                    }
+                }
+                break;
+            }
+        case CFG_MOVE:
+            value = SCCP_operand(solver, instr->u.move);
+            break;
+        case CFG_BINOP:
+            {
+                SCCP_Value left = SCCP_operand(solver, instr->u.binop.left);
+                SCCP_Value right = SCCP_operand(solver, instr->u.binop.right);
+                int result;
+                if (left.kind == SCCP_VARYING || right.kind == SCCP_VARYING) {
+                    break;
+                }
+                if (left.kind == SCCP_UNKNOWN || right.kind == SCCP_UNKNOWN) {
+                    value = SCCP_make(SCCP_UNKNOWN, 0);
+                } else if (FOLD_constant(instr->u.binop.op, left.value, right.value, &result)) {
+                    value = SCCP_make(SCCP_CONST, result);
+                }
+                break;
+            }
+        default:
+            break;
+    }
+    SCCP_lower(solver, instr->dst, value);
+}
+
+static void SCCP_visit_end(SCCP_Solver * solver, CFG_Block block) {
+    if (block->end == CFG_JUMP) {
+        SCCP_reach_edge(solver, block->id, 0);
+    } else if (block->end == CFG_BRANCH) {
+        SCCP_Value test = SCCP_operand(solver, block->value);
+        if (test.kind == SCCP_CONST) {
+            SCCP_reach_edge(solver, block->id, test.value ? 0 : 1);
+        } else if (test.kind == SCCP_VARYING) {
+            SCCP_reach_edge(solver, block->id, 0);
+            SCCP_reach_edge(solver, block->id, 1);
+        }
+    }
+}
+
+/* Visit block on a new edge into it: all of it the first time, after
+ * that only its phis, which may now merge another value. */
+static void SCCP_enter(SCCP_Solver * solver, int block_id) {
+    CFG_Block block = solver->graph->blocks[block_id];
+    bool first = !solver->reached[block_id];
+    solver->reached[block_id] = true;
+    for (int j = 0; j < block->instr_count; ++j) {
+        if (!first && block->instrs[j].kind != CFG_PHI) {
+            return;
+        }
+        SCCP_visit_instr(solver, block_id, &block->instrs[j]);
+    }
+    if (first) {
+        SCCP_visit_end(solver, block);
+    }
+}
+
+static void SCCP_solve(SCCP_Solver * solver) {
+    CFG_Graph graph = solver->graph;
+    SCCP_enter(solver, 0);
+    while (solver->edge_count || solver->temp_count) {
+        if (solver->edge_count) {
+            int edge = solver->edge_work[--solver->edge_count];
+            SCCP_enter(solver, graph->blocks[edge / 2]->succs[edge % 2]);
+            continue;
+        }
+        int temp = solver->temp_work[--solver->temp_count];
+        for (int u = solver->first_use[temp]; u < solver->first_use[temp + 1]; ++u) {
+            SCCP_Use use = solver->uses[u];
+            CFG_Block block = graph->blocks[use.block];
+            if (!solver->reached[use.block]) {
+                continue;
+            }
+            if (use.index == block->instr_count) {
+                SCCP_visit_end(solver, block);
+            } else {
+                SCCP_visit_instr(solver, use.block, &block->instrs[use.index]);
+            }
+        }
+    }
+}
+
+/* Replace the temps found constant, delete their definitions, and
+ * resolve the branches they decide; true if any block became
+ * unreachable. */
+static bool SCCP_rewrite(SCCP_Solver * solver) {
+    CFG_Graph graph = solver->graph;
+    bool pruned = false;
+    for (int i = 0; i < graph->block_count; ++i) {
+        CFG_Block block = graph->blocks[i];
+        if (!solver->reached[i]) {
+            pruned = true;
+            continue;
+        }
+        int kept = 0;
+        for (int j = 0; j < block->instr_count; ++j) {
+            CFG_Instr * instr = &block->instrs[j];
+            if (instr->dst >= 0 && solver->values[instr->dst].kind == SCCP_CONST
+                    && (instr->kind == CFG_PHI || instr->kind == CFG_MOVE
+                        || instr->kind == CFG_BINOP)) {
+                continue;
+            }
+            for (int k = 0, n = CFG_use_count(instr); k < n; ++k) {
+                CFG_Operand * operand = CFG_use(instr, k);
+                if (operand->kind == CFG_TEMP && solver->values[operand->value].kind == SCCP_CONST) {
+                    *operand = CFG_const(solver->values[operand->value].value);
+                }
+            }
+            block->instrs[kept++] = *instr;
+        }
+        block->instr_count = kept;
+        SCCP_Value test = SCCP_operand(solver, block->value);
+        if (block->end == CFG_BRANCH && test.kind == SCCP_CONST) {
+            block->end = CFG_JUMP;
+            block->succs[0] = block->succs[test.value ? 0 : 1];
+            block->succ_count = 1;
+            block->value = CFG_none();
+            pruned = true;
+        } else if (test.kind == SCCP_CONST && block->value.kind == CFG_TEMP) {
+            block->value = CFG_const(test.value);
+        }
+    }
+    return pruned;
+}
+
+void SCCP_graph(CFG_Graph graph) {
+    if (!graph->ssa || !graph->block_count) {
+        return;
+    }
+    SCCP_Solver solver;
+    int n = graph->block_count;
+    solver.graph = graph;
+    solver.values = malloc_checked(graph->temp_count * sizeof(SCCP_Value) + 1);
+    for (int t = 0; t < graph->temp_count; ++t) {
+        solver.values[t] = SCCP_make(SCCP_UNKNOWN, 0);
+    }
+    SCCP_find_uses(&solver);
+    solver.reached = malloc_checked(n * sizeof(bool) + 1);
+    solver.edges = malloc_checked(2 * n * sizeof(bool) + 1);
+    memset(solver.reached, 0, n * sizeof(bool));
+    memset(solver.edges, 0, 2 * n * sizeof(bool));
+    // Each edge is reached once, and each temp lowered at most twice.
+    solver.edge_count = 0;
+    solver.edge_work = malloc_checked(2 * n * sizeof(int) + 1);
+    solver.temp_count = 0;
+    solver.temp_work = malloc_checked(2 * graph->temp_count * sizeof(int) + 1);
+    SCCP_solve(&solver);
+    if (SCCP_rewrite(&solver)) {
+        CFG_remove_unreachable(graph);
+    }
+    free(solver.values);
+    free(solver.first_use);
+    free(solver.uses);
+    free(solver.reached);
+    free(solver.edges);
+    free(solver.edge_work);
+    free(solver.temp_work);
+}
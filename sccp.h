@@ -0,0 +1,24 @@
+/*
+ * sccp.h -
+ * Sparse conditional constant propagation over a CFG in SSA form,
+ * after Wegman and Zadeck. Every temp starts out undetermined and is
+ * lowered, to a constant or to varying, only once an instruction that
+ * defines it is found to run; a branch on a constant runs only the
+ * side it takes, so a value merged in from code that never runs does
+ * not spoil a constant, even around a loop. The constants found
+ * replace their temps, whose definitions are deleted; the branches
+ * they decide become jumps, and the blocks that leaves unreachable
+ * are removed. Does nothing to a graph not in SSA form.
+ * All types and functions declared in this module begin with "SCCP_".
+ */
+
+#pragma once
+
+#include "cfg.h"
+#include "pass_manager.h"
+
+/* Propagate the constants of graph, which must be in SSA form. */
+void SCCP_graph(CFG_Graph graph);
+
+/* SCCP_graph, as the -O2 pass "sccp". */
+extern const PM_Pass SCCP_pass;
@@ -4,22 +4,72 @@
  */
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "env.h"
+#include "escape.h"
+#include "fingerprint.h"
+#include "pool.h"
 #include "semant.h"
+#include "stack.h"
+#include "stats.h"
+#include "table.h"
+#include "trace.h"
+#include "xref.h"
 
 T_Type SEM_trans_type(S_Table tenv, A_Type type);
 T_TypeList SEM_make_formal_type_list(S_Table tenv, A_FieldList params);
 T_Type SEM_actual_type(S_Table tenv, T_Type type);
 bool SEM_types_agree(T_Type t1, T_Type t2);
+void SEM_trans_type_group(S_Table tenv, A_Dec dec);
+
+/* The cache of the re-check in progress, if any; see SEM_recheck_prog. */
+static SEM_Cache active_cache = NULL;
+
+/* Whether the re-check in progress is inside a top-level function body,
+ * where no function is cached. */
+static bool in_cached_body = false;
+
+/* True while checking without translating; see SEM_check_prog.
+ * The type rules look only at the kinds of translations, so in this mode
+ * every expression translates to one of two shared stand-ins, and no
+ * IR, frames or labels are created. */
+static bool check_only = false;
+static struct TR_Exp_ checked_exp = { 0, -1, TR_NUM_EXP, { 0 } };
+static struct TR_Exp_ checked_seq_exp = { 0, -1, TR_SEQ_EXP, { 0 } };
+
+static SEM_ExpType SEM_checked_exp(T_Type type) {
+    return make_SEM_ExpType(make_TR_TransExp(&checked_exp), type);
+}
+
+static SEM_ExpType SEM_checked_stm(T_Type type) {
+    return make_SEM_ExpType(make_TR_TransStm(NULL), type);
+}
+
+/* The index being filled by SEM_check_prog_indexed, if any. */
+static XR_Index active_index = NULL;
+
+/* Enters a value declared at pos into venv, recording it in the index. */
+static void SEM_declare(S_Table venv, S_Symbol name, E_EnvEntry entry, A_Pos pos) {
+    S_enter(venv, name, entry);
+    if (active_index) {
+        XR_declare(active_index, name, entry, pos);
+    }
+}
+
+/* The entry of a variable just added to func's frame, of the given type. */
+static E_EnvEntry SEM_var_entry(TR_Function func, F_Var var, T_Type type) {
+    if (var->escape) {
+        return make_E_VarEntry(type, func->frame->nesting_level, var->offset);
+    }
+    return make_E_TempEntry(type, func->frame->nesting_level, var->temp);
+}
 
 SEM_ExpType make_SEM_ExpType(TR_TransExp exp, T_Type type) {
-    SEM_ExpType exp_type = malloc_checked(sizeof(*exp_type));
-    exp_type->exp = exp;
-    exp_type->type = type;
+    SEM_ExpType exp_type = { exp, type };
     return exp_type;
 }
 
@@ -28,34 +78,46 @@ SEM_ExpType SEM_trans_cond_stm(S_Table venv, S_Table tenv, TR_Exp tr_if_exp,
     T_Type cond_type = make_T_Void();
     TR_Stm tr_cond_stm = NULL;
     TR_Stm tr_then_stm = NULL;
-    if (then_exp_type->exp->kind == TR_STM) {
-        tr_then_stm = then_exp_type->exp->u.stm;
-    } else if (then_exp_type->exp->kind == TR_EXP &&
-            then_exp_type->exp->u.exp->kind == TR_SEQ_EXP) {
-        tr_then_stm = TR_convert_seq_exp_to_stm(then_exp_type->exp->u.exp);
+    if (check_only) {
+        // The branches are checked below; there is nothing to convert.
+    } else if (then_exp_type.exp.kind == TR_STM) {
+        tr_then_stm = then_exp_type.exp.u.stm;
+    } else if (then_exp_type.exp.kind == TR_EXP &&
+            then_exp_type.exp.u.exp->kind == TR_SEQ_EXP) {
+        tr_then_stm = TR_convert_seq_exp_to_stm(then_exp_type.exp.u.exp);
     }
     if (exp->u.iff.elsee) {
         SEM_ExpType else_exp_type = SEM_trans_exp(venv, tenv, func, exp->u.iff.elsee);
-        if (!SEM_types_agree(else_exp_type->type, then_exp_type->type)) {
+        if (!SEM_types_agree(else_exp_type.type, then_exp_type.type)) {
             EM_error(exp->u.iff.then->pos, "types of then and else clauses differ\n");
         }
-        cond_type = else_exp_type->type;
+        cond_type = else_exp_type.type;
         TR_Stm tr_else_stm = NULL;
-        if (else_exp_type->exp) {
-            if (else_exp_type->exp->kind == TR_STM) {
-                tr_else_stm = else_exp_type->exp->u.stm;
-            } else if (else_exp_type->exp->kind == TR_EXP) {
-                tr_else_stm = TR_convert_seq_exp_to_stm(else_exp_type->exp->u.exp);
+        if (else_exp_type.exp.kind != TR_NONE) {
+            if (else_exp_type.exp.kind == TR_STM) {
+                tr_else_stm = else_exp_type.exp.u.stm;
+            } else if (else_exp_type.exp.kind == TR_EXP) {
+                if (!check_only) {
+                    tr_else_stm = TR_convert_seq_exp_to_stm(else_exp_type.exp.u.exp);
+                }
             } else {
                 EM_error(exp->u.iff.elsee->pos, "else clause is neither an expression nor a statement\n");
             }
-            tr_cond_stm = make_TR_IfElseStm(tr_if_exp, tr_then_stm, tr_else_stm);
+            if (!check_only) {
+                tr_cond_stm = make_TR_IfElseStm(tr_if_exp, tr_then_stm, tr_else_stm);
+            }
         }
     } else {
-        if (then_exp_type->type->kind != T_VOID) {
+        if (then_exp_type.type->kind != T_VOID) {
             EM_error(exp->u.iff.then->pos, "then-clause must have no value");
         }
-        tr_cond_stm = make_TR_IfStm(tr_if_exp, tr_then_stm);
+        if (!check_only) {
+            tr_cond_stm = make_TR_IfStm(tr_if_exp, tr_then_stm);
+        }
+    }
+    // An error in the test or the else clause has already been reported.
+    if (!check_only && (!tr_if_exp || !tr_cond_stm)) {
+        return make_SEM_ExpType(make_TR_TransNone(), cond_type);
     }
     TR_TransExp tr = make_TR_TransStm(tr_cond_stm);
     return make_SEM_ExpType(tr, cond_type);
@@ -65,30 +127,38 @@ SEM_ExpType SEM_trans_cond_exp(S_Table venv, S_Table tenv, TR_Exp tr_if_exp,
         SEM_ExpType then_exp_type, TR_Function func, A_Exp exp) {
     T_Type cond_type = make_T_Void();
     TR_Exp tr_cond_exp = NULL;
-    TR_Exp tr_then_exp = then_exp_type->exp->u.exp;
+    TR_Exp tr_then_exp = then_exp_type.exp.u.exp;
     if (exp->u.iff.elsee) {
         SEM_ExpType else_exp_type = SEM_trans_exp(venv, tenv, func, exp->u.iff.elsee);
-        if (!SEM_types_agree(else_exp_type->type, then_exp_type->type)) {
+        if (!SEM_types_agree(else_exp_type.type, then_exp_type.type)) {
             EM_error(exp->u.iff.then->pos, "types of then and else clauses differ\n");
         }
-        cond_type = else_exp_type->type;
+        cond_type = else_exp_type.type;
         TR_Exp tr_else_exp = NULL;
-        if (else_exp_type->exp) {
-            if (else_exp_type->exp->kind == TR_EXP) {
-                tr_else_exp = else_exp_type->exp->u.exp;
-            } else if (else_exp_type->exp->kind == TR_EXP) {
-                tr_else_exp = TR_convert_seq_stm_to_exp(else_exp_type->exp->u.stm,
-                        T_size(else_exp_type->type));
+        if (else_exp_type.exp.kind != TR_NONE) {
+            if (else_exp_type.exp.kind == TR_EXP) {
+                tr_else_exp = else_exp_type.exp.u.exp;
+            } else if (else_exp_type.exp.kind == TR_EXP) {
+                tr_else_exp = TR_convert_seq_stm_to_exp(else_exp_type.exp.u.stm,
+                        T_size(else_exp_type.type));
             } else {
                 EM_error(exp->u.iff.elsee->pos, "else clause is neither an expression nor a statement");
             }
-            tr_cond_exp = make_TR_IfElseExp(tr_if_exp, tr_then_exp, tr_else_exp);
+            if (check_only) {
+                tr_cond_exp = &checked_exp;
+            } else if (tr_else_exp) {
+                tr_cond_exp = make_TR_IfElseExp(tr_if_exp, tr_then_exp, tr_else_exp);
+            }
         }
     } else {
-        if (then_exp_type->type->kind != T_VOID) {
+        if (then_exp_type.type->kind != T_VOID) {
             EM_error(exp->u.iff.then->pos, "then clause must have no value\n");
         }
-        tr_cond_exp = make_TR_IfExp(tr_if_exp, tr_then_exp);
+        tr_cond_exp = check_only ? &checked_exp : make_TR_IfExp(tr_if_exp, tr_then_exp);
+    }
+    // An error in a clause or the test has already been reported.
+    if (!check_only && (!tr_if_exp || then_exp_type.exp.kind != TR_EXP || !tr_cond_exp)) {
+        return make_SEM_ExpType(make_TR_TransNone(), cond_type);
     }
     TR_TransExp tr = make_TR_TransExp(tr_cond_exp);
     return make_SEM_ExpType(tr, cond_type);
@@ -97,114 +167,177 @@ SEM_ExpType SEM_trans_cond_exp(S_Table venv, S_Table tenv, TR_Exp tr_if_exp,
 SEM_ExpType SEM_trans_condition(S_Table venv, S_Table tenv, TR_Function func, A_Exp exp) {
     TR_Exp tr_if_exp = NULL;
     SEM_ExpType if_exp_type = SEM_trans_exp(venv, tenv, func, exp->u.iff.test);
-    if (!if_exp_type || if_exp_type->type->kind != T_INT) {
+    if (!if_exp_type.type || if_exp_type.type->kind != T_INT) {
         EM_error(exp->u.iff.test->pos, "test expression must evaluate to an integer");
     }
-    if (if_exp_type->exp && if_exp_type->exp->kind == TR_EXP) {
-        tr_if_exp = if_exp_type->exp->u.exp;
+    if (if_exp_type.exp.kind == TR_EXP) {
+        tr_if_exp = if_exp_type.exp.u.exp;
     }
     SEM_ExpType then_exp_type = SEM_trans_exp(venv, tenv, func, exp->u.iff.then);
-    if (then_exp_type->exp) {
-        if (then_exp_type->type->kind == T_VOID) {
+    if (then_exp_type.exp.kind != TR_NONE) {
+        if (then_exp_type.type->kind == T_VOID) {
             return SEM_trans_cond_stm(venv, tenv, tr_if_exp, then_exp_type, func, exp);
         } else {
             return SEM_trans_cond_exp(venv, tenv, tr_if_exp, then_exp_type, func, exp);
         }
     }
     EM_error(exp->u.iff.then->pos, "unrecognizable then-clause in conditional expression");
-    return make_SEM_ExpType(NULL, make_T_Void());
+    return make_SEM_ExpType(make_TR_TransNone(), make_T_Void());
 }
 
 void SEM_add_code_to_function(SEM_ExpType body_exp_type, TR_Function func) {
-    if (body_exp_type->exp) {
+    if (!check_only && body_exp_type.exp.kind != TR_NONE) {
         TR_Stm tr_body_stm = NULL;
-        if (body_exp_type->exp->kind == TR_STM) {
-            tr_body_stm = body_exp_type->exp->u.stm;
-        } else if (body_exp_type->exp->kind == TR_EXP) {
-            if (body_exp_type->exp->u.exp->kind == TR_SEQ_EXP) {
-                tr_body_stm = TR_convert_seq_exp_to_stm(body_exp_type->exp->u.exp);
+        if (body_exp_type.exp.kind == TR_STM) {
+            tr_body_stm = body_exp_type.exp.u.stm;
+        } else if (body_exp_type.exp.kind == TR_EXP) {
+            if (body_exp_type.exp.u.exp->kind == TR_SEQ_EXP) {
+                tr_body_stm = TR_convert_seq_exp_to_stm(body_exp_type.exp.u.exp);
             } else {
-                tr_body_stm = make_TR_ExpStm(body_exp_type->exp->u.exp);
+                tr_body_stm = make_TR_ExpStm(body_exp_type.exp.u.exp);
             }
         }
-        TR_add_stm_to_function(func, tr_body_stm);
+        if (tr_body_stm) {
+            TR_add_stm_to_function(func, tr_body_stm);
+        }
+    }
+}
+
+/* A call of SEM_trans_exp or SEM_trans_var continued on a new stack segment
+ * (see stack.h), so deeply nested programs cannot overflow the C stack. */
+typedef struct SEM_DeepCall_ {
+    S_Table venv;
+    S_Table tenv;
+    TR_Function func;
+    A_Exp exp;
+    A_Var var;
+    SEM_ExpType result;
+} SEM_DeepCall;
+
+static void SEM_run_deep_call(void * arg) {
+    SEM_DeepCall * call = arg;
+    if (call->var) {
+        call->result = SEM_trans_var(call->venv, call->tenv, call->func, call->var);
+    } else {
+        call->result = SEM_trans_exp(call->venv, call->tenv, call->func, call->exp);
     }
 }
 
 SEM_ExpType SEM_trans_var(S_Table venv, S_Table tenv, TR_Function func, A_Var var) {
+    if (ST_low()) {
+        SEM_DeepCall call = { venv, tenv, func, NULL, var };
+        ST_call(SEM_run_deep_call, &call);
+        return call.result;
+    }
     switch(var->kind) {
         case A_SIMPLE_VAR:
             {
                 E_EnvEntry entry = S_look(venv, var->u.simple);
                 if (entry && entry->kind == E_VAR_ENTRY) {
+                    if (active_index) {
+                        XR_use(active_index, var->u.simple, entry, var->pos);
+                    }
+                    if (check_only) {
+                        return SEM_checked_exp(SEM_actual_type(tenv, entry->u.var.type));
+                    }
                     return make_SEM_ExpType(make_TR_TransExp(make_TR_MemExp(venv, var->u.simple)), SEM_actual_type(tenv, entry->u.var.type));
                 } else {
                     EM_error(var->pos, "undefined variable %s\n", S_name(var->u.simple));
-                    return make_SEM_ExpType(NULL, make_T_Int());
+                    return make_SEM_ExpType(make_TR_TransNone(), make_T_Int());
                 }
             }
         case A_FIELD_VAR:
             {
                 SEM_ExpType var_exp_type = SEM_trans_var(venv, tenv, func, var->u.field.var);
-                if (!var_exp_type && var_exp_type->type->kind != T_RECORD) {
+                if (!var_exp_type.type || var_exp_type.type->kind != T_RECORD) {
                     EM_error(var->pos, "field used in something not a record");
-                    return make_SEM_ExpType(NULL, make_T_Int());
+                    return make_SEM_ExpType(make_TR_TransNone(), make_T_Int());
                 }
-                T_FieldList fields = var_exp_type->type->u.record;
+                T_FieldList fields = var_exp_type.type->u.record;
                 int field_offset = 0;
                 for (; fields; fields = fields->tail) {
                     if (fields->head->name == var->u.field.sym) {
-                        assert(var_exp_type->exp && var_exp_type->exp->kind == TR_EXP);
-                        return make_SEM_ExpType(make_TR_TransExp(make_TR_FieldExp(var_exp_type->exp->u.exp, var->u.field.sym, T_size(fields->head->type), field_offset)), fields->head->type);
+                        assert(var_exp_type.exp.kind == TR_EXP);
+                        if (check_only) {
+                            return SEM_checked_exp(fields->head->type);
+                        }
+                        return make_SEM_ExpType(make_TR_TransExp(make_TR_FieldExp(var_exp_type.exp.u.exp, var->u.field.sym, T_size(fields->head->type), field_offset)), fields->head->type);
                     }
                     field_offset += T_size(fields->head->type);
                 }
                 EM_error(var->pos, "field not found for given record typek\n");
-                return make_SEM_ExpType(NULL, make_T_Int());
+                return make_SEM_ExpType(make_TR_TransNone(), make_T_Int());
             }
         case A_SUBSCRIPT_VAR:
             {
                 SEM_ExpType var_exp_type = SEM_trans_var(venv, tenv, func, var->u.subscript.var);
-                if (!var_exp_type || var_exp_type->type->kind != T_ARRAY) {
+                if (!var_exp_type.type || var_exp_type.type->kind != T_ARRAY) {
                     EM_error(var->pos, "subscript applied to something not an array\n");
-                    return make_SEM_ExpType(NULL, make_T_Int());
+                    return make_SEM_ExpType(make_TR_TransNone(), make_T_Int());
                 }
                 SEM_ExpType index_exp_type = SEM_trans_exp(venv, tenv, func, var->u.subscript.exp);
-                if (SEM_actual_type(tenv, index_exp_type->type)->kind != T_INT) {
+                if (SEM_actual_type(tenv, index_exp_type.type)->kind != T_INT) {
                     EM_error(var->u.subscript.exp->pos, "non-integer index expression\n");
                 }
-                assert(var_exp_type->exp && var_exp_type->exp->kind == TR_EXP);
-                assert(index_exp_type->exp && index_exp_type->exp->kind == TR_EXP);
-                return make_SEM_ExpType(make_TR_TransExp(make_TR_SubscriptExp(var_exp_type->exp->u.exp, T_size(var_exp_type->type), index_exp_type->exp->u.exp)), var_exp_type->type->u.array); 
+                assert(var_exp_type.exp.kind == TR_EXP);
+                // An error in the index has already been reported.
+                if (index_exp_type.exp.kind != TR_EXP) {
+                    return make_SEM_ExpType(make_TR_TransNone(), var_exp_type.type->u.array);
+                }
+                if (check_only) {
+                    return SEM_checked_exp(var_exp_type.type->u.array);
+                }
+                return make_SEM_ExpType(make_TR_TransExp(make_TR_SubscriptExp(var_exp_type.exp.u.exp, T_size(var_exp_type.type->u.array), index_exp_type.exp.u.exp)), var_exp_type.type->u.array); 
             }
     }
-    return NULL;
+    return make_SEM_ExpType(make_TR_TransNone(), NULL);
 }
 
 SEM_ExpType SEM_trans_exp(S_Table venv, S_Table tenv, TR_Function func, A_Exp exp) {
+    if (ST_low()) {
+        SEM_DeepCall call = { venv, tenv, func, exp, NULL };
+        ST_call(SEM_run_deep_call, &call);
+        return call.result;
+    }
     switch (exp->kind) {
         case A_VAR_EXP:
             {
                 SEM_ExpType var_exp_type = SEM_trans_var(venv, tenv, func, exp->u.var);
-                if (!var_exp_type) {
+                if (!var_exp_type.type) {
                     EM_error(exp->pos, "failed to check variable\n");
-                    return make_SEM_ExpType(NULL, make_T_Int());
+                    return make_SEM_ExpType(make_TR_TransNone(), make_T_Int());
                 }
-                TR_TransExp tr = make_TR_TransExp(make_TR_VarExp(var_exp_type->exp->u.exp));
-                return make_SEM_ExpType(tr, var_exp_type->type);
+                if (check_only) {
+                    return SEM_checked_exp(var_exp_type.type);
+                }
+                // An error within the variable has already been reported.
+                if (var_exp_type.exp.kind != TR_EXP) {
+                    return make_SEM_ExpType(make_TR_TransNone(), var_exp_type.type);
+                }
+                TR_TransExp tr = make_TR_TransExp(make_TR_VarExp(var_exp_type.exp.u.exp));
+                return make_SEM_ExpType(tr, var_exp_type.type);
             }
         case A_NIL_EXP:
             {
+                if (check_only) {
+                    return SEM_checked_exp(make_T_Nil());
+                }
                 TR_TransExp tr = make_TR_TransExp(make_TR_NumExp(0));
                 return make_SEM_ExpType(tr, make_T_Nil());
             }
         case A_INT_EXP:
             {
+                if (check_only) {
+                    return SEM_checked_exp(make_T_Int());
+                }
                 TR_TransExp tr = make_TR_TransExp(make_TR_NumExp(exp->u.intt));
                 return make_SEM_ExpType(tr, make_T_Int());
             }
         case A_STRING_EXP:
             {
+                if (check_only) {
+                    return SEM_checked_exp(make_T_String());
+                }
                 TR_Exp tr_str_exp = make_TR_StringExp(exp->u.stringg);
                 TR_TransExp tr = make_TR_TransExp(tr_str_exp);
                 return make_SEM_ExpType(tr, make_T_String());
@@ -214,31 +347,49 @@ SEM_ExpType SEM_trans_exp(S_Table venv, S_Table tenv, TR_Function func, A_Exp ex
                 E_EnvEntry function_entry = S_look(venv, exp->u.call.func);
                 if (!function_entry || function_entry->kind != E_FUN_ENTRY) {
                     EM_error(exp->pos, "undefined function %s", S_name(exp->u.call.func));
-                    return make_SEM_ExpType(NULL, make_T_Int());
+                    return make_SEM_ExpType(make_TR_TransNone(), make_T_Int());
+                }
+                if (active_index) {
+                    XR_use(active_index, exp->u.call.func, function_entry, exp->pos);
                 }
                 A_ExpList args;
                 T_TypeList formals;
                 TR_ExpList tr_args = NULL;
+                bool translated = true;
                 for (
                         args = exp->u.call.args, formals = function_entry->u.fun.formals;
                         args && formals;
                         args = args->tail, formals = formals->tail
                     ) {
                     SEM_ExpType arg_exp_type = SEM_trans_exp(venv, tenv, func, args->head);
-                    if (arg_exp_type->type->kind != formals->head->kind) {
+                    if (arg_exp_type.type->kind != formals->head->kind) {
                         EM_error(args->head->pos, "argument does not have expected type\n");
                     }
-                    tr_args = TR_add_exp(tr_args, arg_exp_type->exp->u.exp);
+                    if (arg_exp_type.exp.kind != TR_EXP) {
+                        translated = false;
+                    } else if (!check_only) {
+                        tr_args = TR_add_exp(tr_args, arg_exp_type.exp.u.exp);
+                    }
                 }
                 if (formals) {
-                    EM_error(args->head->pos, "too few arguments for function %s\n",
+                    EM_error(exp->pos, "too few arguments for function %s\n",
                             S_name(exp->u.call.func));
                 } else if (args) {
                     EM_error(args->head->pos, "too many arguments for function %s\n",
                             S_name(exp->u.call.func));
                 }
+                bool has_result = function_entry->u.fun.result &&
+                    function_entry->u.fun.result->kind != T_VOID;
+                if (check_only) {
+                    return has_result ? SEM_checked_exp(function_entry->u.fun.result)
+                        : SEM_checked_stm(function_entry->u.fun.result);
+                }
+                // An error in an argument has already been reported.
+                if (!translated) {
+                    return make_SEM_ExpType(make_TR_TransNone(), function_entry->u.fun.result);
+                }
                 TR_TransExp tr;
-                if (function_entry->u.fun.result && function_entry->u.fun.result->kind != T_VOID) {
+                if (has_result) {
                     tr = make_TR_TransExp(make_TR_FCallExp(venv, exp->u.call.func, tr_args));
                 } else {
                     tr = make_TR_TransStm(make_TR_PCallStm(exp->u.call.func, tr_args));
@@ -250,12 +401,13 @@ SEM_ExpType SEM_trans_exp(S_Table venv, S_Table tenv, TR_Function func, A_Exp ex
                 T_Type record_type = S_look(tenv, exp->u.record.type);
                 if (!record_type || record_type->kind != T_RECORD) {
                     EM_error(exp->pos, "not a record type: %s", S_name(exp->u.record.type));
-                    return make_SEM_ExpType(NULL, make_T_Record(NULL));
+                    return make_SEM_ExpType(make_TR_TransNone(), make_T_Record(NULL));
                 }
                 T_FieldList fields;
                 A_EFieldList efields;
                 int size = 0;
                 TR_ExpList tr_fields = NULL;
+                bool translated = true;
                 for (
                         efields = exp->u.record.fields, fields = record_type->u.record;
                         efields && fields;
@@ -266,18 +418,34 @@ SEM_ExpType SEM_trans_exp(S_Table venv, S_Table tenv, TR_Function func, A_Exp ex
                                 S_name(efields->head->name), S_name(fields->head->name));
                     }
                     SEM_ExpType efield_exp_type = SEM_trans_exp(venv, tenv, func, efields->head->exp);
-                    if (!SEM_types_agree(efield_exp_type->type, fields->head->type)) {
+                    if (!SEM_types_agree(efield_exp_type.type, fields->head->type)) {
                         EM_error(exp->pos, "unexpected type for field %s\n",
                                 S_name(efields->head->name));
                     }
-                    tr_fields = TR_add_exp(tr_fields, efield_exp_type->exp->u.exp);
-                    size += T_size(efield_exp_type->type);
+                    // Fields are laid out by their declared types: nil has no
+                    // size of its own, and a parenthesized value records none.
+                    int field_size = T_size(fields->head->type);
+                    if (efield_exp_type.exp.kind != TR_EXP) {
+                        translated = false;
+                    } else if (!check_only) {
+                        TR_Exp init = efield_exp_type.exp.u.exp;
+                        init->size = field_size;
+                        tr_fields = TR_add_exp(tr_fields, init);
+                    }
+                    size += field_size;
                 }
                 if (fields) {
                     EM_error(exp->pos, "too few fields — missing field %s\n", fields->head->name);
                 } else if (efields) {
                     EM_error(exp->pos, "too many fields — unexpected field %s\n", efields->head->name);
                 }
+                if (check_only) {
+                    return SEM_checked_exp(record_type);
+                }
+                // An error in a field has already been reported.
+                if (!translated) {
+                    return make_SEM_ExpType(make_TR_TransNone(), record_type);
+                }
                 TR_TransExp tr = make_TR_TransExp(make_TR_RecordExp(size, tr_fields));
                 return make_SEM_ExpType(tr, record_type);
             }
@@ -290,26 +458,30 @@ SEM_ExpType SEM_trans_exp(S_Table venv, S_Table tenv, TR_Function func, A_Exp ex
                 }
                 T_Type element_type = SEM_actual_type(tenv, array_type->u.array);
                 SEM_ExpType init_exp_type = SEM_trans_exp(venv, tenv, func, exp->u.array.init);
-                if (!init_exp_type || init_exp_type->type->kind != element_type->kind) {
+                if (!init_exp_type.type || init_exp_type.type->kind != element_type->kind) {
                     EM_error(exp->u.array.init->pos, "initializer's type does not match array's declared type\n");
-                    return make_SEM_ExpType(NULL, array_type);
+                    return make_SEM_ExpType(make_TR_TransNone(), array_type);
                 }
                 TR_Exp tr_init_exp = NULL;
-                if (init_exp_type->exp) {
-                    tr_init_exp = init_exp_type->exp->u.exp;
+                if (init_exp_type.exp.kind != TR_NONE) {
+                    tr_init_exp = init_exp_type.exp.u.exp;
                 } else {
                     EM_error(exp->u.array.init->pos, "unrecognized array initializer\n");
-                    tr_init_exp = make_TR_NumExp(0);
+                    tr_init_exp = check_only ? &checked_exp : make_TR_NumExp(0);
                 }
                 int size = 0;
                 SEM_ExpType size_exp_type = SEM_trans_exp(venv, tenv, func, exp->u.array.size);
-                if (!size_exp_type || size_exp_type->type->kind != T_INT) {
+                if (!size_exp_type.type || size_exp_type.type->kind != T_INT) {
                     EM_error(exp->u.array.size->pos, "array size expression does not evaluate to an integer\n");
                 }
-                if (!size_exp_type->exp || size_exp_type->exp->kind != TR_EXP) {
+                if (size_exp_type.exp.kind == TR_NONE || size_exp_type.exp.kind != TR_EXP) {
                     EM_error(exp->u.array.size->pos, "unrecognizable array size");
-                } else {
-                    size = size_exp_type->exp->u.exp->u.num * T_size(element_type);
+                } else if (size_exp_type.exp.u.exp->kind == TR_NUM_EXP) {
+                    // Only an array of constant length has a size known here.
+                    size = size_exp_type.exp.u.exp->u.num * T_size(element_type);
+                }
+                if (check_only) {
+                    return SEM_checked_exp(array_type);
                 }
                 TR_TransExp tr = make_TR_TransExp(make_TR_ArrayExp(size, tr_init_exp));
                 return make_SEM_ExpType(tr, array_type);
@@ -318,25 +490,38 @@ SEM_ExpType SEM_trans_exp(S_Table venv, S_Table tenv, TR_Function func, A_Exp ex
             {
                 TR_StmList stms = NULL;
                 T_Type seq_type = make_T_Void();
+                bool translated = true;
                 if (exp->u.seq) {
                     A_ExpList el;
                     for (el = exp->u.seq; el->tail; el = el->tail) {
                         SEM_ExpType exp_type = SEM_trans_exp(venv, tenv, func, el->head);
-                        if (exp_type && exp_type->exp && exp_type->exp->kind == TR_STM) {
-                            stms = TR_add_stm(stms, exp_type->exp->u.stm);
+                        // An expression's value is dropped, but not its effects.
+                        if (check_only) {
+                            // Nothing to collect.
+                        } else if (exp_type.exp.kind == TR_EXP) {
+                            stms = TR_add_stm(stms, make_TR_ExpStm(exp_type.exp.u.exp));
+                        } else if (exp_type.exp.kind == TR_STM) {
+                            stms = TR_add_stm(stms, exp_type.exp.u.stm);
                         }
                     }
                     SEM_ExpType last_exp_type = SEM_trans_exp(venv, tenv, func, el->head);
-                    if (last_exp_type) {
-                        if (last_exp_type->exp) {
-                            if (last_exp_type->exp->kind == TR_EXP) {
-                                stms = TR_add_stm(stms, make_TR_ExpStm(last_exp_type->exp->u.exp));
-                            } else if (last_exp_type->exp->kind == TR_STM) {
-                                stms = TR_add_stm(stms, last_exp_type->exp->u.stm);
-                            }
-                        }
-                        seq_type = last_exp_type->type;
+                    if (check_only) {
+                        // Nothing to collect.
+                    } else if (last_exp_type.exp.kind == TR_EXP) {
+                        stms = TR_add_stm(stms, make_TR_ExpStm(last_exp_type.exp.u.exp));
+                    } else if (last_exp_type.exp.kind == TR_STM) {
+                        stms = TR_add_stm(stms, last_exp_type.exp.u.stm);
                     }
+                    seq_type = last_exp_type.type;
+                    translated = last_exp_type.exp.kind != TR_NONE;
+                }
+                if (check_only) {
+                    return make_SEM_ExpType(make_TR_TransExp(&checked_seq_exp), seq_type);
+                }
+                // An error in the last expression, whose value this is, has
+                // already been reported.
+                if (!translated) {
+                    return make_SEM_ExpType(make_TR_TransNone(), seq_type);
                 }
                 TR_TransExp tr = make_TR_TransExp(make_TR_SeqExp(stms));
                 return make_SEM_ExpType(tr, seq_type);
@@ -345,22 +530,24 @@ SEM_ExpType SEM_trans_exp(S_Table venv, S_Table tenv, TR_Function func, A_Exp ex
             {
                 SEM_ExpType var_exp_type = SEM_trans_var(venv, tenv, func, exp->u.assign.var);
                 SEM_ExpType val_exp_type = SEM_trans_exp(venv, tenv, func, exp->u.assign.exp);
-                TR_TransExp tr;
-		if (!var_exp_type || !var_exp_type->type) {
+                TR_TransExp tr = make_TR_TransNone();
+		if (!var_exp_type.type) {
                     EM_error(exp->u.assign.var->pos,
                             "cannot resolve type of variable\n");
                 }
-                if (!val_exp_type || !val_exp_type->type) {
+                if (!val_exp_type.type) {
                     EM_error(exp->u.assign.exp->pos,
                             "cannot resolve type of value assigned to variable\n");
                 }
-                if (!SEM_types_agree(var_exp_type->type, val_exp_type->type)) {
+                if (!SEM_types_agree(var_exp_type.type, val_exp_type.type)) {
                     EM_error(exp->pos, "assignment variable and expression types differ\n");
                 }
-                if (val_exp_type && val_exp_type->exp && val_exp_type->exp->kind == TR_EXP
-                        && var_exp_type && var_exp_type->exp && var_exp_type->exp->kind == TR_EXP) {
-                    TR_Exp tr_value = val_exp_type->exp->u.exp;
-                    TR_Exp tr_var = var_exp_type->exp->u.exp;
+                if (val_exp_type.exp.kind == TR_EXP && var_exp_type.exp.kind == TR_EXP) {
+                    if (check_only) {
+                        return SEM_checked_stm(make_T_Void());
+                    }
+                    TR_Exp tr_value = val_exp_type.exp.u.exp;
+                    TR_Exp tr_var = var_exp_type.exp.u.exp;
                     TR_Stm tr_assign = make_TR_AssignStm(tr_value, tr_var);
                     tr = make_TR_TransStm(tr_assign);
                 }
@@ -373,29 +560,42 @@ SEM_ExpType SEM_trans_exp(S_Table venv, S_Table tenv, TR_Function func, A_Exp ex
         case A_WHILE_EXP:
             {
                 SEM_ExpType test_exp_type = SEM_trans_exp(venv, tenv, func, exp->u.whilee.test);
-                if (!test_exp_type || test_exp_type->type->kind != T_INT) {
+                if (!test_exp_type.type || test_exp_type.type->kind != T_INT) {
                     EM_error(exp->u.whilee.test->pos, "test expression must evaluate to an integer\n");
                 }
                 TR_Exp tr_test_exp = NULL;
-                if (test_exp_type->exp && test_exp_type->exp->kind == TR_EXP) {
-                	tr_test_exp = test_exp_type->exp->u.exp;
+                if (test_exp_type.exp.kind == TR_EXP) {
+                	tr_test_exp = test_exp_type.exp.u.exp;
 		}
-                TR_Stm tr_while_stm = make_TR_WhileStm(tr_test_exp, NULL);
-                TR_push_loop(tr_while_stm->u.while_.skip_label);
+                TR_Stm tr_while_stm = NULL;
+                if (check_only) {
+                    // Only whether a loop encloses a break matters.
+                    TR_push_loop(0);
+                } else {
+                    tr_while_stm = make_TR_WhileStm(tr_test_exp, NULL);
+                    TR_push_loop(tr_while_stm->u.while_.skip_label);
+                }
                 SEM_ExpType body_exp_type = SEM_trans_exp(venv, tenv, func, exp->u.whilee.body);
                 TR_pop_loop();
-                if (!body_exp_type || body_exp_type->type->kind != T_VOID) {
+                if (!body_exp_type.type || body_exp_type.type->kind != T_VOID) {
                     EM_error(exp->u.whilee.body->pos, "while-loop body must have no value");
                 }
+                if (check_only) {
+                    return SEM_checked_stm(make_T_Void());
+                }
                 TR_Stm tr_body_stm = NULL;
-                if (body_exp_type->exp) {
-                    if (body_exp_type->exp->kind == TR_STM) {
-                    	tr_body_stm = body_exp_type->exp->u.stm;
-                    } else if (body_exp_type->exp->kind == TR_EXP &&
-                            body_exp_type->exp->u.exp->kind == TR_SEQ_EXP) {
-                        tr_body_stm = TR_convert_seq_exp_to_stm(body_exp_type->exp->u.exp);
+                if (body_exp_type.exp.kind != TR_NONE) {
+                    if (body_exp_type.exp.kind == TR_STM) {
+                    	tr_body_stm = body_exp_type.exp.u.stm;
+                    } else if (body_exp_type.exp.kind == TR_EXP &&
+                            body_exp_type.exp.u.exp->kind == TR_SEQ_EXP) {
+                        tr_body_stm = TR_convert_seq_exp_to_stm(body_exp_type.exp.u.exp);
                     }
                 }
+                // An error in the test or the body has already been reported.
+                if (!tr_test_exp || !tr_body_stm) {
+                    return make_SEM_ExpType(make_TR_TransNone(), make_T_Void());
+                }
                 tr_while_stm->u.while_.body = tr_body_stm;
                 TR_TransExp tr = make_TR_TransStm(tr_while_stm);
                 return make_SEM_ExpType(tr, make_T_Void());
@@ -404,45 +604,60 @@ SEM_ExpType SEM_trans_exp(S_Table venv, S_Table tenv, TR_Function func, A_Exp ex
             {
                 SEM_ExpType lo_exp_type = SEM_trans_exp(venv, tenv, func, exp->u.forr.lo);
                 SEM_ExpType hi_exp_type = SEM_trans_exp(venv, tenv, func, exp->u.forr.hi);
-                if (!lo_exp_type || lo_exp_type->type->kind != T_INT) {
+                if (!lo_exp_type.type || lo_exp_type.type->kind != T_INT) {
                     EM_error(exp->u.forr.lo->pos, "lower bound expression must evaluate to an integer\n");
                 }
                 TR_Exp tr_lo_exp = NULL;
-                if (lo_exp_type->exp && lo_exp_type->exp->kind == TR_EXP) {
-                    tr_lo_exp = lo_exp_type->exp->u.exp;
+                if (lo_exp_type.exp.kind == TR_EXP) {
+                    tr_lo_exp = lo_exp_type.exp.u.exp;
                 }
-                if (!hi_exp_type || hi_exp_type->type->kind != T_INT) {
+                if (!hi_exp_type.type || hi_exp_type.type->kind != T_INT) {
                     EM_error(exp->u.forr.hi->pos, "upper bound expression must evaluate to an integer\n");
                 }
                 TR_Exp tr_hi_exp = NULL;
-                if (hi_exp_type->exp && hi_exp_type->exp->kind == TR_EXP) {
-                    tr_hi_exp = hi_exp_type->exp->u.exp;
+                if (hi_exp_type.exp.kind == TR_EXP) {
+                    tr_hi_exp = hi_exp_type.exp.u.exp;
                 }
                 S_begin_scope(venv);
-                F_add_var(func->frame, make_F_Var(exp->u.forr.var, make_T_Int()));
-                S_enter(venv, exp->u.forr.var,
-                        make_E_VarEntry(lo_exp_type->type, func->frame->nesting_level, func->frame->end));
-                TR_Exp tr_mem_exp = make_TR_MemExp(venv, exp->u.forr.var);
-                TR_Exp tr_var_exp = make_TR_VarExp(tr_mem_exp);
-                TR_Stm tr_for_stm = make_TR_ForStm(tr_var_exp, tr_lo_exp, tr_hi_exp, NULL);
-                TR_push_loop(tr_for_stm->u.for_.skip_label);
+                TR_Stm tr_for_stm = NULL;
+                if (check_only) {
+                    SEM_declare(venv, exp->u.forr.var, make_E_VarEntry(lo_exp_type.type, 0, 0), exp->pos);
+                    TR_push_loop(0);
+                } else {
+                    F_Var counter = TR_add_var(func, exp->u.forr.var, make_T_Int(), exp->u.forr.escape);
+                    SEM_declare(venv, exp->u.forr.var,
+                            SEM_var_entry(func, counter, lo_exp_type.type), exp->pos);
+                    TR_Exp tr_mem_exp = make_TR_MemExp(venv, exp->u.forr.var);
+                    TR_Exp tr_var_exp = make_TR_VarExp(tr_mem_exp);
+                    tr_for_stm = make_TR_ForStm(tr_var_exp, tr_lo_exp, tr_hi_exp, NULL);
+                    TR_push_loop(tr_for_stm->u.for_.skip_label);
+                }
                 SEM_ExpType body_exp_type = SEM_trans_exp(venv, tenv, func, exp->u.forr.body);
                 TR_pop_loop();
-                if (!body_exp_type || body_exp_type->type->kind != T_VOID) {
+                if (!body_exp_type.type || body_exp_type.type->kind != T_VOID) {
                     EM_error(exp->u.forr.body->pos, "for-loop body must have no value");
                 }
                 TR_Stm tr_body_stm = NULL;
-                if (body_exp_type->exp) {
-                    if (body_exp_type->exp->kind == TR_STM) {
-                        tr_body_stm = body_exp_type->exp->u.stm;
-                    } else if (body_exp_type->exp->kind == TR_EXP &&
-                            body_exp_type->exp->u.exp->kind == TR_SEQ_EXP) {
-                        tr_body_stm = TR_convert_seq_exp_to_stm(body_exp_type->exp->u.exp);
+                if (body_exp_type.exp.kind != TR_NONE) {
+                    if (body_exp_type.exp.kind == TR_STM) {
+                        tr_body_stm = body_exp_type.exp.u.stm;
+                    } else if (body_exp_type.exp.kind == TR_EXP &&
+                            body_exp_type.exp.u.exp->kind == TR_SEQ_EXP) {
+                        if (!check_only) {
+                            tr_body_stm = TR_convert_seq_exp_to_stm(body_exp_type.exp.u.exp);
+                        }
                     } else {
                         EM_error(exp->u.forr.body->pos, "for-loop body is misread as a function.");
                     }
                 }
                 S_end_scope(venv);
+                if (check_only) {
+                    return SEM_checked_stm(make_T_Void());
+                }
+                // An error in a bound or the body has already been reported.
+                if (!tr_lo_exp || !tr_hi_exp || !tr_body_stm) {
+                    return make_SEM_ExpType(make_TR_TransNone(), make_T_Void());
+                }
                 tr_for_stm->u.for_.body = tr_body_stm;
                 TR_TransExp tr = make_TR_TransStm(tr_for_stm);
                 return make_SEM_ExpType(tr, make_T_Void());
@@ -451,6 +666,10 @@ SEM_ExpType SEM_trans_exp(S_Table venv, S_Table tenv, TR_Function func, A_Exp ex
             {
                 if (!TR_loop_list) {
                     EM_error(exp->pos, "break statement outside of a loop\n");
+                    return make_SEM_ExpType(make_TR_TransNone(), make_T_Void());
+                }
+                if (check_only) {
+                    return SEM_checked_stm(make_T_Void());
                 }
                 TR_Stm tr_break_stm = make_TR_BreakStm(TR_loop_list->head);
                 TR_TransExp tr = make_TR_TransStm(tr_break_stm);
@@ -459,39 +678,46 @@ SEM_ExpType SEM_trans_exp(S_Table venv, S_Table tenv, TR_Function func, A_Exp ex
         case A_OP_EXP:
             {
                 SEM_ExpType left = SEM_trans_exp(venv, tenv, func, exp->u.op.left);
-                if (!left || !left->type) {
+                if (!left.type) {
                     EM_error(exp->u.op.left->pos, "cannot find type for left operand\n");
-                    return make_SEM_ExpType(NULL, make_T_Int());
+                    return make_SEM_ExpType(make_TR_TransNone(), make_T_Int());
                 }
                 SEM_ExpType right = SEM_trans_exp(venv, tenv, func, exp->u.op.right);
-                if (!right || !right->type) {
+                if (!right.type) {
                     EM_error(exp->u.op.right->pos, "cannot find type for right operand");
-                    return make_SEM_ExpType(NULL, make_T_Int());
+                    return make_SEM_ExpType(make_TR_TransNone(), make_T_Int());
                 }
                 if (exp->u.op.oper == A_EQ_OP || exp->u.op.oper == A_NEQ_OP) {
-                    if (!SEM_types_agree(left->type, right->type)) {
+                    if (!SEM_types_agree(left.type, right.type)) {
                         EM_error(exp->pos, "comparison operand types differ\n");
                     }
                 } else {
-                    if (left->type->kind != T_INT) {
+                    if (left.type->kind != T_INT) {
                         EM_error(exp->u.op.left->pos, "integer required in binary operation");
                     } 
-                    if (right->type->kind != T_INT) {
+                    if (right.type->kind != T_INT) {
                         EM_error(exp->u.op.right->pos, "integer required in binary operation");
                     } 
                 }
+                if (check_only) {
+                    return SEM_checked_exp(make_T_Int());
+                }
+                // An error in an operand has already been reported.
+                if (left.exp.kind != TR_EXP || right.exp.kind != TR_EXP) {
+                    return make_SEM_ExpType(make_TR_TransNone(), make_T_Int());
+                }
                 TR_Exp tr_op_exp = NULL;
                 switch (exp->u.op.oper) {
                     case A_PLUS_OP:
                     case A_MINUS_OP:
                     case A_TIMES_OP:
-                        tr_op_exp = make_TR_ArithOpExp(left->exp->u.exp, right->exp->u.exp, exp->u.op.oper);
+                        tr_op_exp = make_TR_ArithOpExp(left.exp.u.exp, right.exp.u.exp, exp->u.op.oper);
                         break;
                     case A_DIVIDE_OP:
-                        make_TR_DivOpExp(left->exp->u.exp, right->exp->u.exp);
+                        tr_op_exp = make_TR_DivOpExp(left.exp.u.exp, right.exp.u.exp);
                         break;
                     default:
-                        make_TR_RelOpExp(left->exp->u.exp, right->exp->u.exp, exp->u.op.oper);
+                        tr_op_exp = make_TR_RelOpExp(left.exp.u.exp, right.exp.u.exp, exp->u.op.oper);
                 }
                 TR_TransExp tr = make_TR_TransExp(tr_op_exp);
                 return make_SEM_ExpType(tr, make_T_Int());
@@ -500,38 +726,317 @@ SEM_ExpType SEM_trans_exp(S_Table venv, S_Table tenv, TR_Function func, A_Exp ex
             {
                 S_begin_scope(venv);
                 S_begin_scope(tenv);
+                TR_StmList stms = NULL;
                 for (A_DecList d = exp->u.let.decs; d; d = d->tail) {
-                    SEM_trans_dec(venv, tenv, func, d->head);
+                    TR_Stm init = SEM_trans_dec(venv, tenv, func, d->head);
+                    if (init) {
+                        stms = TR_add_stm(stms, init);
+                    }
                 }
                 SEM_ExpType body_exp_type = SEM_trans_exp(venv, tenv, func, exp->u.let.body);
-                if (!body_exp_type) {
+                if (!body_exp_type.type) {
                     EM_error(exp->pos, "cannot establish type of in-clause");
-                    return make_SEM_ExpType(NULL, make_T_Void());
+                    return make_SEM_ExpType(make_TR_TransNone(), make_T_Void());
                 }
                 S_end_scope(tenv);
                 S_end_scope(venv);
-                return body_exp_type;
+                if (!stms) {
+                    return body_exp_type;
+                }
+                // The variables are initialized in order, just before the body.
+                TR_TransExp body = body_exp_type.exp;
+                if (body.kind == TR_EXP && body.u.exp->kind == TR_SEQ_EXP) {
+                    for (int i = 0, n = TR_stm_count(body.u.exp->u.seq); i < n; ++i) {
+                        stms = TR_add_stm(stms, body.u.exp->u.seq->items[i]);
+                    }
+                    body.u.exp->u.seq = stms;
+                    return body_exp_type;
+                }
+                if (body.kind == TR_EXP) {
+                    stms = TR_add_stm(stms, make_TR_ExpStm(body.u.exp));
+                    return make_SEM_ExpType(make_TR_TransExp(make_TR_SeqExp(stms)),
+                            body_exp_type.type);
+                }
+                if (body.kind == TR_STM) {
+                    stms = TR_add_stm(stms, body.u.stm);
+                }
+                return make_SEM_ExpType(make_TR_TransStm(make_TR_SeqStm(stms)), body_exp_type.type);
             }
         default:
             EM_error(exp->pos, "unrecognized expression");
-            return make_SEM_ExpType(NULL, make_T_Void());
+            return make_SEM_ExpType(make_TR_TransNone(), make_T_Void());
     }
 }
 
-void SEM_trans_dec(S_Table venv, S_Table tenv, TR_Function func, A_Dec dec) {
+void SEM_trans_function_body(S_Table venv, S_Table tenv, TR_Function func,
+        TR_Function new_function, A_FunDec fd) {
+    TRACE_begin(S_name(fd->name), "function");
+    E_EnvEntry function_entry = S_look(venv, fd->name);
+    // This also leaves no loop for a break in the body to leave.
+    TR_State enclosing_state = TR_begin_function();
+    S_begin_scope(venv);
+    A_FieldList fields;
+    T_TypeList formals;
+    for (
+            fields = fd->params, formals = function_entry->u.fun.formals;
+            fields;
+            fields = fields->tail, formals = formals->tail
+        ) {
+        if (check_only) {
+            SEM_declare(venv, fields->head->name, make_E_VarEntry(formals->head, 0, 0),
+                    fields->head->pos);
+            continue;
+        }
+        F_Var param = TR_add_param(new_function, fields->head->name, formals->head,
+                fields->head->escape);
+        SEM_declare(venv, fields->head->name,
+                SEM_var_entry(new_function, param, formals->head), fields->head->pos);
+    }
+    SEM_ExpType body_exp_type = SEM_trans_exp(venv, tenv, new_function, fd->body);
+    S_end_scope(venv);
+    if (!body_exp_type.type || !SEM_types_agree(function_entry->u.fun.result, body_exp_type.type)) {
+        EM_error(fd->pos, "function body does not return a value of the given type");
+    }
+    if (fd->body) {
+        SEM_add_code_to_function(body_exp_type, new_function);
+    }
+    TR_end_function(new_function, enclosing_state);
+    TRACE_end();
+    if (TRACE_enabled) {
+        TRACE_counter("heap bytes", STAT_allocated_bytes());
+        TRACE_counter("symbol table size", S_size(venv) + S_size(tenv));
+    }
+}
+
+/* One function body of a declaration group, checked as a pool task. */
+typedef struct SEM_BodyTask_ * SEM_BodyTask;
+
+struct SEM_BodyTask_ {
+    S_Table venv;
+    S_Table tenv;
+    TR_Function func;
+    TR_Function new_function;
+    A_FunDec fd;
+    EM_Buffer errors;
+    PL_Task task;
+};
+
+static void SEM_run_body_task(void * arg) {
+    SEM_BodyTask body_task = arg;
+    EM_Buffer enclosing_errors = EM_redirect(body_task->errors);
+    SEM_trans_function_body(body_task->venv, body_task->tenv, body_task->func,
+            body_task->new_function, body_task->fd);
+    EM_redirect(enclosing_errors);
+}
+
+/* Once a group's headers are entered, its bodies only read the
+ * environments, so each body is checked on the thread pool
+ * against its own snapshot of them, with its own error buffer.
+ * Each function numbers its own temps and labels, so joining the
+ * tasks in source order makes the diagnostics and IR identical
+ * to those of a sequential run.
+ */
+void SEM_trans_function_bodies_in_parallel(S_Table venv, S_Table tenv, TR_Function func,
+        A_FunDecList functions) {
+    int count = 0;
+    for (A_FunDecList fdl = functions; fdl; fdl = fdl->tail) {
+        ++count;
+    }
+    SEM_BodyTask body_tasks = malloc_checked(count * sizeof(*body_tasks));
+    int i = 0;
+    for (A_FunDecList fdl = functions; fdl; fdl = fdl->tail, ++i) {
+        A_FunDec fd = fdl->head;
+        TR_Function new_function = NULL;
+        if (!check_only) {
+            new_function = make_TR_Function(fd->name, make_F_Frame(func->frame->nesting_level + 1));
+            TR_append_function(func, new_function);
+        }
+        body_tasks[i].venv = S_copy(venv);
+        body_tasks[i].tenv = S_copy(tenv);
+        body_tasks[i].func = func;
+        body_tasks[i].new_function = new_function;
+        body_tasks[i].fd = fd;
+        body_tasks[i].errors = make_EM_Buffer();
+        body_tasks[i].task = PL_spawn(SEM_run_body_task, &body_tasks[i]);
+    }
+    for (i = 0; i < count; ++i) {
+        PL_join(body_tasks[i].task);
+        EM_flush(body_tasks[i].errors);
+    }
+    free(body_tasks);
+}
+
+/* Incremental re-checking.
+ * A cache remembers the translation of each top-level function
+ * (one declared directly in the program's outermost let),
+ * keyed by the fingerprint of its declaration and the frame it
+ * is declared in, together with a signature of every binding
+ * the declaration refers to: the type, level and offset of a variable,
+ * the formals and result of a function, or the identity of a type.
+ * Record and array types are identified by a signature of the
+ * type declaration group that created them.
+ * A later check of a declaration with the same fingerprint whose
+ * references all have the same signatures reuses the cached
+ * translation instead of checking the body again, so the work done
+ * is proportional to the declarations that changed, or whose
+ * dependencies did. Bodies that produced diagnostics are not cached.
+ * A cache for checking only has no translations to keep: it remembers
+ * which declarations checked cleanly, keyed by their fingerprint alone.
+ */
+
+#define SEM_CACHE_SIZE 4099
+
+typedef struct SEM_CacheEntry_ * SEM_CacheEntry;
+
+struct SEM_CacheEntry_ {
+    FP_Hash key;
+    FP_Hash dependencies;
+    TR_Function function;
+    int run;
+    SEM_CacheEntry next;
+};
+
+struct SEM_Cache_ {
+    SEM_CacheEntry buckets[SEM_CACHE_SIZE];
+    TAB_Table type_signatures;
+    bool check_only;
+    int run;
+    int reused;
+    int checked;
+};
+
+SEM_Cache make_SEM_Cache(bool check_only) {
+    SEM_Cache cache = malloc_checked(sizeof(*cache));
+    for (int i = 0; i < SEM_CACHE_SIZE; ++i) {
+        cache->buckets[i] = NULL;
+    }
+    cache->type_signatures = NULL;
+    cache->check_only = check_only;
+    cache->run = 0;
+    cache->reused = 0;
+    cache->checked = 0;
+    return cache;
+}
+
+void SEM_cache_stats(SEM_Cache cache, int * reused, int * checked) {
+    *reused = cache->reused;
+    *checked = cache->checked;
+}
+
+static FP_Hash SEM_type_signature(T_Type type) {
+    type = SEM_actual_type(NULL, type);
+    if (!type) {
+        return 0;
+    }
+    void * signature = TAB_look(active_cache->type_signatures, type);
+    if (signature) {
+        return (FP_Hash) (uintptr_t) signature;
+    }
+    FP_Hash hash = FP_combine(0, type->kind);
+    if (type->kind == T_ARRAY) {
+        hash = FP_combine(hash, SEM_type_signature(type->u.array));
+    }
+    return hash;
+}
+
+static FP_Hash SEM_dependency_signature(S_Table venv, S_Table tenv, FP_SymbolList refs) {
+    FP_Hash hash = 0;
+    for (; refs; refs = refs->tail) {
+        if (refs->is_type) {
+            hash = FP_combine(hash, SEM_type_signature(S_look(tenv, refs->sym)));
+            continue;
+        }
+        E_EnvEntry entry = S_look(venv, refs->sym);
+        if (!entry) {
+            hash = FP_combine(hash, 0);
+        } else if (entry->kind == E_VAR_ENTRY) {
+            hash = FP_combine(hash, 1);
+            hash = FP_combine(hash, SEM_type_signature(entry->u.var.type));
+            hash = FP_combine(hash, entry->u.var.nesting_level);
+            hash = FP_combine(hash, entry->u.var.offset);
+            hash = FP_combine(hash, entry->u.var.temp);
+        } else {
+            hash = FP_combine(hash, 2);
+            for (T_TypeList formals = entry->u.fun.formals; formals; formals = formals->tail) {
+                hash = FP_combine(hash, SEM_type_signature(formals->head));
+            }
+            hash = FP_combine(hash, SEM_type_signature(entry->u.fun.result));
+        }
+    }
+    return hash;
+}
+
+static SEM_CacheEntry SEM_cache_find(SEM_Cache cache, FP_Hash key) {
+    for (SEM_CacheEntry entry = cache->buckets[key % SEM_CACHE_SIZE]; entry; entry = entry->next) {
+        if (entry->key == key) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+void SEM_trans_cached_function_body(S_Table venv, S_Table tenv, TR_Function func,
+        TR_Function new_function, A_FunDec fd) {
+    SEM_Cache cache = active_cache;
+    FP_SymbolList refs;
+    FP_Hash key = FP_hash_fundec(fd, &refs);
+    if (!check_only) {
+        key = FP_combine(FP_combine(key, func->frame->nesting_level), func->frame->end);
+    }
+    FP_Hash dependencies = SEM_dependency_signature(venv, tenv, refs);
+    SEM_CacheEntry entry = SEM_cache_find(cache, key);
+    // An entry already used in this run is part of this run's IR.
+    if (entry && entry->run != cache->run && entry->dependencies == dependencies) {
+        entry->run = cache->run;
+        ++cache->reused;
+        if (check_only) {
+            return;
+        }
+        TR_Function cached = entry->function;
+        new_function->frame = cached->frame;
+        new_function->body = cached->body;
+        new_function->children = cached->children;
+        new_function->last_child = cached->last_child;
+        for (TR_FunctionList children = cached->children; children; children = children->tail) {
+            children->head->parent = new_function;
+        }
+        new_function->temp_count = cached->temp_count;
+        new_function->label_count = cached->label_count;
+        entry->function = new_function;
+        return;
+    }
+    EM_Buffer errors = make_EM_Buffer();
+    EM_Buffer enclosing_errors = EM_redirect(errors);
+    in_cached_body = true;
+    SEM_trans_function_body(venv, tenv, func, new_function, fd);
+    in_cached_body = false;
+    EM_redirect(enclosing_errors);
+    ++cache->checked;
+    if (EM_buffer_has_errors(errors)) {
+        EM_flush(errors);
+        return;
+    }
+    if (!entry) {
+        entry = malloc_checked(sizeof(*entry));
+        entry->key = key;
+        entry->next = cache->buckets[key % SEM_CACHE_SIZE];
+        cache->buckets[key % SEM_CACHE_SIZE] = entry;
+    }
+    entry->dependencies = dependencies;
+    entry->function = new_function;
+    entry->run = cache->run;
+}
+
+TR_Stm SEM_trans_dec(S_Table venv, S_Table tenv, TR_Function func, A_Dec dec) {
     switch (dec->kind) {
         case A_VAR_DEC:
             {
                 SEM_ExpType init_exp_type = SEM_trans_exp(venv, tenv, func, dec->u.var.init);
-                if (!init_exp_type) {
-                    EM_error(dec->pos, "variable declaration lacks an initializer\n");
-                    init_exp_type = make_SEM_ExpType(make_TR_TransExp(make_TR_NumExp(0)), make_T_Int());
-                }
-                if (!init_exp_type->type) {
+                if (!init_exp_type.type) {
                     EM_error(dec->u.var.init->pos, "cannot establish type for initializing expression");
-                    init_exp_type->type = make_T_Int();
+                    init_exp_type.type = make_T_Int();
                 }
-                T_Type init_type = init_exp_type->type;
+                T_Type init_type = init_exp_type.type;
                 if (dec->u.var.type) {
                     T_Type declared_type = S_look(tenv, dec->u.var.type);
                     if (!SEM_types_agree(declared_type, init_type)) {
@@ -542,51 +1047,28 @@ void SEM_trans_dec(S_Table venv, S_Table tenv, TR_Function func, A_Dec dec) {
                     EM_error(dec->u.var.init->pos, "nil cannot initialize a non-record variable");
                     init_type = make_T_Int();
                 }
-                TR_add_var(func, dec->u.var.var, init_type);
-                S_enter(venv, dec->u.var.var,
-                        make_E_VarEntry(init_type, func->frame->nesting_level, func->frame->end)); 
-                TR_Exp tr_var_exp = make_TR_MemExp(venv, dec->u.var.var); 
-                // Leave this: assert(init_exp_type->exp);
-                if (!init_exp_type->exp) {
-                    EM_error(dec->u.var.init->pos, "missing initializer expression");
-                    exit(EXIT_FAILURE);
+                // Checking needs only the type, so a missing translation cannot stop it.
+                if (check_only) {
+                    SEM_declare(venv, dec->u.var.var, make_E_VarEntry(init_type, 0, 0), dec->pos);
+                    break;
                 }
-                if (init_exp_type->exp->kind != TR_EXP) {
+                // The initializer's error is reported; a zero stands in for it.
+                if (init_exp_type.exp.kind == TR_NONE) {
+                    init_exp_type.exp = make_TR_TransExp(make_TR_NumExp(0));
+                }
+                if (init_exp_type.exp.kind != TR_EXP) {
                     EM_error(dec->u.var.init->pos, "unrecognizable variable initializer");
                 }
-                assert(init_exp_type->exp->kind == TR_EXP);
-                TR_Exp tr_init_exp = init_exp_type->exp->u.exp;
-                TR_Stm tr_assign_stm = make_TR_AssignStm(tr_init_exp, tr_var_exp);
-                TR_add_stm_to_function(func, tr_assign_stm);
-                break;
+                assert(init_exp_type.exp.kind == TR_EXP);
+                F_Var var = TR_add_var(func, dec->u.var.var, init_type, dec->u.var.escape);
+                SEM_declare(venv, dec->u.var.var, SEM_var_entry(func, var, init_type), dec->pos);
+                TR_Exp tr_var_exp = make_TR_MemExp(venv, dec->u.var.var); 
+                TR_Exp tr_init_exp = init_exp_type.exp.u.exp;
+                return make_TR_AssignStm(tr_init_exp, tr_var_exp);
             }
         case A_TYPE_DEC_GROUP:
             {
-                for (A_TypeDecList tdl = dec->u.type; tdl; tdl = tdl->tail) {
-                    T_Type entered_type = SEM_trans_type(tenv, tdl->head->type);
-                    S_enter(tenv, tdl->head->name, entered_type);
-                }
-                for (A_TypeDecList tdl = dec->u.type; tdl; tdl = tdl->tail) {
-                    T_Type stored_type = S_look(tenv, tdl->head->name);
-                    if (stored_type->kind == T_RECORD) {
-                        T_FieldList fields = stored_type->u.record;
-                        for (; fields; fields = fields->tail) {
-                            if (!fields->head->type) {
-                                EM_error(dec->pos, "incomplete type: field %s", S_name(fields->head->name));
-                            } else if (fields->head->type->kind == T_NAME) {
-                                T_Type field_type = S_look(tenv, fields->head->type->u.name.sym);
-                                if (field_type) {
-                                    fields->head->type = field_type;
-                                } else {
-                                    EM_error(dec->pos, "cannot resolve type for field %s", S_name(fields->head->name));
-                                }
-                            }
-                        }
-                    } else if (stored_type->kind == T_NAME && !stored_type->u.name.type) {
-                        EM_error(dec->pos, "invalid type definition cycle");
-                        return;
-                    }
-                }
+                SEM_trans_type_group(tenv, dec);
                 break;
             }
         case A_FUNCTION_DEC_GROUP:
@@ -600,52 +1082,110 @@ void SEM_trans_dec(S_Table venv, S_Table tenv, TR_Function func, A_Dec dec) {
                         result_type = make_T_Void();
                     }
                     T_TypeList formal_types = SEM_make_formal_type_list(tenv, fd->params);
-                    S_enter(venv, fd->name, make_E_FunEntry(formal_types, result_type));
+                    SEM_declare(venv, fd->name, make_E_FunEntry(formal_types, result_type), fd->pos);
+                }
+                // The group is named after its first function.
+                TRACE_begin(S_name(dec->u.function->head->name), "function group");
+                // The index is filled in source order, on one thread.
+                if (PL_active() && !active_cache && !active_index) {
+                    SEM_trans_function_bodies_in_parallel(venv, tenv, func, dec->u.function);
+                    TRACE_end();
+                    break;
                 }
                 for (A_FunDecList fdl = dec->u.function; fdl; fdl = fdl->tail) {
                     A_FunDec fd = fdl->head;
+                    if (check_only) {
+                        if (active_cache && !in_cached_body) {
+                            SEM_trans_cached_function_body(venv, tenv, func, NULL, fd);
+                        } else {
+                            SEM_trans_function_body(venv, tenv, func, NULL, fd);
+                        }
+                        continue;
+                    }
                     TR_Function new_function = make_TR_Function(fd->name, make_F_Frame(func->frame->nesting_level + 1));
                     TR_append_function(func, new_function);
-                    E_EnvEntry function_entry = S_look(venv, fd->name);
-                    S_begin_scope(venv);
-                    A_FieldList fields;
-                    T_TypeList formals;
-                    for (
-                            fields = fd->params, formals = function_entry->u.fun.formals;
-                            fields;
-                            fields = fields->tail, formals = formals->tail
-                        ) {
-                        TR_add_param(new_function, fields->head->name, formals->head);
-                        S_enter(venv, fields->head->name,
-                                make_E_VarEntry(formals->head, func->frame->nesting_level, func->frame->end));
-                    }
-                    SEM_ExpType body_exp_type = SEM_trans_exp(venv, tenv, new_function, fd->body);
-                    S_end_scope(venv);
-                    if (!body_exp_type || !SEM_types_agree(function_entry->u.fun.result, body_exp_type->type)) {
-                        EM_error(fd->pos, "function body does not return a value of the given type");
-                    }
-                    if (fd->body) {
-                        SEM_add_code_to_function(body_exp_type, new_function);
+                    if (active_cache && !in_cached_body) {
+                        SEM_trans_cached_function_body(venv, tenv, func, new_function, fd);
+                    } else {
+                        SEM_trans_function_body(venv, tenv, func, new_function, fd);
                     }
                 }
+                TRACE_end();
                 break;
             }
         default:
             EM_error(dec->pos, "unrecognized declaration");
             break;
     }
+    return NULL;
+}
+
+/* The base environments built by SEM_prebuild_base_envs, if any.
+ * Every program leaves the scopes it opens, so they can be shared. */
+static S_Table base_venv = NULL;
+static S_Table base_tenv = NULL;
+
+void SEM_prebuild_base_envs() {
+    base_venv = E_base_venv();
+    base_tenv = E_base_tenv();
 }
 
 SEM_ExpType SEM_trans_prog(A_Exp prog) {
-    S_Table venv = E_base_venv();
-    S_Table tenv = E_base_tenv();
+    ESC_find_escapes(prog);
+    TR_State enclosing_state = TR_begin_function();
+    S_Table venv = base_venv ? base_venv : E_base_venv();
+    S_Table tenv = base_tenv ? base_tenv : E_base_tenv();
     F_Frame main_frame = make_F_Frame(0); 
     TR_Function main_ = make_TR_Function(make_S_Symbol("main"), main_frame);
     SEM_ExpType exp_type = SEM_trans_exp(venv, tenv, main_, prog);
-    if (exp_type->exp) {
+    if (exp_type.exp.kind != TR_NONE) {
         SEM_add_code_to_function(exp_type, main_);
     }
-    exp_type->exp = make_TR_TransFunction(main_);
+    TR_end_function(main_, enclosing_state);
+    exp_type.exp = make_TR_TransFunction(main_);
+    return exp_type;
+}
+
+/* Checks prog like SEM_trans_prog, reporting the same diagnostics and
+ * result type, but without translating it: the result has no IR.
+ */
+SEM_ExpType SEM_check_prog(A_Exp prog) {
+    TR_State enclosing_state = TR_begin_function();
+    S_Table venv = base_venv ? base_venv : E_base_venv();
+    S_Table tenv = base_tenv ? base_tenv : E_base_tenv();
+    check_only = true;
+    SEM_ExpType exp_type = SEM_trans_exp(venv, tenv, NULL, prog);
+    check_only = false;
+    TR_end_function(NULL, enclosing_state);
+    exp_type.exp = make_TR_TransNone();
+    return exp_type;
+}
+
+/* Checks prog like SEM_check_prog, recording in index every value
+ * declared and every use of one, with the declaration it resolves to.
+ */
+SEM_ExpType SEM_check_prog_indexed(A_Exp prog, XR_Index index) {
+    active_index = index;
+    SEM_ExpType exp_type = SEM_check_prog(prog);
+    active_index = NULL;
+    return exp_type;
+}
+
+/* Checks prog like SEM_trans_prog, reusing the translations of
+ * unchanged top-level functions from earlier runs with the same cache.
+ * The IR returned by an earlier run may share nodes with this one,
+ * which takes them over, so only the latest result should be used.
+ * With a cache made for checking only, checks prog like SEM_check_prog,
+ * skipping the unchanged top-level functions that checked cleanly.
+ */
+SEM_ExpType SEM_recheck_prog(SEM_Cache cache, A_Exp prog) {
+    ++cache->run;
+    cache->type_signatures = TAB_empty();
+    cache->reused = 0;
+    cache->checked = 0;
+    active_cache = cache;
+    SEM_ExpType exp_type = cache->check_only ? SEM_check_prog(prog) : SEM_trans_prog(prog);
+    active_cache = NULL;
     return exp_type;
 }
 
@@ -662,6 +1202,11 @@ T_TypeList SEM_make_formal_type_list(S_Table tenv, A_FieldList params) {
     return type_list;
 }
 
+/* Translates the right-hand side of one type declaration.
+ * Names are looked up as they stand; within a declaration group
+ * they resolve to the group's T_NAME placeholders, which
+ * SEM_trans_type_group links up afterwards.
+ */
 T_Type SEM_trans_type(S_Table tenv, A_Type type) {
     if (!type) {
         return NULL;
@@ -670,7 +1215,10 @@ T_Type SEM_trans_type(S_Table tenv, A_Type type) {
         case A_NAME_TYPE:
             {
                 T_Type stored_type = S_look(tenv, type->u.name);
-                return make_T_Name(type->u.name, stored_type);
+                if (!stored_type) {
+                    EM_error(type->pos, "undefined type %s", S_name(type->u.name));
+                }
+                return stored_type;
             }
         case A_RECORD_TYPE:
             {
@@ -681,7 +1229,9 @@ T_Type SEM_trans_type(S_Table tenv, A_Type type) {
                     for (; a_fields; a_fields = a_fields->tail) {
                         T_Type t_field_type = S_look(tenv, a_fields->head->type);
                         if (!t_field_type) {
-                            t_field_type = make_T_Name(a_fields->head->type, NULL);
+                            EM_error(a_fields->head->pos, "cannot resolve type for field %s",
+                                    S_name(a_fields->head->name));
+                            t_field_type = make_T_Int();
                         }
                         T_Field t_field = make_T_Field(a_fields->head->name, t_field_type);
                         T_FieldList new_t_field_node = make_T_FieldList(t_field, NULL);
@@ -698,18 +1248,152 @@ T_Type SEM_trans_type(S_Table tenv, A_Type type) {
             }
         case A_ARRAY_TYPE:
             {
-                return make_T_Array(S_look(tenv, type->u.array));
+                T_Type element_type = S_look(tenv, type->u.array);
+                if (!element_type) {
+                    EM_error(type->pos, "undefined type %s", S_name(type->u.array));
+                    element_type = make_T_Int();
+                }
+                return make_T_Array(element_type);
             }
 
     }
     return NULL;
 }
 
-T_Type SEM_actual_type(S_Table tenv, T_Type type) {
-    if (!type) {
-        return NULL;
+/* Resolution state of a T_NAME placeholder within its declaration group. */
+typedef struct SEM_NameMark_ * SEM_NameMark;
+
+struct SEM_NameMark_ {
+    enum { SEM_NAME_UNVISITED, SEM_NAME_ON_PATH, SEM_NAME_DONE } state;
+    int path_index;
+    T_Type name;
+};
+
+void SEM_report_type_cycle(A_Pos pos, SEM_NameMark * cycle, int length) {
+    int message_length = 1;
+    for (int i = 0; i <= length; ++i) {
+        message_length += strlen(S_name(cycle[i % length]->name->u.name.sym)) + 4;
+    }
+    string message = malloc_checked(message_length);
+    message[0] = '\0';
+    for (int i = 0; i <= length; ++i) {
+        if (i) {
+            strcat(message, " -> ");
+        }
+        strcat(message, S_name(cycle[i % length]->name->u.name.sym));
+    }
+    EM_error(pos, "invalid type definition cycle: %s", message);
+    free(message);
+}
+
+/* Resolves a mutually recursive group of type declarations.
+ * Every name in the group is first entered as a T_NAME placeholder,
+ * so that right-hand sides may refer to any name in the group.
+ * Each placeholder then has at most one outgoing alias edge
+ * (type a = b), so the strongly connected components of the alias
+ * graph are simple cycles, which a single coloured walk finds:
+ * a walk that reaches a placeholder already on its own path has
+ * found exactly the members of one cycle, and every placeholder is
+ * visited once, making the pass linear in the size of the group.
+ * The walk path-compresses each placeholder to point straight at
+ * its actual type, rebinds the name to that type, and replaces
+ * placeholders inside record fields and array elements,
+ * so SEM_actual_type never has to follow a chain.
+ */
+void SEM_trans_type_group(S_Table tenv, A_Dec dec) {
+    int count = 0;
+    for (A_TypeDecList tdl = dec->u.type; tdl; tdl = tdl->tail) {
+        ++count;
+    }
+    SEM_NameMark marks = malloc_checked(count * sizeof(*marks));
+    T_Type * bodies = malloc_checked(count * sizeof(*bodies));
+    SEM_NameMark * path = malloc_checked(count * sizeof(*path));
+    TAB_Table mark_table = TAB_empty();
+    FP_Hash group_signature = 0;
+    if (active_cache) {
+        FP_SymbolList refs;
+        group_signature = FP_hash_type_decs(dec->u.type, &refs);
+        for (; refs; refs = refs->tail) {
+            group_signature = FP_combine(group_signature, SEM_type_signature(S_look(tenv, refs->sym)));
+        }
+    }
+    int i = 0;
+    for (A_TypeDecList tdl = dec->u.type; tdl; tdl = tdl->tail, ++i) {
+        marks[i].state = SEM_NAME_UNVISITED;
+        marks[i].path_index = -1;
+        marks[i].name = make_T_Name(tdl->head->name, NULL);
+        TAB_enter(mark_table, marks[i].name, &marks[i]);
+        S_enter(tenv, tdl->head->name, marks[i].name);
+    }
+    i = 0;
+    for (A_TypeDecList tdl = dec->u.type; tdl; tdl = tdl->tail, ++i) {
+        bodies[i] = SEM_trans_type(tenv, tdl->head->type);
+        marks[i].name->u.name.type = bodies[i];
+    }
+    i = 0;
+    for (A_TypeDecList tdl = dec->u.type; tdl; tdl = tdl->tail, ++i) {
+        if (marks[i].state != SEM_NAME_UNVISITED) {
+            continue;
+        }
+        int path_length = 0;
+        T_Type actual = NULL;
+        T_Type current = marks[i].name;
+        while (!actual) {
+            SEM_NameMark mark = TAB_look(mark_table, current);
+            if (!mark || mark->state == SEM_NAME_DONE) {
+                /* Names outside the group, and finished ones, are already compressed. */
+                actual = current->u.name.type;
+                break;
+            }
+            if (mark->state == SEM_NAME_ON_PATH) {
+                SEM_report_type_cycle(tdl->head->type->pos, path + mark->path_index,
+                        path_length - mark->path_index);
+                actual = make_T_Int();
+                break;
+            }
+            mark->state = SEM_NAME_ON_PATH;
+            mark->path_index = path_length;
+            path[path_length++] = mark;
+            T_Type next = current->u.name.type;
+            if (!next) {
+                /* Undefined right-hand side, already reported. */
+                actual = make_T_Int();
+            } else if (next->kind != T_NAME) {
+                actual = next;
+            } else {
+                current = next;
+            }
+        }
+        for (int j = 0; j < path_length; ++j) {
+            path[j]->name->u.name.type = actual;
+            path[j]->state = SEM_NAME_DONE;
+        }
+    }
+    i = 0;
+    for (A_TypeDecList tdl = dec->u.type; tdl; tdl = tdl->tail, ++i) {
+        if (bodies[i] && bodies[i]->kind == T_RECORD) {
+            for (T_FieldList fields = bodies[i]->u.record; fields; fields = fields->tail) {
+                fields->head->type = SEM_actual_type(tenv, fields->head->type);
+            }
+        } else if (bodies[i] && bodies[i]->kind == T_ARRAY) {
+            bodies[i]->u.array = SEM_actual_type(tenv, bodies[i]->u.array);
+        }
+        S_enter(tenv, tdl->head->name, marks[i].name->u.name.type);
+        if (active_cache && bodies[i] && (bodies[i]->kind == T_RECORD || bodies[i]->kind == T_ARRAY)) {
+            FP_Hash signature = FP_combine(group_signature, i) | 1;
+            TAB_enter(active_cache->type_signatures, bodies[i], (void *) (uintptr_t) signature);
+        }
     }
-    while (type->kind == T_NAME) {
+    free(path);
+    free(bodies);
+    free(marks);
+}
+
+/* Every T_NAME is path-compressed by SEM_trans_type_group,
+ * so at most one step separates a name from its actual type.
+ */
+T_Type SEM_actual_type(S_Table tenv, T_Type type) {
+    if (type && type->kind == T_NAME) {
         type = type->u.name.type;
     }
     return type;
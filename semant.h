@@ -15,18 +15,40 @@
 #include "translate.h"
 #include "types.h"
 #include "util.h"
+#include "xref.h"
 
-typedef struct SEM_ExpType_ * SEM_ExpType;
+typedef struct SEM_ExpType_ SEM_ExpType;
+typedef struct SEM_Cache_ * SEM_Cache;
 
+/* The result of checking an expression: its translation and type.
+ * Small enough to be returned by value; a NULL type means
+ * the type could not be established.
+ */
 struct SEM_ExpType_ {
     TR_TransExp exp;
     T_Type type;
 };
 
-SEM_ExpType make_ExpType(TR_TransExp exp, T_Type type);
+SEM_ExpType make_SEM_ExpType(TR_TransExp exp, T_Type type);
 
 SEM_ExpType SEM_trans_var(S_Table venv, S_Table tenv, TR_Function func, A_Var var);
 SEM_ExpType SEM_trans_exp(S_Table venv, S_Table tenv, TR_Function func, A_Exp exp);
-void SEM_trans_dec(S_Table venv, S_Table tenv, TR_Function func, A_Dec dec);
+/* Returns the statement that initializes a variable declaration,
+ * which runs where the declaration is, or NULL. */
+TR_Stm SEM_trans_dec(S_Table venv, S_Table tenv, TR_Function func, A_Dec dec);
 T_Type SEM_trans_type(S_Table tenv, A_Type type);
 SEM_ExpType SEM_trans_prog(A_Exp prog);
+
+/* Build the base environments once, for every later program
+ * checked by this process (or its forks) to share. */
+void SEM_prebuild_base_envs();
+
+/* Type-check only, building no IR, and optionally indexing names:
+ * see SEM_check_prog and SEM_check_prog_indexed in semant.c. */
+SEM_ExpType SEM_check_prog(A_Exp prog);
+SEM_ExpType SEM_check_prog_indexed(A_Exp prog, XR_Index index);
+
+/* Incremental checking: see SEM_recheck_prog in semant.c. */
+SEM_Cache make_SEM_Cache(bool check_only);
+SEM_ExpType SEM_recheck_prog(SEM_Cache cache, A_Exp prog);
+void SEM_cache_stats(SEM_Cache cache, int * reused, int * checked);
@@ -0,0 +1,239 @@
+/*
+ * server.c -
+ * Implementation of the compile daemon and its client.
+ * See server.h for more information.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "server.h"
+
+/* The descriptors passed with a request: the client's standard
+ * input, output and error, and its working directory. */
+#define SV_FDS 4
+
+/* The fixed part of a request, followed by the arguments, each
+ * terminated by a NUL, filling length bytes. */
+typedef struct SV_Header_ {
+    int argc;
+    int length;
+} SV_Header;
+
+static bool SV_write_all(int fd, const void * data, size_t size) {
+    const char * p = data;
+    while (size) {
+        ssize_t written = write(fd, p, size);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        p += written;
+        size -= written;
+    }
+    return true;
+}
+
+static bool SV_read_all(int fd, void * data, size_t size) {
+    char * p = data;
+    while (size) {
+        ssize_t got = read(fd, p, size);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            return false;
+        }
+        p += got;
+        size -= got;
+    }
+    return true;
+}
+
+static bool SV_make_address(string socket_path, struct sockaddr_un * address) {
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(address->sun_path)) {
+        fprintf(stderr, "socket path too long: %s\n", socket_path);
+        return false;
+    }
+    strcpy(address->sun_path, socket_path);
+    return true;
+}
+
+/* Reads a request from the connection: the header and the
+ * descriptors that come with its first byte, then the arguments. */
+static char ** SV_receive_request(int connection, int * argc, int fds[SV_FDS]) {
+    SV_Header header;
+    char control[CMSG_SPACE(SV_FDS * sizeof(int))];
+    struct iovec iov = { &header, sizeof(header) };
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    ssize_t got = recvmsg(connection, &message, 0);
+    struct cmsghdr * cmsg = CMSG_FIRSTHDR(&message);
+    if (got <= 0 || !cmsg || cmsg->cmsg_type != SCM_RIGHTS
+            || cmsg->cmsg_len != CMSG_LEN(SV_FDS * sizeof(int))) {
+        return NULL;
+    }
+    memcpy(fds, CMSG_DATA(cmsg), SV_FDS * sizeof(int));
+    if (!SV_read_all(connection, (char *) &header + got, sizeof(header) - got)
+            || header.argc < 1 || header.length < header.argc) {
+        return NULL;
+    }
+    char * args = malloc_checked(header.length);
+    if (!SV_read_all(connection, args, header.length) || args[header.length - 1]) {
+        return NULL;
+    }
+    char ** argv = malloc_checked((header.argc + 1) * sizeof(*argv));
+    char * arg = args;
+    for (int i = 0; i < header.argc; ++i) {
+        if (arg >= args + header.length) {
+            return NULL;
+        }
+        argv[i] = arg;
+        arg += strlen(arg) + 1;
+    }
+    argv[header.argc] = NULL;
+    *argc = header.argc;
+    return argv;
+}
+
+/* Runs in a fork of the daemon for each connection: forks again to
+ * compile in the client's directory with the client's streams,
+ * then reports the compile's exit status. Never returns. */
+static void SV_handle(int connection, SV_Compile compile) {
+    signal(SIGCHLD, SIG_DFL);
+    int argc;
+    int fds[SV_FDS];
+    char ** argv = SV_receive_request(connection, &argc, fds);
+    if (!argv) {
+        _exit(EXIT_FAILURE);
+    }
+    pid_t compiler = fork();
+    if (compiler == 0) {
+        close(connection);
+        if (fchdir(fds[3])) {
+            _exit(EXIT_FAILURE);
+        }
+        for (int i = 0; i < 3; ++i) {
+            dup2(fds[i], i);
+        }
+        for (int i = 0; i < SV_FDS; ++i) {
+            close(fds[i]);
+        }
+        exit(compile(argc, argv));
+    }
+    for (int i = 0; i < SV_FDS; ++i) {
+        close(fds[i]);
+    }
+    int status = EXIT_FAILURE;
+    int wait_status;
+    if (compiler > 0 && waitpid(compiler, &wait_status, 0) == compiler) {
+        status = WIFEXITED(wait_status) ? WEXITSTATUS(wait_status) : 128 + WTERMSIG(wait_status);
+    }
+    SV_write_all(connection, &status, sizeof(status));
+    _exit(EXIT_SUCCESS);
+}
+
+int SV_serve(string socket_path, SV_Compile compile) {
+    struct sockaddr_un address;
+    if (!SV_make_address(socket_path, &address)) {
+        return EXIT_FAILURE;
+    }
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        perror("socket");
+        return EXIT_FAILURE;
+    }
+    // A socket left behind by an earlier daemon would make bind fail.
+    unlink(socket_path);
+    if (bind(listener, (struct sockaddr *) &address, sizeof(address)) || listen(listener, 64)) {
+        perror(socket_path);
+        return EXIT_FAILURE;
+    }
+    // Handlers are never waited for.
+    signal(SIGCHLD, SIG_IGN);
+    for (;;) {
+        int connection = accept(listener, NULL, NULL);
+        if (connection < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            perror("accept");
+            return EXIT_FAILURE;
+        }
+        fflush(stdout);
+        fflush(stderr);
+        pid_t handler = fork();
+        if (handler == 0) {
+            close(listener);
+            SV_handle(connection, compile);
+        }
+        if (handler < 0) {
+            perror("fork");
+        }
+        close(connection);
+    }
+}
+
+int SV_forward(string socket_path, int argc, char ** argv) {
+    struct sockaddr_un address;
+    if (!SV_make_address(socket_path, &address)) {
+        return -1;
+    }
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock < 0) {
+        return -1;
+    }
+    if (connect(sock, (struct sockaddr *) &address, sizeof(address))) {
+        close(sock);
+        return -1;
+    }
+    SV_Header header = { argc, 0 };
+    for (int i = 0; i < argc; ++i) {
+        header.length += strlen(argv[i]) + 1;
+    }
+    int fds[SV_FDS] = { STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO, open(".", O_RDONLY) };
+    char control[CMSG_SPACE(SV_FDS * sizeof(int))];
+    memset(control, 0, sizeof(control));
+    struct iovec iov = { &header, sizeof(header) };
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    struct cmsghdr * cmsg = CMSG_FIRSTHDR(&message);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(SV_FDS * sizeof(int));
+    memcpy(CMSG_DATA(cmsg), fds, SV_FDS * sizeof(int));
+    bool sent = fds[3] >= 0 && sendmsg(sock, &message, 0) == sizeof(header);
+    for (int i = 0; sent && i < argc; ++i) {
+        sent = SV_write_all(sock, argv[i], strlen(argv[i]) + 1);
+    }
+    if (fds[3] >= 0) {
+        close(fds[3]);
+    }
+    int status;
+    if (!sent || !SV_read_all(sock, &status, sizeof(status))) {
+        fprintf(stderr, "compile server at %s failed to answer\n", socket_path);
+        status = EXIT_FAILURE;
+    }
+    close(sock);
+    return status;
+}
@@ -0,0 +1,28 @@
+/*
+ * server.h -
+ * A compile daemon listening on a Unix domain socket, and its client.
+ * The daemon is started once, with its warm state (interned symbols,
+ * base environments, stack segments) already built; each request
+ * then runs in a fork of it, so the request pays no process startup
+ * and everything it allocates is reclaimed when the fork exits.
+ * A request carries the client's arguments, working directory and
+ * standard streams, so the compile reads its input (a path, or the
+ * client's standard input given as "-") and streams its output and
+ * diagnostics exactly as if run by the client; the daemon then
+ * returns the compile's exit status.
+ * All types and functions declared in this module begin with "SV_".
+ */
+
+#pragma once
+
+#include "util.h"
+
+/* A compile run with the given arguments, returning an exit status. */
+typedef int (*SV_Compile)(int argc, char ** argv);
+
+/* Serve requests on the socket until killed; returns only on error. */
+int SV_serve(string socket_path, SV_Compile compile);
+
+/* Have the daemon at socket_path compile with the given arguments.
+ * Returns the compile's exit status, or -1 if no daemon is listening. */
+int SV_forward(string socket_path, int argc, char ** argv);
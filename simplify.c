@@ -0,0 +1,259 @@
+/*
+ * simplify.c -
+ * Implementation of control-flow simplification.
+ * See simplify.h for more information.
+ */
+
+#include "fold.h"
+#include "simplify.h"
+#include "stack.h"
+
+const PM_Pass SIMP_pass = { "simplify", 1, SIMP_function, NULL, NULL };
+
+static TR_Exp SIMP_exp(TR_Exp exp);
+static TR_Stm SIMP_stm(TR_Stm stm);
+
+/* Whether control never falls through stm to the statement after it. */
+static bool SIMP_jumps(TR_Stm stm) {
+    switch (stm->kind) {
+        case TR_BREAK_STM:
+            return true;
+        case TR_SEQ_STM:
+            return stm->u.seq && SIMP_jumps(stm->u.seq->items[stm->u.seq->length - 1]);
+        case TR_IF_ELSE_STM:
+            return stm->u.if_else.true_branch && SIMP_jumps(stm->u.if_else.true_branch)
+                && stm->u.if_else.false_branch && SIMP_jumps(stm->u.if_else.false_branch);
+        default:
+            return false;
+    }
+}
+
+/* A statement that evaluates exp for its effects, or NULL if it has none. */
+static TR_Stm SIMP_effect(TR_Exp exp) {
+    return FOLD_pure(exp) ? NULL : make_TR_ExpStm(exp);
+}
+
+/* The simplified statements of stms, with nested sequences spliced in.
+ * If value, the last statement is the value of the sequence or function
+ * body, which is kept as it is. */
+static TR_StmList SIMP_stms(TR_StmList stms, bool value) {
+    TR_StmList result = NULL;
+    for (int i = 0, n = TR_stm_count(stms); i < n; ++i) {
+        TR_Stm stm = stms->items[i];
+        if (value && i == n - 1 && stm && stm->kind == TR_EXP_STM) {
+            stm->u.exp = SIMP_exp(stm->u.exp);
+            result = TR_add_stm(result, stm);
+            break;
+        }
+        stm = SIMP_stm(stm);
+        if (!stm) {
+            continue;
+        }
+        if (stm->kind == TR_SEQ_STM) {
+            for (int j = 0, m = TR_stm_count(stm->u.seq); j < m; ++j) {
+                result = TR_add_stm(result, stm->u.seq->items[j]);
+            }
+        } else {
+            result = TR_add_stm(result, stm);
+        }
+        // A sequence expression must still end in its value.
+        if (!value && SIMP_jumps(stm)) {
+            break;
+        }
+    }
+    return result;
+}
+
+/* The statement a simplified branch or body is replaced with when
+ * it does nothing. */
+static TR_Stm SIMP_nothing(TR_Stm stm) {
+    return stm ? stm : make_TR_SeqStm(NULL);
+}
+
+static void SIMP_exps(TR_ExpList exps) {
+    for (int i = 0, n = TR_exp_count(exps); i < n; ++i) {
+        exps->items[i] = SIMP_exp(exps->items[i]);
+    }
+}
+
+/* A call of SIMP_exp or SIMP_stm continued on a new stack segment. */
+typedef struct SIMP_DeepCall_ {
+    TR_Exp exp;
+    TR_Stm stm;
+    TR_Exp exp_result;
+    TR_Stm stm_result;
+} SIMP_DeepCall;
+
+static void SIMP_run_deep_call(void * arg) {
+    SIMP_DeepCall * call = arg;
+    if (call->stm) {
+        call->stm_result = SIMP_stm(call->stm);
+    } else {
+        call->exp_result = SIMP_exp(call->exp);
+    }
+}
+
+static TR_Exp SIMP_exp(TR_Exp exp) {
+    if (!exp) {
+        return NULL;
+    }
+    if (ST_low()) {
+        SIMP_DeepCall call = { exp, NULL, NULL, NULL };
+        ST_call(SIMP_run_deep_call, &call);
+        return call.exp_result;
+    }
+    switch (exp->kind) {
+        case TR_NUM_EXP:
+        case TR_STRING_EXP:
+        case TR_MEM_EXP:
+            break;
+        case TR_VAR_EXP:
+            exp->u.var = SIMP_exp(exp->u.var);
+            break;
+        case TR_FIELD_EXP:
+            exp->u.field.var = SIMP_exp(exp->u.field.var);
+            break;
+        case TR_SUBSCRIPT_EXP:
+            exp->u.subscript.var = SIMP_exp(exp->u.subscript.var);
+            exp->u.subscript.index = SIMP_exp(exp->u.subscript.index);
+            break;
+        case TR_RECORD_EXP:
+            SIMP_exps(exp->u.record.fields);
+            break;
+        case TR_ARRAY_EXP:
+            exp->u.array.init = SIMP_exp(exp->u.array.init);
+            break;
+        case TR_ARITH_OP_EXP:
+            exp->u.arith.left = SIMP_exp(exp->u.arith.left);
+            exp->u.arith.right = SIMP_exp(exp->u.arith.right);
+            break;
+        case TR_DIV_OP_EXP:
+            exp->u.div.left = SIMP_exp(exp->u.div.left);
+            exp->u.div.right = SIMP_exp(exp->u.div.right);
+            break;
+        case TR_REL_OP_EXP:
+            exp->u.rel.left = SIMP_exp(exp->u.rel.left);
+            exp->u.rel.right = SIMP_exp(exp->u.rel.right);
+            break;
+        case TR_IF_EXP:
+            exp->u.if_.test = SIMP_exp(exp->u.if_.test);
+            if (exp->u.if_.test->kind == TR_NUM_EXP) {
+                return exp->u.if_.test->u.num ? SIMP_exp(exp->u.if_.true_branch)
+                    : make_TR_SeqExp(NULL);
+            }
+            exp->u.if_.true_branch = SIMP_exp(exp->u.if_.true_branch);
+            break;
+        case TR_IF_ELSE_EXP:
+            exp->u.if_else.test = SIMP_exp(exp->u.if_else.test);
+            if (exp->u.if_else.test->kind == TR_NUM_EXP) {
+                return SIMP_exp(exp->u.if_else.test->u.num ? exp->u.if_else.true_branch
+                        : exp->u.if_else.false_branch);
+            }
+            exp->u.if_else.true_branch = SIMP_exp(exp->u.if_else.true_branch);
+            exp->u.if_else.false_branch = SIMP_exp(exp->u.if_else.false_branch);
+            break;
+        case TR_FCALL_EXP:
+            SIMP_exps(exp->u.fcall.args);
+            break;
+        case TR_SEQ_EXP:
+            exp->u.seq = SIMP_stms(exp->u.seq, true);
+            break;
+    }
+    return exp;
+}
+
+/* The simplified form of stm, or NULL if it does nothing. */
+static TR_Stm SIMP_stm(TR_Stm stm) {
+    if (!stm) {
+        return NULL;
+    }
+    if (ST_low()) {
+        SIMP_DeepCall call = { NULL, stm, NULL, NULL };
+        ST_call(SIMP_run_deep_call, &call);
+        return call.stm_result;
+    }
+    switch (stm->kind) {
+        case TR_ASSIGN_STM:
+            stm->u.assign.value = SIMP_exp(stm->u.assign.value);
+            stm->u.assign.var = SIMP_exp(stm->u.assign.var);
+            return stm;
+        case TR_PCALL_STM:
+            SIMP_exps(stm->u.pcall.args);
+            return stm;
+        case TR_SEQ_STM:
+            stm->u.seq = SIMP_stms(stm->u.seq, false);
+            if (!stm->u.seq) {
+                return NULL;
+            }
+            return stm->u.seq->length == 1 ? stm->u.seq->items[0] : stm;
+        case TR_IF_STM:
+            {
+                TR_Exp test = stm->u.if_.test = SIMP_exp(stm->u.if_.test);
+                if (test->kind == TR_NUM_EXP) {
+                    return test->u.num ? SIMP_stm(stm->u.if_.true_branch) : NULL;
+                }
+                stm->u.if_.true_branch = SIMP_stm(stm->u.if_.true_branch);
+                return stm->u.if_.true_branch ? stm : SIMP_effect(test);
+            }
+        case TR_IF_ELSE_STM:
+            {
+                TR_Exp test = stm->u.if_else.test = SIMP_exp(stm->u.if_else.test);
+                if (test->kind == TR_NUM_EXP) {
+                    return SIMP_stm(test->u.num ? stm->u.if_else.true_branch
+                            : stm->u.if_else.false_branch);
+                }
+                TR_Stm true_branch = SIMP_stm(stm->u.if_else.true_branch);
+                TR_Stm false_branch = SIMP_stm(stm->u.if_else.false_branch);
+                if (!true_branch && !false_branch) {
+                    return SIMP_effect(test);
+                }
+                stm->u.if_else.true_branch = SIMP_nothing(true_branch);
+                stm->u.if_else.false_branch = SIMP_nothing(false_branch);
+                return stm;
+            }
+        case TR_WHILE_STM:
+            stm->u.while_.test = SIMP_exp(stm->u.while_.test);
+            if (stm->u.while_.test->kind == TR_NUM_EXP && !stm->u.while_.test->u.num) {
+                return NULL;
+            }
+            stm->u.while_.body = SIMP_nothing(SIMP_stm(stm->u.while_.body));
+            return stm;
+        case TR_FOR_STM:
+            {
+                TR_Exp lo = stm->u.for_.lo = SIMP_exp(stm->u.for_.lo);
+                TR_Exp hi = stm->u.for_.hi = SIMP_exp(stm->u.for_.hi);
+                if (lo->kind == TR_NUM_EXP && hi->kind == TR_NUM_EXP && lo->u.num > hi->u.num) {
+                    return NULL;
+                }
+                TR_Stm body = SIMP_stm(stm->u.for_.body);
+                // A loop with a bounded trip count and no body does nothing.
+                if (!body && FOLD_pure(lo) && FOLD_pure(hi)) {
+                    return NULL;
+                }
+                stm->u.for_.body = SIMP_nothing(body);
+                return stm;
+            }
+        case TR_BREAK_STM:
+            return stm;
+        case TR_EXP_STM:
+            {
+                TR_Exp exp = stm->u.exp;
+                if (exp && exp->kind == TR_SEQ_EXP) {
+                    // The value is unused, so the sequence is just its statements.
+                    exp->u.seq = SIMP_stms(exp->u.seq, false);
+                    return exp->u.seq ? TR_convert_seq_exp_to_stm(exp) : NULL;
+                }
+                exp = stm->u.exp = SIMP_exp(exp);
+                if (exp && exp->kind == TR_SEQ_EXP) {
+                    return exp->u.seq ? TR_convert_seq_exp_to_stm(exp) : NULL;
+                }
+                return exp && !FOLD_pure(exp) ? stm : NULL;
+            }
+    }
+    return stm;
+}
+
+void SIMP_function(TR_Function func) {
+    // A function's value, if any, is that of the last statement of its body.
+    func->body = SIMP_stms(func->body, true);
+}
@@ -0,0 +1,25 @@
+/*
+ * simplify.h -
+ * Control-flow simplification of the TR IR.
+ * A conditional whose test is a constant becomes the branch it
+ * takes (or nothing); a while loop whose test is 0 disappears, as
+ * does a for loop whose constant bounds are out of order or whose
+ * body is empty and bounds have no side effects. Nested statement
+ * sequences are flattened into their enclosing list, statements
+ * that compute nothing are dropped, and whatever follows a statement
+ * that always breaks out of its loop is deleted as unreachable.
+ * Run after folding, which turns guards such as if 1 then ... into
+ * constant tests.
+ * All types and functions declared in this module begin with "SIMP_".
+ */
+
+#pragma once
+
+#include "pass_manager.h"
+#include "translate.h"
+
+/* Simplify the control flow of func's body. */
+void SIMP_function(TR_Function func);
+
+/* SIMP_function, as the -O1 pass "simplify". */
+extern const PM_Pass SIMP_pass;
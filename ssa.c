@@ -0,0 +1,961 @@
+/*
+ * ssa.c -
+ * Implementation of the conversion into and out of SSA form.
+ * See ssa.h for more information.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "ssa.h"
+#include "stack.h"
+#include "util.h"
+
+const PM_Pass SSA_build_pass = { "ssa", 2, NULL, NULL, SSA_build };
+const PM_Pass SSA_destroy_pass = { "unssa", 2, NULL, NULL, SSA_destroy };
+
+#define SSA_WORD_BITS ((int) (8 * sizeof(unsigned long)))
+
+/* The values a renamed variable has along the current dominator-tree
+ * path, the innermost last. */
+typedef struct SSA_Stack_ {
+    int depth;
+    int capacity;
+    CFG_Operand * values;
+} SSA_Stack;
+
+typedef struct SSA_Builder_ {
+    CFG_Graph graph;
+    /* The variables renamed, numbered from 0: frame variables by
+     * offset and temps by number, -1 for those left alone. */
+    int var_count;
+    int offset_count;
+    int * offset_var;
+    /* The graph's temps before renaming; later ones are already SSA. */
+    int temp_count;
+    int * temp_var;
+    /* An access of each frame variable, for its name and size; the
+     * temp of each renamed temp, or -1 for a frame variable. */
+    CFG_Instr * accesses;
+    int * var_temp;
+    /* Per block, bit sets of variables: used before being defined in
+     * the block, defined in it, and live on entry to it. */
+    int words;
+    unsigned long * uses;
+    unsigned long * defs;
+    unsigned long * live;
+    int * idom;
+    int * first_child;
+    int * children;
+    /* The variable of each phi, by its temp less first_phi. */
+    int first_phi;
+    int * phi_var;
+    SSA_Stack * stacks;
+    /* The variables pushed, in order, so that a block can pop its own. */
+    int log_count;
+    int log_capacity;
+    int * log;
+    /* What each load of a frame variable now stands for, by its temp. */
+    CFG_Operand * replacement;
+} SSA_Builder;
+
+static bool SSA_test(unsigned long * set, int var) {
+    return (set[var / SSA_WORD_BITS] >> (var % SSA_WORD_BITS)) & 1;
+}
+
+static void SSA_set(unsigned long * set, int var) {
+    set[var / SSA_WORD_BITS] |= 1UL << (var % SSA_WORD_BITS);
+}
+
+/* The renamed frame variable instr loads or stores, or -1. */
+static int SSA_frame_var(SSA_Builder * builder, CFG_Instr * instr) {
+    if ((instr->kind != CFG_LOAD_VAR && instr->kind != CFG_STORE_VAR)
+            || instr->u.var.level != builder->graph->func->frame->nesting_level
+            || instr->u.var.offset < 0 || instr->u.var.offset >= builder->offset_count) {
+        return -1;
+    }
+    return builder->offset_var[instr->u.var.offset];
+}
+
+/* The renamed temp operand reads, or -1. */
+static int SSA_temp_var(SSA_Builder * builder, CFG_Operand operand) {
+    if (operand.kind != CFG_TEMP || operand.value < 0 || operand.value >= builder->temp_count) {
+        return -1;
+    }
+    return builder->temp_var[operand.value];
+}
+
+static int SSA_add_var(SSA_Builder * builder, int temp, CFG_Instr * access) {
+    int var = builder->var_count++;
+    builder->var_temp = realloc_checked(builder->var_temp, builder->var_count * sizeof(int));
+    builder->accesses = realloc_checked(builder->accesses,
+            builder->var_count * sizeof(CFG_Instr));
+    builder->var_temp[var] = temp;
+    if (access) {
+        builder->accesses[var] = *access;
+    }
+    return var;
+}
+
+/* Choose the variables to rename: the function's own frame variables,
+ * when no nested function can reach them, and the temps defined more
+ * than once. */
+static void SSA_find_vars(SSA_Builder * builder) {
+    CFG_Graph graph = builder->graph;
+    int level = graph->func->frame->nesting_level;
+    bool own_frame = !graph->func->children;
+    int * def_counts = malloc_checked(graph->temp_count * sizeof(int) + 1);
+    memset(def_counts, 0, graph->temp_count * sizeof(int));
+    builder->offset_count = 0;
+    for (int i = 0; i < graph->block_count; ++i) {
+        CFG_Block block = graph->blocks[i];
+        for (int j = 0; j < block->instr_count; ++j) {
+            CFG_Instr * instr = &block->instrs[j];
+            if (instr->dst >= 0) {
+                ++def_counts[instr->dst];
+            }
+            if (own_frame && (instr->kind == CFG_LOAD_VAR || instr->kind == CFG_STORE_VAR)
+                    && instr->u.var.level == level && instr->u.var.offset >= builder->offset_count) {
+                builder->offset_count = instr->u.var.offset + 1;
+            }
+        }
+    }
+    builder->offset_var = malloc_checked(builder->offset_count * sizeof(int) + 1);
+    for (int i = 0; i < builder->offset_count; ++i) {
+        builder->offset_var[i] = -1;
+    }
+    for (int i = 0; i < graph->block_count; ++i) {
+        CFG_Block block = graph->blocks[i];
+        for (int j = 0; j < block->instr_count; ++j) {
+            CFG_Instr * instr = &block->instrs[j];
+            if ((instr->kind == CFG_LOAD_VAR || instr->kind == CFG_STORE_VAR)
+                    && instr->u.var.level == level && instr->u.var.offset >= 0
+                    && instr->u.var.offset < builder->offset_count
+                    && builder->offset_var[instr->u.var.offset] < 0) {
+                builder->offset_var[instr->u.var.offset] = SSA_add_var(builder, -1, instr);
+            }
+        }
+    }
+    builder->temp_count = graph->temp_count;
+    builder->temp_var = malloc_checked(graph->temp_count * sizeof(int) + 1);
+    for (int t = 0; t < graph->temp_count; ++t) {
+        builder->temp_var[t] = def_counts[t] > 1 ? SSA_add_var(builder, t, NULL) : -1;
+    }
+    free(def_counts);
+}
+
+/* Note in the block's sets a use of var, unless the block defined it first. */
+static void SSA_note_use(SSA_Builder * builder, int block, int var) {
+    if (var >= 0 && !SSA_test(&builder->defs[block * builder->words], var)) {
+        SSA_set(&builder->uses[block * builder->words], var);
+    }
+}
+
+/* The variables live on entry to each block, to a fixed point
+ * visiting the blocks in postorder. */
+static void SSA_compute_liveness(SSA_Builder * builder) {
+    CFG_Graph graph = builder->graph;
+    int words = builder->words;
+    int size = graph->block_count * words * sizeof(unsigned long) + 1;
+    builder->uses = malloc_checked(size);
+    builder->defs = malloc_checked(size);
+    builder->live = malloc_checked(size);
+    memset(builder->uses, 0, size);
+    memset(builder->defs, 0, size);
+    for (int i = 0; i < graph->block_count; ++i) {
+        CFG_Block block = graph->blocks[i];
+        for (int j = 0; j < block->instr_count; ++j) {
+            CFG_Instr * instr = &block->instrs[j];
+            for (int k = 0, n = CFG_use_count(instr); k < n; ++k) {
+                SSA_note_use(builder, i, SSA_temp_var(builder, *CFG_use(instr, k)));
+            }
+            int var = SSA_frame_var(builder, instr);
+            if (var >= 0 && instr->kind == CFG_LOAD_VAR) {
+                SSA_note_use(builder, i, var);
+            }
+            if (var < 0 || instr->kind == CFG_LOAD_VAR) {
+                var = SSA_temp_var(builder, CFG_temp(instr->dst));
+            }
+            if (var >= 0) {
+                SSA_set(&builder->defs[i * words], var);
+            }
+        }
+        SSA_note_use(builder, i, SSA_temp_var(builder, block->value));
+    }
+    memcpy(builder->live, builder->uses, size);
+    int count;
+    int * order = CFG_reverse_postorder(graph, &count);
+    for (bool changed = true; changed; ) {
+        changed = false;
+        for (int i = count - 1; i >= 0; --i) {
+            CFG_Block block = graph->blocks[order[i]];
+            unsigned long * live = &builder->live[block->id * words];
+            unsigned long * defs = &builder->defs[block->id * words];
+            for (int j = 0; j < block->succ_count; ++j) {
+                unsigned long * out = &builder->live[block->succs[j] * words];
+                for (int w = 0; w < words; ++w) {
+                    unsigned long added = out[w] & ~defs[w] & ~live[w];
+                    if (added) {
+                        live[w] |= added;
+                        changed = true;
+                    }
+                }
+            }
+        }
+    }
+    free(order);
+}
+
+/* A block in the dominance frontier of another. */
+typedef struct SSA_Frontier_ {
+    int block;
+    int member;
+} SSA_Frontier;
+
+/* Place a phi for each variable at the iterated dominance frontier of
+ * its definitions, where it is live; returns the phis' blocks and
+ * variables, setting *count. */
+static SSA_Frontier * SSA_place_phis(SSA_Builder * builder, int * count) {
+    CFG_Graph graph = builder->graph;
+    int n = graph->block_count;
+    // The dominance frontiers, sorted by block.
+    int frontier_count = 0;
+    int frontier_capacity = n + 1;
+    SSA_Frontier * frontiers = malloc_checked(frontier_capacity * sizeof(SSA_Frontier));
+    for (int i = 0; i < n; ++i) {
+        CFG_Block block = graph->blocks[i];
+        if (block->pred_count < 2) {
+            continue;
+        }
+        for (int j = 0; j < block->pred_count; ++j) {
+            for (int runner = block->preds[j]; runner != builder->idom[i];
+                    runner = builder->idom[runner]) {
+                if (frontier_count == frontier_capacity) {
+                    frontier_capacity *= 2;
+                    frontiers = realloc_checked(frontiers,
+                            frontier_capacity * sizeof(SSA_Frontier));
+                }
+                frontiers[frontier_count].block = runner;
+                frontiers[frontier_count].member = i;
+                ++frontier_count;
+            }
+        }
+    }
+    int * first = malloc_checked((n + 2) * sizeof(int));
+    int * members = malloc_checked(frontier_count * sizeof(int) + 1);
+    memset(first, 0, (n + 2) * sizeof(int));
+    for (int i = 0; i < frontier_count; ++i) {
+        ++first[frontiers[i].block + 2];
+    }
+    for (int i = 0; i < n; ++i) {
+        first[i + 2] += first[i + 1];
+    }
+    for (int i = 0; i < frontier_count; ++i) {
+        members[first[frontiers[i].block + 1]++] = frontiers[i].member;
+    }
+    // first[b] now begins b's frontier and first[b + 1] ends it.
+    int words = builder->words;
+    int * has_phi = malloc_checked(n * sizeof(int) + 1);
+    int * queued = malloc_checked(n * sizeof(int) + 1);
+    int * work = malloc_checked(n * sizeof(int) + 1);
+    for (int i = 0; i < n; ++i) {
+        has_phi[i] = -1;
+        queued[i] = -1;
+    }
+    int phi_count = 0;
+    int phi_capacity = 16;
+    SSA_Frontier * phis = malloc_checked(phi_capacity * sizeof(SSA_Frontier));
+    for (int var = 0; var < builder->var_count; ++var) {
+        int depth = 0;
+        for (int i = 0; i < n; ++i) {
+            if (SSA_test(&builder->defs[i * words], var)) {
+                queued[i] = var;
+                work[depth++] = i;
+            }
+        }
+        while (depth) {
+            int block = work[--depth];
+            for (int k = first[block]; k < first[block + 1]; ++k) {
+                int member = members[k];
+                if (has_phi[member] == var || !SSA_test(&builder->live[member * words], var)) {
+                    continue;
+                }
+                has_phi[member] = var;
+                if (phi_count == phi_capacity) {
+                    phi_capacity *= 2;
+                    phis = realloc_checked(phis, phi_capacity * sizeof(SSA_Frontier));
+                }
+                phis[phi_count].block = member;
+                phis[phi_count].member = var;
+                ++phi_count;
+                if (queued[member] != var) {
+                    queued[member] = var;
+                    work[depth++] = member;
+                }
+            }
+        }
+    }
+    free(frontiers);
+    free(first);
+    free(members);
+    free(has_phi);
+    free(queued);
+    free(work);
+    *count = phi_count;
+    return phis;
+}
+
+/* Put the phis at the start of their blocks, with arguments to be
+ * filled in by renaming, and load each frame variable live on entry
+ * at the start of the entry block. */
+static void SSA_insert_phis(SSA_Builder * builder, SSA_Frontier * phis, int phi_count) {
+    CFG_Graph graph = builder->graph;
+    int n = graph->block_count;
+    int * added = malloc_checked(n * sizeof(int) + 1);
+    memset(added, 0, n * sizeof(int));
+    for (int i = 0; i < phi_count; ++i) {
+        ++added[phis[i].block];
+    }
+    CFG_Instr ** entries = malloc_checked(n * sizeof(CFG_Instr *) + 1);
+    for (int i = 0; i < builder->var_count; ++i) {
+        if (builder->var_temp[i] < 0 && SSA_test(builder->live, i)) {
+            ++added[0];
+        }
+    }
+    for (int i = 0; i < n; ++i) {
+        CFG_Block block = graph->blocks[i];
+        entries[i] = NULL;
+        if (!added[i]) {
+            continue;
+        }
+        int capacity = block->instr_count + added[i];
+        CFG_Instr * instrs = AR_alloc(capacity * sizeof(CFG_Instr));
+        memcpy(instrs + added[i], block->instrs, block->instr_count * sizeof(CFG_Instr));
+        block->instrs = instrs;
+        block->instr_count = capacity;
+        block->instr_capacity = capacity;
+        entries[i] = instrs;
+    }
+    for (int i = 0; i < builder->var_count; ++i) {
+        if (builder->var_temp[i] < 0 && SSA_test(builder->live, i)) {
+            CFG_Instr * load = entries[0]++;
+            *load = builder->accesses[i];
+            load->kind = CFG_LOAD_VAR;
+            load->dst = CFG_new_temp(graph);
+            load->u.var.value = CFG_none();
+        }
+    }
+    builder->first_phi = graph->temp_count;
+    builder->phi_var = malloc_checked(phi_count * sizeof(int) + 1);
+    for (int i = 0; i < phi_count; ++i) {
+        CFG_Block block = graph->blocks[phis[i].block];
+        CFG_Instr * phi = entries[block->id]++;
+        memset(phi, 0, sizeof(*phi));
+        phi->kind = CFG_PHI;
+        phi->dst = CFG_new_temp(graph);
+        phi->u.phi.arg_count = block->pred_count;
+        phi->u.phi.args = AR_alloc(block->pred_count * sizeof(CFG_Operand));
+        for (int k = 0; k < block->pred_count; ++k) {
+            phi->u.phi.args[k] = CFG_none();
+        }
+        builder->phi_var[phi->dst - builder->first_phi] = phis[i].member;
+    }
+    free(added);
+    free(entries);
+}
+
+static CFG_Operand SSA_current(SSA_Builder * builder, int var) {
+    SSA_Stack * stack = &builder->stacks[var];
+    // A variable read before any assignment reads 0, like a fresh frame.
+    return stack->depth ? stack->values[stack->depth - 1] : CFG_const(0);
+}
+
+static void SSA_push(SSA_Builder * builder, int var, CFG_Operand value) {
+    SSA_Stack * stack = &builder->stacks[var];
+    if (stack->depth == stack->capacity) {
+        stack->capacity = stack->capacity ? 2 * stack->capacity : 4;
+        stack->values = realloc_checked(stack->values, stack->capacity * sizeof(CFG_Operand));
+    }
+    stack->values[stack->depth++] = value;
+    if (builder->log_count == builder->log_capacity) {
+        builder->log_capacity = builder->log_capacity ? 2 * builder->log_capacity : 64;
+        builder->log = realloc_checked(builder->log, builder->log_capacity * sizeof(int));
+    }
+    builder->log[builder->log_count++] = var;
+}
+
+static void SSA_rewrite(SSA_Builder * builder, CFG_Operand * operand) {
+    if (operand->kind != CFG_TEMP || operand->value >= builder->temp_count) {
+        return;
+    }
+    int var = builder->temp_var[operand->value];
+    if (var >= 0) {
+        *operand = SSA_current(builder, var);
+    } else if (builder->replacement[operand->value].kind != CFG_NONE) {
+        *operand = builder->replacement[operand->value];
+    }
+}
+
+/* Record that temp, defined by an instruction that was deleted, is value. */
+static void SSA_define(SSA_Builder * builder, int temp, CFG_Operand value) {
+    if (builder->temp_var[temp] >= 0) {
+        SSA_push(builder, builder->temp_var[temp], value);
+    } else {
+        builder->replacement[temp] = value;
+    }
+}
+
+static void SSA_rename(SSA_Builder * builder, int block_id);
+
+/* A call of SSA_rename continued on a new stack segment. */
+typedef struct SSA_DeepCall_ {
+    SSA_Builder * builder;
+    int block_id;
+} SSA_DeepCall;
+
+static void SSA_run_deep_call(void * arg) {
+    SSA_DeepCall * call = arg;
+    SSA_rename(call->builder, call->block_id);
+}
+
+/* Rename the variables in block and, recursively, in the blocks it
+ * immediately dominates. */
+static void SSA_rename(SSA_Builder * builder, int block_id) {
+    if (ST_low()) {
+        SSA_DeepCall call = { builder, block_id };
+        ST_call(SSA_run_deep_call, &call);
+        return;
+    }
+    CFG_Graph graph = builder->graph;
+    CFG_Block block = graph->blocks[block_id];
+    int mark = builder->log_count;
+    int kept = 0;
+    for (int j = 0; j < block->instr_count; ++j) {
+        CFG_Instr instr = block->instrs[j];
+        if (instr.kind == CFG_PHI) {
+            if (instr.dst >= builder->first_phi) {
+                SSA_push(builder, builder->phi_var[instr.dst - builder->first_phi],
+                        CFG_temp(instr.dst));
+            }
+            block->instrs[kept++] = instr;
+            continue;
+        }
+        for (int k = 0, n = CFG_use_count(&instr); k < n; ++k) {
+            SSA_rewrite(builder, CFG_use(&instr, k));
+        }
+        int var = SSA_frame_var(builder, &instr);
+        if (var >= 0 && instr.kind == CFG_LOAD_VAR && instr.dst < builder->temp_count) {
+            SSA_define(builder, instr.dst, SSA_current(builder, var));
+            continue;
+        }
+        if (var >= 0 && instr.kind == CFG_STORE_VAR) {
+            SSA_push(builder, var, instr.u.var.value);
+            continue;
+        }
+        var = SSA_temp_var(builder, CFG_temp(instr.dst));
+        if (var >= 0 && instr.kind == CFG_MOVE) {
+            SSA_push(builder, var, instr.u.move);
+            continue;
+        }
+        if (var >= 0) {
+            instr.dst = CFG_new_temp(graph);
+            SSA_push(builder, var, CFG_temp(instr.dst));
+        } else if (instr.kind == CFG_LOAD_VAR && instr.dst >= builder->temp_count) {
+            // A load of a variable live on entry: its first value.
+            SSA_push(builder, SSA_frame_var(builder, &instr), CFG_temp(instr.dst));
+        }
+        block->instrs[kept++] = instr;
+    }
+    block->instr_count = kept;
+    SSA_rewrite(builder, &block->value);
+    for (int j = 0; j < block->succ_count; ++j) {
+        CFG_Block succ = graph->blocks[block->succs[j]];
+        for (int i = 0; i < succ->instr_count && succ->instrs[i].kind == CFG_PHI; ++i) {
+            CFG_Instr * phi = &succ->instrs[i];
+            int var = builder->phi_var[phi->dst - builder->first_phi];
+            for (int k = 0; k < succ->pred_count; ++k) {
+                if (succ->preds[k] == block_id) {
+                    phi->u.phi.args[k] = SSA_current(builder, var);
+                }
+            }
+        }
+    }
+    for (int i = builder->first_child[block_id]; i < builder->first_child[block_id + 1]; ++i) {
+        SSA_rename(builder, builder->children[i]);
+    }
+    while (builder->log_count > mark) {
+        --builder->stacks[builder->log[--builder->log_count]].depth;
+    }
+}
+
+void SSA_build(CFG_Graph graph) {
+    // The entry must have no predecessors, so that it can load the
+    // variables live on entry.
+    if (graph->ssa || !graph->block_count || graph->blocks[0]->pred_count) {
+        return;
+    }
+    SSA_Builder builder;
+    memset(&builder, 0, sizeof(builder));
+    builder.graph = graph;
+    SSA_find_vars(&builder);
+    if (builder.var_count) {
+        builder.words = (builder.var_count + SSA_WORD_BITS - 1) / SSA_WORD_BITS;
+        SSA_compute_liveness(&builder);
+        builder.idom = CFG_dominators(graph);
+        builder.children = CFG_dominator_children(graph, builder.idom, &builder.first_child);
+        int phi_count;
+        SSA_Frontier * phis = SSA_place_phis(&builder, &phi_count);
+        SSA_insert_phis(&builder, phis, phi_count);
+        free(phis);
+        builder.stacks = malloc_checked(builder.var_count * sizeof(SSA_Stack));
+        memset(builder.stacks, 0, builder.var_count * sizeof(SSA_Stack));
+        builder.replacement = malloc_checked(builder.temp_count * sizeof(CFG_Operand) + 1);
+        for (int t = 0; t < builder.temp_count; ++t) {
+            builder.replacement[t] = CFG_none();
+        }
+        SSA_rename(&builder, 0);
+        for (int i = 0; i < builder.var_count; ++i) {
+            free(builder.stacks[i].values);
+        }
+        free(builder.stacks);
+        free(builder.replacement);
+        free(builder.uses);
+        free(builder.defs);
+        free(builder.live);
+        free(builder.idom);
+        free(builder.first_child);
+        free(builder.children);
+        free(builder.phi_var);
+        free(builder.log);
+    }
+    free(builder.offset_var);
+    free(builder.temp_var);
+    free(builder.var_temp);
+    free(builder.accesses);
+    graph->ssa = true;
+}
+
+/* Number the temps densely, in the order they first appear. */
+static void SSA_renumber_temps(CFG_Graph graph) {
+    int * numbers = malloc_checked(graph->temp_count * sizeof(int) + 1);
+    int count = 0;
+    for (int t = 0; t < graph->temp_count; ++t) {
+        numbers[t] = -1;
+    }
+    for (int i = 0; i < graph->block_count; ++i) {
+        CFG_Block block = graph->blocks[i];
+        for (int j = 0; j <= block->instr_count; ++j) {
+            CFG_Instr * instr = j < block->instr_count ? &block->instrs[j] : NULL;
+            int n = instr ? CFG_use_count(instr) : 1;
+            for (int k = 0; k < n; ++k) {
+                CFG_Operand * operand = instr ? CFG_use(instr, k) : &block->value;
+                if (operand->kind == CFG_TEMP) {
+                    if (numbers[operand->value] < 0) {
+                        numbers[operand->value] = count++;
+                    }
+                    operand->value = numbers[operand->value];
+                }
+            }
+            if (instr && instr->dst >= 0) {
+                if (numbers[instr->dst] < 0) {
+                    numbers[instr->dst] = count++;
+                }
+                instr->dst = numbers[instr->dst];
+            }
+        }
+    }
+    graph->temp_count = count;
+    free(numbers);
+}
+
+/* The state of taking a graph out of SSA form. The temps related by
+ * phis, as their results or arguments, are grouped into classes that
+ * can share a single temp. */
+typedef struct SSA_Destroyer_ {
+    CFG_Graph graph;
+    /* The related temps, numbered from 0, and the number of each of
+     * the first temp_count temps, or -1; later temps are copies. */
+    int temp_count;
+    int related_count;
+    int * temps;
+    int * related;
+    /* Where each related temp is defined. */
+    int * def_block;
+    int * def_index;
+    /* Per block, the related temps live on entry and on exit. */
+    int words;
+    unsigned long * live_in;
+    unsigned long * live_out;
+    int * enter;
+    int * leave;
+    /* The class of each related temp, as a union-find forest, and its
+     * members as a circular list. */
+    int * parent;
+    int * size;
+    int * next;
+} SSA_Destroyer;
+
+/* Split each edge into a block with phis from a block with another
+ * successor, so that the copies for the phis can go at the end of a
+ * block that leads nowhere else. */
+static void SSA_split_edges(CFG_Graph graph) {
+    for (int i = 0, n = graph->block_count; i < n; ++i) {
+        CFG_Block block = graph->blocks[i];
+        if (!block->instr_count || block->instrs[0].kind != CFG_PHI) {
+            continue;
+        }
+        for (int k = 0; k < block->pred_count; ++k) {
+            CFG_Block pred = graph->blocks[block->preds[k]];
+            if (pred->succ_count < 2) {
+                continue;
+            }
+            CFG_Block edge = CFG_new_block(graph);
+            block = graph->blocks[i];
+            edge->end = CFG_JUMP;
+            edge->succ_count = 1;
+            edge->succs[0] = i;
+            edge->pred_count = 1;
+            edge->preds = AR_alloc(sizeof(int));
+            edge->preds[0] = pred->id;
+            // A branch to the block on both sides is split once per side.
+            int j = pred->succs[0] == i ? 0 : 1;
+            pred->succs[j] = edge->id;
+            block->preds[k] = edge->id;
+        }
+    }
+}
+
+/* Number the temps phis define or read, note where they are defined,
+ * and compute where they are live. */
+static void SSA_find_related(SSA_Destroyer * destroyer) {
+    CFG_Graph graph = destroyer->graph;
+    int n = graph->block_count;
+    destroyer->temp_count = graph->temp_count;
+    destroyer->related = malloc_checked(graph->temp_count * sizeof(int) + 1);
+    destroyer->temps = malloc_checked(graph->temp_count * sizeof(int) + 1);
+    for (int t = 0; t < graph->temp_count; ++t) {
+        destroyer->related[t] = -1;
+    }
+    int count = 0;
+    for (int i = 0; i < n; ++i) {
+        CFG_Block block = graph->blocks[i];
+        for (int j = 0; j < block->instr_count && block->instrs[j].kind == CFG_PHI; ++j) {
+            CFG_Instr * phi = &block->instrs[j];
+            for (int k = -1; k < phi->u.phi.arg_count; ++k) {
+                CFG_Operand operand = k < 0 ? CFG_temp(phi->dst) : phi->u.phi.args[k];
+                if (operand.kind == CFG_TEMP && destroyer->related[operand.value] < 0) {
+                    destroyer->related[operand.value] = count;
+                    destroyer->temps[count++] = operand.value;
+                }
+            }
+        }
+    }
+    destroyer->related_count = count;
+    destroyer->def_block = malloc_checked(count * sizeof(int) + 1);
+    destroyer->def_index = malloc_checked(count * sizeof(int) + 1);
+    int words = destroyer->words = (count + SSA_WORD_BITS - 1) / SSA_WORD_BITS;
+    int size = n * words * sizeof(unsigned long) + 1;
+    unsigned long * uses = malloc_checked(size);
+    unsigned long * defs = malloc_checked(size);
+    destroyer->live_in = malloc_checked(size);
+    destroyer->live_out = malloc_checked(size);
+    memset(uses, 0, size);
+    memset(defs, 0, size);
+    memset(destroyer->live_out, 0, size);
+    for (int i = 0; i < n; ++i) {
+        CFG_Block block = graph->blocks[i];
+        for (int j = 0; j <= block->instr_count; ++j) {
+            CFG_Instr * instr = j < block->instr_count ? &block->instrs[j] : NULL;
+            int m = instr ? CFG_use_count(instr) : 1;
+            for (int k = 0; k < m; ++k) {
+                CFG_Operand operand = instr ? *CFG_use(instr, k) : block->value;
+                if (operand.kind != CFG_TEMP || destroyer->related[operand.value] < 0) {
+                    continue;
+                }
+                int r = destroyer->related[operand.value];
+                if (instr && instr->kind == CFG_PHI) {
+                    // A phi reads its argument at the end of the predecessor.
+                    SSA_set(&destroyer->live_out[block->preds[k] * words], r);
+                } else if (!SSA_test(&defs[i * words], r)) {
+                    SSA_set(&uses[i * words], r);
+                }
+            }
+            if (instr && instr->dst >= 0 && destroyer->related[instr->dst] >= 0) {
+                int r = destroyer->related[instr->dst];
+                destroyer->def_block[r] = i;
+                destroyer->def_index[r] = j;
+                SSA_set(&defs[i * words], r);
+            }
+        }
+    }
+    memcpy(destroyer->live_in, uses, size);
+    int order_count;
+    int * order = CFG_reverse_postorder(graph, &order_count);
+    for (bool changed = true; changed; ) {
+        changed = false;
+        for (int i = order_count - 1; i >= 0; --i) {
+            CFG_Block block = graph->blocks[order[i]];
+            unsigned long * in = &destroyer->live_in[block->id * words];
+            unsigned long * out = &destroyer->live_out[block->id * words];
+            unsigned long * def = &defs[block->id * words];
+            for (int j = 0; j < block->succ_count; ++j) {
+                unsigned long * succ_in = &destroyer->live_in[block->succs[j] * words];
+                for (int w = 0; w < words; ++w) {
+                    out[w] |= succ_in[w];
+                }
+            }
+            for (int w = 0; w < words; ++w) {
+                unsigned long added = out[w] & ~def[w] & ~in[w];
+                if (added) {
+                    in[w] |= added;
+                    changed = true;
+                }
+            }
+        }
+    }
+    free(order);
+    free(uses);
+    free(defs);
+}
+
+static bool SSA_dominates(SSA_Destroyer * destroyer, int a, int b) {
+    return destroyer->enter[a] <= destroyer->enter[b]
+        && destroyer->leave[b] <= destroyer->leave[a];
+}
+
+/* Whether related temps a and b are ever live at once: in SSA form,
+ * whether the one defined first is live just after the other's
+ * definition. */
+static bool SSA_interfere(SSA_Destroyer * destroyer, int a, int b) {
+    CFG_Graph graph = destroyer->graph;
+    int block_a = destroyer->def_block[a];
+    int block_b = destroyer->def_block[b];
+    if (block_a == block_b) {
+        CFG_Block block = graph->blocks[block_a];
+        // The phis of a block all define their temps at its start.
+        if (block->instrs[destroyer->def_index[a]].kind == CFG_PHI
+                && block->instrs[destroyer->def_index[b]].kind == CFG_PHI) {
+            return true;
+        }
+        if (destroyer->def_index[a] > destroyer->def_index[b]) {
+            int swap = a;
+            a = b;
+            b = swap;
+        }
+    } else if (SSA_dominates(destroyer, block_b, block_a)) {
+        int swap = a;
+        a = b;
+        b = swap;
+    } else if (!SSA_dominates(destroyer, block_a, block_b)) {
+        return false;
+    }
+    CFG_Block block = graph->blocks[destroyer->def_block[b]];
+    if (SSA_test(&destroyer->live_out[block->id * destroyer->words], a)) {
+        return true;
+    }
+    CFG_Operand temp = CFG_temp(destroyer->temps[a]);
+    for (int j = destroyer->def_index[b] + 1; j < block->instr_count; ++j) {
+        CFG_Instr * instr = &block->instrs[j];
+        for (int k = 0, m = instr->kind == CFG_PHI ? 0 : CFG_use_count(instr); k < m; ++k) {
+            CFG_Operand * operand = CFG_use(instr, k);
+            if (operand->kind == CFG_TEMP && operand->value == temp.value) {
+                return true;
+            }
+        }
+    }
+    return block->value.kind == CFG_TEMP && block->value.value == temp.value;
+}
+
+static int SSA_find(SSA_Destroyer * destroyer, int r) {
+    while (destroyer->parent[r] != r) {
+        r = destroyer->parent[r] = destroyer->parent[destroyer->parent[r]];
+    }
+    return r;
+}
+
+/* Pairs of members compared before two classes are taken to interfere. */
+#define SSA_MAX_COMPARISONS 4096
+
+/* Merge the classes of related temps a and b unless their members interfere. */
+static void SSA_coalesce(SSA_Destroyer * destroyer, int a, int b) {
+    a = SSA_find(destroyer, a);
+    b = SSA_find(destroyer, b);
+    if (a == b || destroyer->size[a] * destroyer->size[b] > SSA_MAX_COMPARISONS) {
+        return;
+    }
+    int m = a;
+    do {
+        int n = b;
+        do {
+            if (SSA_interfere(destroyer, m, n)) {
+                return;
+            }
+            n = destroyer->next[n];
+        } while (n != b);
+        m = destroyer->next[m];
+    } while (m != a);
+    if (destroyer->size[a] < destroyer->size[b]) {
+        int swap = a;
+        a = b;
+        b = swap;
+    }
+    destroyer->parent[b] = a;
+    destroyer->size[a] += destroyer->size[b];
+    int swap = destroyer->next[a];
+    destroyer->next[a] = destroyer->next[b];
+    destroyer->next[b] = swap;
+}
+
+/* The temp that stands for operand's class. */
+static CFG_Operand SSA_class(SSA_Destroyer * destroyer, CFG_Operand operand) {
+    if (operand.kind == CFG_TEMP && operand.value < destroyer->temp_count
+            && destroyer->related[operand.value] >= 0) {
+        operand.value = destroyer->temps[SSA_find(destroyer, destroyer->related[operand.value])];
+    }
+    return operand;
+}
+
+/* Append to block moves that copy each of srcs to the temp in dsts
+ * at once, through a new temp where they form a cycle. */
+static void SSA_copy(CFG_Graph graph, CFG_Block block, int * dsts, CFG_Operand * srcs,
+        int count) {
+    CFG_Instr move;
+    memset(&move, 0, sizeof(move));
+    move.kind = CFG_MOVE;
+    while (count) {
+        int ready = -1;
+        for (int i = 0; i < count && ready < 0; ++i) {
+            ready = i;
+            for (int j = 0; j < count; ++j) {
+                if (j != i && srcs[j].kind == CFG_TEMP && srcs[j].value == dsts[i]) {
+                    ready = -1;
+                    break;
+                }
+            }
+        }
+        if (ready < 0) {
+            // Every destination is still to be read: save one first.
+            move.dst = CFG_new_temp(graph);
+            move.u.move = CFG_temp(dsts[0]);
+            CFG_add_instr(block, move);
+            for (int j = 0; j < count; ++j) {
+                if (srcs[j].kind == CFG_TEMP && srcs[j].value == dsts[0]) {
+                    srcs[j] = CFG_temp(move.dst);
+                }
+            }
+            continue;
+        }
+        move.dst = dsts[ready];
+        move.u.move = srcs[ready];
+        CFG_add_instr(block, move);
+        dsts[ready] = dsts[--count];
+        srcs[ready] = srcs[count];
+    }
+}
+
+/* Give each class its temp, replace the phis by copies where an
+ * argument is not in the class of the phi's result, and drop them. */
+static void SSA_replace_phis(SSA_Destroyer * destroyer) {
+    CFG_Graph graph = destroyer->graph;
+    for (int i = 0; i < graph->block_count; ++i) {
+        CFG_Block block = graph->blocks[i];
+        int phi_count = 0;
+        while (phi_count < block->instr_count && block->instrs[phi_count].kind == CFG_PHI) {
+            ++phi_count;
+        }
+        int * dsts = malloc_checked(phi_count * sizeof(int) + 1);
+        CFG_Operand * srcs = malloc_checked(phi_count * sizeof(CFG_Operand) + 1);
+        for (int k = 0; k < block->pred_count; ++k) {
+            int count = 0;
+            for (int j = 0; j < phi_count; ++j) {
+                CFG_Instr * phi = &block->instrs[j];
+                CFG_Operand dst = SSA_class(destroyer, CFG_temp(phi->dst));
+                CFG_Operand src = SSA_class(destroyer, phi->u.phi.args[k]);
+                if (src.kind != CFG_TEMP || src.value != dst.value) {
+                    dsts[count] = dst.value;
+                    srcs[count++] = src;
+                }
+            }
+            SSA_copy(graph, graph->blocks[block->preds[k]], dsts, srcs, count);
+        }
+        free(dsts);
+        free(srcs);
+        block->instr_count -= phi_count;
+        memmove(block->instrs, block->instrs + phi_count,
+                block->instr_count * sizeof(CFG_Instr));
+    }
+    for (int i = 0; i < graph->block_count; ++i) {
+        CFG_Block block = graph->blocks[i];
+        int kept = 0;
+        for (int j = 0; j < block->instr_count; ++j) {
+            CFG_Instr instr = block->instrs[j];
+            for (int k = 0, m = CFG_use_count(&instr); k < m; ++k) {
+                *CFG_use(&instr, k) = SSA_class(destroyer, *CFG_use(&instr, k));
+            }
+            if (instr.dst >= 0) {
+                instr.dst = SSA_class(destroyer, CFG_temp(instr.dst)).value;
+            }
+            if (instr.kind == CFG_MOVE && instr.u.move.kind == CFG_TEMP
+                    && instr.u.move.value == instr.dst) {
+                continue;
+            }
+            block->instrs[kept++] = instr;
+        }
+        block->instr_count = kept;
+        block->value = SSA_class(destroyer, block->value);
+    }
+}
+
+void SSA_destroy(CFG_Graph graph) {
+    if (!graph->ssa) {
+        return;
+    }
+    SSA_split_edges(graph);
+    SSA_Destroyer destroyer;
+    memset(&destroyer, 0, sizeof(destroyer));
+    destroyer.graph = graph;
+    SSA_find_related(&destroyer);
+    int * idom = CFG_dominators(graph);
+    CFG_dominator_intervals(graph, idom, &destroyer.enter, &destroyer.leave);
+    free(idom);
+    int count = destroyer.related_count;
+    destroyer.parent = malloc_checked(count * sizeof(int) + 1);
+    destroyer.size = malloc_checked(count * sizeof(int) + 1);
+    destroyer.next = malloc_checked(count * sizeof(int) + 1);
+    for (int r = 0; r < count; ++r) {
+        destroyer.parent[r] = r;
+        destroyer.size[r] = 1;
+        destroyer.next[r] = r;
+    }
+    // Try to give each phi's result and arguments a single temp.
+    for (int i = 0; i < graph->block_count; ++i) {
+        CFG_Block block = graph->blocks[i];
+        for (int j = 0; j < block->instr_count && block->instrs[j].kind == CFG_PHI; ++j) {
+            CFG_Instr * phi = &block->instrs[j];
+            for (int k = 0; k < phi->u.phi.arg_count; ++k) {
+                if (phi->u.phi.args[k].kind == CFG_TEMP) {
+                    SSA_coalesce(&destroyer, destroyer.related[phi->dst],
+                            destroyer.related[phi->u.phi.args[k].value]);
+                }
+            }
+        }
+    }
+    SSA_replace_phis(&destroyer);
+    graph->ssa = false;
+    // This also removes the blocks that split an edge but were given no
+    // copies, and the jumps left by passes that took branches away.
+    CFG_merge_blocks(graph);
+    SSA_renumber_temps(graph);
+    free(destroyer.temps);
+    free(destroyer.related);
+    free(destroyer.def_block);
+    free(destroyer.def_index);
+    free(destroyer.live_in);
+    free(destroyer.live_out);
+    free(destroyer.enter);
+    free(destroyer.leave);
+    free(destroyer.parent);
+    free(destroyer.size);
+    free(destroyer.next);
+}
@@ -0,0 +1,35 @@
+/*
+ * ssa.h -
+ * Conversion of a control-flow graph into SSA form and back.
+ * Into SSA: the variables of the function's own frame that no nested
+ * function can reach, and the temps assigned more than once (the
+ * values of conditional expressions), are renamed so that each
+ * definition gets a temp of its own. Their loads and stores become
+ * uses and definitions of those temps, and a phi merges them where
+ * control flow joins: at the dominance frontiers of the definitions,
+ * and only where the variable is live (pruned SSA). A variable live
+ * on entry, such as a parameter, is loaded once at the start.
+ * Out of SSA: a phi's result and arguments share one temp wherever
+ * their live ranges do not overlap; the arguments left over are
+ * copied at the end of their predecessors, on edges split for the
+ * purpose where a predecessor has another successor, as one parallel
+ * copy per edge. Jump-only blocks are then merged away (see
+ * CFG_merge_blocks) and temps renumbered densely.
+ * All types and functions declared in this module begin with "SSA_".
+ */
+
+#pragma once
+
+#include "cfg.h"
+#include "pass_manager.h"
+
+/* Put graph into SSA form, if it is not already. */
+void SSA_build(CFG_Graph graph);
+
+/* Take graph out of SSA form, if it is in it. */
+void SSA_destroy(CFG_Graph graph);
+
+/* SSA_build and SSA_destroy, as the -O2 passes "ssa" and "unssa",
+ * which bracket the passes that need SSA form. */
+extern const PM_Pass SSA_build_pass;
+extern const PM_Pass SSA_destroy_pass;
@@ -0,0 +1,101 @@
+/*
+ * stack.c -
+ * Implementation of the segmented-stack fallback.
+ * See stack.h for more information.
+ * Assumes, as on every platform we build on, that the stack grows downward.
+ */
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <ucontext.h>
+
+#include "stack.h"
+#include "util.h"
+
+#define ST_SEGMENT_SIZE (64 << 20)
+/* Room left below the limit for the frames a pass pushes
+ * between two checks, including those of library calls;
+ * at most a quarter of a thread's own stack when that is small. */
+#define ST_RED_ZONE (256 << 10)
+#define ST_DEFAULT_STACK (1 << 20)
+
+typedef struct ST_Segment_ * ST_Segment;
+
+struct ST_Segment_ {
+    char * base;
+    ucontext_t context;
+    ucontext_t caller;
+    void (*run)(void *);
+    void * arg;
+    char * caller_limit;
+    ST_Segment shallower;
+    ST_Segment deeper;
+};
+
+/* The lowest address the current segment's frames may reach
+ * before the next recursive call should switch segments. */
+static __thread char * limit = NULL;
+/* The segment running now; NULL on the thread's own stack. */
+static __thread ST_Segment current = NULL;
+/* The first segment, kept for reuse once the thread returns from it. */
+static __thread ST_Segment first = NULL;
+
+static void ST_init_limit(char * here) {
+    pthread_attr_t attr;
+    void * addr = NULL;
+    size_t size = 0;
+    if (!pthread_getattr_np(pthread_self(), &attr)) {
+        if (pthread_attr_getstack(&attr, &addr, &size)) {
+            addr = NULL;
+        }
+        pthread_attr_destroy(&attr);
+    }
+    if (!addr || (char *) addr >= here) {
+        addr = here - ST_DEFAULT_STACK;
+    }
+    // Measure from here: part of the stack is already in use.
+    size_t left = here - (char *) addr;
+    limit = (char *) addr + (left / 4 < ST_RED_ZONE ? left / 4 : ST_RED_ZONE);
+}
+
+bool ST_low() {
+    char here;
+    if (!limit) {
+        ST_init_limit(&here);
+    }
+    return &here < limit;
+}
+
+static void ST_run_segment() {
+    current->run(current->arg);
+}
+
+void ST_call(void (*run)(void *), void * arg) {
+    ST_Segment segment = current ? current->deeper : first;
+    if (!segment) {
+        segment = malloc_checked(sizeof(*segment));
+        segment->base = malloc_checked(ST_SEGMENT_SIZE);
+        segment->shallower = current;
+        segment->deeper = NULL;
+        if (current) {
+            current->deeper = segment;
+        } else {
+            first = segment;
+        }
+    }
+    segment->run = run;
+    segment->arg = arg;
+    segment->caller_limit = limit;
+    getcontext(&segment->context);
+    segment->context.uc_stack.ss_sp = segment->base;
+    segment->context.uc_stack.ss_size = ST_SEGMENT_SIZE;
+    segment->context.uc_link = &segment->caller;
+    makecontext(&segment->context, ST_run_segment, 0);
+    current = segment;
+    limit = segment->base + ST_RED_ZONE;
+    swapcontext(&segment->caller, &segment->context);
+    current = segment->shallower;
+    limit = segment->caller_limit;
+}
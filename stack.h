@@ -0,0 +1,23 @@
+/*
+ * stack.h -
+ * Segmented-stack fallback for the recursive passes.
+ * Semantic analysis and the printers recurse once per level
+ * of nesting in the program, so a machine-generated program
+ * nested a million levels deep would overflow the C stack.
+ * Each such pass calls ST_low() on entry; when it returns true,
+ * the pass makes its recursive call through ST_call, which runs it
+ * on a fresh segment of stack allocated from the heap.
+ * Segments are kept per thread and reused, so the memory used
+ * grows with the deepest nesting seen, not the number of switches.
+ * All types and functions declared in this module begin with "ST_".
+ */
+
+#pragma once
+
+#include <stdbool.h>
+
+/* True when the current stack segment is nearly used up. */
+bool ST_low();
+
+/* Run run(arg) on the next stack segment of the calling thread. */
+void ST_call(void (*run)(void *), void * arg);
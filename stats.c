@@ -0,0 +1,113 @@
+/*
+ * stats.c -
+ * Implementation of per-phase compile statistics.
+ * See stats.h for more information.
+ */
+
+#include <stdio.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include "stats.h"
+
+#define STAT_MAX_PHASES 16
+
+typedef struct STAT_Phase_ {
+    string name;
+    double seconds;
+    long allocations;
+    long bytes;
+    long peak_kb;
+} STAT_Phase;
+
+bool STAT_counting = false;
+
+static STAT_Phase phases[STAT_MAX_PHASES];
+static int phase_count = 0;
+static bool in_phase = false;
+static double phase_start;
+/* Totals since STAT_enable, updated by every thread. */
+static long allocations = 0;
+static long bytes = 0;
+static long phase_allocations;
+static long phase_bytes;
+
+static double STAT_now() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+/* The most memory the process has held resident so far. */
+static long STAT_peak_kb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+void STAT_enable() {
+    STAT_counting = true;
+}
+
+void STAT_count_allocation(long size) {
+    __atomic_fetch_add(&allocations, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&bytes, size, __ATOMIC_RELAXED);
+}
+
+long STAT_allocated_bytes() {
+    return __atomic_load_n(&bytes, __ATOMIC_RELAXED);
+}
+
+void STAT_end() {
+    if (!in_phase) {
+        return;
+    }
+    in_phase = false;
+    STAT_Phase * phase = &phases[phase_count++];
+    phase->seconds = STAT_now() - phase_start;
+    phase->allocations = __atomic_load_n(&allocations, __ATOMIC_RELAXED) - phase_allocations;
+    phase->bytes = __atomic_load_n(&bytes, __ATOMIC_RELAXED) - phase_bytes;
+    phase->peak_kb = STAT_peak_kb();
+}
+
+void STAT_begin(string name) {
+    STAT_end();
+    if (!STAT_counting || phase_count == STAT_MAX_PHASES) {
+        return;
+    }
+    in_phase = true;
+    phases[phase_count].name = name;
+    phase_allocations = __atomic_load_n(&allocations, __ATOMIC_RELAXED);
+    phase_bytes = __atomic_load_n(&bytes, __ATOMIC_RELAXED);
+    phase_start = STAT_now();
+}
+
+void STAT_print(FILE * out, bool json) {
+    STAT_end();
+    STAT_Phase total = { "total", 0, 0, 0, STAT_peak_kb() };
+    for (int i = 0; i < phase_count; ++i) {
+        total.seconds += phases[i].seconds;
+        total.allocations += phases[i].allocations;
+        total.bytes += phases[i].bytes;
+    }
+    if (json) {
+        fprintf(out, "{\"phases\": [");
+        for (int i = 0; i < phase_count; ++i) {
+            fprintf(out, "%s{\"name\": \"%s\", \"ms\": %.3f, \"allocations\": %ld, "
+                    "\"bytes\": %ld, \"peak_rss_kb\": %ld}",
+                    i ? ", " : "", phases[i].name, phases[i].seconds * 1e3,
+                    phases[i].allocations, phases[i].bytes, phases[i].peak_kb);
+        }
+        fprintf(out, "], \"total\": {\"ms\": %.3f, \"allocations\": %ld, "
+                "\"bytes\": %ld, \"peak_rss_kb\": %ld}}\n",
+                total.seconds * 1e3, total.allocations, total.bytes, total.peak_kb);
+        return;
+    }
+    fprintf(out, "%-10s %12s %12s %14s %14s\n",
+            "phase", "time (ms)", "allocations", "bytes", "peak RSS (KB)");
+    for (int i = 0; i <= phase_count; ++i) {
+        STAT_Phase * phase = i < phase_count ? &phases[i] : &total;
+        fprintf(out, "%-10s %12.3f %12ld %14ld %14ld\n", phase->name, phase->seconds * 1e3,
+                phase->allocations, phase->bytes, phase->peak_kb);
+    }
+}
@@ -0,0 +1,35 @@
+/*
+ * stats.h -
+ * Per-phase compile statistics: the time each phase of the compiler
+ * takes on a monotonic clock, the allocations it makes through
+ * malloc_checked, and the high-water mark of the process's memory.
+ * Nothing is counted until STAT_enable is called.
+ * All types and functions declared in this module begin with "STAT_".
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "util.h"
+
+/* True once STAT_enable has been called; checked by malloc_checked. */
+extern bool STAT_counting;
+
+void STAT_enable();
+
+/* End the phase in progress, if any, and start the named one. */
+void STAT_begin(string phase);
+
+/* End the phase in progress, if any. */
+void STAT_end();
+
+/* Record an allocation of the given size; safe to call from any thread. */
+void STAT_count_allocation(long bytes);
+
+/* The bytes allocated through malloc_checked since STAT_enable. */
+long STAT_allocated_bytes();
+
+/* Print the phases as a table, or as a JSON object. */
+void STAT_print(FILE * out, bool json);
@@ -7,19 +7,24 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "util.h"
 #include "symbol.h"
 #include "table.h"
 
-#define SIZE 109  /* should be prime */
+#define SIZE 109  /* initial size */
 
 struct S_Symbol_ {
     string name;
     S_Symbol next;
 };
 
-static S_Symbol hashtable[SIZE];
+/* Grows with the number of symbols, so interning stays constant-time
+ * even for generated programs with millions of distinct names. */
+static S_Symbol * hashtable = NULL;
+static unsigned int hashtable_size = 0;
+static unsigned int symbol_count = 0;
 static struct S_Symbol_ marksym = {"<mark>", 0};
 
 
@@ -43,8 +48,31 @@ static int streq(string a, string b) {
     return !strcmp(a, b);
 }
 
+static void grow_hashtable() {
+    unsigned int size = hashtable_size ? 2 * hashtable_size + 1 : SIZE;
+    S_Symbol * table = malloc_checked(size * sizeof(*table));
+    for (unsigned int i = 0; i < size; i++) {
+        table[i] = NULL;
+    }
+    for (unsigned int i = 0; i < hashtable_size; i++) {
+        S_Symbol next;
+        for (S_Symbol sym = hashtable[i]; sym; sym = next) {
+            next = sym->next;
+            unsigned int index = hash(sym->name) % size;
+            sym->next = table[index];
+            table[index] = sym;
+        }
+    }
+    free(hashtable);
+    hashtable = table;
+    hashtable_size = size;
+}
+
 S_Symbol make_S_Symbol(string name) {
-    int index = hash(name) % SIZE;
+    if (symbol_count >= hashtable_size) {
+        grow_hashtable();
+    }
+    int index = hash(name) % hashtable_size;
     S_Symbol syms = hashtable[index];
     S_Symbol sym;
     for(sym = syms; sym; sym = sym->next) {
@@ -54,6 +82,7 @@ S_Symbol make_S_Symbol(string name) {
     }
     sym = mksymbol(name, syms);
     hashtable[index] = sym;
+    symbol_count++;
     return sym;
 }
  
@@ -65,6 +94,10 @@ S_Table S_empty() {
     return TAB_empty();
 }
 
+S_Table S_copy(S_Table t) {
+    return TAB_copy(t);
+}
+
 void S_enter(S_Table t, S_Symbol sym, void * value) {
     TAB_enter(t, sym, value);
 }
@@ -73,6 +106,10 @@ void * S_look(S_Table t, S_Symbol sym) {
     return TAB_look(t, sym);
 }
 
+int S_size(S_Table t) {
+    return TAB_size(t);
+}
+
 void S_begin_scope(S_Table t) {
     S_enter(t, &marksym, NULL);
 }
@@ -31,6 +31,9 @@ typedef struct TAB_Table_ * S_Table;
 /* Make a new table */
 S_Table S_empty();
 
+/* Make a snapshot of "t" that can be extended independently. */
+S_Table S_copy(S_Table t);
+
 /* Enter a binding "sym->value" into "t", shadowing but not deleting
  *    any previous binding of "sym". */
 void S_enter(S_Table t, S_Symbol sym, void * value);
@@ -39,6 +42,9 @@ void S_enter(S_Table t, S_Symbol sym, void * value);
  *    if sym is unbound. */
 void * S_look(S_Table t, S_Symbol sym);
 
+/* The number of bindings in "t", including shadowed ones and scope marks. */
+int S_size(S_Table t);
+
 /* Start a new "scope" in "t".  Scopes are nested. */
 void S_begin_scope(S_Table t);
 
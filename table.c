@@ -22,6 +22,7 @@ struct Binder_ {
 struct TAB_Table_ {
     Binder table[TABSIZE];
     void * top;
+    int size;
 };
 
 
@@ -37,12 +38,19 @@ static Binder make_Binder(void * key, void * value, Binder next, void * prevtop)
 TAB_Table TAB_empty() { 
     TAB_Table t = malloc_checked(sizeof(*t));
     t->top = NULL;
+    t->size = 0;
     for (int i = 0; i < TABSIZE; i++) {
         t->table[i] = NULL;
     }
     return t;
 }
 
+TAB_Table TAB_copy(TAB_Table t) {
+    TAB_Table copy = malloc_checked(sizeof(*copy));
+    *copy = *t;
+    return copy;
+}
+
 /* The cast from pointer to integer in the expression
  *   ((unsigned)key) % TABSIZE
  * may lead to a warning message.  However, the code is safe,
@@ -58,6 +66,7 @@ void TAB_enter(TAB_Table t, void * key, void * value) {
     index = ((unsigned long)key) % TABSIZE;
     t->table[index] = make_Binder(key, value, t->table[index], t->top);
     t->top = key;
+    t->size++;
 }
 
 void * TAB_look(TAB_Table t, void * key) {
@@ -85,9 +94,14 @@ void * TAB_pop(TAB_Table t) {
     assert(b);
     t->table[index] = b->next;
     t->top = b->prevtop;
+    t->size--;
     return b->key;
 }
 
+int TAB_size(TAB_Table t) {
+    return t->size;
+}
+
 void TAB_dump(TAB_Table t, void (*show)(void * key, void * value)) {
     void * k = t->top;
     int index = ((unsigned long)k) % TABSIZE;
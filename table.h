@@ -18,6 +18,11 @@ TAB_Table TAB_empty();
  *    shadowing but not destroying any previous binding for "key". */
 void TAB_enter(TAB_Table t, void * key, void * value);
 
+/* Make a new table with the same bindings and scopes as "t".
+ * Bindings are never modified in place, so this copies only
+ * the bucket heads; the two tables may then change independently. */
+TAB_Table TAB_copy(TAB_Table t);
+
 /* Look up the most recent binding for "key" in table "t" */
 void * TAB_look(TAB_Table t, void * key);
 
@@ -25,6 +30,9 @@ void * TAB_look(TAB_Table t, void * key);
  * This may expose another binding for the same key, if there was one. */
 void * TAB_pop(TAB_Table t);
 
+/* The number of bindings in "t", shadowed ones included. */
+int TAB_size(TAB_Table t);
+
 
 /* Call "show" on every "key"->"value" pair in the table,
  *  including shadowed bindings, in order from the most 
@@ -0,0 +1,108 @@
+#!/bin/sh
+#
+# run.sh -
+# Tests the compile cache, --cache=<dir>. A hit must print what the
+# compile it replays printed, on stdout and stderr, and in the same
+# order when both go to one file, and exit with the same status. -j
+# must not be part of the key. --emit-ir, --stats, --trace,
+# --pass-stats and programs read from standard input must bypass the
+# cache, and --cache-size must evict the least recently used entries.
+# $PARSE names the compiler, ./parse by default.
+# Usage: tests/cache/run.sh
+#
+cd "$(dirname "$0")/../.." || exit 1
+PARSE=${PARSE:-./parse}
+work=$(mktemp -d) || exit 1
+trap 'rm -rf "$work"' EXIT
+failed=0
+
+fail() {
+    echo "FAILED: $*"
+    failed=$((failed + 1))
+}
+
+# Prints the cache's hits, misses and entries on one line.
+counts() {
+    $PARSE --cache-stats="$1" | sed -n 's/^\(hits\|misses\|entries\): //p' | tr '\n' ' '
+}
+
+# Runs the compiler with the given arguments, saving its stdout,
+# stderr, both in order, and exit status under the name $1.
+run() {
+    name=$1
+    shift
+    $PARSE "$@" > "$work/$name.out" 2> "$work/$name.err"
+    echo $? > "$work/$name.status"
+    $PARSE "$@" > "$work/$name.both" 2>&1
+}
+
+same() {
+    for part in out err status both; do
+        if ! cmp -s "$work/$1.$part" "$work/$2.$part"; then
+            return 1
+        fi
+    done
+}
+
+# Replays: a program with IR, one with type errors, one with a syntax
+# error and a bad option, which fails.
+cache=$work/replay
+for args in "tests/samples/program.tig --cfg" "tests/errors/add_string.tig" \
+        "tests/recheck/reparse_fails_edited.tig" "tests/samples/program.tig -fpasses=nosuch"; do
+    rm -rf "$cache"
+    run direct $args
+    run miss $args --cache="$cache"
+    run hit $args --cache="$cache"
+    if [ "$(counts "$cache")" != "3 1 1 " ]; then
+        fail "$args: expected 3 hits, 1 miss and 1 entry, got $(counts "$cache")"
+    elif ! same direct miss || ! same direct hit; then
+        fail "$args: the cached compile prints differently"
+    fi
+done
+
+# -j is left out of the key.
+cache=$work/jobs
+$PARSE tests/samples/program.tig --cache="$cache" > /dev/null 2>&1
+$PARSE tests/samples/program.tig -j 3 --cache="$cache" > /dev/null 2>&1
+$PARSE tests/samples/program.tig -j2 --cache="$cache" > /dev/null 2>&1
+if [ "$(counts "$cache")" != "2 1 1 " ]; then
+    fail "-j: expected 2 hits, 1 miss and 1 entry, got $(counts "$cache")"
+fi
+
+# Bypasses leave the cache as it was.
+cache=$work/bypass
+$PARSE tests/samples/program.tig --cache="$cache" > /dev/null 2>&1
+for args in "--emit-ir=$work/program.ir" --stats --trace="$work/trace.json" --pass-stats; do
+    $PARSE tests/samples/program.tig $args --cache="$cache" > /dev/null 2>&1
+    if [ "$(counts "$cache")" != "0 1 1 " ]; then
+        fail "$args: the cache was used"
+    fi
+done
+$PARSE - --cache="$cache" < tests/samples/program.tig > "$work/stdin" 2>&1
+if [ "$(counts "$cache")" != "0 1 1 " ]; then
+    fail "standard input: the cache was used"
+elif ! grep -q '^Type: ' "$work/stdin"; then
+    fail "standard input: not compiled"
+fi
+
+# Two entries of over half a megabyte each do not fit in one; the
+# first is evicted when the second is stored, and used less recently.
+cache=$work/evict
+python3 tests/gen.py deep ops 350 > "$work/first.tig" || exit 1
+python3 tests/gen.py deep ops 360 > "$work/second.tig" || exit 1
+$PARSE "$work/first.tig" --cache="$cache" --cache-size=1 > /dev/null 2>&1
+$PARSE "$work/second.tig" --cache="$cache" --cache-size=1 > /dev/null 2>&1
+$PARSE "$work/second.tig" --cache="$cache" --cache-size=1 > /dev/null 2>&1
+if [ "$(counts "$cache")" != "1 2 1 " ]; then
+    fail "--cache-size: expected 1 hit, 2 misses and 1 entry, got $(counts "$cache")"
+fi
+$PARSE "$work/first.tig" --cache="$cache" --cache-size=1 > /dev/null 2>&1
+if [ "$(counts "$cache")" != "1 3 1 " ]; then
+    fail "--cache-size: the evicted entry was used"
+fi
+
+if [ $failed -ne 0 ]; then
+    echo "$failed cache test(s) failed"
+    exit 1
+fi
+echo "All cache tests passed"
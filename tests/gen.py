@@ -0,0 +1,86 @@
+#!/usr/bin/env python3
+"""
+gen.py -
+Generates the large Tiger programs that the stress tests and the
+measurements in the commit log run on, and writes one to stdout:
+
+  gen.py functions <n>      n top-level functions with records, arrays
+                            and loops, called from the main program
+                            (functions 20000 is "the 20k-function corpus")
+  gen.py deep <shape> <n>   one expression nested n deep, where shape is
+                            ops (a+a+...), parens, ifs (if/else chains),
+                            minus (unary minus) or lets (nested lets)
+  gen.py long <shape> <n>   one list n long, where shape is seq (a
+                            sequence of assignments), locals (a function
+                            with n local variables), fields (a record
+                            type and literal with n fields) or args (a
+                            function of n parameters and a call of it)
+"""
+
+import sys
+
+
+def functions(n):
+    lines = ['let type rec = {a: int, b: string}',
+             '    type arr = array of int',
+             '    var total := 0']
+    for i in range(n):
+        if i % 500 == 0:
+            lines.append('    var sep%d := %d' % (i, i))
+        lines.append('    function f%d(n: int, s: string) : int = '
+                     'let var r := rec {a = n * %d, b = s} var v := arr [10] of n in '
+                     'for j := 0 to 9 do v[j] := v[j] + r.a + j; '
+                     'while n do (total := total + v[3]; break); '
+                     'r.a - v[2] * (n + %d) end' % (i, i, i))
+    lines.append('in')
+    lines.append(' total := ' + ' + '.join('f%d(1, "x")' % i for i in range(0, n, 97)))
+    lines.append('end')
+    return '\n'.join(lines) + '\n'
+
+
+def deep(shape, n):
+    if shape == 'ops':
+        return 'let var a := 1 in a' + '+a' * (n - 1) + ' end\n'
+    if shape == 'parens':
+        return '(' * n + '1' + ')' * n + '\n'
+    if shape == 'ifs':
+        return 'if 1 then ' * n + '1' + ' else 0' * n + '\n'
+    if shape == 'minus':
+        return '-' * n + '1\n'
+    if shape == 'lets':
+        return (''.join('let var x%d := %d in ' % (i, i) for i in range(n))
+                + 'x0' + ' end' * n + '\n')
+    raise SystemExit('unknown deep shape: ' + shape)
+
+
+def long(shape, n):
+    if shape == 'seq':
+        return ('let var x := 0 in ('
+                + ';\n'.join('x := x + %d' % i for i in range(n)) + ') end\n')
+    if shape == 'locals':
+        return ('let function g() : int = let\n'
+                + ''.join('var v%d := %d\n' % (i, i) for i in range(n))
+                + ' in v7 end in g() end\n')
+    if shape == 'fields':
+        return ('let type r = {' + ', '.join('f%d: int' % i for i in range(n)) + '}\n'
+                + ' var v := r {' + ', '.join('f%d = %d' % (i, i) for i in range(n))
+                + '} in v.f7 end\n')
+    if shape == 'args':
+        return ('let function g(' + ', '.join('a%d: int' % i for i in range(n))
+                + ') : int = a1 in g(' + ', '.join('%d' % i for i in range(n)) + ') end\n')
+    raise SystemExit('unknown long shape: ' + shape)
+
+
+def main(argv):
+    if len(argv) == 3 and argv[1] == 'functions':
+        sys.stdout.write(functions(int(argv[2])))
+    elif len(argv) == 4 and argv[1] == 'deep':
+        sys.stdout.write(deep(argv[2], int(argv[3])))
+    elif len(argv) == 4 and argv[1] == 'long':
+        sys.stdout.write(long(argv[2], int(argv[3])))
+    else:
+        raise SystemExit(__doc__)
+
+
+if __name__ == '__main__':
+    main(sys.argv)
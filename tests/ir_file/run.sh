@@ -0,0 +1,78 @@
+#!/bin/sh
+#
+# run.sh -
+# Tests the binary IR file. Each test program that compiles without
+# errors, with nothing but -O, -f and --cfg options, is compiled with
+# --emit-ir, and what --load-ir prints for the file, given the same
+# options, must match what the compile printed. Then $CORRUPTIONS
+# copies of the file for tests/samples/program.tig, 300 by default,
+# each with 1 to 4 bytes overwritten at random, must load or be
+# rejected, never crash the compiler.
+# $PARSE names the compiler, ./parse by default.
+# Usage: tests/ir_file/run.sh
+#
+cd "$(dirname "$0")/../.." || exit 1
+PARSE=${PARSE:-./parse}
+CORRUPTIONS=${CORRUPTIONS:-300}
+work=$(mktemp -d) || exit 1
+trap 'rm -rf "$work"' EXIT
+failed=0
+
+fail() {
+    echo "FAILED: $*"
+    failed=$((failed + 1))
+}
+
+checked=0
+for program in tests/*/*.tig; do
+    args=$(sed -n '1s|^/\* args: \(.*\) \*/$|\1|p' "$program")
+    skip=false
+    for arg in $args; do
+        case $arg in
+            --cfg|-O*|-f*) ;;
+            *) skip=true ;;
+        esac
+    done
+    rm -f "$work/ir"
+    if $skip || ! $PARSE "$program" $args --emit-ir="$work/ir" > "$work/direct" 2> "$work/errors" \
+            || [ -s "$work/errors" ] || [ ! -f "$work/ir" ]; then
+        continue
+    fi
+    sed '1{/^Parsing successful!$/d}' "$work/direct" > "$work/expected"
+    $PARSE --load-ir="$work/ir" $args > "$work/loaded" 2>&1
+    status=$?
+    if [ $status -ne 0 ] || ! cmp -s "$work/expected" "$work/loaded"; then
+        fail "$program: --load-ir $args, exit status $status"
+    fi
+    checked=$((checked + 1))
+done
+echo "$checked programs loaded back"
+
+$PARSE tests/samples/program.tig --emit-ir="$work/program.ir" > /dev/null 2>&1
+rejected=0
+i=0
+while [ $i -lt $CORRUPTIONS ]; do
+    python3 - "$work/program.ir" "$work/corrupt.ir" $i <<'PY'
+import random, sys
+data = bytearray(open(sys.argv[1], 'rb').read())
+rng = random.Random(int(sys.argv[3]))
+for _ in range(rng.randint(1, 4)):
+    data[rng.randrange(len(data))] = rng.randrange(256)
+open(sys.argv[2], 'wb').write(data)
+PY
+    $PARSE --load-ir="$work/corrupt.ir" --cfg > /dev/null 2>&1
+    status=$?
+    if [ $status -gt 1 ]; then
+        fail "corruption $i: exit status $status"
+    elif [ $status -eq 1 ]; then
+        rejected=$((rejected + 1))
+    fi
+    i=$((i + 1))
+done
+echo "$rejected of $CORRUPTIONS corrupted files rejected"
+
+if [ $failed -ne 0 ]; then
+    echo "$failed IR file test(s) failed"
+    exit 1
+fi
+echo "All IR file tests passed"
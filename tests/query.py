@@ -0,0 +1,88 @@
+#!/usr/bin/env python3
+"""
+query.py -
+Drives `parse --query` the way an editor would, and writes the
+results to stdout:
+
+  query.py <parse> <file> <method>:<line>:<column> ...
+        sends each query, then asks for the file's diagnostics
+  query.py <parse> <file>
+        sends 5000 hover, definition and references queries at
+        random positions of the file and reports their latency
+"""
+
+import json
+import random
+import subprocess
+import sys
+import time
+
+
+class Service:
+    def __init__(self, parse):
+        self.process = subprocess.Popen([parse, '--query'],
+                                        stdin=subprocess.PIPE, stdout=subprocess.PIPE)
+        self.id = 0
+
+    def call(self, method, **params):
+        self.id += 1
+        body = json.dumps({'jsonrpc': '2.0', 'id': self.id,
+                           'method': method, 'params': params}).encode()
+        self.process.stdin.write(b'Content-Length: %d\r\n\r\n' % len(body) + body)
+        self.process.stdin.flush()
+        length = None
+        while True:
+            line = self.process.stdout.readline()
+            if not line:
+                raise SystemExit('the query service exited')
+            if line.lower().startswith(b'content-length:'):
+                length = int(line.split(b':')[1])
+            if line in (b'\r\n', b'\n'):
+                break
+        reply = json.loads(self.process.stdout.read(length))
+        assert reply['id'] == self.id, reply
+        return reply.get('result', reply.get('error'))
+
+    def shutdown(self):
+        self.call('shutdown')
+        return self.process.wait()
+
+
+def latency(service, name):
+    start = time.time()
+    diagnostics = service.call('diagnostics', file=name)
+    print('load %.1f ms, %s, %d diagnostics'
+          % ((time.time() - start) * 1e3, diagnostics['type'], len(diagnostics['diagnostics'])))
+    lines = open(name).read().split('\n')
+    random.seed(1)
+    times = []
+    for _ in range(5000):
+        line = random.randrange(len(lines))
+        column = random.randrange(max(1, len(lines[line]))) + 1
+        method = random.choice(['hover', 'definition', 'references'])
+        start = time.time()
+        service.call(method, file=name, line=line + 1, column=column)
+        times.append((time.time() - start) * 1e3)
+    times.sort()
+    print('p50 %.3f ms, p99 %.3f ms, max %.3f ms'
+          % (times[len(times) // 2], times[int(len(times) * .99)], times[-1]))
+
+
+def main(argv):
+    if len(argv) < 3:
+        raise SystemExit(__doc__)
+    service = Service(argv[1])
+    name = argv[2]
+    if len(argv) > 3:
+        for query in argv[3:]:
+            method, line, column = query.split(':')
+            print(query, json.dumps(service.call(method, file=name,
+                                                 line=int(line), column=int(column))))
+        print(json.dumps(service.call('diagnostics', file=name)))
+    else:
+        latency(service, name)
+    print('exit status', service.shutdown())
+
+
+if __name__ == '__main__':
+    main(sys.argv)
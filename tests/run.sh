@@ -0,0 +1,44 @@
+#!/bin/sh
+#
+# run.sh -
+# Runs the compiler on each test program, tests/<group>/<name>.tig, and
+# compares everything it prints, and its exit status, with what was
+# recorded in tests/<group>/<name>.out.
+# A program's first line may give the options it is compiled with, as a
+# comment: /* args: -O1 --cfg */. Options in $ARGS are added to every
+# run; ARGS="-j 3" checks that parallel checking prints the same.
+# The times in --pass-stats tables are left out.
+# $PARSE names the compiler, ./parse by default.
+# Usage: tests/run.sh            compare with the recorded output
+#        tests/run.sh record     record the current output
+#
+
+cd "$(dirname "$0")/.." || exit 1
+PARSE=${PARSE:-./parse}
+failed=0
+for program in tests/*/*.tig; do
+    expected=${program%.tig}.out
+    args=$(sed -n '1s|^/\* args: \(.*\) \*/$|\1|p' "$program")
+    actual=$($PARSE "$program" $args $ARGS 2>&1; echo "exit status $?")
+    # Pass timings differ from run to run, so --pass-stats tables are
+    # compared without them.
+    case $args in
+        *--pass-stats*)
+            actual=$(printf '%s\n' "$actual" | sed 's/^\([a-z]* *[0-9]*\) *[0-9]*\.[0-9]* /\1 /')
+            ;;
+    esac
+    if [ "$1" = record ]; then
+        printf '%s\n' "$actual" > "$expected"
+    elif [ "$actual" != "$(cat "$expected" 2>/dev/null)" ]; then
+        echo "FAILED: $program"
+        printf '%s\n' "$actual" | diff "$expected" - | head -n 20
+        failed=$((failed + 1))
+    fi
+done
+if [ "$1" != record ]; then
+    if [ $failed -ne 0 ]; then
+        echo "$failed test(s) failed"
+        exit 1
+    fi
+    echo "All tests passed"
+fi
@@ -0,0 +1,85 @@
+#!/bin/sh
+#
+# run.sh -
+# Tests the compile daemon. It starts --server=<socket> and runs each
+# test program, with its options, through --client=<socket>, and
+# then one read from standard input; each must print the same on
+# stdout and stderr, and exit with the same status, as a local
+# compile. A client given a socket nothing listens on, or no socket
+# at all, must compile locally. The daemon must still be running at
+# the end.
+# $PARSE names the compiler, ./parse by default.
+# Usage: tests/server/run.sh
+#
+cd "$(dirname "$0")/../.." || exit 1
+PARSE=${PARSE:-./parse}
+work=$(mktemp -d) || exit 1
+trap 'kill $server 2>/dev/null; rm -rf "$work"' EXIT
+failed=0
+
+fail() {
+    echo "FAILED: $*"
+    failed=$((failed + 1))
+}
+
+# Runs the compiler with the given arguments, saving its stdout,
+# stderr and exit status under the name $1. The times in --pass-stats
+# tables differ from run to run and are left out.
+run() {
+    name=$1
+    shift
+    $PARSE "$@" > "$work/$name.out" 2> "$work/$name.stderr"
+    echo $? > "$work/$name.status"
+    sed 's/^\([a-z]* *[0-9]*\) *[0-9]*\.[0-9]* /\1 /' "$work/$name.stderr" > "$work/$name.err"
+}
+
+same() {
+    cmp -s "$work/$1.out" "$work/$2.out" && cmp -s "$work/$1.err" "$work/$2.err" \
+        && cmp -s "$work/$1.status" "$work/$2.status"
+}
+
+socket=$work/parse.sock
+$PARSE --server="$socket" > "$work/server.log" 2>&1 &
+server=$!
+tries=0
+while [ ! -S "$socket" ] && [ $tries -lt 100 ]; do
+    sleep 0.1
+    tries=$((tries + 1))
+done
+if [ ! -S "$socket" ]; then
+    echo "FAILED: the daemon did not start"
+    exit 1
+fi
+
+for program in tests/*/*.tig; do
+    args=$(sed -n '1s|^/\* args: \(.*\) \*/$|\1|p' "$program")
+    run local "$program" $args
+    run remote "$program" $args --client="$socket"
+    if ! same local remote; then
+        fail "$program through the daemon"
+    fi
+done
+run local - < tests/samples/program.tig
+run remote - --client="$socket" < tests/samples/program.tig
+if ! same local remote; then
+    fail "standard input through the daemon"
+fi
+
+# A socket file nothing listens on, and a missing one.
+touch "$work/stale.sock"
+for missing in "$work/stale.sock" "$work/missing.sock"; do
+    run local tests/samples/program.tig --cfg
+    run fallback tests/samples/program.tig --cfg --client="$missing"
+    if ! same local fallback; then
+        fail "$missing: not compiled locally"
+    fi
+done
+
+if ! kill -0 $server 2>/dev/null; then
+    fail "the daemon exited: $(cat "$work/server.log")"
+fi
+if [ $failed -ne 0 ]; then
+    echo "$failed server test(s) failed"
+    exit 1
+fi
+echo "All server tests passed"
@@ -0,0 +1,70 @@
+#!/bin/sh
+#
+# run.sh -
+# Stress tests for deeply nested programs. Each nesting shape that
+# tests/gen.py makes is checked with --check-only at $DEPTH levels,
+# 1000000 by default, and must type-check; the time each takes is
+# printed. Each is also lowered to control-flow graphs with --cfg at
+# that depth, which must succeed. Then, with the C stack limited to 64 KB, programs
+# $SMALL_DEPTH levels deep, 5000 by default, must print the same
+# AST and IR as a sequential run with the normal stack, also under
+# -j 4, and -r must print what it does with the normal stack.
+# $PARSE names the compiler, ./parse by default.
+# Usage: tests/stress/run.sh
+#
+cd "$(dirname "$0")/../.." || exit 1
+PARSE=${PARSE:-./parse}
+DEPTH=${DEPTH:-1000000}
+SMALL_DEPTH=${SMALL_DEPTH:-5000}
+work=$(mktemp -d) || exit 1
+trap 'rm -rf "$work"' EXIT
+failed=0
+
+fail() {
+    echo "FAILED: $*"
+    failed=$((failed + 1))
+}
+
+for shape in ops parens ifs minus lets; do
+    program=$work/$shape.tig
+    python3 tests/gen.py deep $shape $DEPTH > "$program" || exit 1
+    start=$(date +%s%N)
+    $PARSE "$program" --check-only > "$work/out" 2>&1
+    status=$?
+    end=$(date +%s%N)
+    if [ $status -ne 0 ] || ! grep -q '^Type: T_INT$' "$work/out"; then
+        fail "$shape at depth $DEPTH, exit status $status"
+    else
+        echo "$shape at depth $DEPTH: $(( (end - start) / 1000000 )) ms"
+    fi
+done
+
+for shape in ops parens ifs minus lets; do
+    program=$work/$shape.tig
+    python3 tests/gen.py deep $shape $DEPTH > "$program" || exit 1
+    $PARSE "$program" --cfg > /dev/null 2>&1
+    status=$?
+    if [ $status -ne 0 ]; then
+        fail "$shape at depth $DEPTH with --cfg, exit status $status"
+    fi
+done
+
+for shape in ops parens ifs minus lets; do
+    program=$work/$shape.tig
+    python3 tests/gen.py deep $shape $SMALL_DEPTH > "$program" || exit 1
+    $PARSE "$program" -p > "$work/sequential" 2>&1
+    $PARSE "$program" -p -r "$program" > "$work/recheck" 2>&1
+    for args in "-p sequential" "-p -j 4 sequential" "-p -r $program recheck"; do
+        expected=$work/${args##* }
+        (ulimit -s 64 && $PARSE "$program" ${args% *}) > "$work/actual" 2>&1
+        if ! cmp -s "$expected" "$work/actual"; then
+            fail "$shape at depth $SMALL_DEPTH with a 64 KB stack: ${args% *}"
+        fi
+    done
+done
+
+if [ $failed -ne 0 ]; then
+    echo "$failed stress test(s) failed"
+    exit 1
+fi
+echo "All stress tests passed"
@@ -0,0 +1,84 @@
+#!/bin/sh
+#
+# run.sh -
+# Tests --watch through bad edits and their fixes. It watches the
+# program below, saves each ill-typed version of one of its function
+# bodies over it in turn, saving the program back after each, and
+# compares everything the watcher printed, times left out, with
+# tests/watch/expected.out. It then adds a directory named like a
+# program, which cannot be read, and saves the program again. The
+# watcher must still be running at the end.
+# $PARSE names the compiler, ./parse by default.
+# Usage: tests/watch/run.sh            compare with the recorded output
+#        tests/watch/run.sh record     record the current output
+#
+
+cd "$(dirname "$0")/../.." || exit 1
+PARSE=${PARSE:-./parse}
+case $PARSE in
+    /*) ;;
+    *) PARSE=$(pwd)/$PARSE ;;
+esac
+tests=$(pwd)/tests/watch
+work=$(mktemp -d) || exit 1
+trap 'kill $watcher 2>/dev/null; rm -rf "$work"' EXIT
+mkdir "$work/src"
+
+# Saves $1 as the watched program, as editors do, and waits for the
+# watcher to report it.
+save() {
+    reports=$(grep -c '^\./program\.tig: ' "$work/out")
+    printf '%s\n' "$1" > "$work/next.tig"
+    mv "$work/next.tig" "$work/src/program.tig"
+    wait_for_report $((reports + 1))
+}
+
+wait_for_report() {
+    tries=0
+    while [ "$(grep -c '^\./program\.tig: ' "$work/out")" -lt "$1" ] && [ $tries -lt 100 ]; do
+        sleep 0.1
+        tries=$((tries + 1))
+    done
+}
+
+good='let function double(n: int) : int = n * 2
+    function edited() : int = double(3)
+    function report() = print("done")
+in
+    report();
+    edited()
+end'
+printf '%s\n' "$good" > "$work/src/program.tig"
+(cd "$work/src" && exec "$PARSE" --watch=.) > "$work/out" 2>&1 &
+watcher=$!
+wait_for_report 1
+for body in 'let var x := nosuch() in x end' \
+        'if 1 then print("a") else nosuch()' \
+        '(while nosuch() do (); 0)' \
+        '(for i := 1 to nosuch() do (); 0)' \
+        'nosuch() + 1' \
+        'n + nosuch' \
+        'double(nosuch)' \
+        'let var a := arr [3] of 0 in a[0] end'; do
+    save "$(printf '%s\n' "$good" | sed "s|double(3)|$body|")"
+    save "$good"
+done
+# A directory cannot be read; the watcher reports it and goes on.
+mkdir "$work/next.tig"
+mv "$work/next.tig" "$work/src/directory.tig"
+save "$good"
+if kill -0 $watcher 2>/dev/null; then
+    echo "watcher still running" >> "$work/out"
+else
+    wait $watcher
+    echo "watcher exited with status $?" >> "$work/out"
+fi
+sed 's/([0-9.]* ms; /(/' "$work/out" > "$work/actual"
+if [ "$1" = record ]; then
+    cp "$work/actual" "$tests/expected.out"
+elif ! diff "$tests/expected.out" "$work/actual"; then
+    echo "FAILED: tests/watch"
+    exit 1
+else
+    echo "All watch tests passed"
+fi
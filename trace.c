@@ -0,0 +1,168 @@
+/*
+ * trace.c -
+ * Implementation of Chrome trace-event recording.
+ * See trace.h for more information.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "trace.h"
+
+/* Events kept per thread: about 10 MB, touched only as they are recorded. */
+#define TRACE_RING_SIZE (1 << 18)
+#define TRACE_MAX_DEPTH 256
+
+typedef struct TRACE_Event_ {
+    string name;
+    string category;
+    long start;
+    /* The duration of a span, or the value of a counter sample. */
+    long value;
+    bool counter;
+} TRACE_Event;
+
+typedef struct TRACE_Span_ {
+    string name;
+    string category;
+    long start;
+} TRACE_Span;
+
+typedef struct TRACE_Buffer_ * TRACE_Buffer;
+
+struct TRACE_Buffer_ {
+    int thread;
+    long recorded;
+    TRACE_Event events[TRACE_RING_SIZE];
+    int depth;
+    TRACE_Span open[TRACE_MAX_DEPTH];
+    TRACE_Buffer next;
+};
+
+bool TRACE_enabled = false;
+
+static long trace_start;
+static pthread_mutex_t buffers_lock = PTHREAD_MUTEX_INITIALIZER;
+static TRACE_Buffer buffers = NULL;
+static int thread_count = 0;
+static __thread TRACE_Buffer buffer = NULL;
+
+static long TRACE_now() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000L + now.tv_nsec - trace_start;
+}
+
+/* The calling thread's buffer, made and registered on first use. */
+static TRACE_Buffer TRACE_buffer() {
+    if (!buffer) {
+        buffer = malloc_checked(sizeof(*buffer));
+        buffer->recorded = 0;
+        buffer->depth = 0;
+        pthread_mutex_lock(&buffers_lock);
+        buffer->thread = ++thread_count;
+        buffer->next = buffers;
+        buffers = buffer;
+        pthread_mutex_unlock(&buffers_lock);
+    }
+    return buffer;
+}
+
+static void TRACE_record(TRACE_Buffer buffer, string name, string category,
+        long start, long value, bool counter) {
+    TRACE_Event * event = &buffer->events[buffer->recorded++ % TRACE_RING_SIZE];
+    event->name = name;
+    event->category = category;
+    event->start = start;
+    event->value = value;
+    event->counter = counter;
+}
+
+void TRACE_start() {
+    TRACE_enabled = false;
+    trace_start = TRACE_now();
+    TRACE_enabled = true;
+}
+
+void TRACE_begin(string name, string category) {
+    if (!TRACE_enabled) {
+        return;
+    }
+    TRACE_Buffer buffer = TRACE_buffer();
+    // Spans nested too deeply are dropped, but still counted, so ends still match.
+    if (buffer->depth < TRACE_MAX_DEPTH) {
+        TRACE_Span * span = &buffer->open[buffer->depth];
+        span->name = name;
+        span->category = category;
+        span->start = TRACE_now();
+    }
+    ++buffer->depth;
+}
+
+void TRACE_end() {
+    if (!TRACE_enabled) {
+        return;
+    }
+    TRACE_Buffer buffer = TRACE_buffer();
+    if (!buffer->depth) {
+        return;
+    }
+    if (--buffer->depth < TRACE_MAX_DEPTH) {
+        TRACE_Span * span = &buffer->open[buffer->depth];
+        TRACE_record(buffer, span->name, span->category, span->start,
+                TRACE_now() - span->start, false);
+    }
+}
+
+void TRACE_counter(string name, long value) {
+    if (!TRACE_enabled) {
+        return;
+    }
+    TRACE_record(TRACE_buffer(), name, "counter", TRACE_now(), value, true);
+}
+
+static void TRACE_write_string(FILE * out, string s) {
+    fputc('"', out);
+    for (; *s; ++s) {
+        if (*s == '"' || *s == '\\') {
+            fputc('\\', out);
+        }
+        fputc(*s, out);
+    }
+    fputc('"', out);
+}
+
+bool TRACE_write(string file_name) {
+    FILE * out = fopen(file_name, "w");
+    if (!out) {
+        return false;
+    }
+    fprintf(out, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    bool first = true;
+    for (TRACE_Buffer buffer = buffers; buffer; buffer = buffer->next) {
+        fprintf(out, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, "
+                "\"args\": {\"name\": \"%s %d\"}}",
+                first ? "" : ",\n", buffer->thread,
+                buffer->thread == 1 ? "main" : "worker", buffer->thread);
+        first = false;
+        long oldest = buffer->recorded > TRACE_RING_SIZE ? buffer->recorded - TRACE_RING_SIZE : 0;
+        for (long i = oldest; i < buffer->recorded; ++i) {
+            TRACE_Event * event = &buffer->events[i % TRACE_RING_SIZE];
+            fprintf(out, ",\n{\"name\": ");
+            TRACE_write_string(out, event->name);
+            fprintf(out, ", \"cat\": ");
+            TRACE_write_string(out, event->category);
+            if (event->counter) {
+                fprintf(out, ", \"ph\": \"C\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, "
+                        "\"args\": {\"value\": %ld}}",
+                        buffer->thread, event->start / 1e3, event->value);
+            } else {
+                fprintf(out, ", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}",
+                        buffer->thread, event->start / 1e3, event->value / 1e3);
+            }
+        }
+    }
+    fprintf(out, "\n]}\n");
+    return !fclose(out);
+}
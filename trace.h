@@ -0,0 +1,36 @@
+/*
+ * trace.h -
+ * Records the compiler's activity as Chrome trace events,
+ * viewable in Perfetto or chrome://tracing.
+ * Spans nest per thread; each is recorded when it ends, as one
+ * complete event holding its start and duration, into a ring buffer
+ * owned by the recording thread, so recording takes no locks.
+ * A thread that records more events than its ring holds
+ * loses its oldest spans, never half of one.
+ * Every call returns at once unless TRACE_start has been called.
+ * All types and functions declared in this module begin with "TRACE_".
+ */
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "util.h"
+
+/* True once TRACE_start has been called. */
+extern bool TRACE_enabled;
+
+void TRACE_start();
+
+/* Open a span on the calling thread. The strings are not copied,
+ * so they must outlive the trace. */
+void TRACE_begin(string name, string category);
+
+/* Close the calling thread's innermost open span. */
+void TRACE_end();
+
+/* Record a sample of a counter track. */
+void TRACE_counter(string name, long value);
+
+/* Write every thread's events to a JSON file; false if it cannot be written. */
+bool TRACE_write(string file_name);
@@ -1,7 +1,9 @@
 #include <assert.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <stdio.h>
 
+#include "arena.h"
 #include "env.h"
 #include "frame.h"
 #include "symbol.h"
@@ -9,7 +11,16 @@
 #include "types.h"
 #include "util.h"
 
-TR_LabelList TR_loop_list;
+/* The size of a node whose u holds the given variant;
+ * nodes are allocated no larger than that. */
+#define TR_STM_SIZE(variant) (offsetof(struct TR_Stm_, u) + sizeof(((TR_Stm) 0)->u.variant))
+#define TR_EXP_SIZE(variant) (offsetof(struct TR_Exp_, u) + sizeof(((TR_Exp) 0)->u.variant))
+/* The capacity of a list when its first item is added. */
+#define TR_LIST_CAPACITY 2
+
+__thread TR_LabelList TR_loop_list;
+static __thread TR_Temp next_temp = 0;
+static __thread TR_Label next_label = 0;
 
 TR_VarList make_TR_VarList(F_Var head, TR_VarList tail) {
     TR_VarList list = malloc_checked(sizeof(*list));
@@ -18,24 +29,71 @@ TR_VarList make_TR_VarList(F_Var head, TR_VarList tail) {
     return list;
 }
 
+static TR_Stm TR_alloc_stm(int kind, int size) {
+    TR_Stm p = AR_alloc(size);
+    p->kind = kind;
+    return p;
+}
+
+static TR_Exp TR_alloc_exp(int kind, int size) {
+    TR_Exp p = AR_alloc(size);
+    p->kind = kind;
+    return p;
+}
+
+int TR_stm_size(TR_Stm stm) {
+    switch (stm->kind) {
+        case TR_ASSIGN_STM: return TR_STM_SIZE(assign);
+        case TR_PCALL_STM: return TR_STM_SIZE(pcall);
+        case TR_SEQ_STM: return TR_STM_SIZE(seq);
+        case TR_IF_STM: return TR_STM_SIZE(if_);
+        case TR_IF_ELSE_STM: return TR_STM_SIZE(if_else);
+        case TR_WHILE_STM: return TR_STM_SIZE(while_);
+        case TR_FOR_STM: return TR_STM_SIZE(for_);
+        case TR_BREAK_STM: return TR_STM_SIZE(break_);
+        case TR_EXP_STM: return TR_STM_SIZE(exp);
+    }
+    return sizeof(*stm);
+}
+
+int TR_exp_size(TR_Exp exp) {
+    switch (exp->kind) {
+        case TR_NUM_EXP: return TR_EXP_SIZE(num);
+        case TR_STRING_EXP: return TR_EXP_SIZE(str);
+        case TR_MEM_EXP: return TR_EXP_SIZE(mem);
+        case TR_VAR_EXP: return TR_EXP_SIZE(var);
+        case TR_FIELD_EXP: return TR_EXP_SIZE(field);
+        case TR_SUBSCRIPT_EXP: return TR_EXP_SIZE(subscript);
+        case TR_RECORD_EXP: return TR_EXP_SIZE(record);
+        case TR_ARRAY_EXP: return TR_EXP_SIZE(array);
+        case TR_ARITH_OP_EXP: return TR_EXP_SIZE(arith);
+        case TR_DIV_OP_EXP: return TR_EXP_SIZE(div);
+        case TR_REL_OP_EXP: return TR_EXP_SIZE(rel);
+        case TR_IF_EXP: return TR_EXP_SIZE(if_);
+        case TR_IF_ELSE_EXP: return TR_EXP_SIZE(if_else);
+        case TR_FCALL_EXP: return TR_EXP_SIZE(fcall);
+        case TR_SEQ_EXP: return TR_EXP_SIZE(seq);
+    }
+    return sizeof(*exp);
+}
+
+TR_TransExp make_TR_TransNone() {
+    TR_TransExp p = { .kind = TR_NONE };
+    return p;
+}
+
 TR_TransExp make_TR_TransFunction(TR_Function function) {
-    TR_TransExp p = malloc_checked(sizeof(*p));
-    p->kind = TR_FUNCTION;
-    p->u.function = function;
+    TR_TransExp p = { .kind = TR_FUNCTION, .u.function = function };
     return p;
 }
 
 TR_TransExp make_TR_TransStm(TR_Stm stm) {
-    TR_TransExp p = malloc_checked(sizeof(*p));
-    p->kind = TR_STM;
-    p->u.stm = stm;
+    TR_TransExp p = { .kind = TR_STM, .u.stm = stm };
     return p;
 }
 
 TR_TransExp make_TR_TransExp(TR_Exp exp) {
-    TR_TransExp p = malloc_checked(sizeof(*p));
-    p->kind = TR_EXP;
-    p->u.exp = exp;
+    TR_TransExp p = { .kind = TR_EXP, .u.exp = exp };
     return p;
 }
 
@@ -46,6 +104,9 @@ TR_Function make_TR_Function(S_Symbol name, F_Frame frame) {
     p->parent = NULL;
     p->children = NULL;
     p->body = NULL;
+    p->last_child = NULL;
+    p->temp_count = 0;
+    p->label_count = 0;
     return p;
 }
 
@@ -61,12 +122,9 @@ void TR_append_function(TR_Function parent, TR_Function child) {
     if (!parent->children) {
         parent->children = new_list;
     } else {
-        TR_FunctionList flist = parent->children;
-        while (flist->tail) {
-            flist = flist->tail;
-        }
-        flist->tail = new_list;
+        parent->last_child->tail = new_list;
     }
+    parent->last_child = new_list;
     assert(parent->frame);
     int nesting_level = parent->frame->nesting_level + 1;
     if (!child->frame) {
@@ -77,14 +135,18 @@ void TR_append_function(TR_Function parent, TR_Function child) {
     child->parent = parent;
 }
 
-void TR_add_param(TR_Function func, S_Symbol name, T_Type type) {
+F_Var TR_add_param(TR_Function func, S_Symbol name, T_Type type, bool escape) {
     assert(func->frame);
-    F_add_param(func->frame, make_F_Var(name, type));
+    F_Var param = make_F_Var(name, type, escape ? -1 : TR_new_temp());
+    F_add_param(func->frame, param);
+    return param;
 }
 
-void TR_add_var(TR_Function func, S_Symbol name, T_Type type) {
+F_Var TR_add_var(TR_Function func, S_Symbol name, T_Type type, bool escape) {
     assert(func->frame);
-    F_add_var(func->frame, make_F_Var(name, type));
+    F_Var var = make_F_Var(name, type, escape ? -1 : TR_new_temp());
+    F_add_var(func->frame, var);
+    return var;
 }
 
 void TR_add_stm_to_function(TR_Function func, TR_Stm stm) {
@@ -92,51 +154,37 @@ void TR_add_stm_to_function(TR_Function func, TR_Stm stm) {
         TR_add_stm_list_to_function(func, stm->u.seq);
         return;
     }
-    TR_StmList stm_list = make_TR_StmList(stm, NULL);
-    if (!func->body) {
-        func->body = stm_list;
-    } else {
-        TR_StmList current = func->body;
-        while (current->tail) {
-            current = current->tail;
-        }
-        current->tail = stm_list;
-    }
+    func->body = TR_add_stm(func->body, stm);
 }
 
 void TR_add_stm_list_to_function(TR_Function func, TR_StmList stms) {
-    while (stms) {
-        TR_add_stm_to_function(func, stms->head);
-        stms = stms->tail;
+    for (int i = 0, n = TR_stm_count(stms); i < n; ++i) {
+        TR_add_stm_to_function(func, stms->items[i]);
     }
 }
 
 TR_Stm make_TR_AssignStm(TR_Exp value, TR_Exp var) {
-    TR_Stm p = malloc_checked(sizeof(*p));
-    p->kind = TR_ASSIGN_STM;
+    TR_Stm p = TR_alloc_stm(TR_ASSIGN_STM, TR_STM_SIZE(assign));
     p->u.assign.value = value;
     p->u.assign.var = var;
     return p;
 }
 
 TR_Stm make_TR_PCallStm(S_Symbol name, TR_ExpList args) {
-    TR_Stm p = malloc_checked(sizeof(*p));
-    p->kind = TR_PCALL_STM;
+    TR_Stm p = TR_alloc_stm(TR_PCALL_STM, TR_STM_SIZE(pcall));
     p->u.pcall.name = name;
     p->u.pcall.args = args;
     return p;
 }
 
 TR_Stm make_TR_SeqStm(TR_StmList stms) {
-    TR_Stm p = malloc_checked(sizeof(*p));
-    p->kind = TR_SEQ_STM;
+    TR_Stm p = TR_alloc_stm(TR_SEQ_STM, TR_STM_SIZE(seq));
     p->u.seq = stms;
     return p;
 }
 
 TR_Stm make_TR_IfStm(TR_Exp test, TR_Stm true_branch) {
-    TR_Stm p = malloc_checked(sizeof(*p));
-    p->kind = TR_IF_STM;
+    TR_Stm p = TR_alloc_stm(TR_IF_STM, TR_STM_SIZE(if_));
     p->u.if_.test = test;
     p->u.if_.false_label = TR_new_label();
     p->u.if_.true_branch = true_branch;
@@ -144,8 +192,7 @@ TR_Stm make_TR_IfStm(TR_Exp test, TR_Stm true_branch) {
 }
 
 TR_Stm make_TR_IfElseStm(TR_Exp test, TR_Stm true_branch, TR_Stm false_branch) {
-    TR_Stm p = malloc_checked(sizeof(*p));
-    p->kind = TR_IF_ELSE_STM;
+    TR_Stm p = TR_alloc_stm(TR_IF_ELSE_STM, TR_STM_SIZE(if_else));
     p->u.if_else.test = test;
     p->u.if_else.false_label = TR_new_label();
     p->u.if_else.true_branch = true_branch;
@@ -155,8 +202,7 @@ TR_Stm make_TR_IfElseStm(TR_Exp test, TR_Stm true_branch, TR_Stm false_branch) {
 }
 
 TR_Stm make_TR_WhileStm(TR_Exp test, TR_Stm body) {
-    TR_Stm p = malloc_checked(sizeof(*p));
-    p->kind = TR_WHILE_STM;
+    TR_Stm p = TR_alloc_stm(TR_WHILE_STM, TR_STM_SIZE(while_));
     p->u.while_.test_label = TR_new_label();
     p->u.while_.test = test;
     p->u.while_.skip_label = TR_new_label();
@@ -165,8 +211,7 @@ TR_Stm make_TR_WhileStm(TR_Exp test, TR_Stm body) {
 }
 
 TR_Stm make_TR_ForStm(TR_Exp var, TR_Exp lo, TR_Exp hi, TR_Stm body) {
-    TR_Stm p = malloc_checked(sizeof(*p));
-    p->kind = TR_FOR_STM;
+    TR_Stm p = TR_alloc_stm(TR_FOR_STM, TR_STM_SIZE(for_));
     p->u.for_.var = var;
     p->u.for_.lo = lo;
     p->u.for_.hi = hi;
@@ -177,43 +222,46 @@ TR_Stm make_TR_ForStm(TR_Exp var, TR_Exp lo, TR_Exp hi, TR_Stm body) {
 }
 
 TR_Stm make_TR_BreakStm(TR_Label skip_label) {
-    TR_Stm p = malloc_checked(sizeof(*p));
-    p->kind = TR_BREAK_STM;
+    TR_Stm p = TR_alloc_stm(TR_BREAK_STM, TR_STM_SIZE(break_));
     p->u.break_ = skip_label;
     return p;
 }
 
 TR_Stm make_TR_ExpStm(TR_Exp exp) {
-    TR_Stm p = malloc_checked(sizeof(*p));
-    p->kind = TR_EXP_STM;
+    TR_Stm p = TR_alloc_stm(TR_EXP_STM, TR_STM_SIZE(exp));
     p->u.exp = exp;
     return p;
 }
 
-TR_StmList make_TR_StmList(TR_Stm head, TR_StmList tail) {
-    TR_StmList p = malloc_checked(sizeof(*p));
-    p->head = head;
-    p->tail = tail;
-    return p;
+/* Room for one more item in a list with items of the given size,
+ * which may move the list; NULL is the empty list. */
+static void * TR_grow_list(void * list, int length, int capacity, int item_size) {
+    if (list && length < capacity) {
+        return list;
+    }
+    int new_capacity = capacity ? 2 * capacity : TR_LIST_CAPACITY;
+    int header_size = offsetof(struct TR_StmList_, items);
+    // Both list types share this layout.
+    struct TR_StmList_ * grown = AR_resize(list, header_size + capacity * item_size,
+            header_size + new_capacity * item_size);
+    grown->length = length;
+    grown->capacity = new_capacity;
+    return grown;
 }
 
 TR_StmList TR_add_stm(TR_StmList list, TR_Stm stm) {
-    TR_StmList new_list = make_TR_StmList(stm, NULL);
-    if (!list) {
-        return new_list;
-    }
-    TR_StmList current = list;
-    while (current->tail) {
-        current = current->tail;
-    }
-    current->tail = new_list;
+    list = TR_grow_list(list, TR_stm_count(list), list ? list->capacity : 0, sizeof(stm));
+    list->items[list->length++] = stm;
     return list;
 }
 
+int TR_stm_count(TR_StmList list) {
+    return list ? list->length : 0;
+}
+
 
 TR_Exp make_TR_NumExp(int num) {
-    TR_Exp p = malloc_checked(sizeof(*p));
-    p->kind = TR_NUM_EXP;
+    TR_Exp p = TR_alloc_exp(TR_NUM_EXP, TR_EXP_SIZE(num));
     p->size = T_INT_SIZE;
     p->reg = -1;
     p->u.num = num;
@@ -221,41 +269,47 @@ TR_Exp make_TR_NumExp(int num) {
 }
 
 TR_Exp make_TR_StringExp(string lit) {
-    TR_Exp p = malloc_checked(sizeof(*p));
+    TR_Exp p = TR_alloc_exp(TR_STRING_EXP, TR_EXP_SIZE(str));
     p->size = T_POINTER_SIZE;
     p->reg = TR_new_temp();
-    p->kind = TR_STRING_EXP;
     p->u.str.str = lit;
     p->u.str.label = TR_new_label();
     return p;
 }
 
 TR_Exp make_TR_MemExp(S_Table venv, S_Symbol sym) {
-    TR_Exp p = malloc_checked(sizeof(*p));
+    TR_Exp p = TR_alloc_exp(TR_MEM_EXP, TR_EXP_SIZE(mem));
     E_EnvEntry var_entry = S_look(venv, sym);
     assert(var_entry);
     assert(var_entry->kind == E_VAR_ENTRY);
-    p->kind = TR_MEM_EXP;
     p->size = T_size(var_entry->u.var.type);
-    p->reg = -1;
+    p->reg = var_entry->u.var.temp;
     p->u.mem.name = sym;
     p->u.mem.nesting_level = var_entry->u.var.nesting_level;
     p->u.mem.offset = var_entry->u.var.offset;
     return p;
 }
 
+TR_Exp make_TR_VarMemExp(F_Var var, int nesting_level) {
+    TR_Exp p = TR_alloc_exp(TR_MEM_EXP, TR_EXP_SIZE(mem));
+    p->size = var->size;
+    p->reg = var->temp;
+    p->u.mem.name = var->name;
+    p->u.mem.nesting_level = nesting_level;
+    p->u.mem.offset = var->offset;
+    return p;
+}
+
 TR_Exp make_TR_VarExp(TR_Exp var) {
-    TR_Exp p = malloc_checked(sizeof(*p));
+    TR_Exp p = TR_alloc_exp(TR_VAR_EXP, TR_EXP_SIZE(var));
     p->size = var->size;
     p->reg = TR_new_temp();
-    p->kind = TR_VAR_EXP;
     p->u.var = var;
     return p;
 }
 
 TR_Exp make_TR_FieldExp(TR_Exp var, S_Symbol field_name, int field_size, int field_offset) {
-    TR_Exp p = malloc_checked(sizeof(*p));
-    p->kind = TR_FIELD_EXP;
+    TR_Exp p = TR_alloc_exp(TR_FIELD_EXP, TR_EXP_SIZE(field));
     p->size = field_size;
     p->reg = TR_new_temp();
     p->u.field.var = var;
@@ -265,8 +319,7 @@ TR_Exp make_TR_FieldExp(TR_Exp var, S_Symbol field_name, int field_size, int fie
 }
 
 TR_Exp make_TR_SubscriptExp(TR_Exp var, int element_size, TR_Exp index) {
-    TR_Exp p = malloc_checked(sizeof(*p));
-    p->kind = TR_SUBSCRIPT_EXP;
+    TR_Exp p = TR_alloc_exp(TR_SUBSCRIPT_EXP, TR_EXP_SIZE(subscript));
     p->size = element_size;
     p->reg = TR_new_temp();
     p->u.subscript.var = var;
@@ -275,28 +328,27 @@ TR_Exp make_TR_SubscriptExp(TR_Exp var, int element_size, TR_Exp index) {
 }
 
 TR_Exp make_TR_RecordExp(int size, TR_ExpList inits) {
-    TR_Exp p = malloc_checked(sizeof(*p));
-    p->kind = TR_RECORD_EXP;
+    TR_Exp p = TR_alloc_exp(TR_RECORD_EXP, TR_EXP_SIZE(record));
     p->size = size;
     p->reg = TR_new_temp();
-    p->u.record = inits;
+    p->u.record.fields = inits;
+    p->u.record.offset = -1;
     return p;
 }
 
 TR_Exp make_TR_ArrayExp(int size, TR_Exp init) {
-    TR_Exp p = malloc_checked(sizeof(*p));
-    p->kind = TR_ARRAY_EXP;
+    TR_Exp p = TR_alloc_exp(TR_ARRAY_EXP, TR_EXP_SIZE(array));
     p->size = size;
     p->reg = TR_new_temp();
-    p->u.array = init;
+    p->u.array.init = init;
+    p->u.array.offset = -1;
     return p;
 }
 
 TR_Exp make_TR_ArithOpExp(TR_Exp left, TR_Exp right, A_Oper op) {
-    TR_Exp p = malloc_checked(sizeof(*p));
+    TR_Exp p = TR_alloc_exp(TR_ARITH_OP_EXP, TR_EXP_SIZE(arith));
     p->size = right->size;
     p->reg = right->reg;
-    p->kind = TR_ARITH_OP_EXP;
     p->u.arith.left = left;
     p->u.arith.right = right;
     p->u.arith.op = op;
@@ -304,20 +356,18 @@ TR_Exp make_TR_ArithOpExp(TR_Exp left, TR_Exp right, A_Oper op) {
 }
 
 TR_Exp make_TR_DivOpExp(TR_Exp left, TR_Exp right) {
-    TR_Exp p = malloc_checked(sizeof(*p));
+    TR_Exp p = TR_alloc_exp(TR_DIV_OP_EXP, TR_EXP_SIZE(div));
     p->size = right->size;
     p->reg = right->reg;
-    p->kind = TR_DIV_OP_EXP;
     p->u.div.left = left;
     p->u.div.right = right;
     return p;
 }
 
 TR_Exp make_TR_RelOpExp(TR_Exp left, TR_Exp right, A_Oper op) {
-    TR_Exp p = malloc_checked(sizeof(*p));
+    TR_Exp p = TR_alloc_exp(TR_REL_OP_EXP, TR_EXP_SIZE(rel));
     p->size = T_INT_SIZE;
     p->reg = right->reg;
-    p->kind = TR_REL_OP_EXP;
     p->u.rel.left = left;
     p->u.rel.right = right;
     p->u.rel.op = op;
@@ -325,8 +375,9 @@ TR_Exp make_TR_RelOpExp(TR_Exp left, TR_Exp right, A_Oper op) {
 }
 
 TR_Exp make_TR_IfExp(TR_Exp test, TR_Exp true_branch) {
-    TR_Exp p = malloc_checked(sizeof(*p));
-    p->kind = TR_IF_EXP;
+    TR_Exp p = TR_alloc_exp(TR_IF_EXP, TR_EXP_SIZE(if_));
+    p->size = 0;
+    p->reg = -1;
     p->u.if_.test = test;
     p->u.if_.false_label = TR_new_label();
     p->u.if_.true_branch = true_branch;
@@ -334,8 +385,9 @@ TR_Exp make_TR_IfExp(TR_Exp test, TR_Exp true_branch) {
 }
 
 TR_Exp make_TR_IfElseExp(TR_Exp test, TR_Exp true_branch, TR_Exp false_branch) {
-    TR_Exp p = malloc_checked(sizeof(*p));
-    p->kind = TR_IF_ELSE_EXP;
+    TR_Exp p = TR_alloc_exp(TR_IF_ELSE_EXP, TR_EXP_SIZE(if_else));
+    p->size = true_branch ? true_branch->size : 0;
+    p->reg = -1;
     p->u.if_else.test = test;
     p->u.if_else.false_label = TR_new_label();
     p->u.if_else.true_branch = true_branch;
@@ -345,63 +397,54 @@ TR_Exp make_TR_IfElseExp(TR_Exp test, TR_Exp true_branch, TR_Exp false_branch) {
 }
 
 TR_Exp make_TR_FCallExp(S_Table venv, S_Symbol name, TR_ExpList args) {
-    TR_Exp p = malloc_checked(sizeof(*p));
+    TR_Exp p = TR_alloc_exp(TR_FCALL_EXP, TR_EXP_SIZE(fcall));
     E_EnvEntry func_entry = S_look(venv, name);
     assert(func_entry);
     assert(func_entry->kind = E_FUN_ENTRY);
     assert(func_entry->u.fun.result);
     p->size = T_size(func_entry->u.fun.result);
     p->reg = TR_new_temp();
-    p->kind = TR_FCALL_EXP;
     p->u.fcall.name = name;
     p->u.fcall.args = args;
     return p;
 }
 
 TR_Exp make_TR_SeqExp(TR_StmList stms) {
-    TR_Exp p = malloc_checked(sizeof(*p));
-    p->kind = TR_SEQ_EXP;
+    TR_Exp p = TR_alloc_exp(TR_SEQ_EXP, TR_EXP_SIZE(seq));
+    p->size = 0;
+    p->reg = -1;
     p->u.seq = stms;
     return p;
 }
 
 TR_Stm TR_convert_seq_exp_to_stm(TR_Exp seq) {
-    TR_Stm p = malloc_checked(sizeof(*p));
-    p->kind = TR_SEQ_STM;
+    if (!seq || seq->kind != TR_SEQ_EXP) {
+        return make_TR_ExpStm(seq);
+    }
+    TR_Stm p = TR_alloc_stm(TR_SEQ_STM, TR_STM_SIZE(seq));
     p->u.seq = seq->u.seq;
     return p;
 }
 
 TR_Exp TR_convert_seq_stm_to_exp(TR_Stm seq, int size) {
-    TR_Exp p = malloc_checked(sizeof(*p));
-    p->kind = TR_SEQ_EXP;
+    TR_Exp p = TR_alloc_exp(TR_SEQ_EXP, TR_EXP_SIZE(seq));
     p->reg = TR_new_temp();
     p->size = size;
-    p->u.seq = seq->u.seq;
+    p->u.seq = seq && seq->kind == TR_SEQ_STM ? seq->u.seq : TR_add_stm(NULL, seq);
     return p;
 }
 
 
-TR_ExpList make_TR_ExpList(TR_Exp head, TR_ExpList tail) {
-    TR_ExpList p = malloc_checked(sizeof(*p));
-    p->head = head;
-    p->tail = tail;
-    return p;
-}
-
 TR_ExpList TR_add_exp(TR_ExpList list, TR_Exp exp) {
-    TR_ExpList new_list = make_TR_ExpList(exp, NULL);
-    if (!list) {
-        return new_list;
-    }
-    TR_ExpList current = list;
-    while (current->tail) {
-        current = current->tail;
-    }
-    current->tail = new_list;
+    list = TR_grow_list(list, TR_exp_count(list), list ? list->capacity : 0, sizeof(exp));
+    list->items[list->length++] = exp;
     return list;
 }
 
+int TR_exp_count(TR_ExpList list) {
+    return list ? list->length : 0;
+}
+
 TR_LabelList make_TR_LabelList(TR_Label label) {
     TR_LabelList p = malloc_checked(sizeof(*p));
     p->head = label;
@@ -424,13 +467,36 @@ void TR_pop_loop() {
 }
 
 TR_Label TR_new_temp() {
-    static TR_Temp temp = 0;
-    return temp++;
+    return next_temp++;
 }
 
 TR_Label TR_new_label() {
-    static TR_Label label = 0;
-    return label++;
+    return next_label++;
+}
+
+TR_State make_TR_State() {
+    TR_State state = { 0, 0, NULL };
+    return state;
+}
+
+TR_State TR_swap_state(TR_State state) {
+    TR_State previous = { next_temp, next_label, TR_loop_list };
+    next_temp = state.temps;
+    next_label = state.labels;
+    TR_loop_list = state.loops;
+    return previous;
+}
+
+TR_State TR_begin_function() {
+    return TR_swap_state(make_TR_State());
+}
+
+void TR_end_function(TR_Function func, TR_State enclosing) {
+    TR_State used = TR_swap_state(enclosing);
+    if (func) {
+        func->temp_count = used.temps;
+        func->label_count = used.labels;
+    }
 }
 
 void TR_print_function(TR_Function func) {
@@ -441,6 +507,7 @@ void TR_print_function(TR_Function func) {
     if (func->parent) {
         printf("\tParent: %s\n", S_name(func->parent->name));
     }
+    printf("\tTemps: %d - Labels: %d\n", func->temp_count, func->label_count);
     if (func->frame) {
         F_print_frame(func->frame);
     }
@@ -8,7 +8,7 @@
 #define TR_ESC_REG 15
 #define TR_ESC_REG2 14
 
-typedef struct TR_TransExp_ * TR_TransExp;
+typedef struct TR_TransExp_ TR_TransExp;
 typedef struct TR_Function_ * TR_Function;
 typedef struct TR_FunctionList_ * TR_FunctionList;
 typedef struct TR_Stm_ * TR_Stm;
@@ -20,8 +20,12 @@ typedef struct TR_VarList_ *TR_VarList;
 typedef int TR_Label;
 typedef int TR_Temp;
 
+/* The result of translating one AST node: a tagged handle to
+ * the IR it produced, passed by value. TR_NONE marks the absence
+ * of a translation (e.g. after a type error).
+ */
 struct TR_TransExp_ {
-    enum { TR_FUNCTION, TR_STM, TR_EXP } kind;
+    enum { TR_NONE, TR_FUNCTION, TR_STM, TR_EXP } kind;
     union {
         TR_Function function;
         TR_Stm stm;
@@ -35,6 +39,12 @@ struct TR_Function_ {
     TR_Function parent;
     TR_FunctionList children;
     TR_StmList body;
+    /* The last cell of children, so appending takes constant time. */
+    TR_FunctionList last_child;
+    /* Each function numbers its own temps and labels densely from 0;
+     * these are how many it used. */
+    TR_Temp temp_count;
+    TR_Label label_count;
 };
 
 struct TR_FunctionList_ {
@@ -47,6 +57,8 @@ struct TR_VarList_ {
     TR_VarList tail;
 };
 
+/* Statements and expressions are allocated from the arena, each only
+ * as large as its kind's variant of u, so a node is never copied whole. */
 struct TR_Stm_ {
     enum {
         TR_ASSIGN_STM,
@@ -94,9 +106,12 @@ struct TR_Stm_ {
     } u;
 };
 
+/* A list of statements or expressions is one block: a header
+ * and the children in order. NULL is the empty list. */
 struct TR_StmList_ {
-    TR_Stm head;
-    TR_StmList tail;
+    int length;
+    int capacity;
+    TR_Stm items[];
 };
 
 struct TR_Exp_ {
@@ -122,6 +137,9 @@ struct TR_Exp_ {
     union {
         int num;
         struct { string str; TR_Label label; } str;
+        /* A variable of the frame at nesting_level; or, if reg is not -1,
+         * one kept in that temp of its own function, with offset -1.
+         * A parameter kept in a temp holds its argument on entry. */
         struct { S_Symbol name; int nesting_level; int offset; } mem;
         TR_Exp var;
         struct { TR_Exp var; S_Symbol field_name; int field_offset; } field;
@@ -142,15 +160,18 @@ struct TR_Exp_ {
             TR_Label join_label;
         } if_else;
         struct { S_Symbol name; TR_ExpList args; } fcall;
-        TR_Exp array;
-        TR_ExpList  record;
+        /* An object lives on the heap if offset is -1, and otherwise
+         * in its function's frame, in the object slot at offset. */
+        struct { TR_Exp init; int offset; } array;
+        struct { TR_ExpList fields; int offset; } record;
         TR_StmList seq;
     } u;
 };
 
 struct TR_ExpList_ {
-    TR_Exp head;
-    TR_ExpList tail;
+    int length;
+    int capacity;
+    TR_Exp items[];
 };
 
 struct TR_LabelList_ {
@@ -158,8 +179,22 @@ struct TR_LabelList_ {
     TR_LabelList tail;
 };
 
-extern TR_LabelList TR_loop_list;
+/* Translation state private to a thread: the temp and label counters
+ * of the function being translated and the stack of its enclosing
+ * loops' skip labels. */
+typedef struct TR_State_ {
+    TR_Temp temps;
+    TR_Label labels;
+    TR_LabelList loops;
+} TR_State;
 
+extern __thread TR_LabelList TR_loop_list;
+
+/* The bytes a node occupies, which depend on its kind. */
+int TR_stm_size(TR_Stm stm);
+int TR_exp_size(TR_Exp exp);
+
+TR_TransExp make_TR_TransNone();
 TR_TransExp make_TR_TransFunction(TR_Function function);
 TR_TransExp make_TR_TransStm(TR_Stm stm);
 TR_TransExp make_TR_TransExp(TR_Exp exp);
@@ -167,8 +202,10 @@ TR_TransExp make_TR_TransExp(TR_Exp exp);
 TR_Function make_TR_Function(S_Symbol name, F_Frame frame);
 TR_FunctionList make_TR_FunctionList(TR_Function head, TR_FunctionList tail);
 void TR_append_function(TR_Function parent, TR_Function child);
-void TR_add_param(TR_Function func, S_Symbol name, T_Type type);
-void TR_add_var(TR_Function func, S_Symbol name, T_Type type);
+/* Declare a parameter or variable of func; one that does not escape
+ * gets a temp of the function being translated. */
+F_Var TR_add_param(TR_Function func, S_Symbol name, T_Type type, bool escape);
+F_Var TR_add_var(TR_Function func, S_Symbol name, T_Type type, bool escape);
 void TR_add_stm_to_function(TR_Function func, TR_Stm stm);
 void TR_add_stm_list_to_function(TR_Function func, TR_StmList stms);
 
@@ -182,14 +219,19 @@ TR_Stm make_TR_ForStm(TR_Exp var, TR_Exp lo, TR_Exp hi, TR_Stm body);
 TR_Stm make_TR_BreakStm(TR_Label skip_label);
 TR_Stm make_TR_ExpStm(TR_Exp exp);
 
-TR_StmList make_TR_StmList(TR_Stm head, TR_StmList tail);
+/* Append stm to list, which grows by doubling, so appending takes
+ * amortized constant time. Returns the list, which may have moved. */
 TR_StmList TR_add_stm(TR_StmList list, TR_Stm stm);
+int TR_stm_count(TR_StmList list);
 
 
 
 TR_Exp make_TR_NumExp(int num);
 TR_Exp make_TR_StringExp(string lit);
 TR_Exp make_TR_MemExp(S_Table venv, S_Symbol sym);
+/* A mem_exp for var, of the function at nesting_level, for passes that
+ * add variables after translation. */
+TR_Exp make_TR_VarMemExp(F_Var var, int nesting_level);
 TR_Exp make_TR_VarExp(TR_Exp var);
 TR_Exp make_TR_FieldExp(TR_Exp var, S_Symbol field_name, int field_size, int field_offset);
 TR_Exp make_TR_SubscriptExp(TR_Exp var, int element_size, TR_Exp index);
@@ -203,11 +245,14 @@ TR_Exp make_TR_IfElseExp(TR_Exp test, TR_Exp true_branch, TR_Exp false_branch);
 TR_Exp make_TR_FCallExp(S_Table venv, S_Symbol name, TR_ExpList args);
 TR_Exp make_TR_SeqExp(TR_StmList stms);
 
+/* Convert a sequence between its expression and statement forms;
+ * anything else is wrapped as the sequence's only statement. */
 TR_Stm TR_convert_seq_exp_to_stm(TR_Exp seq);
 TR_Exp TR_convert_seq_stm_to_exp(TR_Stm seq, int size);
 
-TR_ExpList make_TR_ExpList(TR_Exp head, TR_ExpList tail);
+/* Append exp to list, as TR_add_stm does. */
 TR_ExpList TR_add_exp(TR_ExpList list, TR_Exp exp);
+int TR_exp_count(TR_ExpList list);
 
 TR_LabelList make_TR_LabelList(TR_Label label);
 void TR_push_loop(TR_Label label);
@@ -215,5 +260,15 @@ void TR_pop_loop();
 
 TR_Label TR_new_label();
 TR_Temp TR_new_temp();
+TR_State make_TR_State();
+TR_State TR_swap_state(TR_State state);
+
+/* Start translating a function body on the calling thread, numbering
+ * its temps and labels from 0. Returns the enclosing state, which
+ * TR_end_function restores after recording func's counts; func may be
+ * NULL when only checking. Functions translated on different threads
+ * therefore need no coordination. */
+TR_State TR_begin_function();
+void TR_end_function(TR_Function func, TR_State enclosing);
 
 void TR_print_function(TR_Function func);
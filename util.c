@@ -8,10 +8,23 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "stats.h"
 #include "util.h"
 
 void * malloc_checked(int len) {
     void * p = malloc(len);
+    if (STAT_counting) {
+        STAT_count_allocation(len);
+    }
+    if (!p) {
+        perror("Memory allocation failure");
+        exit(1);
+    }
+    return p;
+}
+
+void * realloc_checked(void * p, int len) {
+    p = realloc(p, len);
     if (!p) {
         perror("Memory allocation failure");
         exit(1);
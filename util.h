@@ -20,6 +20,7 @@ struct UBoolList_ {
 };
 
 void * malloc_checked(int);
+void * realloc_checked(void *, int);
 string make_String(const char * const);
 UBoolList make_UBoolList(bool head, UBoolList tail);
 
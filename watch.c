@@ -0,0 +1,127 @@
+/*
+ * watch.c -
+ * Implementation of the directory watcher.
+ * See watch.h for more information.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "symbol.h"
+#include "watch.h"
+
+/* How long the directory must be quiet before changes are reported. */
+#define WA_QUIET_MS 30
+#define WA_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_DELETE_SELF)
+
+typedef struct WA_NameList_ * WA_NameList;
+
+struct WA_NameList_ {
+    S_Symbol name;
+    WA_NameList tail;
+};
+
+static bool WA_is_source(const char * name) {
+    size_t length = strlen(name);
+    return length > 4 && !strcmp(name + length - 4, ".tig");
+}
+
+static string WA_path(string dir, const char * name) {
+    string path = malloc_checked(strlen(dir) + strlen(name) + 2);
+    sprintf(path, "%s/%s", dir, name);
+    return path;
+}
+
+static int WA_select_source(const struct dirent * dirent) {
+    return WA_is_source(dirent->d_name);
+}
+
+/* Adds name to the pending changes unless it is already there;
+ * names are interned, so they compare by address. The symbol table
+ * keeps the string it is given, and name is in the read buffer, so
+ * a copy is interned. */
+static WA_NameList WA_add_name(WA_NameList names, const char * name) {
+    S_Symbol sym = make_S_Symbol(make_String(name));
+    for (WA_NameList list = names; list; list = list->tail) {
+        if (list->name == sym) {
+            return names;
+        }
+    }
+    WA_NameList list = malloc_checked(sizeof(*list));
+    list->name = sym;
+    list->tail = names;
+    return list;
+}
+
+/* Reads the events waiting on fd into the pending changes;
+ * false if the directory itself is gone or fd fails. */
+static bool WA_read_events(int fd, WA_NameList * names) {
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t got = read(fd, buffer, sizeof(buffer));
+    if (got < 0) {
+        return errno == EINTR || errno == EAGAIN;
+    }
+    for (char * p = buffer; p < buffer + got; ) {
+        struct inotify_event * event = (struct inotify_event *) p;
+        if (event->mask & (IN_DELETE_SELF | IN_IGNORED)) {
+            return false;
+        }
+        if (event->len && WA_is_source(event->name)) {
+            *names = WA_add_name(*names, event->name);
+        }
+        p += sizeof(*event) + event->len;
+    }
+    return true;
+}
+
+/* Reports the pending changes in the order they first occurred. */
+static void WA_report(string dir, WA_NameList names, WA_Handler handler) {
+    if (!names) {
+        return;
+    }
+    WA_report(dir, names->tail, handler);
+    string path = WA_path(dir, S_name(names->name));
+    handler(path, access(path, F_OK) != 0);
+}
+
+int WA_watch(string dir, WA_Handler handler) {
+    int fd = inotify_init();
+    if (fd < 0 || inotify_add_watch(fd, dir, WA_EVENTS) < 0) {
+        perror(dir);
+        return EXIT_FAILURE;
+    }
+    // Watch first, so that no change made during the first pass is missed.
+    struct dirent ** sources;
+    int count = scandir(dir, &sources, WA_select_source, alphasort);
+    if (count < 0) {
+        perror(dir);
+        return EXIT_FAILURE;
+    }
+    for (int i = 0; i < count; ++i) {
+        handler(WA_path(dir, sources[i]->d_name), false);
+        free(sources[i]);
+    }
+    free(sources);
+    struct pollfd pollfd = { fd, POLLIN, 0 };
+    for (;;) {
+        WA_NameList names = NULL;
+        if (!WA_read_events(fd, &names)) {
+            fprintf(stderr, "stopped watching %s\n", dir);
+            return EXIT_FAILURE;
+        }
+        // Debounce: wait out the rest of the burst.
+        while (poll(&pollfd, 1, WA_QUIET_MS) > 0) {
+            if (!WA_read_events(fd, &names)) {
+                fprintf(stderr, "stopped watching %s\n", dir);
+                return EXIT_FAILURE;
+            }
+        }
+        WA_report(dir, names, handler);
+    }
+}
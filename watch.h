@@ -0,0 +1,23 @@
+/*
+ * watch.h -
+ * Watches a directory for changes to Tiger sources with inotify.
+ * Editors save a file in bursts of writes (truncate, write, rename),
+ * so changes are collected until the directory has been quiet for
+ * a moment, and each changed file is then reported once.
+ * Only the directory itself is watched, not its subdirectories.
+ * All types and functions declared in this module begin with "WA_".
+ */
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "util.h"
+
+/* Called with the path of a Tiger source that is new or changed,
+ * or, with removed set, that is gone. */
+typedef void (*WA_Handler)(string path, bool removed);
+
+/* Report every Tiger source in dir, in name order, and then each one
+ * that changes, until killed; returns only on error. */
+int WA_watch(string dir, WA_Handler handler);
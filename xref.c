@@ -0,0 +1,243 @@
+/*
+ * xref.c -
+ * Implementation of the cross-reference index.
+ * See xref.h for more information.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xref.h"
+
+/* A declaration or use: where it is and what it refers to. */
+typedef struct XR_Occurrence_ {
+    A_Pos pos;
+    XR_Decl decl;
+} XR_Occurrence;
+
+struct XR_Index_ {
+    /* Open-addressed map from environment entries to declarations. */
+    XR_Decl * decls;
+    int decl_count;
+    int decl_capacity;
+    XR_Occurrence * occurrences;
+    int count;
+    int capacity;
+    /* Whether the occurrences are in source order. */
+    bool sorted;
+};
+
+XR_Index make_XR_Index() {
+    XR_Index index = malloc_checked(sizeof(*index));
+    index->decl_count = 0;
+    index->decl_capacity = 64;
+    index->decls = malloc_checked(index->decl_capacity * sizeof(*index->decls));
+    memset(index->decls, 0, index->decl_capacity * sizeof(*index->decls));
+    index->count = 0;
+    index->capacity = 64;
+    index->occurrences = malloc_checked(index->capacity * sizeof(*index->occurrences));
+    index->sorted = true;
+    return index;
+}
+
+static unsigned XR_hash(E_EnvEntry entry, int capacity) {
+    return (unsigned) (((uintptr_t) entry >> 4) * 2654435761u) & (capacity - 1);
+}
+
+/* The slot holding entry's declaration, or the empty slot where it belongs. */
+static XR_Decl * XR_slot(XR_Decl * decls, int capacity, E_EnvEntry entry) {
+    unsigned i = XR_hash(entry, capacity);
+    while (decls[i] && decls[i]->entry != entry) {
+        i = (i + 1) & (capacity - 1);
+    }
+    return &decls[i];
+}
+
+static XR_Decl XR_decl(XR_Index index, S_Symbol name, E_EnvEntry entry) {
+    XR_Decl * slot = XR_slot(index->decls, index->decl_capacity, entry);
+    if (*slot) {
+        return *slot;
+    }
+    XR_Decl decl = malloc_checked(sizeof(*decl));
+    decl->name = name;
+    decl->entry = entry;
+    decl->declared = false;
+    decl->uses = NULL;
+    decl->use_count = 0;
+    *slot = decl;
+    // Keep the map at most half full.
+    if (2 * ++index->decl_count > index->decl_capacity) {
+        int capacity = 2 * index->decl_capacity;
+        XR_Decl * decls = malloc_checked(capacity * sizeof(*decls));
+        memset(decls, 0, capacity * sizeof(*decls));
+        for (int i = 0; i < index->decl_capacity; ++i) {
+            if (index->decls[i]) {
+                *XR_slot(decls, capacity, index->decls[i]->entry) = index->decls[i];
+            }
+        }
+        free(index->decls);
+        index->decls = decls;
+        index->decl_capacity = capacity;
+    }
+    return decl;
+}
+
+static void XR_add(XR_Index index, A_Pos pos, XR_Decl decl) {
+    if (index->count == index->capacity) {
+        XR_Occurrence * grown = malloc_checked(2 * index->capacity * sizeof(*grown));
+        memcpy(grown, index->occurrences, index->count * sizeof(*grown));
+        free(index->occurrences);
+        index->occurrences = grown;
+        index->capacity *= 2;
+    }
+    index->occurrences[index->count++] = (XR_Occurrence) { pos, decl };
+    index->sorted = false;
+}
+
+void XR_declare(XR_Index index, S_Symbol name, E_EnvEntry entry, A_Pos pos) {
+    XR_Decl decl = XR_decl(index, name, entry);
+    decl->declared = true;
+    decl->pos = pos;
+    XR_add(index, pos, decl);
+}
+
+void XR_use(XR_Index index, S_Symbol name, E_EnvEntry entry, A_Pos pos) {
+    XR_Decl decl = XR_decl(index, name, entry);
+    XR_PosList uses = malloc_checked(sizeof(*uses));
+    uses->head = pos;
+    uses->tail = decl->uses;
+    decl->uses = uses;
+    ++decl->use_count;
+    XR_add(index, pos, decl);
+}
+
+static int XR_compare_pos(A_Pos a, A_Pos b) {
+    if (a.first_line != b.first_line) {
+        return a.first_line < b.first_line ? -1 : 1;
+    }
+    return (a.first_column > b.first_column) - (a.first_column < b.first_column);
+}
+
+static int XR_compare_occurrences(const void * a, const void * b) {
+    return XR_compare_pos(((const XR_Occurrence *) a)->pos, ((const XR_Occurrence *) b)->pos);
+}
+
+/* Whether the token at pos covers the given column of its line. */
+static bool XR_covers(A_Pos pos, int line, int column) {
+    if (pos.first_line != line || column < pos.first_column) {
+        return false;
+    }
+    return column == pos.first_column || column < pos.last_column;
+}
+
+XR_Decl XR_find(XR_Index index, int line, int column) {
+    if (!index->sorted) {
+        qsort(index->occurrences, index->count, sizeof(*index->occurrences),
+                XR_compare_occurrences);
+        index->sorted = true;
+    }
+    // The last occurrence starting at or before the position.
+    A_Pos at = { line, column, line, column };
+    int low = 0;
+    int high = index->count;
+    while (low < high) {
+        int middle = low + (high - low) / 2;
+        if (XR_compare_pos(index->occurrences[middle].pos, at) <= 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    if (low && XR_covers(index->occurrences[low - 1].pos, line, column)) {
+        return index->occurrences[low - 1].decl;
+    }
+    return NULL;
+}
+
+static void XR_append(string * text, int * length, int * capacity, const char * s) {
+    int size = strlen(s);
+    if (*length + size + 1 > *capacity) {
+        *capacity = 2 * *capacity + size + 1;
+        string grown = malloc_checked(*capacity);
+        memcpy(grown, *text, *length);
+        *text = grown;
+    }
+    memcpy(*text + *length, s, size + 1);
+    *length += size;
+}
+
+/* Appends a type: named types by name, others by structure. */
+static void XR_append_type(string * text, int * length, int * capacity, T_Type type, bool top) {
+    if (!type) {
+        XR_append(text, length, capacity, "?");
+        return;
+    }
+    switch (type->kind) {
+        case T_INT:
+            XR_append(text, length, capacity, "int");
+            break;
+        case T_STRING:
+            XR_append(text, length, capacity, "string");
+            break;
+        case T_NIL:
+            XR_append(text, length, capacity, "nil");
+            break;
+        case T_VOID:
+            XR_append(text, length, capacity, "void");
+            break;
+        case T_NAME:
+            XR_append(text, length, capacity, S_name(type->u.name.sym));
+            break;
+        case T_ARRAY:
+            XR_append(text, length, capacity, "array of ");
+            XR_append_type(text, length, capacity, type->u.array, false);
+            break;
+        case T_RECORD:
+            // Only the outermost record is spelled out; records may be recursive.
+            if (!top) {
+                XR_append(text, length, capacity, "{...}");
+                break;
+            }
+            XR_append(text, length, capacity, "{");
+            for (T_FieldList fields = type->u.record; fields; fields = fields->tail) {
+                XR_append(text, length, capacity, S_name(fields->head->name));
+                XR_append(text, length, capacity, ": ");
+                XR_append_type(text, length, capacity, fields->head->type, false);
+                if (fields->tail) {
+                    XR_append(text, length, capacity, ", ");
+                }
+            }
+            XR_append(text, length, capacity, "}");
+            break;
+    }
+}
+
+string XR_describe(XR_Decl decl) {
+    int length = 0;
+    int capacity = 64;
+    string text = malloc_checked(capacity);
+    text[0] = '\0';
+    XR_append(&text, &length, &capacity, S_name(decl->name));
+    E_EnvEntry entry = decl->entry;
+    if (entry->kind == E_VAR_ENTRY) {
+        XR_append(&text, &length, &capacity, ": ");
+        XR_append_type(&text, &length, &capacity, entry->u.var.type, true);
+        return text;
+    }
+    XR_append(&text, &length, &capacity, "(");
+    for (T_TypeList formals = entry->u.fun.formals; formals; formals = formals->tail) {
+        XR_append_type(&text, &length, &capacity, formals->head, false);
+        if (formals->tail) {
+            XR_append(&text, &length, &capacity, ", ");
+        }
+    }
+    XR_append(&text, &length, &capacity, "): ");
+    XR_append_type(&text, &length, &capacity, entry->u.fun.result, false);
+    return text;
+}
+
+int XR_size(XR_Index index) {
+    return index->count;
+}
@@ -0,0 +1,54 @@
+/*
+ * xref.h -
+ * A cross-reference index of a checked program: for every name that
+ * is declared or used, its source position and the declaration it
+ * resolves to, with that declaration's type. Semantic analysis fills
+ * the index as it resolves names (see SEM_check_prog_indexed); queries
+ * then find the name at a position by binary search.
+ * Declarations are located at their first token: the keyword of a
+ * var, function or for, or the name of a parameter.
+ * All types and functions declared in this module begin with "XR_".
+ */
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "absyn.h"
+#include "env.h"
+#include "symbol.h"
+
+typedef struct XR_Index_ * XR_Index;
+typedef struct XR_Decl_ * XR_Decl;
+typedef struct XR_PosList_ * XR_PosList;
+
+struct XR_PosList_ {
+    A_Pos head;
+    XR_PosList tail;
+};
+
+struct XR_Decl_ {
+    S_Symbol name;
+    E_EnvEntry entry;
+    /* False for the built-in functions, which have no position. */
+    bool declared;
+    A_Pos pos;
+    /* The positions where the name is used, latest first. */
+    XR_PosList uses;
+    int use_count;
+};
+
+XR_Index make_XR_Index();
+
+/* Record a declaration, or a use of the declaration entry resolved to. */
+void XR_declare(XR_Index index, S_Symbol name, E_EnvEntry entry, A_Pos pos);
+void XR_use(XR_Index index, S_Symbol name, E_EnvEntry entry, A_Pos pos);
+
+/* The declaration declared or used at the given line and column, or NULL. */
+XR_Decl XR_find(XR_Index index, int line, int column);
+
+/* The declaration's name and type, as in "x: int" or "f(int, string): int". */
+string XR_describe(XR_Decl decl);
+
+/* The number of declarations and uses recorded. */
+int XR_size(XR_Index index);